@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "allocation_counter.h"
+
+namespace util {
+
+// Counts the allocations made while a benchmark runs and reports them per iteration
+// NOTE: The counts are for the whole process, so this is only accurate for single threaded benchmarks
+// Usage:
+// cAllocationCounter allocation_counter;
+// for (auto _ : state) { ... }
+// allocation_counter.SetCounters(state);
+class cAllocationCounter {
+public:
+  cAllocationCounter();
+
+  // Adds allocations_per_op and allocated_bytes_per_op to the benchmark's output
+  void SetCounters(benchmark::State& state) const;
+
+private:
+  uint64_t allocations_at_start;
+  uint64_t allocated_bytes_at_start;
+};
+
+// Reports the size of each message that a benchmark produces, as bytes_per_op and as a throughput
+void SetBytesPerOperation(benchmark::State& state, uint64_t bytes);
+
+}
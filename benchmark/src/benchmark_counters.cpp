@@ -0,0 +1,24 @@
+#include "benchmark_counters.h"
+
+namespace util {
+
+cAllocationCounter::cAllocationCounter() :
+  allocations_at_start(GetAllocationCount()),
+  allocated_bytes_at_start(GetAllocatedBytes())
+{
+}
+
+void cAllocationCounter::SetCounters(benchmark::State& state) const
+{
+  state.counters["allocations_per_op"] = benchmark::Counter(double(GetAllocationCount() - allocations_at_start), benchmark::Counter::kAvgIterations);
+  state.counters["allocated_bytes_per_op"] = benchmark::Counter(double(GetAllocatedBytes() - allocated_bytes_at_start), benchmark::Counter::kAvgIterations);
+}
+
+void SetBytesPerOperation(benchmark::State& state, uint64_t bytes)
+{
+  // Each thread reports the same size, so average rather than sum them
+  state.counters["bytes_per_op"] = benchmark::Counter(double(bytes), benchmark::Counter::kAvgThreads);
+  state.SetBytesProcessed(int64_t(state.iterations() * bytes));
+}
+
+}
@@ -0,0 +1,4 @@
+// Google Benchmark headers
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
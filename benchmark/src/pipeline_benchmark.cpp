@@ -0,0 +1,208 @@
+// Standard headers
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Google Benchmark headers
+#include <benchmark/benchmark.h>
+
+// Application headers
+#include "car_update_processor.h"
+#include "synthetic_pipeline.h"
+#include "trace.h"
+
+// The whole pipeline from a raw ACUDP packet to a websocket frame for every client, using the real ingest and sender code with the sockets replaced by memory
+// ProcessUpdate -> ac_data -> cWebSocketSender::SendUpdate -> EncodeWebSocketFrame -> cMemoryFrameSink
+
+namespace {
+
+typedef std::array<uint8_t, sizeof(acudp_car_t)> packet_t;
+
+// A few laps of raw packets, so that the track map and gear ratio estimates settle like they would in a session
+std::vector<packet_t> GetSyntheticPackets()
+{
+  const std::vector<acudp_car_t> samples = GetSyntheticLaps(3);
+
+  std::vector<packet_t> packets(samples.size());
+  for (size_t i = 0; i < samples.size(); i++) {
+    memcpy(packets[i].data(), &samples[i], sizeof(acudp_car_t));
+  }
+
+  return packets;
+}
+
+// The wake up for one sender thread in BM_PipelineThreadPerClient
+class cSenderWakeUp {
+public:
+  cSenderWakeUp() : wake_up_notify(false), stop(false) {}
+
+  std::mutex wake_up_mutex;
+  std::condition_variable wake_up_sender;
+  bool wake_up_notify; // Protected by wake_up_mutex
+  bool stop; // Protected by wake_up_mutex
+};
+
+// Decoding is a copy of the datagram into the struct, which is all the acudp library does after receiving it
+void IngestPacket(acdisplay::cCarUpdateProcessor& processor, const packet_t& packet)
+{
+  acudp_car_t car;
+  memcpy(&car, packet.data(), sizeof(car));
+  processor.ProcessUpdate(car, util::GetMonotonicTimeUS());
+}
+
+void SetPipelineCounters(benchmark::State& state, std::vector<uint64_t>& latencies_ns, const std::vector<std::unique_ptr<cMemoryClient>>& clients)
+{
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  for (auto&& client : clients) {
+    frames += client->sink.frames;
+    bytes += client->sink.bytes;
+  }
+
+  state.counters["samples_per_second"] = benchmark::Counter(double(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["frames_per_second"] = benchmark::Counter(double(frames), benchmark::Counter::kIsRate);
+  state.SetBytesProcessed(int64_t(bytes));
+
+  if (latencies_ns.empty()) {
+    return;
+  }
+
+  // The latency is from receiving a sample to the last client's frame being written
+  std::sort(latencies_ns.begin(), latencies_ns.end());
+  auto percentile_us = [&latencies_ns](double percentile) {
+    return double(latencies_ns[size_t(percentile * double(latencies_ns.size() - 1))]) / 1000.0;
+  };
+  state.counters["latency_p50_us"] = percentile_us(0.5);
+  state.counters["latency_p99_us"] = percentile_us(0.99);
+  state.counters["latency_max_us"] = percentile_us(1.0);
+}
+
+}
+
+// One thread receives each sample and then sends it to every client in turn, this is the CPU cost of a sample without any thread wake ups
+static void BM_PipelineSequential(benchmark::State& state)
+{
+  const std::vector<packet_t> packets = GetSyntheticPackets();
+
+  acdisplay::cCarUpdateProcessor processor;
+
+  std::vector<std::unique_ptr<cMemoryClient>> clients;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    clients.push_back(std::make_unique<cMemoryClient>(int(i)));
+  }
+
+  std::vector<uint64_t> latencies_ns;
+  latencies_ns.reserve(1000000);
+
+  size_t sample = 0;
+  for (auto _ : state) {
+    const uint64_t start_ns = util::GetTraceTimeNS();
+
+    IngestPacket(processor, packets[sample]);
+    sample = (sample + 1) % packets.size();
+
+    for (auto&& client : clients) {
+      client->sender->SendUpdate();
+    }
+
+    if (latencies_ns.size() < latencies_ns.capacity()) {
+      latencies_ns.push_back(util::GetTraceTimeNS() - start_ns);
+    }
+  }
+
+  SetPipelineCounters(state, latencies_ns, clients);
+}
+BENCHMARK(BM_PipelineSequential)->ArgName("clients")->Arg(1)->Arg(10)->Arg(100)->Arg(1000)->UseRealTime();
+
+// Like the web server, each client has its own sender thread, the ingest thread wakes them all for each sample and waits for the last one to finish
+static void BM_PipelineThreadPerClient(benchmark::State& state)
+{
+  const std::vector<packet_t> packets = GetSyntheticPackets();
+
+  acdisplay::cCarUpdateProcessor processor;
+
+  std::vector<std::unique_ptr<cMemoryClient>> clients;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    clients.push_back(std::make_unique<cMemoryClient>(int(i)));
+  }
+
+  // Each sender has its own wake up mutex and condition variable like ConnectedUser, so waking one client doesn't contend with the others
+  std::vector<std::unique_ptr<cSenderWakeUp>> wake_ups;
+  for (size_t i = 0; i < clients.size(); i++) {
+    wake_ups.push_back(std::make_unique<cSenderWakeUp>());
+  }
+
+  // The last sender to finish a sample wakes the ingest thread
+  std::atomic<size_t> remaining(0);
+  std::mutex mutex_done;
+  std::condition_variable cv_done;
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < clients.size(); i++) {
+    threads.emplace_back([&, sender = clients[i]->sender.get(), &wake_up = *wake_ups[i]]() {
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(wake_up.wake_up_mutex);
+          wake_up.wake_up_sender.wait(lock, [&]{ return wake_up.stop || wake_up.wake_up_notify; });
+          if (wake_up.stop) {
+            return;
+          }
+          wake_up.wake_up_notify = false;
+        }
+
+        sender->SendUpdate();
+
+        if (remaining.fetch_sub(1) == 1) {
+          std::lock_guard<std::mutex> lock(mutex_done);
+          cv_done.notify_one();
+        }
+      }
+    });
+  }
+
+  std::vector<uint64_t> latencies_ns;
+  latencies_ns.reserve(1000000);
+
+  size_t sample = 0;
+  for (auto _ : state) {
+    const uint64_t start_ns = util::GetTraceTimeNS();
+
+    IngestPacket(processor, packets[sample]);
+    sample = (sample + 1) % packets.size();
+
+    remaining.store(clients.size());
+    for (auto&& wake_up : wake_ups) {
+      std::lock_guard<std::mutex> lock(wake_up->wake_up_mutex);
+      wake_up->wake_up_notify = true;
+      wake_up->wake_up_sender.notify_one();
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_done);
+      cv_done.wait(lock, [&]{ return (remaining.load() == 0); });
+    }
+
+    if (latencies_ns.size() < latencies_ns.capacity()) {
+      latencies_ns.push_back(util::GetTraceTimeNS() - start_ns);
+    }
+  }
+
+  for (auto&& wake_up : wake_ups) {
+    std::lock_guard<std::mutex> lock(wake_up->wake_up_mutex);
+    wake_up->stop = true;
+    wake_up->wake_up_sender.notify_one();
+  }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+
+  SetPipelineCounters(state, latencies_ns, clients);
+}
+BENCHMARK(BM_PipelineThreadPerClient)->ArgName("clients")->Arg(1)->Arg(10)->Arg(100)->Arg(1000)->UseRealTime();
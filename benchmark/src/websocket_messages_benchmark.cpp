@@ -0,0 +1,278 @@
+// Standard headers
+#include <mutex>
+#include <string>
+#include <vector>
+
+// microhttpd headers
+#include <microhttpd.h>
+#include <microhttpd_ws.h>
+
+// Google Benchmark headers
+#include <benchmark/benchmark.h>
+
+// Application headers
+#include "ac_data.h"
+#include "benchmark_counters.h"
+#include "track_map.h"
+#include "websocket_frame.h"
+#include "websocket_messages.h"
+
+namespace {
+
+// Values that look like the middle of a lap, so the numbers have a realistic number of digits
+cACData GetRealisticACData()
+{
+  cACData data;
+  data.config_rpm_red_line = 7200.0f;
+  data.config_rpm_maximum = 7500.0f;
+  data.config_speedometer_red_line_kph = 200.0f;
+  data.config_speedometer_maximum_kph = 220.0f;
+  data.telemetry.core.gear = 4;
+  data.telemetry.core.accelerator_0_to_1 = 0.87f;
+  data.telemetry.core.brake_0_to_1 = 0.0f;
+  data.telemetry.core.clutch_0_to_1 = 1.0f;
+  data.telemetry.core.rpm = 6543.21f;
+  data.telemetry.core.speed_kmh = 163.8f;
+  data.telemetry.core.lap_time_ms = 54321;
+  data.telemetry.core.last_lap_ms = 104567;
+  data.telemetry.core.best_lap_ms = 103987;
+  data.telemetry.core.lap_count = 7;
+  data.telemetry.core.shift_lights = 0x1f;
+  data.telemetry.core.current_sector = 1;
+  data.telemetry.core.current_sector_ms = 21034;
+  data.sector_times.last_ms = { 33210, 35871, 35486 };
+  data.sector_times.best_ms = { 33002, 35710, 35275 };
+  data.sector_times.theoretical_best_lap_ms = 103987;
+  data.sector_times.last_completed_sector = 0;
+  data.telemetry.core.wheel_slip = 0;
+  data.telemetry.core.track_position_index = 312;
+  data.telemetry.dynamics.accG_horizontal = 1.12f;
+  data.telemetry.dynamics.suspension_height = { 0.052f, 0.061f, 0.071f, 0.069f };
+  data.telemetry.wheels.load = { 3510.5f, 4702.25f, 3890.75f, 4980.5f };
+  data.telemetry.wheels.slip_ratio = { 0.021f, 0.034f, 0.045f, 0.052f };
+  data.telemetry.position.car_position_normalized = 0.4376f;
+  data.telemetry.position.car_coordinates = { -312.25f, 12.5f, 845.75f };
+  return data;
+}
+
+acdisplay::cTrackMap GetRealisticTrackMap()
+{
+  // A simplified track map has a few hundred points
+  acdisplay::cTrackMap map;
+  for (uint16_t i = 0; i < 300; i++) {
+    map.points.push_back({ uint16_t(i * 3), -1234.5f + float(i) * 7.25f, 876.5f - float(i) * 3.5f });
+  }
+  return map;
+}
+
+}
+
+static void BM_CarUpdateMessage(benchmark::State& state)
+{
+  const cACData data = GetRealisticACData();
+  size_t bytes = 0;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    const std::string message = acdisplay::GetCarUpdateMessage(data);
+    benchmark::DoNotOptimize(message.data());
+    bytes = message.size();
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, bytes);
+}
+BENCHMARK(BM_CarUpdateMessage);
+
+// The same values for the binary clients, into a reused buffer like cWebSocketSender does
+static void BM_CarUpdateBinaryMessage(benchmark::State& state)
+{
+  const cACData data = GetRealisticACData();
+  std::string message;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    acdisplay::FormatCarUpdateBinaryMessage(data, message);
+    benchmark::DoNotOptimize(message.data());
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, message.size());
+}
+BENCHMARK(BM_CarUpdateBinaryMessage);
+
+// A batch of samples for the batch clients, the argument is the number of samples, compare bytes_per_sample with BM_CarUpdateBinaryMessage
+static void BM_CarUpdateBatchBinaryMessage(benchmark::State& state)
+{
+  const cACData data = GetRealisticACData();
+  std::vector<acdisplay::cTelemetry> samples(size_t(state.range(0)), data.telemetry);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i].core.published_time_us = 1000000 + (3000 * i);
+  }
+
+  std::string message;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    acdisplay::FormatCarUpdateBatchBinaryMessage(samples, acdisplay::TELEMETRY_CORE_GROUP, message);
+    benchmark::DoNotOptimize(message.data());
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, message.size());
+  state.counters["bytes_per_sample"] = double(message.size()) / double(samples.size());
+}
+BENCHMARK(BM_CarUpdateBatchBinaryMessage)->Arg(1)->Arg(10)->Arg(33);
+
+static void BM_CarConfigMessage(benchmark::State& state)
+{
+  const cACData data = GetRealisticACData();
+  size_t bytes = 0;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    const std::string message = acdisplay::GetCarConfigMessage(data);
+    benchmark::DoNotOptimize(message.data());
+    bytes = message.size();
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, bytes);
+}
+BENCHMARK(BM_CarConfigMessage);
+
+static void BM_SectorTimesMessage(benchmark::State& state)
+{
+  const cACData data = GetRealisticACData();
+  size_t bytes = 0;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    const std::string message = acdisplay::GetSectorTimesMessage(data.sector_times);
+    benchmark::DoNotOptimize(message.data());
+    bytes = message.size();
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, bytes);
+}
+BENCHMARK(BM_SectorTimesMessage);
+
+static void BM_TrackMapMessage(benchmark::State& state)
+{
+  const acdisplay::cTrackMap map = GetRealisticTrackMap();
+  size_t bytes = 0;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    const std::string message = acdisplay::GetTrackMapMessage(map);
+    benchmark::DoNotOptimize(message.data());
+    bytes = message.size();
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, bytes);
+}
+BENCHMARK(BM_TrackMapMessage);
+
+// Framing a car update the way cWebSocketSender::SendMessage does, without the socket write
+static void BM_WebSocketEncodeText(benchmark::State& state)
+{
+  const std::string message = acdisplay::GetCarUpdateMessage(GetRealisticACData());
+  std::string frame;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    acdisplay::EncodeWebSocketFrame(acdisplay::WEBSOCKET_OPCODE::TEXT, message, frame);
+    benchmark::DoNotOptimize(frame.data());
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, frame.size());
+}
+BENCHMARK(BM_WebSocketEncodeText);
+
+// The same frame from libmicrohttpd_ws, which allocates a new buffer for each one, for comparison
+static void BM_WebSocketEncodeTextMHD(benchmark::State& state)
+{
+  struct MHD_WebSocketStream* ws = nullptr;
+  if (MHD_websocket_stream_init(&ws, MHD_WEBSOCKET_FLAG_SERVER | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0) != MHD_WEBSOCKET_STATUS_OK) {
+    state.SkipWithError("MHD_websocket_stream_init failed");
+    return;
+  }
+
+  const std::string message = acdisplay::GetCarUpdateMessage(GetRealisticACData());
+  size_t bytes = 0;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    char* frame_data = nullptr;
+    size_t frame_len = 0;
+    MHD_websocket_encode_text(ws, message.data(), message.size(), MHD_WEBSOCKET_FRAGMENTATION_NONE, &frame_data, &frame_len, nullptr);
+    benchmark::DoNotOptimize(frame_data);
+    bytes = frame_len;
+    MHD_websocket_free(ws, frame_data);
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, bytes);
+
+  MHD_websocket_stream_free(ws);
+}
+BENCHMARK(BM_WebSocketEncodeTextMHD);
+
+// The copy that each sender takes of the shared data before formatting an update
+static void BM_ACDataSnapshotCopy(benchmark::State& state)
+{
+  {
+    std::lock_guard lock(mutex_ac_data);
+    ac_data = GetRealisticACData();
+  }
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    mutex_ac_data.lock();
+    const cACData copy = ac_data;
+    mutex_ac_data.unlock();
+    benchmark::DoNotOptimize(&copy);
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, sizeof(cACData));
+}
+BENCHMARK(BM_ACDataSnapshotCopy);
+
+// The same copy with several senders competing for the mutex
+// NOTE: The allocation counts are for the whole process, so they aren't reported for the threaded version
+static void BM_ACDataSnapshotCopyContended(benchmark::State& state)
+{
+  for (auto _ : state) {
+    mutex_ac_data.lock();
+    const cACData copy = ac_data;
+    mutex_ac_data.unlock();
+    benchmark::DoNotOptimize(&copy);
+  }
+  util::SetBytesPerOperation(state, sizeof(cACData));
+}
+BENCHMARK(BM_ACDataSnapshotCopyContended)->Threads(2)->Threads(4)->Threads(8);
+
+// The whole update for one sender, snapshot, format and frame, reusing the buffers like cWebSocketSender does
+// The argument is the telemetry groups the client asked for, a client that only wants the core channels shouldn't pay for the others
+static void BM_CarUpdateSnapshotFormatAndEncode(benchmark::State& state)
+{
+  {
+    std::lock_guard lock(mutex_ac_data);
+    ac_data = GetRealisticACData();
+  }
+
+  const uint32_t telemetry_groups = uint32_t(state.range(0));
+
+  cACData snapshot;
+  std::string message;
+  std::string frame;
+
+  util::cAllocationCounter allocation_counter;
+  for (auto _ : state) {
+    mutex_ac_data.lock();
+    snapshot.CopyFrom(ac_data, telemetry_groups);
+    mutex_ac_data.unlock();
+
+    acdisplay::FormatCarUpdateMessage(snapshot, telemetry_groups, message);
+    acdisplay::EncodeWebSocketFrame(acdisplay::WEBSOCKET_OPCODE::TEXT, message, frame);
+    benchmark::DoNotOptimize(frame.data());
+  }
+  allocation_counter.SetCounters(state);
+  util::SetBytesPerOperation(state, frame.size());
+}
+BENCHMARK(BM_CarUpdateSnapshotFormatAndEncode)->Arg(acdisplay::TELEMETRY_CORE_GROUP)->Arg(acdisplay::TELEMETRY_GROUP_MASK_ALL);
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <cstdint>
+
 #include <mutex>
 
-class cACData {
+#include "instrumented_mutex.h"
+#include "sector_timing.h"
+#include "shift_lights.h"
+#include "telemetry_channels.h"
+#include "wheel_slip.h"
+
+// Everything in cACData apart from the telemetry, senders copy all of it with one assignment
+// NOTE: New members go in here rather than in cACData
+class cACDataState {
 public:
-  cACData();
+  cACDataState();
 
   // Config is not expected to change very frequently
   // NOTE: Assetto Corsa doesn't provide any of these values so we have to make them up, I think AC expects you to be on the same machine and look it up in that car's config file?
@@ -12,21 +22,26 @@ public:
   float config_rpm_maximum;
   float config_speedometer_red_line_kph;
   float config_speedometer_maximum_kph;
+  acdisplay::cShiftLightsConfig config_shift_lights;
+  bool config_automatic; // Whether the rpm config should be replaced by the values estimated from the live data
+  uint32_t config_sequence; // Incremented every time the config changes so that senders can tell when to send it again
 
   // Update date changes frequently
-  uint8_t gear;
-  float accelerator_0_to_1;
-  float brake_0_to_1;
-  float clutch_0_to_1;
-  float rpm;
-  float speed_kmh;
-  uint32_t lap_time_ms;
-  uint32_t last_lap_ms;
-  uint32_t best_lap_ms;
-  uint32_t lap_count;
+  acdisplay::cSectorTimes sector_times;
+  uint32_t track_map_sequence; // Incremented every time acdisplay::track_map changes so that senders can tell when to send it again
+  uint32_t leaderboard_sequence; // The acdisplay::leaderboard sequence, so that senders can tell when to send it again
+  uint32_t telemetry_groups; // The telemetry groups filled in by the latest sample, the other groups still hold whatever they had when a client last subscribed to them
+};
+
+class cACData : public cACDataState {
+public:
+  // Copies everything apart from the telemetry groups that aren't in telemetry_groups, so a sender only copies the channels that its client will be sent
+  void CopyFrom(const cACData& rhs, uint32_t telemetry_groups);
+
+  acdisplay::cTelemetry telemetry; // The channels in each car_update, see ACDISPLAY_TELEMETRY_CHANNELS
 };
 
 // Mutex and data
 // Lock the mutex, use the data, and unlock the mutex
-extern std::mutex mutex_ac_data;
+extern acdisplay::cInstrumentedMutex mutex_ac_data;
 extern cACData ac_data;
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <string>
+
 #include "settings.h"
 
 namespace acdisplay {
 
-bool RunServer(const application::cSettings& settings);
+// The settings file is watched while we are running, and changes are applied without restarting
+bool RunServer(const std::string& settings_file_path, const application::cSettings& settings);
 
 }
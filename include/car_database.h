@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "file_watcher.h"
+
+namespace acdisplay {
+
+class cCarConfig {
+public:
+  cCarConfig();
+
+  float rpm_red_line;
+  float rpm_maximum;
+  float speedometer_red_line_kph;
+  float speedometer_maximum_kph;
+};
+
+// The config for each car, indexed by the car name that Assetto Corsa reports in the handshake (For example "ks_mazda_mx5_cup")
+class cCarDatabase {
+public:
+  bool LoadFromFile(const std::string& file_path);
+  bool LoadFromString(const std::string& contents);
+
+  const cCarConfig* Find(const std::string& car_name) const;
+
+  size_t GetCount() const { return cars.size(); }
+
+private:
+  std::unordered_map<std::string, cCarConfig> cars;
+};
+
+// Owns the current car database, applies the config for the current car to ac_data, and reloads the database when the file changes
+// The database is immutable once loaded, a reload builds a new one and swaps it in so readers never see a half loaded database
+class cCarDatabaseManager {
+public:
+  bool Start(const std::string& file_path);
+  void Stop();
+
+  // Called when the handshake tells us which car is being driven
+  void SetCurrentCar(const std::string& car_name);
+
+  std::shared_ptr<const cCarDatabase> GetDatabase() const { return database.load(); }
+
+private:
+  void Reload();
+  void Apply();
+
+  std::string file_path;
+  std::atomic<std::shared_ptr<const cCarDatabase>> database;
+
+  std::mutex mutex_car_name;
+  std::string car_name;
+
+  util::cFileWatcher file_watcher;
+};
+
+extern cCarDatabaseManager car_database;
+
+}
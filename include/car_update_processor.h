@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <string>
+
+#include <acudp.hpp>
+
+#include "gear_ratio_estimator.h"
+#include "sector_timing.h"
+#include "shift_lights.h"
+#include "track_map.h"
+#include "wheel_slip.h"
+
+namespace acdisplay {
+
+// Works out the shift lights, sector times, wheel slip, track map, etc. from each car update and publishes them in ac_data for the websocket senders
+// This doesn't know about the ACUDP socket, so the benchmarks can feed it recorded or made up updates
+class cCarUpdateProcessor {
+public:
+  cCarUpdateProcessor();
+
+  // Called when we connect to Assetto Corsa, tells us which car and track this session is for
+  void OnHandshake(const acudp_setup_response_t& response);
+
+  // Processes and publishes one car update, received_time_us is when it was received, see util::GetMonotonicTimeUS
+  void ProcessUpdate(const acudp_car_t& car, uint64_t received_time_us);
+
+private:
+  void ApplyGearRatioEstimates();
+  void PublishTrackMap(const cTrackMap& map);
+
+  cShiftLights shift_lights;
+  cSectorTiming sector_timing;
+  cGearRatioEstimator gear_ratio_estimator;
+  cWheelSlipDetector wheel_slip_detector;
+
+  std::string track_map_file_path;
+  cTrackMapBuilder track_map_builder;
+
+  // Shift lights for each gear based on the estimated upshift points, only used once we have an estimate for that gear
+  std::array<cShiftLightsConfig, GEAR_RATIO_ESTIMATOR_GEAR_COUNT> gear_shift_lights;
+  std::array<bool, GEAR_RATIO_ESTIMATOR_GEAR_COUNT> gear_shift_lights_valid;
+
+  uint64_t last_received_time_us;
+};
+
+}
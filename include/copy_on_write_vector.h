@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+
+// A vector that is read far more often than it is changed, readers take a snapshot without locking and can iterate it for as long as they like
+// Each change copies the vector and swaps the copy in, so a change never waits for a reader and a reader never sees a half finished change
+// NOTE: The items in a snapshot stay alive until the snapshot is released, store shared pointers if the items are owned elsewhere
+template <class T>
+class cCopyOnWriteVector {
+public:
+  typedef std::vector<T> vector_t;
+
+  cCopyOnWriteVector() :
+    items(std::make_shared<const vector_t>())
+  {
+  }
+
+  std::shared_ptr<const vector_t> GetSnapshot() const { return items.load(std::memory_order_acquire); }
+
+  // Returns the new size
+  size_t Add(const T& item)
+  {
+    std::lock_guard<std::mutex> lock(mutex_writers);
+
+    std::shared_ptr<vector_t> copy = std::make_shared<vector_t>(*items.load(std::memory_order_relaxed));
+    copy->push_back(item);
+    const size_t size = copy->size();
+    items.store(std::move(copy), std::memory_order_release);
+    return size;
+  }
+
+  // Returns false if the item was not found
+  bool Remove(const T& item, size_t& out_size)
+  {
+    std::lock_guard<std::mutex> lock(mutex_writers);
+
+    const std::shared_ptr<const vector_t> current = items.load(std::memory_order_relaxed);
+    auto iter = std::find(current->begin(), current->end(), item);
+    if (iter == current->end()) {
+      out_size = current->size();
+      return false;
+    }
+
+    std::shared_ptr<vector_t> copy = std::make_shared<vector_t>(*current);
+    copy->erase(copy->begin() + (iter - current->begin()));
+    out_size = copy->size();
+    items.store(std::move(copy), std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::mutex mutex_writers; // Only serialises the writers with each other
+  std::atomic<std::shared_ptr<const vector_t>> items;
+};
+
+}
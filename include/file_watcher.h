@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace util {
+
+// Calls a function on its own thread whenever a file is written, replaced, created or deleted
+// NOTE: We watch the folder rather than the file because most editors save by writing a new file and renaming it over the old one
+class cFileWatcher {
+public:
+  cFileWatcher();
+  ~cFileWatcher();
+
+  bool Start(const std::string& file_path, std::function<void()> on_changed);
+  void Stop();
+
+private:
+  void MainLoop();
+
+  std::string file_name;
+  std::function<void()> on_changed;
+
+  int inotify_fd;
+  int stop_event_fd;
+  std::thread thread;
+};
+
+}
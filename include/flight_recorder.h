@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace acdisplay {
+
+const size_t FLIGHT_RECORDER_EVENT_COUNT = 1024;
+const size_t FLIGHT_RECORDER_EVENT_MAX_LENGTH = 160;
+
+// An always on record of the most recent significant events, connects, disconnects, handshakes, packet gaps, slow sends, etc.
+// This is for working out what happened after a stall, so unlike the log it is never filtered or rate limited, the oldest events are overwritten instead
+// NOTE: Only record things that are rare, this takes a mutex
+class cFlightRecorder {
+public:
+  cFlightRecorder();
+
+  void Record(std::string_view text);
+
+  // Oldest first, each one starts with the time it was recorded
+  std::vector<std::string> GetEvents() const;
+
+  void Clear();
+
+private:
+  class cEvent {
+  public:
+    uint64_t time_ms;
+    uint8_t length;
+    std::array<char, FLIGHT_RECORDER_EVENT_MAX_LENGTH> text;
+  };
+
+  mutable std::mutex mutex;
+  std::array<cEvent, FLIGHT_RECORDER_EVENT_COUNT> events;
+  size_t next;
+  size_t count;
+};
+
+extern cFlightRecorder flight_recorder;
+
+}
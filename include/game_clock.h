@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+namespace acdisplay {
+
+// A clock built from the lap times in each update, it only advances while the game is running so pausing the game doesn't count
+class cGameClock {
+public:
+  cGameClock();
+
+  void Reset();
+
+  // Returns true if the session was restarted (The lap count or the lap time went backwards), in that case the clock starts again from this sample
+  bool Update(uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count);
+
+  uint64_t GetTimeMS() const { return time_ms; }
+  uint32_t GetDeltaMS() const { return delta_ms; } // The time since the previous sample
+  bool IsNewLap() const { return new_lap; } // True if the line was crossed between the previous sample and this one
+
+private:
+  bool has_previous;
+  uint32_t previous_lap_time_ms;
+  uint32_t previous_lap_count;
+
+  uint64_t time_ms;
+  uint32_t delta_ms;
+  bool new_lap;
+};
+
+}
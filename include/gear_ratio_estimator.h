@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+
+#include "game_clock.h"
+
+namespace acdisplay {
+
+// Gear indices are the same as Assetto Corsa, 0 is reverse, 1 is neutral, 2 is first, etc.
+const size_t GEAR_RATIO_ESTIMATOR_GEAR_COUNT = 10;
+const uint8_t GEAR_RATIO_ESTIMATOR_FIRST_GEAR = 2;
+
+// Acceleration is collected in fixed size rpm buckets for each gear
+const size_t GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT = 80;
+const float GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH = 250.0f;
+
+class cGearEstimate {
+public:
+  cGearEstimate();
+
+  void Clear();
+
+  // The overall ratio is estimated with a least squares fit of rpm = ratio * speed through the origin
+  void AddRatioSample(float speed_kmh, float rpm);
+  bool IsRatioConverged() const;
+  float GetRatio() const; // Engine rpm per km/h
+
+  void AddAccelerationSample(float rpm, float acceleration_ms2);
+  bool GetAcceleration(float rpm, float& out_acceleration_ms2) const;
+
+  float max_rpm;
+
+private:
+  uint32_t ratio_samples;
+  double sum_speed_rpm;
+  double sum_speed_squared;
+  double sum_rpm_squared;
+  double sum_rpm;
+
+  std::array<float, GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT> acceleration_mean_ms2;
+  std::array<uint32_t, GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT> acceleration_samples;
+};
+
+// Learns the gear ratios and the acceleration at each rpm in each gear from the live data, and from those works out the optimal upshift rpm for each gear
+// Each sample is O(1), the upshift points are only recalculated about once a second
+class cGearRatioEstimator {
+public:
+  cGearRatioEstimator();
+
+  void Reset();
+
+  // Returns true if the estimated upshift points or maximum rpm changed with this sample
+  bool Update(uint8_t gear, float rpm, float speed_kmh, float accelerator_0_to_1, float brake_0_to_1, float clutch_0_to_1, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count);
+
+  float GetRatio(uint8_t gear) const; // 0 if not known yet
+  float GetUpshiftRPM(uint8_t gear) const; // 0 if not known yet
+  float GetMaximumRPM() const { return max_rpm; }
+
+private:
+  bool Recalculate();
+  float CalculateUpshiftRPM(uint8_t gear) const;
+
+  cGameClock clock;
+
+  std::array<cGearEstimate, GEAR_RATIO_ESTIMATOR_GEAR_COUNT> gears;
+
+  // Acceleration is measured between an anchor sample and a later sample so that the speed quantisation doesn't swamp it
+  bool has_anchor;
+  uint64_t anchor_time_ms;
+  float anchor_speed_kmh;
+  float anchor_rpm;
+
+  uint8_t previous_gear;
+  uint64_t gear_engaged_time_ms;
+
+  uint64_t last_recalculate_time_ms;
+
+  std::array<float, GEAR_RATIO_ESTIMATOR_GEAR_COUNT> upshift_rpm;
+  float max_rpm;
+  float reported_max_rpm; // The maximum rpm the last time that we said something changed
+};
+
+}
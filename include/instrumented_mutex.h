@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+
+#include "metrics.h"
+#include "util.h"
+
+namespace acdisplay {
+
+// A std::mutex that records how often it is locked, how long threads wait for it, and how long it is held, in a cLockMetrics
+// An uncontended lock costs one extra clock read when locking and one when unlocking, the wait is only timed when the mutex is already locked
+// NOTE: This is Lockable rather than a std::mutex, so use std::condition_variable_any to wait on it
+class cInstrumentedMutex {
+public:
+  explicit cInstrumentedMutex(cLockMetrics& _lock_metrics) :
+    lock_metrics(_lock_metrics),
+    locked_time_us(0)
+  {
+  }
+
+  cInstrumentedMutex(const cInstrumentedMutex&) = delete;
+  cInstrumentedMutex& operator=(const cInstrumentedMutex&) = delete;
+
+  void lock()
+  {
+    if (!mutex.try_lock()) {
+      const uint64_t wait_start_us = util::GetMonotonicTimeUS();
+      mutex.lock();
+      locked_time_us = util::GetMonotonicTimeUS();
+      lock_metrics.contended.Increment();
+      lock_metrics.wait_time.Observe(locked_time_us - wait_start_us);
+    } else {
+      locked_time_us = util::GetMonotonicTimeUS();
+    }
+
+    lock_metrics.acquisitions.Increment();
+  }
+
+  bool try_lock()
+  {
+    if (!mutex.try_lock()) {
+      return false;
+    }
+
+    locked_time_us = util::GetMonotonicTimeUS();
+    lock_metrics.acquisitions.Increment();
+    return true;
+  }
+
+  void unlock()
+  {
+    // Read this before unlocking, another thread can overwrite it as soon as we unlock
+    const uint64_t held_us = util::GetMonotonicTimeUS() - locked_time_us;
+    mutex.unlock();
+    lock_metrics.hold_time.Observe(held_us);
+  }
+
+private:
+  cLockMetrics& lock_metrics;
+  std::mutex mutex;
+  uint64_t locked_time_us; // Only accessed while the mutex is locked
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace acdisplay {
+
+class cLeaderboardEntry {
+public:
+  uint32_t car_identifier;
+  std::string driver_name;
+  std::string car_name;
+  uint32_t laps;
+  uint32_t last_lap_ms;
+  uint32_t best_lap_ms; // 0 if there isn't one yet
+  uint64_t total_ms; // The sum of the lap times, the gap to the car in front is worked out from this and the laps
+  uint32_t changed_sequence; // The leaderboard sequence when this entry last changed
+};
+
+// The live order for every car in the session, built from the lap events that Assetto Corsa sends for each car
+// Cars are ordered by laps completed and then by total time, like a race
+// There are only ever a few dozen cars so the entries are kept in a small vector in order and each lap only moves one car up the order
+class cLeaderboard {
+public:
+  cLeaderboard();
+
+  void Clear();
+
+  // Returns true if the order changed
+  bool AddLap(uint32_t car_identifier, uint32_t lap, const std::string& driver_name, const std::string& car_name, uint32_t lap_time_ms);
+
+  const std::vector<cLeaderboardEntry>& GetEntries() const { return entries; }
+
+  uint32_t sequence; // Incremented every time an entry changes
+  uint32_t order_sequence; // Incremented every time the order changes
+
+private:
+  std::vector<cLeaderboardEntry> entries;
+};
+
+// Mutex and data
+// Lock the mutex, use the data, and unlock the mutex
+// NOTE: ac_data.leaderboard_sequence tells senders when this has changed without having to lock it
+extern std::mutex mutex_leaderboard;
+extern cLeaderboard leaderboard;
+
+}
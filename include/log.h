@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+// NOTE: The values have a prefix because DEBUG is defined on the command line in debug builds
+enum class LOG_LEVEL : uint8_t {
+  LEVEL_DEBUG,
+  LEVEL_INFO,
+  LEVEL_WARNING,
+  LEVEL_ERROR,
+};
+
+// Debug logs are compiled out of release builds completely
+#ifdef NDEBUG
+constexpr LOG_LEVEL LOG_COMPILE_TIME_MIN_LEVEL = LOG_LEVEL::LEVEL_INFO;
+#else
+constexpr LOG_LEVEL LOG_COMPILE_TIME_MIN_LEVEL = LOG_LEVEL::LEVEL_DEBUG;
+#endif
+
+const size_t LOG_LINE_MAX_LENGTH = 256;
+
+// Each call site can log this many messages per second, after that they are dropped and counted
+const uint32_t LOG_RATE_LIMIT_PER_SECOND = 20;
+
+bool ParseLogLevel(std::string_view text, LOG_LEVEL& out_level);
+
+// The runtime level, messages below this level are skipped without being formatted
+void SetLogLevel(LOG_LEVEL level);
+bool IsLogLevelEnabled(LOG_LEVEL level);
+
+// Blocks until everything that has been logged so far has been written, for shutting down
+void FlushLog();
+
+class cLogMessage {
+public:
+  LOG_LEVEL level;
+  uint16_t length;
+  std::array<char, LOG_LINE_MAX_LENGTH> text;
+};
+
+// Bounded multiple producer, single consumer queue
+// Producers never block or allocate, if the queue is full the message is dropped
+class cLogRingBuffer {
+public:
+  static const size_t SIZE = 1024; // Must be a power of 2
+
+  cLogRingBuffer();
+
+  bool TryPush(LOG_LEVEL level, std::string_view text);
+  bool TryPop(cLogMessage& out_message); // Only call this from one thread
+
+private:
+  class cSlot {
+  public:
+    std::atomic<size_t> sequence; // Which lap of the ring this slot is ready to be written or read for
+    cLogMessage message;
+  };
+
+  std::array<cSlot, SIZE> slots;
+  alignas(64) std::atomic<size_t> write_position;
+  alignas(64) size_t read_position;
+};
+
+class cLogRateLimiter {
+public:
+  cLogRateLimiter();
+
+  bool Allow();
+  bool Allow(uint64_t now_ms);
+
+  // The number of messages that were dropped since the last time this was called
+  uint32_t TakeSuppressed() { return suppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> window_start_ms;
+  std::atomic<uint32_t> count_in_window;
+  std::atomic<uint32_t> suppressed;
+};
+
+// Formats a single line into a fixed size buffer without allocating, then queues it for the writer thread when it goes out of scope
+// Lines that are too long are truncated
+class cLogLine {
+public:
+  cLogLine(LOG_LEVEL level, uint32_t suppressed);
+  ~cLogLine();
+
+  cLogLine(const cLogLine&) = delete;
+  cLogLine& operator=(const cLogLine&) = delete;
+
+  std::string_view GetText() const { return std::string_view(text.data(), length); }
+
+  cLogLine& operator<<(std::string_view value) { Append(value); return *this; }
+  cLogLine& operator<<(const char* value) { Append((value != nullptr) ? std::string_view(value) : std::string_view("(null)")); return *this; }
+  cLogLine& operator<<(const std::string& value) { Append(value); return *this; }
+  cLogLine& operator<<(char value) { Append(std::string_view(&value, 1)); return *this; }
+  cLogLine& operator<<(bool value) { Append(value ? "1" : "0"); return *this; }
+
+  template <class T>
+  requires (std::integral<T> || std::floating_point<T>)
+  cLogLine& operator<<(T value)
+  {
+    std::array<char, 32> buffer;
+    const std::to_chars_result result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    Append(std::string_view(buffer.data(), result.ptr - buffer.data()));
+    return *this;
+  }
+
+private:
+  void Append(std::string_view value);
+
+  LOG_LEVEL level;
+  size_t length;
+  std::array<char, LOG_LINE_MAX_LENGTH> text;
+};
+
+}
+
+// Usage: LOG_INFO<<"Connected to "<<address<<":"<<port;
+// NOTE: Each call site gets its own rate limiter, the message is only formatted if it is going to be logged
+#define LOG(LEVEL) \
+  if constexpr ((LEVEL) < util::LOG_COMPILE_TIME_MIN_LEVEL) {} else \
+  if (!util::IsLogLevelEnabled(LEVEL)) {} else \
+  if (static util::cLogRateLimiter log_rate_limiter; !log_rate_limiter.Allow()) {} else \
+  util::cLogLine((LEVEL), log_rate_limiter.TakeSuppressed())
+
+#define LOG_DEBUG LOG(util::LOG_LEVEL::LEVEL_DEBUG)
+#define LOG_INFO LOG(util::LOG_LEVEL::LEVEL_INFO)
+#define LOG_WARNING LOG(util::LOG_LEVEL::LEVEL_WARNING)
+#define LOG_ERROR LOG(util::LOG_LEVEL::LEVEL_ERROR)
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "settings.h"
+
+namespace util {
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus, std::string& out_error);
+bool SetCurrentThreadRealtimePriority(int priority, std::string& out_error);
+
+// Locks the memory we have mapped now, after pre-faulting this much of the heap
+bool LockMemory(size_t prefault_bytes, std::string& out_error);
+
+// Locks the top of the calling thread's stack
+bool LockCurrentThreadStack(size_t bytes, std::string& out_error);
+
+// The acudp library doesn't give us its socket, so this finds all of our UDP sockets and sets SO_BUSY_POLL on each one
+// Returns the number of sockets that were changed
+size_t SetBusyPollOnUDPSockets(int microseconds, std::string& out_error);
+
+}
+
+namespace acdisplay {
+
+enum class LOW_LATENCY_THREAD {
+  ACUDP,
+  WEBSOCKET,
+};
+
+// Process wide settings, mlockall and pre-faulting the heap, call this once at startup before starting any threads
+// NOTE: The settings are remembered for the threads and sockets that are set up later
+void ApplyLowLatencyProcessSettings(const application::cLowLatencySettings& settings);
+
+// Pins the calling thread to its cores, and for the ACUDP thread locks its stack and sets its real time priority
+void ApplyLowLatencyThreadSettings(LOW_LATENCY_THREAD thread);
+
+// Turns on busy polling for the ACUDP sockets, call this after the ACUDP connections have been opened
+void ApplyLowLatencySocketSettings();
+
+}
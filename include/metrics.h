@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace acdisplay {
+
+// Counters and gauges are relaxed atomics, each one sits on its own cache line so that threads updating different values don't slow each other down
+
+class alignas(64) cCounter {
+public:
+  cCounter() : value(0) {}
+
+  void Increment(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+  uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value;
+};
+
+class alignas(64) cGauge {
+public:
+  cGauge() : value(0) {}
+
+  void Set(int64_t new_value) { value.store(new_value, std::memory_order_relaxed); }
+  void Add(int64_t amount) { value.fetch_add(amount, std::memory_order_relaxed); }
+  int64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> value;
+};
+
+// The upper bound of each latency histogram bucket in microseconds, there is also an implicit +Inf bucket
+constexpr std::array<uint64_t, 12> LATENCY_HISTOGRAM_BUCKETS_US = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000 };
+
+class alignas(64) cLatencyHistogram {
+public:
+  cLatencyHistogram();
+
+  void Observe(uint64_t duration_us);
+
+  uint64_t GetCount() const { return count.load(std::memory_order_relaxed); }
+  uint64_t GetBucketCount(size_t bucket) const { return buckets[bucket].load(std::memory_order_relaxed); } // Not cumulative
+
+  void ToPrometheus(std::string& out, const std::string& name, const std::string& help) const;
+
+private:
+  std::array<std::atomic<uint64_t>, LATENCY_HISTOGRAM_BUCKETS_US.size() + 1> buckets;
+  std::atomic<uint64_t> sum_us;
+  std::atomic<uint64_t> count;
+};
+
+// Contention statistics for a lock, see cInstrumentedMutex
+class cLockMetrics {
+public:
+  cCounter acquisitions;
+  cCounter contended; // Acquisitions that had to wait for another thread to unlock
+  cLatencyHistogram wait_time; // Only contended acquisitions are timed
+  cLatencyHistogram hold_time;
+
+  void ToPrometheus(std::string& out, const std::string& name) const;
+};
+
+class cMetrics {
+public:
+  // ACUDP
+  cCounter acudp_packets_received;
+  cCounter acudp_lap_events_received;
+  cCounter samples_published;
+  cLatencyHistogram acudp_processing_latency; // From receiving a packet to publishing it in ac_data
+
+  // Websockets
+  cGauge websocket_clients;
+  cCounter websocket_clients_connected;
+  cCounter websocket_evictions; // Clients that we disconnected because of a websocket protocol error
+  cCounter websocket_frames_encoded;
+  cCounter websocket_bytes_sent;
+  cCounter websocket_send_errors;
+  cLatencyHistogram websocket_send_latency; // Encoding and sending a single frame
+  cLatencyHistogram sample_age_at_send; // From publishing a sample in ac_data to sending it to a client
+  cCounter batch_samples_sent; // Samples sent to the batch clients, see telemetry_history
+  cCounter batch_samples_skipped; // Samples that a batch client fell too far behind to be sent
+
+  // Locks
+  cLockMetrics lock_ac_data; // mutex_ac_data, shared by the ingest thread and every sender
+  cLockMetrics lock_wake_up; // The wake_up_mutex of every client combined, held by each sender around its wait
+  cLockMetrics lock_send; // The send_mutex of every client combined
+  cLockMetrics lock_telemetry_history; // telemetry_history, shared by the ingest thread and every batch sender
+
+  // Appends all of the metrics in the Prometheus text format
+  void ToPrometheus(std::string& out) const;
+};
+
+extern cMetrics metrics;
+
+// Helpers for adding extra values that are only calculated when the metrics are requested
+void AppendPrometheusGauge(std::string& out, const std::string& name, const std::string& help, int64_t value);
+
+}
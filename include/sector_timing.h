@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+
+#include "game_clock.h"
+
+namespace acdisplay {
+
+// Assetto Corsa doesn't send the track's sector layout over UDP so we split the lap into equal sectors
+const size_t SECTOR_COUNT = 3;
+
+class cSectorTimes {
+public:
+  cSectorTimes();
+
+  void Clear();
+
+  uint8_t current_sector; // The sector that the car is currently in
+  uint32_t current_sector_ms; // The running time in the current sector, 0 if we joined part way through the sector
+  std::array<uint32_t, SECTOR_COUNT> last_ms; // The last completed time for each sector, 0 if there isn't one yet
+  std::array<uint32_t, SECTOR_COUNT> best_ms; // The best time for each sector this session, 0 if there isn't one yet
+  uint32_t theoretical_best_lap_ms; // The sum of the best sectors, 0 until every sector has a time
+  uint8_t last_completed_sector; // The sector that was most recently completed
+  uint32_t sequence; // Incremented every time a sector is completed so that senders can tell when to send an event
+};
+
+// Works out sector times from the normalized position around the track
+// Crossing times are interpolated between samples so the times don't depend on the update rate
+class cSectorTiming {
+public:
+  cSectorTiming();
+
+  void Reset();
+
+  // Returns true if a sector was completed with this sample
+  bool Update(float position_normalized, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count);
+
+  const cSectorTimes& GetTimes() const { return times; }
+
+private:
+  void ResetTimes();
+
+  std::array<float, SECTOR_COUNT> sector_start_positions;
+
+  // The game clock only advances while the game is running, so pausing doesn't add to the sector times
+  cGameClock clock;
+
+  bool has_previous;
+  float previous_position;
+  double previous_clock_ms;
+
+  bool sector_start_valid;
+  double sector_start_clock_ms;
+
+  cSectorTimes times;
+};
+
+}
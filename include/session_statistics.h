@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <mutex>
+#include <string>
+
+#include "game_clock.h"
+
+namespace acdisplay {
+
+// Gear indices are the same as Assetto Corsa, 0 is reverse, 1 is neutral, 2 is first, etc.
+const size_t SESSION_STATISTICS_GEAR_COUNT = 10;
+
+// The rpm histogram has fixed size buckets, anything above the last bucket is counted in the last bucket
+const size_t SESSION_STATISTICS_RPM_BUCKET_COUNT = 24;
+const float SESSION_STATISTICS_RPM_BUCKET_WIDTH = 500.0f;
+
+// Running mean and variance using Welford's algorithm, so we don't have to keep every value around
+class cRunningMoments {
+public:
+  cRunningMoments();
+
+  void Clear();
+  void Add(double value);
+
+  uint64_t GetCount() const { return count; }
+  double GetMean() const { return mean; }
+  double GetVariance() const;
+  double GetStandardDeviation() const;
+  double GetMinimum() const { return minimum; }
+  double GetMaximum() const { return maximum; }
+
+private:
+  uint64_t count;
+  double mean;
+  double m2;
+  double minimum;
+  double maximum;
+};
+
+// Aggregates for the whole session, each sample costs the same regardless of how long the session has been running
+class cSessionStatistics {
+public:
+  cSessionStatistics();
+
+  void Clear();
+
+  void Update(float speed_kmh, uint8_t gear, float rpm, float accelerator_0_to_1, float brake_0_to_1, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count);
+
+  std::string ToJSON() const;
+
+  float max_speed_kmh;
+  uint64_t total_ms;
+  std::array<uint64_t, SESSION_STATISTICS_GEAR_COUNT> gear_ms;
+  std::array<uint64_t, SESSION_STATISTICS_RPM_BUCKET_COUNT> rpm_histogram_ms;
+  uint64_t full_throttle_ms;
+  uint64_t braking_ms;
+  cRunningMoments lap_times_ms;
+
+private:
+  cGameClock clock;
+};
+
+// Mutex and data
+// Lock the mutex, use the data, and unlock the mutex
+extern std::mutex mutex_session_statistics;
+extern cSessionStatistics session_statistics;
+
+}
@@ -2,11 +2,29 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "ip_address.h"
+#include "log.h"
 
 namespace application {
 
+// Optional settings for trading CPU time for lower latency on a dedicated machine, these are all off by default
+class cLowLatencySettings {
+public:
+  cLowLatencySettings();
+
+  bool IsEnabled() const;
+  void Clear();
+
+  std::vector<int> acudp_cpus; // Pin the ACUDP threads to these cores
+  std::vector<int> websocket_cpus; // Pin the websocket sender threads to these cores
+  int realtime_priority; // SCHED_FIFO priority for the ACUDP thread, 1 to 99, or 0 to leave them as normal threads
+  bool lock_memory; // Lock the heap and the ACUDP thread stack so that we never take a page fault on the hot paths
+  uint32_t prefault_heap_mb; // Grow the heap by this much and touch every page at startup, only used with lock_memory
+  uint32_t busy_poll_us; // SO_BUSY_POLL on the ACUDP sockets, or 0 to wait for interrupts as normal
+};
+
 class cSettings {
 public:
   cSettings();
@@ -23,6 +41,10 @@ public:
   constexpr uint16_t GetHTTPSPort() const { return https_port; }
   constexpr const std::string& GetHTTPSPrivateKey() const { return https_private_key; }
   constexpr const std::string& GetHTTPSPublicCert() const { return https_public_cert; }
+  constexpr uint16_t GetUpdateIntervalMS() const { return update_interval_ms; }
+  constexpr uint16_t GetBatchIntervalMS() const { return batch_interval_ms; }
+  constexpr util::LOG_LEVEL GetLogLevel() const { return log_level; }
+  const cLowLatencySettings& GetLowLatency() const { return low_latency; }
 
 private:
   bool running_in_container;
@@ -32,6 +54,10 @@ private:
   uint16_t https_port;
   std::string https_private_key;
   std::string https_public_cert;
+  uint16_t update_interval_ms; // How often we send updates to each client, this can be changed while running
+  uint16_t batch_interval_ms; // How often we send updates to each batch client, this can be changed while running
+  util::LOG_LEVEL log_level; // This can be changed while running
+  cLowLatencySettings low_latency; // These are only applied at startup
 };
 
 }
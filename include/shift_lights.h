@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+
+namespace acdisplay {
+
+// The number of LEDs in the F1 style shift lights strip
+const size_t SHIFT_LIGHTS_LED_COUNT = 8;
+
+// The shift lights state is packed into a single small integer for sending to the clients
+// Bits 0..7: The LEDs that are currently lit (The blink phase has already been applied)
+// Bit 8: The rpm is at the limiter and the LEDs are flashing
+// Bit 9: The current blink phase, 1 is lit, 0 is unlit (Only meaningful when bit 8 is set)
+const uint16_t SHIFT_LIGHTS_LED_MASK = 0x00FF;
+const uint16_t SHIFT_LIGHTS_FLAG_FLASHING = (1 << 8);
+const uint16_t SHIFT_LIGHTS_FLAG_BLINK_PHASE = (1 << 9);
+
+class cShiftLightsConfig {
+public:
+  cShiftLightsConfig();
+
+  // Lay out the LEDs nonlinearly so that the first LED is always on and the rest are bunched up towards the red line, which is where the shifts actually happen and we want more precision
+  void SetDefaultsForRedLine(float rpm_red_line);
+
+  std::array<float, SHIFT_LIGHTS_LED_COUNT> led_on_rpm; // The rpm at which each LED turns on, this should be ascending
+  float flash_rpm; // At or above this rpm all the LEDs flash
+  uint32_t flash_period_ms; // The length of a full on and off blink cycle
+};
+
+class cShiftLights {
+public:
+  cShiftLights();
+
+  // Returns the packed state for this sample, see SHIFT_LIGHTS_LED_MASK
+  uint16_t Update(const cShiftLightsConfig& config, float rpm, uint64_t time_ms);
+
+private:
+  bool flashing;
+  uint64_t flashing_start_time_ms;
+};
+
+}
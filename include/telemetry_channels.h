@@ -0,0 +1,407 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "util.h"
+
+namespace acdisplay {
+
+// The telemetry channels that we send to the clients, these tables are the only place that lists them
+// Everything else is generated from them at compile time, the cTelemetry struct, the channel indices and masks, the text, binary and CSV encoders, and the descriptor that tells the clients how to decode them
+//
+// The channels are in groups, each group is on its own cache lines, and a group is only copied and encoded when at least one client has asked for it
+// Every client gets the core group, the other groups are only for clients that ask for them with ?groups=wheels,dynamics
+// NOTE: The channels outside the core group have the same names as the acudp_car_t members they come from, so cCarUpdateProcessor can copy them without listing them again, see ACDISPLAY_TELEMETRY_ACUDP_GROUPS
+//
+// group, name, type, count, default value, binary type, binary scale, units
+// A count of more than 1 is an array, one for each wheel for example, the elements are sent together
+// The binary encoding sends round(value * scale) as the binary type, so that floats can go as small integers, and the clients divide by the scale again
+// NOTE: This is also the order of the fields in each encoding
+#define ACDISPLAY_TELEMETRY_CORE_CHANNELS(CHANNEL) \
+  CHANNEL(core, gear, uint8_t, 1, 1, uint8_t, 1, "") /* 0 is reverse, 1 is neutral, 2 is first gear */ \
+  CHANNEL(core, accelerator_0_to_1, float, 1, 0.0f, uint8_t, 255, "") \
+  CHANNEL(core, brake_0_to_1, float, 1, 0.0f, uint8_t, 255, "") \
+  CHANNEL(core, clutch_0_to_1, float, 1, 0.0f, uint8_t, 255, "") \
+  CHANNEL(core, rpm, float, 1, 0.0f, uint16_t, 1, "rpm") \
+  CHANNEL(core, speed_kmh, float, 1, 0.0f, uint16_t, 10, "km/h") \
+  CHANNEL(core, lap_time_ms, uint32_t, 1, 0, uint32_t, 1, "ms") \
+  CHANNEL(core, last_lap_ms, uint32_t, 1, 0, uint32_t, 1, "ms") \
+  CHANNEL(core, best_lap_ms, uint32_t, 1, 0, uint32_t, 1, "ms") \
+  CHANNEL(core, lap_count, uint32_t, 1, 0, uint16_t, 1, "") \
+  CHANNEL(core, shift_lights, uint16_t, 1, 0, uint16_t, 1, "") /* Packed LED state, see SHIFT_LIGHTS_LED_MASK */ \
+  CHANNEL(core, current_sector, uint8_t, 1, 0, uint8_t, 1, "") /* See cSectorTimes */ \
+  CHANNEL(core, current_sector_ms, uint32_t, 1, 0, uint32_t, 1, "ms") \
+  CHANNEL(core, wheel_slip, uint8_t, 1, 0, uint8_t, 1, "") /* Packed lockup and wheelspin flags, see WHEEL_SLIP_LOCKUP_MASK */ \
+  CHANNEL(core, track_position_index, uint16_t, 1, 0, uint16_t, 1, "") /* The car's position around the lap, see TRACK_MAP_BIN_COUNT */ \
+  CHANNEL(core, published_time_us, uint64_t, 1, 0, uint64_t, 1, "us") /* When this update was published, see util::GetMonotonicTimeUS, for measuring how long updates take to reach the clients */
+
+#define ACDISPLAY_TELEMETRY_ASSISTS_CHANNELS(CHANNEL) \
+  CHANNEL(assists, is_abs_enabled, uint8_t, 1, 0, uint8_t, 1, "") \
+  CHANNEL(assists, is_abs_in_action, uint8_t, 1, 0, uint8_t, 1, "") \
+  CHANNEL(assists, is_tc_enabled, uint8_t, 1, 0, uint8_t, 1, "") \
+  CHANNEL(assists, is_tc_in_action, uint8_t, 1, 0, uint8_t, 1, "") \
+  CHANNEL(assists, is_in_pit, uint8_t, 1, 0, uint8_t, 1, "") \
+  CHANNEL(assists, is_engine_limiter_on, uint8_t, 1, 0, uint8_t, 1, "")
+
+#define ACDISPLAY_TELEMETRY_DYNAMICS_CHANNELS(CHANNEL) \
+  CHANNEL(dynamics, accG_vertical, float, 1, 0.0f, int16_t, 1000, "g") \
+  CHANNEL(dynamics, accG_horizontal, float, 1, 0.0f, int16_t, 1000, "g") \
+  CHANNEL(dynamics, accG_frontal, float, 1, 0.0f, int16_t, 1000, "g") \
+  CHANNEL(dynamics, steer, float, 1, 0.0f, float, 1, "") \
+  CHANNEL(dynamics, cg_height, float, 1, 0.0f, float, 1, "m") \
+  CHANNEL(dynamics, car_slope, float, 1, 0.0f, float, 1, "") \
+  CHANNEL(dynamics, suspension_height, float, 4, 0.0f, float, 1, "m")
+
+// Front left, front right, rear left, rear right
+#define ACDISPLAY_TELEMETRY_WHEELS_CHANNELS(CHANNEL) \
+  CHANNEL(wheels, wheel_angular_speed, float, 4, 0.0f, float, 1, "rad/s") \
+  CHANNEL(wheels, slip_angle, float, 4, 0.0f, float, 1, "deg") \
+  CHANNEL(wheels, slip_angle_contact_patch, float, 4, 0.0f, float, 1, "deg") \
+  CHANNEL(wheels, slip_ratio, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, tyre_slip, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, nd_slip, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, load, float, 4, 0.0f, float, 1, "N") \
+  CHANNEL(wheels, Dy, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, Mz, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, tyre_dirty_level, float, 4, 0.0f, float, 1, "") \
+  CHANNEL(wheels, camber_RAD, float, 4, 0.0f, float, 1, "rad") \
+  CHANNEL(wheels, tyre_radius, float, 4, 0.0f, float, 1, "m") \
+  CHANNEL(wheels, tyre_loaded_radius, float, 4, 0.0f, float, 1, "m")
+
+#define ACDISPLAY_TELEMETRY_POSITION_CHANNELS(CHANNEL) \
+  CHANNEL(position, car_position_normalized, float, 1, 0.0f, float, 1, "") \
+  CHANNEL(position, car_coordinates, float, 3, 0.0f, float, 1, "m")
+
+// name, class, channels
+// The groups that are copied straight from the acudp_car_t members with the same names
+#define ACDISPLAY_TELEMETRY_ACUDP_GROUPS(GROUP) \
+  GROUP(assists, cTelemetryAssists, ACDISPLAY_TELEMETRY_ASSISTS_CHANNELS) \
+  GROUP(dynamics, cTelemetryDynamics, ACDISPLAY_TELEMETRY_DYNAMICS_CHANNELS) \
+  GROUP(wheels, cTelemetryWheels, ACDISPLAY_TELEMETRY_WHEELS_CHANNELS) \
+  GROUP(position, cTelemetryPosition, ACDISPLAY_TELEMETRY_POSITION_CHANNELS)
+
+#define ACDISPLAY_TELEMETRY_GROUPS(GROUP) \
+  GROUP(core, cTelemetryCore, ACDISPLAY_TELEMETRY_CORE_CHANNELS) \
+  ACDISPLAY_TELEMETRY_ACUDP_GROUPS(GROUP)
+
+#define ACDISPLAY_TELEMETRY_CHANNELS(CHANNEL) \
+  ACDISPLAY_TELEMETRY_CORE_CHANNELS(CHANNEL) \
+  ACDISPLAY_TELEMETRY_ASSISTS_CHANNELS(CHANNEL) \
+  ACDISPLAY_TELEMETRY_DYNAMICS_CHANNELS(CHANNEL) \
+  ACDISPLAY_TELEMETRY_WHEELS_CHANNELS(CHANNEL) \
+  ACDISPLAY_TELEMETRY_POSITION_CHANNELS(CHANNEL)
+
+// A channel with a count of 1 is just a value, otherwise it is an array
+template <typename T, size_t COUNT>
+class cTelemetryChannelType {
+public:
+  typedef std::array<T, COUNT> type;
+
+  static constexpr type Make(T value)
+  {
+    type values;
+    values.fill(value);
+    return values;
+  }
+};
+
+template <typename T>
+class cTelemetryChannelType<T, 1> {
+public:
+  typedef T type;
+
+  static constexpr T Make(T value) { return value; }
+};
+
+// One class for each group
+#define ACDISPLAY_TELEMETRY_MEMBER(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) cTelemetryChannelType<TYPE, COUNT>::type NAME = cTelemetryChannelType<TYPE, COUNT>::Make(DEFAULT);
+#define ACDISPLAY_TELEMETRY_GROUP_CLASS(GROUP, CLASS, CHANNELS) \
+  class alignas(64) CLASS { \
+  public: \
+    CHANNELS(ACDISPLAY_TELEMETRY_MEMBER) \
+  };
+ACDISPLAY_TELEMETRY_GROUPS(ACDISPLAY_TELEMETRY_GROUP_CLASS)
+#undef ACDISPLAY_TELEMETRY_GROUP_CLASS
+#undef ACDISPLAY_TELEMETRY_MEMBER
+
+// Every channel, telemetry.core.rpm for example
+class cTelemetry {
+public:
+#define ACDISPLAY_TELEMETRY_GROUP_MEMBER(GROUP, CLASS, CHANNELS) CLASS GROUP;
+  ACDISPLAY_TELEMETRY_GROUPS(ACDISPLAY_TELEMETRY_GROUP_MEMBER)
+#undef ACDISPLAY_TELEMETRY_GROUP_MEMBER
+};
+
+enum class TELEMETRY_GROUP : uint8_t {
+#define ACDISPLAY_TELEMETRY_GROUP_ENUM(GROUP, CLASS, CHANNELS) GROUP,
+  ACDISPLAY_TELEMETRY_GROUPS(ACDISPLAY_TELEMETRY_GROUP_ENUM)
+#undef ACDISPLAY_TELEMETRY_GROUP_ENUM
+  COUNT
+};
+
+const size_t TELEMETRY_GROUP_COUNT = size_t(TELEMETRY_GROUP::COUNT);
+
+constexpr std::array<const char*, TELEMETRY_GROUP_COUNT> TELEMETRY_GROUP_NAMES = {
+#define ACDISPLAY_TELEMETRY_GROUP_NAME(GROUP, CLASS, CHANNELS) #GROUP,
+  ACDISPLAY_TELEMETRY_GROUPS(ACDISPLAY_TELEMETRY_GROUP_NAME)
+#undef ACDISPLAY_TELEMETRY_GROUP_NAME
+};
+
+// A set of groups is a mask with a bit for each group
+constexpr uint32_t GetTelemetryGroupMask(TELEMETRY_GROUP group)
+{
+  return uint32_t(1) << uint8_t(group);
+}
+
+constexpr uint32_t TELEMETRY_GROUP_MASK_ALL = (uint32_t(1) << TELEMETRY_GROUP_COUNT) - 1;
+
+enum class TELEMETRY_CHANNEL : uint8_t {
+#define ACDISPLAY_TELEMETRY_ENUM(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) NAME,
+  ACDISPLAY_TELEMETRY_CHANNELS(ACDISPLAY_TELEMETRY_ENUM)
+#undef ACDISPLAY_TELEMETRY_ENUM
+  COUNT
+};
+
+const size_t TELEMETRY_CHANNEL_COUNT = size_t(TELEMETRY_CHANNEL::COUNT);
+
+// A set of channels is a mask with a bit for each channel
+static_assert(TELEMETRY_CHANNEL_COUNT <= 64, "The channel masks are 64 bit");
+
+constexpr uint64_t GetTelemetryChannelMask(TELEMETRY_CHANNEL channel)
+{
+  return uint64_t(1) << uint8_t(channel);
+}
+
+constexpr uint64_t TELEMETRY_CHANNEL_MASK_ALL = (TELEMETRY_CHANNEL_COUNT == 64) ? ~uint64_t(0) : ((uint64_t(1) << TELEMETRY_CHANNEL_COUNT) - 1);
+
+// The binary type names in the descriptor, see resources/receive.js for the decoding side
+template <typename T>
+constexpr const char* GetTelemetryBinaryTypeName()
+{
+  if constexpr (std::is_same_v<T, uint8_t>) return "u8";
+  else if constexpr (std::is_same_v<T, uint16_t>) return "u16";
+  else if constexpr (std::is_same_v<T, uint32_t>) return "u32";
+  else if constexpr (std::is_same_v<T, uint64_t>) return "u64";
+  else if constexpr (std::is_same_v<T, int8_t>) return "i8";
+  else if constexpr (std::is_same_v<T, int16_t>) return "i16";
+  else if constexpr (std::is_same_v<T, int32_t>) return "i32";
+  else if constexpr (std::is_same_v<T, float>) return "f32";
+  else static_assert(!sizeof(T), "Unsupported binary type");
+}
+
+class cTelemetryChannelInfo {
+public:
+  TELEMETRY_GROUP group;
+  const char* name;
+  size_t count;
+  const char* binary_type; // See GetTelemetryBinaryTypeName
+  size_t binary_size; // For all the elements
+  uint32_t scale;
+  const char* units;
+};
+
+constexpr std::array<cTelemetryChannelInfo, TELEMETRY_CHANNEL_COUNT> TELEMETRY_CHANNEL_INFO = {{
+#define ACDISPLAY_TELEMETRY_INFO(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) { TELEMETRY_GROUP::GROUP, #NAME, COUNT, GetTelemetryBinaryTypeName<BINARY_TYPE>(), COUNT * sizeof(BINARY_TYPE), SCALE, UNITS },
+  ACDISPLAY_TELEMETRY_CHANNELS(ACDISPLAY_TELEMETRY_INFO)
+#undef ACDISPLAY_TELEMETRY_INFO
+}};
+
+// The channels in a set of groups
+constexpr uint64_t GetTelemetryGroupChannels(uint32_t groups)
+{
+  uint64_t mask = 0;
+  for (size_t i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+    if ((groups & GetTelemetryGroupMask(TELEMETRY_CHANNEL_INFO[i].group)) != 0) {
+      mask |= (uint64_t(1) << i);
+    }
+  }
+  return mask;
+}
+
+// Every client gets the core group
+constexpr uint32_t TELEMETRY_CORE_GROUP = GetTelemetryGroupMask(TELEMETRY_GROUP::core);
+
+// The channels in a car_update for a client that hasn't asked for anything else
+constexpr uint64_t TELEMETRY_CAR_UPDATE_CHANNELS = GetTelemetryGroupChannels(TELEMETRY_CORE_GROUP);
+
+// The size of the binary encoding of a set of channels
+constexpr size_t GetTelemetryBinarySize(uint64_t mask)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+    if ((mask & (uint64_t(1) << i)) != 0) {
+      size += TELEMETRY_CHANNEL_INFO[i].binary_size;
+    }
+  }
+  return size;
+}
+
+// Parses a comma separated list of group names, unknown names are ignored, the core group is always included
+uint32_t ParseTelemetryGroups(std::string_view names);
+
+// Copies just these groups
+void CopyTelemetryGroups(const cTelemetry& from, uint32_t groups, cTelemetry& to);
+
+// Counts how many clients want each group, so that cCarUpdateProcessor only fills in the groups that someone will read
+class cTelemetrySubscriptions {
+public:
+  cTelemetrySubscriptions();
+
+  void Subscribe(uint32_t groups);
+  void Unsubscribe(uint32_t groups);
+
+  // The groups that at least one client wants, this always includes the core group
+  uint32_t GetGroups() const { return groups.load(std::memory_order_relaxed); }
+
+private:
+  void UpdateGroups();
+
+  std::mutex mutex;
+  std::array<uint32_t, TELEMETRY_GROUP_COUNT> counts;
+
+  // The processor reads this for every sample without taking the lock
+  std::atomic<uint32_t> groups;
+};
+
+extern cTelemetrySubscriptions telemetry_subscriptions;
+
+
+// The binary encoding is little endian, which every machine we run on is anyway, so the values can be copied straight in
+static_assert(std::endian::native == std::endian::little, "The binary encoding assumes a little endian machine");
+
+// Writes the value at out and moves out past it
+template <typename BINARY_TYPE, typename T>
+inline void WriteTelemetryBinaryValue(char*& out, T value, uint32_t scale)
+{
+  BINARY_TYPE encoded = 0;
+  if constexpr (std::is_same_v<BINARY_TYPE, T>) {
+    encoded = (scale == 1) ? value : BINARY_TYPE(value * scale);
+  } else if constexpr (std::is_floating_point_v<BINARY_TYPE>) {
+    encoded = BINARY_TYPE(double(value) * scale);
+  } else {
+    // Round and clamp to what fits, a NaN is sent as 0
+    const double scaled = std::round(double(value) * scale);
+    if (!std::isnan(scaled)) {
+      encoded = BINARY_TYPE(util::clamp(scaled, double(std::numeric_limits<BINARY_TYPE>::lowest()), double(std::numeric_limits<BINARY_TYPE>::max())));
+    }
+  }
+
+  std::memcpy(out, &encoded, sizeof(encoded));
+  out += sizeof(encoded);
+}
+
+template <typename BINARY_TYPE, typename T, size_t COUNT>
+inline void WriteTelemetryBinaryValue(char*& out, const std::array<T, COUNT>& values, uint32_t scale)
+{
+  for (auto&& value : values) {
+    WriteTelemetryBinaryValue<BINARY_TYPE>(out, value, scale);
+  }
+}
+
+// Arrays are sent as one field with the elements separated by commas
+template <typename T>
+inline void AppendTelemetryTextValue(std::string& out, T value)
+{
+  util::AppendNumber(out, value);
+}
+
+template <typename T, size_t COUNT>
+inline void AppendTelemetryTextValue(std::string& out, const std::array<T, COUNT>& values)
+{
+  for (size_t i = 0; i < COUNT; i++) {
+    if (i != 0) {
+      out += ',';
+    }
+    util::AppendNumber(out, values[i]);
+  }
+}
+
+// The encoders, each one is generated for a set of channels, so only the channels in the set are looked at and the rest compiles away
+
+// Appends the values separated by separator
+template <uint64_t MASK>
+inline void AppendTelemetryText(const cTelemetry& telemetry, char separator, std::string& out)
+{
+  constexpr uint64_t first = MASK & (~MASK + 1);
+#define ACDISPLAY_TELEMETRY_TEXT(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) \
+  if constexpr ((MASK & GetTelemetryChannelMask(TELEMETRY_CHANNEL::NAME)) != 0) { \
+    if constexpr (GetTelemetryChannelMask(TELEMETRY_CHANNEL::NAME) != first) { \
+      out += separator; \
+    } \
+    AppendTelemetryTextValue(out, telemetry.GROUP.NAME); \
+  }
+  ACDISPLAY_TELEMETRY_CHANNELS(ACDISPLAY_TELEMETRY_TEXT)
+#undef ACDISPLAY_TELEMETRY_TEXT
+}
+
+// Appends GetTelemetryBinarySize(MASK) bytes
+// NOTE: The values are written into a buffer on the stack and appended in one go, the string is only touched once however many channels there are
+template <uint64_t MASK>
+inline void AppendTelemetryBinary(const cTelemetry& telemetry, std::string& out)
+{
+  std::array<char, GetTelemetryBinarySize(MASK)> buffer;
+  char* position = buffer.data();
+#define ACDISPLAY_TELEMETRY_BINARY(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) \
+  if constexpr ((MASK & GetTelemetryChannelMask(TELEMETRY_CHANNEL::NAME)) != 0) { \
+    WriteTelemetryBinaryValue<BINARY_TYPE>(position, telemetry.GROUP.NAME, SCALE); \
+  }
+  ACDISPLAY_TELEMETRY_CHANNELS(ACDISPLAY_TELEMETRY_BINARY)
+#undef ACDISPLAY_TELEMETRY_BINARY
+  (void)position;
+
+  out.append(buffer.data(), buffer.size());
+}
+
+// Appends count samples as one array for each channel, so that each channel's values are together rather than each sample's
+// An array channel has all of its elements for the first sample, then all of them for the second sample, and so on
+template <uint64_t MASK>
+inline void AppendTelemetryBatchBinary(const cTelemetry* samples, size_t count, std::string& out)
+{
+  const size_t offset = out.size();
+  out.resize(offset + (count * GetTelemetryBinarySize(MASK)));
+  char* position = out.data() + offset;
+#define ACDISPLAY_TELEMETRY_BATCH_BINARY(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) \
+  if constexpr ((MASK & GetTelemetryChannelMask(TELEMETRY_CHANNEL::NAME)) != 0) { \
+    for (size_t i = 0; i < count; i++) { \
+      WriteTelemetryBinaryValue<BINARY_TYPE>(position, samples[i].GROUP.NAME, SCALE); \
+    } \
+  }
+  ACDISPLAY_TELEMETRY_CHANNELS(ACDISPLAY_TELEMETRY_BATCH_BINARY)
+#undef ACDISPLAY_TELEMETRY_BATCH_BINARY
+  (void)position;
+}
+
+// The encoders for the channels in a set of groups, a client can ask for any set so there is an encoder generated for each one, see ParseTelemetryGroups
+void AppendTelemetryGroupsText(const cTelemetry& telemetry, uint32_t groups, char separator, std::string& out);
+void AppendTelemetryGroupsBinary(const cTelemetry& telemetry, uint32_t groups, std::string& out);
+
+// The channels in a batch, published_time_us is left out because the sample times are sent separately
+constexpr uint64_t GetTelemetryGroupBatchChannels(uint32_t groups)
+{
+  return GetTelemetryGroupChannels(groups) & ~GetTelemetryChannelMask(TELEMETRY_CHANNEL::published_time_us);
+}
+
+void AppendTelemetryGroupsBatchBinary(const cTelemetry* samples, size_t count, uint32_t groups, std::string& out);
+
+// Appends a line with the channel names, array channels have a column for each element, rpm,load_0,load_1,..., and then one line per sample
+void AppendTelemetryCSVHeader(uint64_t mask, std::string& out);
+
+template <uint64_t MASK>
+inline void AppendTelemetryCSVRow(const cTelemetry& telemetry, std::string& out)
+{
+  AppendTelemetryText<MASK>(telemetry, ',', out);
+  out += '\n';
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "instrumented_mutex.h"
+#include "telemetry_channels.h"
+
+namespace acdisplay {
+
+// Assetto Corsa sends an update every physics step
+const size_t TELEMETRY_HISTORY_SAMPLE_RATE_HZ = 333;
+
+// About 0.77 seconds of updates, a batch client that falls further behind than this skips the oldest samples
+const size_t TELEMETRY_HISTORY_SAMPLES = 256;
+
+// The longest batch_interval_ms that the history can hold every sample for
+// NOTE: A sender can wake up to one interval late, so there can be two intervals between batches
+const uint16_t TELEMETRY_HISTORY_MAX_BATCH_INTERVAL_MS = 250;
+static_assert(((2 * TELEMETRY_HISTORY_MAX_BATCH_INTERVAL_MS * TELEMETRY_HISTORY_SAMPLE_RATE_HZ) / 1000) < TELEMETRY_HISTORY_SAMPLES, "The history must hold two of the longest batch intervals");
+
+// The most recent samples, for the clients that want every sample in batches rather than the latest one at each update, see FormatCarUpdateBatchBinaryMessage
+// The processor pushes each sample and each batch sender reads the samples it hasn't sent yet
+// NOTE: Nothing is recorded while there are no batch clients, and only the telemetry groups that at least one client wants are copied, see telemetry_subscriptions
+class cTelemetryHistory {
+public:
+  cTelemetryHistory();
+
+  void Subscribe();
+  void Unsubscribe();
+  bool IsSubscribed() const { return subscribers.load(std::memory_order_relaxed) != 0; }
+
+  // Records a sample, only the groups in telemetry_groups are copied
+  void Push(const cTelemetry& telemetry, uint32_t telemetry_groups);
+
+  // The sequence number that the next sample pushed will have
+  uint64_t GetNextSequence();
+
+  // Replaces out_samples with the samples from next_sequence onwards, and moves next_sequence past them, only the groups in telemetry_groups are copied
+  // Returns how many samples were skipped because they had already been overwritten
+  // NOTE: This only allocates if out_samples has less than TELEMETRY_HISTORY_SAMPLES capacity
+  size_t Read(uint64_t& next_sequence, uint32_t telemetry_groups, std::vector<cTelemetry>& out_samples);
+
+private:
+  cInstrumentedMutex mutex;
+  std::array<cTelemetry, TELEMETRY_HISTORY_SAMPLES> samples; // A ring buffer, sample n is at n % TELEMETRY_HISTORY_SAMPLES
+  uint64_t sequence; // The sequence number of the next sample
+
+  std::atomic<uint32_t> subscribers;
+};
+
+extern cTelemetryHistory telemetry_history;
+
+}
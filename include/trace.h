@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+// The number of spans each thread keeps, the oldest are overwritten
+const size_t TRACE_EVENTS_PER_THREAD = 4096;
+
+// Once there are this many thread buffers the buffers of threads that have exited are reused, until then they are kept so that we can see what a disconnected client was doing
+const size_t TRACE_MAX_THREAD_BUFFERS = 64;
+
+// Recording is always on so that we can look back at a stutter after it has happened, each span is two clock reads and a few relaxed stores into a buffer owned by the thread
+// Nothing is formatted until a trace is requested
+void SetTracingEnabled(bool enabled);
+bool IsTracingEnabled();
+
+// Names the calling thread in the trace
+void SetTraceThreadName(const std::string& name);
+
+uint64_t GetTraceTimeNS();
+
+// Records a span that has already finished, name must be a string literal or otherwise live forever
+void RecordTraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+// The innermost TRACE_SCOPE on the calling thread, or nullptr outside of any scope
+// The allocation counter in the unit tests and benchmarks uses this to attribute allocations to pipeline stages
+inline thread_local const char* trace_scope_name = nullptr;
+
+// Returns the spans from the last duration_ms of every thread in the Chrome trace event format, which can be loaded in Perfetto or chrome://tracing
+std::string GetTraceJSON(uint64_t duration_ms);
+
+// Writes the trace to a file in folder whenever the process receives signal_number, for example SIGUSR2
+bool StartTraceDumpOnSignal(int signal_number, const std::string& folder, uint64_t duration_ms);
+
+class cTraceScope {
+public:
+  explicit cTraceScope(const char* _name) :
+    name(_name),
+    parent_name(trace_scope_name),
+    start_ns(IsTracingEnabled() ? GetTraceTimeNS() : 0)
+  {
+    trace_scope_name = name;
+  }
+
+  ~cTraceScope()
+  {
+    if (start_ns != 0) {
+      RecordTraceSpan(name, start_ns, GetTraceTimeNS());
+    }
+
+    trace_scope_name = parent_name;
+  }
+
+  cTraceScope(const cTraceScope&) = delete;
+  cTraceScope& operator=(const cTraceScope&) = delete;
+
+private:
+  const char* name;
+  const char* parent_name;
+  uint64_t start_ns;
+};
+
+}
+
+#define TRACE_SCOPE_CONCATENATE_INNER(a, b) a##b
+#define TRACE_SCOPE_CONCATENATE(a, b) TRACE_SCOPE_CONCATENATE_INNER(a, b)
+
+// Usage: TRACE_SCOPE("websocket_encode"); records a span from here to the end of the scope
+#define TRACE_SCOPE(NAME) util::cTraceScope TRACE_SCOPE_CONCATENATE(trace_scope_, __LINE__)(NAME)
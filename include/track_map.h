@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace acdisplay {
+
+// The lap is split into this many bins by normalized track position, the car's position is sent to the clients as a bin index
+const size_t TRACK_MAP_BIN_COUNT = 1024;
+
+class cTrackMapPoint {
+public:
+  uint16_t bin; // The position bin that this point came from, so that clients can place the car between two points
+  float x;
+  float z;
+};
+
+// A simplified outline of the track in world coordinates, ordered by position around the lap
+class cTrackMap {
+public:
+  void Clear() { points.clear(); }
+  bool IsValid() const { return (points.size() >= 2); }
+
+  std::vector<cTrackMapPoint> points;
+};
+
+uint16_t GetTrackMapPositionIndex(float position_normalized);
+
+// Simplify a polyline with the Douglas-Peucker algorithm, points closer than tolerance to the simplified line are removed
+void SimplifyTrackMap(const std::vector<cTrackMapPoint>& points, float tolerance, std::vector<cTrackMapPoint>& out_points);
+
+// Track maps are cached on disk so that we only have to drive a lap on each track once
+std::string GetTrackMapFilePath(const std::string& track_name, const std::string& track_config);
+bool LoadTrackMap(const std::string& file_path, cTrackMap& out_map);
+bool SaveTrackMap(const std::string& file_path, const cTrackMap& map);
+
+// Saves a copy of the map on another thread, so that the ingest thread doesn't wait for the disk
+void SaveTrackMapInBackground(const std::string& file_path, const cTrackMap& map);
+
+// Builds the track map from the car coordinates on the first clean lap
+// A lap is clean if we saw it start at the line and the car was never teleported (Back to the pits, restarted, etc.)
+class cTrackMapBuilder {
+public:
+  cTrackMapBuilder();
+
+  void Reset();
+
+  // Use a map that we already have, such as the cached map for this track, instead of building one
+  void SetMap(const cTrackMap& new_map);
+
+  // Returns true if the map was completed with this sample
+  bool Update(float position_normalized, float x, float z, uint32_t lap_count);
+
+  bool HasMap() const { return has_map; }
+  const cTrackMap& GetMap() const { return map; }
+
+private:
+  void StartLap(uint32_t lap_count);
+  bool FinishLap();
+
+  bool has_previous;
+  float previous_position;
+  uint32_t previous_lap_count;
+
+  bool recording;
+  uint32_t recording_lap_count;
+
+  class cBin {
+  public:
+    double sum_x;
+    double sum_z;
+    uint32_t samples;
+  };
+  std::array<cBin, TRACK_MAP_BIN_COUNT> bins;
+
+  bool has_map;
+  cTrackMap map;
+};
+
+// Mutex and data
+// Lock the mutex, use the data, and unlock the mutex
+// NOTE: This changes very rarely so it is kept out of cACData to avoid copying it for every update, ac_data.track_map_sequence tells senders when it has changed
+extern std::mutex mutex_track_map;
+extern cTrackMap track_map;
+
+}
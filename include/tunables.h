@@ -0,0 +1,20 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace acdisplay {
+
+// Values that can be changed while running without restarting anything
+// These are read on the hot paths, so each one is an atomic rather than sitting behind a mutex
+class cTunables {
+public:
+  cTunables();
+
+  std::atomic<uint32_t> update_interval_ms; // How often we send updates to each client
+  std::atomic<uint32_t> batch_interval_ms; // How often we send updates to each batch client, see WEBSOCKET_UPDATE_FORMAT::BATCH
+};
+
+extern cTunables tunables;
+
+}
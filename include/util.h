@@ -1,8 +1,11 @@
 #pragma once
 
+#include <charconv>
 #include <cstdint>
 
+#include <string>
 #include <string_view>
+#include <type_traits>
 
 namespace util {
 
@@ -12,12 +15,33 @@ inline constexpr T clamp(const T& i, const T& lower, const T& upper)
   return (i < lower) ? lower : (i > upper) ? upper : i;
 }
 
+// Formats like std::to_string, but appends to out so that a reused buffer doesn't allocate
+template <typename T>
+inline void AppendNumber(std::string& out, T value)
+{
+  // Big enough for the largest float in fixed notation
+  char buffer[64];
+  std::to_chars_result result;
+  if constexpr (std::is_floating_point_v<T>) {
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6);
+  } else {
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  }
+
+  if (result.ec == std::errc()) {
+    out.append(buffer, result.ptr);
+  }
+}
+
 // msleep(): Sleep for the requested number of milliseconds
 int msleep(long msec);
 
 // Get the time since epoch in milliseconds
 uint64_t GetTimeMS();
 
+// Get a monotonic time in microseconds, only useful for measuring durations
+uint64_t GetMonotonicTimeUS();
+
 std::string GetHomeFolder();
 std::string GetConfigFolder(std::string_view sApplicationNameLower);
 bool TestFileExists(const std::string& sFilePath);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace acdisplay {
+
+enum class WATCHDOG_STAGE {
+  INGEST, // Receiving and publishing the ACUDP packets
+  BROADCAST, // Sending the updates to the websocket clients
+};
+
+const size_t WATCHDOG_STAGE_COUNT = 2;
+
+const char* GetWatchdogStageName(WATCHDOG_STAGE stage);
+
+const size_t WATCHDOG_MAX_STALL_REPORTS = 20;
+
+// Checks that the ingest and broadcast stages are still making progress, when one of them stalls the flight recorder, the state of each thread, the metrics and the recent trace spans are written to a folder
+// A stage is only expected to make progress once it has started, ingest after the first packet and while it isn't waiting for the next one, and broadcast while there are clients connected
+// NOTE: Each stall is only reported once until the stage makes progress again, and only the newest WATCHDOG_MAX_STALL_REPORTS reports are kept
+class cWatchdog {
+public:
+  cWatchdog();
+  ~cWatchdog();
+
+  bool Start(const std::string& folder, uint64_t stall_threshold_ms);
+  void Stop();
+
+  // Called by each stage every time it does some work, this is a single relaxed store
+  void Progress(WATCHDOG_STAGE stage, uint64_t now_ms);
+
+  // Called by a stage before and after it blocks waiting for input, a stage that is waiting isn't stalled, for example ingest while the game is paused or closed
+  void SetWaiting(WATCHDOG_STAGE stage, bool waiting);
+
+  // Returns the stages that have just stalled, expected says which stages should currently be making progress
+  std::vector<WATCHDOG_STAGE> Check(uint64_t now_ms, const std::array<bool, WATCHDOG_STAGE_COUNT>& expected);
+
+  void SetStallThresholdMS(uint64_t _stall_threshold_ms) { stall_threshold_ms.store(_stall_threshold_ms, std::memory_order_relaxed); }
+
+private:
+  void MainLoop();
+
+  std::atomic<uint64_t> stall_threshold_ms;
+  std::array<std::atomic<uint64_t>, WATCHDOG_STAGE_COUNT> last_progress_ms;
+  std::array<std::atomic<bool>, WATCHDOG_STAGE_COUNT> waiting;
+
+  // Only accessed by Check
+  std::array<uint64_t, WATCHDOG_STAGE_COUNT> expected_since_ms;
+  std::array<bool, WATCHDOG_STAGE_COUNT> stalled;
+
+  std::string folder;
+
+  std::mutex mutex_stop;
+  std::condition_variable cv_stop;
+  bool stop;
+  std::thread thread;
+};
+
+extern cWatchdog watchdog;
+
+// Returns the name, state and kernel wait channel of each thread in this process, one per line
+std::string GetThreadStates();
+
+// Writes a stall report and the recent trace spans to folder, returns the path of the report
+std::string WriteStallReport(const std::string& folder, const std::string& reason);
+
+// Removes all but the newest max_reports stall reports and their traces from folder
+void RemoveOldStallReports(const std::string& folder, size_t max_reports);
+
+}
@@ -1,10 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "ip_address.h"
 
 namespace acdisplay {
 
 class cStaticResourcesRequestHandler;
+class cDynamicResourcesRequestHandler;
 class cWebSocketRequestHandler;
 class cWebServer;
 
@@ -15,13 +24,39 @@ public:
   ~cWebServerManager();
 
   bool Create(const util::cIPAddress& host, uint16_t port, const std::string& private_key, const std::string& public_cert);
+
+  // Start listening with new settings without dropping the clients that are already connected
+  bool Rebind(const util::cIPAddress& host, uint16_t port, const std::string& private_key, const std::string& public_cert);
+
   bool Destroy();
 
 private:
+  // A server that has been replaced by Rebind, it keeps serving its existing clients for a while
+  class cRetiredWebServer {
+  public:
+    cWebServer* webserver;
+    uint64_t retired_time_ms;
+    uint64_t closing_clients_time_ms; // When we asked its remaining clients to disconnect, 0 if we haven't yet
+  };
+
+  void ReaperMainLoop();
+  void StopReaperThread();
+  void ReapRetiredWebServers(uint64_t now_ms);
+
   // NOTE: We would use std::unique_ptr, but it needs to know about the destructor of the item to delete it
   cStaticResourcesRequestHandler* static_resources_request_handler;
+  cDynamicResourcesRequestHandler* dynamic_resources_request_handler;
   cWebSocketRequestHandler* web_socket_request_handler;
   cWebServer* webserver;
+
+  std::mutex mutex_retired_webservers;
+  std::vector<cRetiredWebServer> retired_webservers; // Previous servers that are still serving their existing clients
+
+  // Stops the retired servers once their clients have gone
+  std::mutex mutex_stop;
+  std::condition_variable cv_stop;
+  bool stop;
+  std::thread reaper_thread;
 };
 
 }
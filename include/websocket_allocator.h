@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+struct MHD_WebSocketStream;
+
+namespace acdisplay {
+
+// libmicrohttpd_ws allocates a new buffer for every frame that it decodes and frees it straight after (We write our own frames, see websocket_frame.h)
+// Our streams allocate through these instead, which keep a few freed buffers on each thread and hand them out again, so a receiver that has warmed up doesn't touch the heap
+void* WebSocketMalloc(size_t size);
+void* WebSocketRealloc(void* p, size_t size);
+void WebSocketFree(void* p);
+
+// Creates a server side stream for a client connection that allocates with the functions above, returns a MHD_WEBSOCKET_STATUS
+int CreateServerWebSocketStream(struct MHD_WebSocketStream** out_ws);
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+
+namespace acdisplay {
+
+// Writes the frames that we send to the websocket clients (RFC 6455)
+// libmicrohttpd_ws allocates a new buffer for every frame it encodes, these write into a buffer that the caller keeps, so once it has grown to fit the biggest frame there is nothing left to allocate
+// NOTE: We only use libmicrohttpd_ws to decode what the clients send us
+// NOTE: Frames from the server are never masked or fragmented, so the header is just the opcode and the payload length
+
+enum class WEBSOCKET_OPCODE : uint8_t {
+  TEXT = 0x1,
+  BINARY = 0x2,
+  CLOSE = 0x8,
+  PING = 0x9,
+  PONG = 0xA,
+};
+
+// 2 bytes, plus 8 for the longest payload length
+const size_t WEBSOCKET_MAX_FRAME_HEADER_BYTES = 10;
+
+// Writes the header for a final frame with this payload length, and returns the number of bytes written
+size_t WriteWebSocketFrameHeader(WEBSOCKET_OPCODE opcode, size_t payload_length, uint8_t (&out_header)[WEBSOCKET_MAX_FRAME_HEADER_BYTES]);
+
+// Replaces the contents of out_frame with the header followed by the payload
+// NOTE: libmicrohttpd does the TLS, we write plain bytes to our end of the upgraded connection's socket pair, so a writev of the header and the payload would work too
+// The payload is copied in anyway so that each frame is a single buffer for cWebSocketFrameSink and a single send, our payloads are small so the copy costs little next to the send, see BM_WebSocketEncodeText
+// NOTE: A text payload must be valid UTF-8, the browser closes the connection if it isn't, so anything that came from outside has to be checked before it is put in a message
+void EncodeWebSocketFrame(WEBSOCKET_OPCODE opcode, std::string_view payload, std::string& out_frame);
+
+// A close frame with a status code and no reason
+void EncodeWebSocketCloseFrame(uint16_t status_code, std::string& out_frame);
+
+}
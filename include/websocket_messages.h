@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include "ac_data.h"
+#include "leaderboard.h"
+#include "sector_timing.h"
+#include "track_map.h"
+
+namespace acdisplay {
+
+// The text messages that we send to the websocket clients, each one is a type followed by "|" separated fields, see resources/receive.js for the parsing side
+// These don't lock or send anything so that they can be tested and benchmarked on their own
+// The Format functions replace the contents of out, so a sender can reuse one buffer for every message without allocating once it has grown
+
+// car_config|rpm_red_line|rpm_maximum|speedometer_red_line_kph|speedometer_maximum_kph
+void FormatCarConfigMessage(const cACData& data, std::string& out);
+std::string GetCarConfigMessage(const cACData& data);
+
+// telemetry_channels|name,binary_type,scale,units,count|...
+// Describes the channels in each car_update, in order, so that the clients don't have to hard code where each value is, see ACDISPLAY_TELEMETRY_CHANNELS
+// A channel with a count of more than 1 is an array, it is one field with the elements separated by commas in a text update, and count values in a binary update
+void FormatTelemetryChannelsMessage(uint64_t mask, std::string& out);
+
+// car_update|gear|accelerator|brake|clutch|rpm|speed_kmh|lap_time_ms|last_lap_ms|best_lap_ms|lap_count|shift_lights|current_sector|current_sector_ms|wheel_slip|track_position_index|published_time_us
+// The fields are the TELEMETRY_CAR_UPDATE_CHANNELS, published_time_us is the server's monotonic clock (See util::GetMonotonicTimeUS), a client on the same machine can use it to measure the latency of each update
+void FormatCarUpdateMessage(const cACData& data, std::string& out);
+// The core channels followed by the channels in any other groups that the client asked for, see ParseTelemetryGroups
+void FormatCarUpdateMessage(const cACData& data, uint32_t telemetry_groups, std::string& out);
+std::string GetCarUpdateMessage(const cACData& data);
+
+// Binary messages start with a type byte
+enum class BINARY_MESSAGE_TYPE : uint8_t {
+  CAR_UPDATE = 1,
+  CAR_UPDATE_BATCH = 2,
+};
+
+// The same values as car_update, packed as the binary types in the telemetry_channels message, for clients that connect with ?format=binary
+void FormatCarUpdateBinaryMessage(const cACData& data, std::string& out);
+void FormatCarUpdateBinaryMessage(const cACData& data, uint32_t telemetry_groups, std::string& out);
+
+// Every sample since the last batch in one message, for clients that connect with ?format=batch
+// The type byte, a u16 sample count, the u64 published_time_us of the first sample, and a u32 for each sample with the microseconds since then
+// Followed by an array for each channel in the telemetry_channels message apart from published_time_us, with a value for each sample (count values for each sample for an array channel)
+// NOTE: There can be at most TELEMETRY_HISTORY_SAMPLES samples
+void FormatCarUpdateBatchBinaryMessage(const std::vector<cTelemetry>& samples, uint32_t telemetry_groups, std::string& out);
+
+// sector_times|last_completed_sector|last_ms...|best_ms...|theoretical_best_lap_ms
+void FormatSectorTimesMessage(const cSectorTimes& sector_times, std::string& out);
+std::string GetSectorTimesMessage(const cSectorTimes& sector_times);
+
+// track_map|bin_count|bin,x,z|...
+void FormatTrackMapMessage(const cTrackMap& map, std::string& out);
+std::string GetTrackMapMessage(const cTrackMap& map);
+
+// car_id,laps,last_lap_ms,best_lap_ms,total_ms,driver,car
+// NOTE: This appends to out, because the rows are added to a leaderboard message
+void AppendLeaderboardRow(const cLeaderboardEntry& entry, std::string& out);
+std::string GetLeaderboardRow(const cLeaderboardEntry& entry);
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ac_data.h"
+#include "sector_timing.h"
+#include "websocket_frame.h"
+
+namespace acdisplay {
+
+// Where the frames for one client go, the web server writes them to the client's socket and the benchmarks keep them in memory
+class cWebSocketFrameSink {
+public:
+  virtual ~cWebSocketFrameSink() {}
+
+  // Returns false if the frame could not be sent
+  virtual bool SendFrame(std::string_view frame) = 0;
+};
+
+// How a client wants the car updates, the other messages are always text
+enum class WEBSOCKET_UPDATE_FORMAT {
+  TEXT,
+  BINARY,
+  BATCH, // Binary, with every sample since the last update, see FormatCarUpdateBatchBinaryMessage
+};
+
+// Sends the updates to one websocket client, and remembers which config, sector times, track map and leaderboard it has already been sent
+// NOTE: Each client has its own sender which is only used by that client's sender thread
+// NOTE: The sender subscribes to the client's telemetry groups for as long as it exists, see telemetry_subscriptions
+class cWebSocketSender {
+public:
+  cWebSocketSender(cWebSocketFrameSink& sink, int client_id, WEBSOCKET_UPDATE_FORMAT update_format, uint32_t telemetry_groups);
+  ~cWebSocketSender();
+
+  cWebSocketSender(const cWebSocketSender&) = delete;
+  cWebSocketSender& operator=(const cWebSocketSender&) = delete;
+
+  // Sends the telemetry channels and the car config, this is called once when the client connects
+  void SendInitialMessages();
+
+  // Sends a car update from the latest ac_data, followed by any events that have changed since the last update
+  void SendUpdate();
+
+private:
+  // Sends whatever is in message
+  void SendMessage(WEBSOCKET_OPCODE opcode);
+  void SendCarConfig(const cACData& copy);
+  void SendSectorTimes(const cSectorTimes& sector_times);
+  void SendTrackMap();
+  void SendLeaderboard();
+
+  cWebSocketFrameSink& sink;
+  int client_id; // Only used for diagnostics
+  WEBSOCKET_UPDATE_FORMAT update_format;
+  uint32_t telemetry_groups; // The groups of channels in each car update, see ParseTelemetryGroups
+
+  // The latest ac_data, only the telemetry groups that this client wants are copied into it
+  cACData snapshot;
+
+  // For batch clients, the next sample to send from telemetry_history, and the samples that are being sent
+  uint64_t history_sequence;
+  std::vector<cTelemetry> batch_samples;
+
+  // Every message is formatted into this, so it only allocates until it has grown to fit the biggest message
+  std::string message;
+
+  // The message is framed into this, which is reused the same way
+  std::string frame;
+
+  // The last car config that was sent to this client
+  uint32_t car_config_sequence;
+
+  // The last sector times event that was sent to this client
+  uint32_t sector_times_sequence;
+
+  // The last track map that was sent to this client
+  uint32_t track_map_sequence;
+
+  // The last leaderboard that was sent to this client
+  uint32_t leaderboard_sequence;
+  uint32_t leaderboard_order_sequence;
+};
+
+}
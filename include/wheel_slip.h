@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace acdisplay {
+
+// Wheels are in the same order as Assetto Corsa, front left, front right, rear left, rear right
+const size_t WHEEL_COUNT = 4;
+
+// The wheel slip state is packed into a single small integer for sending to the clients
+// Bits 0..3: The wheel is locked up (Turning much slower than the car is moving)
+// Bits 4..7: The wheel is spinning (Turning much faster than the car is moving)
+const uint8_t WHEEL_SLIP_LOCKUP_MASK = 0x0F;
+const uint8_t WHEEL_SLIP_WHEELSPIN_MASK = 0xF0;
+const uint8_t WHEEL_SLIP_WHEELSPIN_SHIFT = 4;
+
+// Detects lockups and wheelspin on all four wheels at once
+// The slip for each wheel is (wheel surface speed - car speed) / car speed, a wheel is flagged when the slip goes past the on threshold and stays flagged until it comes back past the off threshold, so that the flags don't flicker
+class cWheelSlipDetector {
+public:
+  cWheelSlipDetector();
+
+  void Reset();
+
+  // Returns the packed state for this sample, see WHEEL_SLIP_LOCKUP_MASK
+  // NOTE: This uses SSE2 where it is available, define ACDISPLAY_WHEEL_SLIP_SCALAR to use UpdateScalar instead
+  uint8_t Update(float speed_ms, const float wheel_angular_speed[WHEEL_COUNT], const float tyre_radius[WHEEL_COUNT], const float load[WHEEL_COUNT]);
+
+  // The plain loop that Update uses without SSE2, this is always compiled so that the unit tests can check it against Update on any machine
+  uint8_t UpdateScalar(float speed_ms, const float wheel_angular_speed[WHEEL_COUNT], const float tyre_radius[WHEEL_COUNT], const float load[WHEEL_COUNT]);
+
+  uint8_t GetState() const { return state; }
+
+private:
+  uint8_t state;
+};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "gnutlsmm.h"
+#include "ip_address.h"
+#include "tcp_connection.h"
+
+namespace loadgenerator {
+
+// A TCP connection to the server, with TLS on top if credentials are provided
+class cClientConnection {
+public:
+  // Connects and performs the TLS handshake, this blocks until it is done
+  // receive_buffer_bytes asks for a smaller socket receive buffer, 0 leaves it at the default
+  bool Connect(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials, int receive_buffer_bytes);
+  void Close();
+
+  void SetNonBlocking();
+
+  int GetSocket() const { return connection.get_sd(); }
+
+  // Whether there is TLS data that has already been read from the socket but not decrypted yet, poll won't tell us about it
+  bool HasPendingData() const;
+
+  bool SendAll(std::string_view data);
+
+  // Returns the number of bytes read, 0 if the connection was closed, or -1 with errno set to EAGAIN if nothing was available on a non blocking connection
+  ssize_t Receive(uint8_t* buffer, size_t length);
+
+private:
+  tcp_connection connection;
+  std::unique_ptr<gnutlsmm::client_session> session;
+};
+
+}
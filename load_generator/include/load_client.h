@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include <microhttpd.h>
+#include <microhttpd_ws.h>
+
+#include "client_connection.h"
+
+namespace loadgenerator {
+
+// What one simulated display has received since the statistics were last reset
+class cClientStatistics {
+public:
+  cClientStatistics();
+
+  void Clear();
+
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t car_updates;
+  std::vector<uint32_t> latencies_us; // From the car_update published_time_us to the frame being decoded here
+};
+
+// One simulated display, connects to /ACDisplayServerWebSocket over HTTP or TLS and decodes the frames the server sends
+// NOTE: The latency is only meaningful when we are on the same machine as the server, because published_time_us is the server's monotonic clock
+class cLoadClient {
+public:
+  // groups is a comma separated list of the telemetry groups to ask for, or empty for just the core channels
+  // A batch client asks for every sample in batches, see FormatCarUpdateBatchBinaryMessage
+  cLoadClient(bool slow_reader, const std::string& groups, bool batch);
+  ~cLoadClient();
+
+  // Connects, performs the TLS handshake if credentials are provided, and upgrades to a websocket, this blocks until it is done
+  bool Connect(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials);
+  void Close();
+
+  bool IsConnected() const { return connected; }
+  bool IsSlowReader() const { return slow_reader; }
+  int GetSocket() const { return connection.GetSocket(); }
+
+  bool HasPendingData() const { return connection.HasPendingData(); }
+
+  // Reads whatever is available without blocking and decodes it, a slow reader only reads one small chunk at a time
+  // Returns false if the connection was closed
+  bool Read();
+
+  cClientStatistics statistics;
+
+private:
+  bool ReadUpgradeResponse();
+  bool Decode(const uint8_t* data, size_t length);
+  void OnTextFrame(const char* payload, size_t length);
+  void OnBinaryFrame(const char* payload, size_t length);
+
+  const bool slow_reader;
+  const std::string groups;
+  const bool batch;
+  bool connected;
+
+  cClientConnection connection;
+  struct MHD_WebSocketStream* ws;
+
+  // Where published_time_us is in each car_update, from the telemetry_channels message, or 0 if we haven't been told
+  size_t published_time_us_field;
+};
+
+}
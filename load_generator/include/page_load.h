@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include "gnutlsmm.h"
+#include "ip_address.h"
+
+namespace loadgenerator {
+
+// What a browser fetches when it loads index.html, see cStaticResourcesRequestHandler::LoadStaticResources
+const std::array<std::string_view, 8> PAGE_RESOURCES = {
+  "/",
+  "/style.css",
+  "/favicon.svg",
+  "/disconnected_icon.svg",
+  "/fullscreen_icon.svg",
+  "/dial.js",
+  "/receive.js",
+  "/util.js",
+};
+
+class cPageLoadTimes {
+public:
+  cPageLoadTimes();
+
+  std::vector<uint32_t> handshake_us; // Connecting and the TLS handshake, one for each connection
+  std::vector<uint32_t> request_us; // From sending a request to receiving the whole response
+  uint32_t page_us; // From starting to connect to receiving the last resource
+  uint64_t bytes;
+};
+
+// Loads the whole page like a display does, either over one keep alive connection, or with a new connection for each resource
+bool LoadPage(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials, bool connection_per_request, cPageLoadTimes& out_times);
+
+}
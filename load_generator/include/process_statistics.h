@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace loadgenerator {
+
+// The CPU time and memory used by a process so far, read from /proc/<pid>
+class cProcessSample {
+public:
+  cProcessSample();
+
+  uint64_t cpu_time_ms; // User and system time of all threads
+  uint64_t rss_bytes;
+};
+
+bool GetProcessSample(int pid, cProcessSample& out_sample);
+
+// The CPU used between two samples as a percentage of one core
+float GetCPUPercent(const cProcessSample& before, const cProcessSample& after, uint64_t elapsed_ms);
+
+}
@@ -0,0 +1,89 @@
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "client_connection.h"
+
+namespace loadgenerator {
+
+bool cClientConnection::Connect(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials, int receive_buffer_bytes)
+{
+  Close();
+
+  if (!connection.connect(host, port)) {
+    return false;
+  }
+
+  if (receive_buffer_bytes != 0) {
+    setsockopt(connection.get_sd(), SOL_SOCKET, SO_RCVBUF, &receive_buffer_bytes, sizeof(receive_buffer_bytes));
+  }
+
+  if (credentials != nullptr) {
+    session = std::make_unique<gnutlsmm::client_session>();
+    session->init();
+    session->set_credentials(*credentials);
+    session->set_priority("SECURE128:+SECURE192:-VERS-ALL:+VERS-TLS1.2:%SAFE_RENEGOTIATION", nullptr);
+    session->set_transport_ptr((gnutls_transport_ptr_t)(ptrdiff_t)connection.get_sd());
+
+    int result = 0;
+    do {
+      result = session->handshake();
+    } while ((result < 0) && (gnutls_error_is_fatal(result) == 0));
+
+    if (result < 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void cClientConnection::Close()
+{
+  session.reset();
+  connection.close();
+}
+
+void cClientConnection::SetNonBlocking()
+{
+  const int flags = fcntl(connection.get_sd(), F_GETFL, 0);
+  fcntl(connection.get_sd(), F_SETFL, flags | O_NONBLOCK);
+}
+
+bool cClientConnection::HasPendingData() const
+{
+  return (session != nullptr) && (session->check_pending() != 0);
+}
+
+bool cClientConnection::SendAll(std::string_view data)
+{
+  size_t sent = 0;
+  while (sent < data.length()) {
+    const ssize_t result = (session != nullptr) ? session->send(data.data() + sent, data.length() - sent) : ::send(connection.get_sd(), data.data() + sent, data.length() - sent, MSG_NOSIGNAL);
+    if (result <= 0) {
+      return false;
+    }
+
+    sent += size_t(result);
+  }
+
+  return true;
+}
+
+ssize_t cClientConnection::Receive(uint8_t* buffer, size_t length)
+{
+  if (session != nullptr) {
+    const ssize_t result = session->recv(buffer, length);
+    if ((result == GNUTLS_E_AGAIN) || (result == GNUTLS_E_INTERRUPTED)) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    return (result < 0) ? 0 : result;
+  }
+
+  return ::recv(connection.get_sd(), buffer, length, 0);
+}
+
+}
@@ -0,0 +1,290 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <string_view>
+
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "load_client.h"
+#include "util.h"
+
+namespace {
+
+// The upgrade response is tiny, anything bigger than this isn't our server
+const size_t MAX_UPGRADE_RESPONSE_BYTES = 4 * 1024;
+
+const size_t READ_BUFFER_BYTES = 16 * 1024;
+
+// A slow reader reads one small chunk at a time, and asks for a small socket receive buffer so that the server's sends back up sooner
+const size_t SLOW_READER_READ_BYTES = 512;
+const int SLOW_READER_RECEIVE_BUFFER_BYTES = 4 * 1024;
+
+// Client mode needs random numbers to mask the frames we send, we never send any, but the stream still requires a generator
+size_t RandomNumberGenerator(void* cls, void* buf, size_t buf_len)
+{
+  (void)cls;
+
+  const ssize_t result = getrandom(buf, buf_len, 0);
+  return (result < 0) ? 0 : size_t(result);
+}
+
+bool GetField(std::string_view message, size_t index, std::string_view& out_field)
+{
+  for (size_t i = 0; i < index; i++) {
+    const size_t separator = message.find('|');
+    if (separator == std::string_view::npos) {
+      return false;
+    }
+
+    message.remove_prefix(separator + 1);
+  }
+
+  out_field = message.substr(0, message.find('|'));
+  return true;
+}
+
+}
+
+namespace loadgenerator {
+
+cClientStatistics::cClientStatistics() :
+  frames(0),
+  bytes(0),
+  car_updates(0)
+{
+}
+
+void cClientStatistics::Clear()
+{
+  frames = 0;
+  bytes = 0;
+  car_updates = 0;
+  latencies_us.clear();
+}
+
+
+cLoadClient::cLoadClient(bool _slow_reader, const std::string& _groups, bool _batch) :
+  slow_reader(_slow_reader),
+  groups(_groups),
+  batch(_batch),
+  connected(false),
+  ws(nullptr),
+  published_time_us_field(0)
+{
+}
+
+cLoadClient::~cLoadClient()
+{
+  Close();
+}
+
+bool cLoadClient::Connect(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials)
+{
+  Close();
+
+  if (MHD_websocket_stream_init2(&ws, MHD_WEBSOCKET_FLAG_CLIENT | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0, malloc, realloc, free, nullptr, RandomNumberGenerator) != MHD_WEBSOCKET_STATUS_OK) {
+    ws = nullptr;
+    return false;
+  }
+
+  if (!connection.Connect(host, port, credentials, slow_reader ? SLOW_READER_RECEIVE_BUFFER_BYTES : 0)) {
+    return false;
+  }
+
+  std::string query;
+  if (batch) {
+    query = "format=batch";
+  }
+  if (!groups.empty()) {
+    query += (query.empty() ? "groups=" : "&groups=") + groups;
+  }
+
+  // The key is only there so the server can prove it understood the request, it doesn't need to be secret
+  const std::string request =
+    "GET /ACDisplayServerWebSocket" + (query.empty() ? std::string() : ("?" + query)) + " HTTP/1.1\r\n"
+    "Host: " + util::ToString(host) + ":" + std::to_string(port) + "\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n";
+  if (!connection.SendAll(request) || !ReadUpgradeResponse()) {
+    return false;
+  }
+
+  // From now on we only read when poll tells us to
+  connection.SetNonBlocking();
+
+  connected = true;
+  return true;
+}
+
+void cLoadClient::Close()
+{
+  connected = false;
+  published_time_us_field = 0;
+
+  connection.Close();
+
+  if (ws != nullptr) {
+    MHD_websocket_stream_free(ws);
+    ws = nullptr;
+  }
+}
+
+bool cLoadClient::ReadUpgradeResponse()
+{
+  // Read one byte at a time so that we don't swallow the start of the first frame
+  std::string response;
+  while (response.find("\r\n\r\n") == std::string::npos) {
+    if (response.length() >= MAX_UPGRADE_RESPONSE_BYTES) {
+      return false;
+    }
+
+    uint8_t c = 0;
+    if (connection.Receive(&c, 1) != 1) {
+      return false;
+    }
+
+    response.push_back(char(c));
+  }
+
+  // HTTP/1.1 101 Switching Protocols
+  return response.starts_with("HTTP/1.1 101");
+}
+
+bool cLoadClient::Read()
+{
+  uint8_t buffer[READ_BUFFER_BYTES];
+  const size_t read_length = slow_reader ? SLOW_READER_READ_BYTES : sizeof(buffer);
+
+  while (true) {
+    const ssize_t result = connection.Receive(buffer, read_length);
+    if (result == 0) {
+      // The server closed the connection
+      return false;
+    } else if (result < 0) {
+      return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR));
+    }
+
+    statistics.bytes += size_t(result);
+
+    if (!Decode(buffer, size_t(result))) {
+      return false;
+    }
+
+    if (slow_reader) {
+      // Leave the rest for next time
+      return true;
+    }
+  }
+}
+
+bool cLoadClient::Decode(const uint8_t* data, size_t length)
+{
+  size_t offset = 0;
+  while (offset < length) {
+    size_t new_offset = 0;
+    char* payload = nullptr;
+    size_t payload_length = 0;
+    const int status = MHD_websocket_decode(ws, reinterpret_cast<const char*>(data + offset), length - offset, &new_offset, &payload, &payload_length);
+    if (status < 0) {
+      if (payload != nullptr) {
+        MHD_websocket_free(ws, payload);
+      }
+      return false;
+    }
+
+    offset += new_offset;
+
+    if (status == MHD_WEBSOCKET_STATUS_OK) {
+      // The rest of the frame hasn't arrived yet, the stream keeps what it has seen so far
+      break;
+    }
+
+    statistics.frames++;
+
+    if (status == MHD_WEBSOCKET_STATUS_TEXT_FRAME) {
+      OnTextFrame(payload, payload_length);
+    } else if (status == MHD_WEBSOCKET_STATUS_BINARY_FRAME) {
+      OnBinaryFrame(payload, payload_length);
+    }
+
+    if (payload != nullptr) {
+      MHD_websocket_free(ws, payload);
+    }
+
+    if (status == MHD_WEBSOCKET_STATUS_CLOSE_FRAME) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void cLoadClient::OnTextFrame(const char* payload, size_t length)
+{
+  const std::string_view message(payload, length);
+  if (message.starts_with("telemetry_channels|")) {
+    // telemetry_channels|name,binary_type,scale,units,count|..., the car_update fields are in the same order
+    std::string_view channel;
+    for (size_t i = 1; GetField(message, i, channel); i++) {
+      if (channel.substr(0, channel.find(',')) == "published_time_us") {
+        published_time_us_field = i;
+        break;
+      }
+    }
+    return;
+  } else if (!message.starts_with("car_update|")) {
+    return;
+  }
+
+  statistics.car_updates++;
+
+  std::string_view field;
+  if ((published_time_us_field == 0) || !GetField(message, published_time_us_field, field) || field.empty()) {
+    return;
+  }
+
+  const uint64_t published_time_us = std::strtoull(std::string(field).c_str(), nullptr, 10);
+  const uint64_t now_us = util::GetMonotonicTimeUS();
+  if ((published_time_us != 0) && (now_us >= published_time_us)) {
+    statistics.latencies_us.push_back(uint32_t(std::min<uint64_t>(now_us - published_time_us, UINT32_MAX)));
+  }
+}
+
+void cLoadClient::OnBinaryFrame(const char* payload, size_t length)
+{
+  // The type byte, a u16 sample count, the u64 published_time_us of the first sample, and a u32 for each sample with the microseconds since then, see FormatCarUpdateBatchBinaryMessage
+  const uint8_t CAR_UPDATE_BATCH = 2;
+  const size_t header_size = 1 + sizeof(uint16_t) + sizeof(uint64_t);
+  if ((length < header_size) || (uint8_t(payload[0]) != CAR_UPDATE_BATCH)) {
+    return;
+  }
+
+  uint16_t count = 0;
+  std::memcpy(&count, payload + 1, sizeof(count));
+  uint64_t base_time_us = 0;
+  std::memcpy(&base_time_us, payload + 1 + sizeof(count), sizeof(base_time_us));
+  if (length < (header_size + (count * sizeof(uint32_t)))) {
+    return;
+  }
+
+  statistics.car_updates += count;
+
+  // Every sample in the batch has waited since it was published
+  const uint64_t now_us = util::GetMonotonicTimeUS();
+  for (size_t i = 0; i < count; i++) {
+    uint32_t offset_us = 0;
+    std::memcpy(&offset_us, payload + header_size + (i * sizeof(offset_us)), sizeof(offset_us));
+    const uint64_t published_time_us = base_time_us + offset_us;
+    if ((base_time_us != 0) && (now_us >= published_time_us)) {
+      statistics.latencies_us.push_back(uint32_t(std::min<uint64_t>(now_us - published_time_us, UINT32_MAX)));
+    }
+  }
+}
+
+}
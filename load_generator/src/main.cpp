@@ -0,0 +1,660 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sysexits.h>
+
+#include "gnutlsmm.h"
+#include "load_client.h"
+#include "page_load.h"
+#include "process_statistics.h"
+#include "util.h"
+
+// Simulates a room full of displays connected to ac-display, and reports how the server copes as the number of displays goes up
+// NOTE: The server needs something to send, either Assetto Corsa, or build it with DEBUG_SINE_WAVE defined in ac_display.cpp
+
+namespace application {
+
+// How long a worker waits in poll before checking for new work
+const int POLL_TIMEOUT_MS = 10;
+
+// How long to wait for a step's connections before measuring anyway
+const uint64_t CONNECT_TIMEOUT_MS = 60000;
+
+class cOptions {
+public:
+  cOptions();
+
+  util::cIPAddress host;
+  uint16_t port;
+  bool tls;
+  size_t clients;
+  size_t step;
+  size_t step_seconds;
+  size_t threads;
+  size_t slow_percent;
+  size_t slow_read_interval_ms;
+  int server_pid;
+  std::string groups;
+  bool batch;
+
+  // Page load mode
+  bool page_load;
+  size_t rounds;
+  bool connection_per_request;
+};
+
+cOptions::cOptions() :
+  host(127, 0, 0, 1),
+  port(8443),
+  tls(true),
+  clients(1000),
+  step(100),
+  step_seconds(10),
+  threads(4),
+  slow_percent(0),
+  slow_read_interval_ms(1000),
+  server_pid(0),
+  batch(false),
+  page_load(false),
+  rounds(10),
+  connection_per_request(false)
+{
+}
+
+void PrintUsage()
+{
+  std::cout<<"Usage: ./load_generator [OPTION]..."<<std::endl;
+  std::cout<<std::endl;
+  std::cout<<"  --host ADDRESS               The server address (Default 127.0.0.1)"<<std::endl;
+  std::cout<<"  --port PORT                  The server port (Default 8443)"<<std::endl;
+  std::cout<<"  --http                       Connect without TLS"<<std::endl;
+  std::cout<<"  --clients COUNT              The maximum number of displays (Default 1000)"<<std::endl;
+  std::cout<<"  --step COUNT                 How many displays to add each step (Default 100)"<<std::endl;
+  std::cout<<"  --step-seconds SECONDS       How long to measure each step for (Default 10)"<<std::endl;
+  std::cout<<"  --threads COUNT              How many threads to run the displays on (Default 4)"<<std::endl;
+  std::cout<<"  --slow-percent PERCENT       The percentage of displays that read slowly (Default 0)"<<std::endl;
+  std::cout<<"  --slow-read-interval-ms MS   How often a slow display reads (Default 1000)"<<std::endl;
+  std::cout<<"  --server-pid PID             Report the CPU and memory used by this process"<<std::endl;
+  std::cout<<"  --groups NAMES               The telemetry groups each display asks for as well as the core channels, for example wheels,dynamics"<<std::endl;
+  std::cout<<"  --batch                      Each display asks for every sample in batches, the updates and latencies are then per sample"<<std::endl;
+  std::cout<<std::endl;
+  std::cout<<"  --page-load                  Instead of websockets, every display loads the whole page at once, like they do after a server restart"<<std::endl;
+  std::cout<<"  --rounds COUNT               How many times to load the page (Default 10)"<<std::endl;
+  std::cout<<"  --connection-per-request     Connect again for each resource instead of keeping the connection alive"<<std::endl;
+  std::cout<<std::endl;
+  std::cout<<"  -h, --help                   Print this help and exit"<<std::endl;
+}
+
+bool ParseSize(const std::string& text, size_t& out_value)
+{
+  try {
+    size_t end = 0;
+    out_value = std::stoul(text, &end);
+    return (end == text.length());
+  } catch (...) {
+    return false;
+  }
+}
+
+bool ParseArguments(int argc, char* argv[], cOptions& options)
+{
+  for (int i = 1; i < argc; i++) {
+    const std::string argument(argv[i]);
+    if (argument == "--http") {
+      options.tls = false;
+      continue;
+    } else if (argument == "--page-load") {
+      options.page_load = true;
+      continue;
+    } else if (argument == "--connection-per-request") {
+      options.connection_per_request = true;
+      continue;
+    } else if (argument == "--batch") {
+      options.batch = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      return false;
+    }
+
+    const std::string value(argv[++i]);
+    size_t number = 0;
+    if (argument == "--host") {
+      if (!util::ParseAddress(value, options.host)) {
+        return false;
+      }
+    } else if (argument == "--groups") {
+      options.groups = value;
+    } else if (!ParseSize(value, number)) {
+      return false;
+    } else if (argument == "--port") {
+      options.port = uint16_t(number);
+    } else if (argument == "--clients") {
+      options.clients = number;
+    } else if (argument == "--step") {
+      options.step = number;
+    } else if (argument == "--step-seconds") {
+      options.step_seconds = number;
+    } else if (argument == "--threads") {
+      options.threads = number;
+    } else if (argument == "--slow-percent") {
+      options.slow_percent = number;
+    } else if (argument == "--slow-read-interval-ms") {
+      options.slow_read_interval_ms = number;
+    } else if (argument == "--server-pid") {
+      options.server_pid = int(number);
+    } else if (argument == "--rounds") {
+      options.rounds = number;
+    } else {
+      return false;
+    }
+  }
+
+  return (options.clients != 0) && (options.step != 0) && (options.step_seconds != 0) && (options.threads != 0) && (options.slow_percent <= 100) && (options.rounds != 0);
+}
+
+// What all the displays received during one step
+class cStepStatistics {
+public:
+  cStepStatistics();
+
+  size_t connected;
+  size_t failed;
+  size_t dropped;
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t car_updates;
+  std::vector<uint32_t> latencies_us;
+  std::vector<uint32_t> slow_latencies_us;
+  uint32_t worst_client_p99_us;
+};
+
+cStepStatistics::cStepStatistics() :
+  connected(0),
+  failed(0),
+  dropped(0),
+  frames(0),
+  bytes(0),
+  car_updates(0),
+  worst_client_p99_us(0)
+{
+}
+
+uint32_t GetPercentile(std::vector<uint32_t>& values, float percentile)
+{
+  if (values.empty()) {
+    return 0;
+  }
+
+  const size_t index = size_t(percentile * float(values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+// Runs some of the displays on one thread, every display owned by a worker is read from its poll loop
+class cWorker {
+public:
+  cWorker(const cOptions& options, size_t index, gnutlsmm::certificate_credentials* credentials);
+
+  void Start();
+  void Stop();
+
+  void SetTargetClients(size_t clients);
+  bool IsConnectingFinished() const;
+
+  void ResetStatistics();
+  void AddStatistics(cStepStatistics& statistics);
+
+private:
+  void MainLoop();
+  bool IsSlowReader(size_t client_index) const;
+
+  const cOptions& options;
+  const size_t index;
+  gnutlsmm::certificate_credentials* credentials;
+
+  std::atomic<bool> running;
+  std::atomic<size_t> target_clients;
+  std::atomic<size_t> attempted_clients;
+
+  // Guards the clients and their statistics, the worker holds it while reading and the main thread while collecting the statistics
+  std::mutex mutex;
+  std::vector<std::unique_ptr<loadgenerator::cLoadClient>> clients;
+  std::vector<uint64_t> next_read_time_ms;
+  size_t failed;
+  size_t dropped;
+
+  std::thread thread;
+};
+
+cWorker::cWorker(const cOptions& _options, size_t _index, gnutlsmm::certificate_credentials* _credentials) :
+  options(_options),
+  index(_index),
+  credentials(_credentials),
+  running(false),
+  target_clients(0),
+  attempted_clients(0),
+  failed(0),
+  dropped(0)
+{
+}
+
+void cWorker::Start()
+{
+  running = true;
+  thread = std::thread(&cWorker::MainLoop, this);
+}
+
+void cWorker::Stop()
+{
+  running = false;
+  if (thread.joinable()) {
+    thread.join();
+  }
+
+  clients.clear();
+}
+
+void cWorker::SetTargetClients(size_t clients)
+{
+  target_clients = clients;
+}
+
+bool cWorker::IsConnectingFinished() const
+{
+  return (attempted_clients >= target_clients);
+}
+
+void cWorker::ResetStatistics()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto&& client : clients) {
+    client->statistics.Clear();
+  }
+  dropped = 0;
+}
+
+void cWorker::AddStatistics(cStepStatistics& statistics)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  statistics.failed += failed;
+  statistics.dropped += dropped;
+
+  for (auto&& client : clients) {
+    if (!client->IsConnected()) {
+      continue;
+    }
+
+    statistics.connected++;
+
+    loadgenerator::cClientStatistics& client_statistics = client->statistics;
+    statistics.frames += client_statistics.frames;
+    statistics.bytes += client_statistics.bytes;
+    statistics.car_updates += client_statistics.car_updates;
+
+    std::vector<uint32_t>& latencies_us = client->IsSlowReader() ? statistics.slow_latencies_us : statistics.latencies_us;
+    latencies_us.insert(latencies_us.end(), client_statistics.latencies_us.begin(), client_statistics.latencies_us.end());
+
+    if (!client->IsSlowReader()) {
+      std::vector<uint32_t> client_latencies_us = client_statistics.latencies_us;
+      statistics.worst_client_p99_us = std::max(statistics.worst_client_p99_us, GetPercentile(client_latencies_us, 0.99f));
+    }
+  }
+}
+
+bool cWorker::IsSlowReader(size_t client_index) const
+{
+  // Spread the slow readers evenly over the workers and the steps
+  const size_t global_index = index + (client_index * options.threads);
+  return ((global_index % 100) < options.slow_percent);
+}
+
+void cWorker::MainLoop()
+{
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> fd_clients;
+
+  while (running) {
+    // Connect any new displays for this step
+    while (running && (attempted_clients < target_clients)) {
+      std::unique_ptr<loadgenerator::cLoadClient> client = std::make_unique<loadgenerator::cLoadClient>(IsSlowReader(attempted_clients), options.groups, options.batch);
+      const bool result = client->Connect(options.host, options.port, credentials);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (result) {
+        clients.push_back(std::move(client));
+        next_read_time_ms.push_back(0);
+      } else {
+        failed++;
+      }
+
+      attempted_clients++;
+    }
+
+    // Wait for something to read, slow readers are left out until it is their turn
+    const uint64_t now_ms = util::GetTimeMS();
+    fds.clear();
+    fd_clients.clear();
+    bool pending = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < clients.size(); i++) {
+        if (!clients[i]->IsConnected() || (now_ms < next_read_time_ms[i])) {
+          continue;
+        }
+
+        pending = pending || clients[i]->HasPendingData();
+
+        struct pollfd fd;
+        fd.fd = clients[i]->GetSocket();
+        fd.events = POLLIN;
+        fd.revents = 0;
+        fds.push_back(fd);
+        fd_clients.push_back(i);
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), pending ? 0 : POLL_TIMEOUT_MS) < 0) {
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < fds.size(); i++) {
+      loadgenerator::cLoadClient& client = *clients[fd_clients[i]];
+      if ((fds[i].revents == 0) && !client.HasPendingData()) {
+        continue;
+      }
+
+      if (!client.Read()) {
+        client.Close();
+        dropped++;
+        continue;
+      }
+
+      if (client.IsSlowReader()) {
+        next_read_time_ms[fd_clients[i]] = util::GetTimeMS() + options.slow_read_interval_ms;
+      }
+    }
+  }
+}
+
+void PrintHeader(bool server_statistics)
+{
+  std::cout<<std::setw(8)<<"clients"<<std::setw(10)<<"connected"<<std::setw(8)<<"failed"<<std::setw(8)<<"dropped"
+    <<std::setw(12)<<"updates/s"<<std::setw(10)<<"MB/s"
+    <<std::setw(10)<<"p50_ms"<<std::setw(10)<<"p99_ms"<<std::setw(10)<<"max_ms"<<std::setw(14)<<"worst_p99_ms"<<std::setw(13)<<"slow_p99_ms";
+  if (server_statistics) {
+    std::cout<<std::setw(12)<<"server_cpu%"<<std::setw(15)<<"server_rss_MB";
+  }
+  std::cout<<std::endl;
+}
+
+void PrintStep(size_t clients, cStepStatistics& statistics, uint64_t elapsed_ms, bool server_statistics, float server_cpu_percent, uint64_t server_rss_bytes)
+{
+  const double seconds = double(std::max<uint64_t>(elapsed_ms, 1)) / 1000.0;
+
+  std::cout<<std::fixed<<std::setprecision(2)
+    <<std::setw(8)<<clients<<std::setw(10)<<statistics.connected<<std::setw(8)<<statistics.failed<<std::setw(8)<<statistics.dropped
+    <<std::setw(12)<<(double(statistics.car_updates) / seconds)<<std::setw(10)<<(double(statistics.bytes) / seconds / 1e6)
+    <<std::setw(10)<<(GetPercentile(statistics.latencies_us, 0.5f) / 1000.0)
+    <<std::setw(10)<<(GetPercentile(statistics.latencies_us, 0.99f) / 1000.0)
+    <<std::setw(10)<<(GetPercentile(statistics.latencies_us, 1.0f) / 1000.0)
+    <<std::setw(14)<<(statistics.worst_client_p99_us / 1000.0)
+    <<std::setw(13)<<(GetPercentile(statistics.slow_latencies_us, 0.99f) / 1000.0);
+  if (server_statistics) {
+    std::cout<<std::setw(12)<<server_cpu_percent<<std::setw(15)<<(double(server_rss_bytes) / 1e6);
+  }
+  std::cout<<std::endl;
+}
+
+// Adds displays a step at a time, and measures what they receive at each step
+void RunWebSocketLoad(const cOptions& options, gnutlsmm::certificate_credentials* credentials)
+{
+  std::vector<std::unique_ptr<cWorker>> workers;
+  for (size_t i = 0; i < options.threads; i++) {
+    workers.push_back(std::make_unique<cWorker>(options, i, credentials));
+    workers.back()->Start();
+  }
+
+  const bool server_statistics = (options.server_pid != 0);
+  PrintHeader(server_statistics);
+
+  for (size_t clients = std::min(options.step, options.clients); ; clients = std::min(clients + options.step, options.clients)) {
+    // Split the displays between the workers, the first workers get any left over
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i]->SetTargetClients((clients / workers.size()) + ((i < (clients % workers.size())) ? 1 : 0));
+    }
+
+    const uint64_t connect_start_ms = util::GetTimeMS();
+    while (!std::all_of(workers.begin(), workers.end(), [](auto&& worker) { return worker->IsConnectingFinished(); })) {
+      if ((util::GetTimeMS() - connect_start_ms) > CONNECT_TIMEOUT_MS) {
+        std::cerr<<"Timed out connecting "<<clients<<" clients, measuring anyway"<<std::endl;
+        break;
+      }
+
+      util::msleep(10);
+    }
+
+    // Measure the step
+    for (auto&& worker : workers) {
+      worker->ResetStatistics();
+    }
+
+    loadgenerator::cProcessSample server_before;
+    if (server_statistics) {
+      loadgenerator::GetProcessSample(options.server_pid, server_before);
+    }
+
+    const uint64_t start_ms = util::GetTimeMS();
+    std::this_thread::sleep_for(std::chrono::seconds(options.step_seconds));
+
+    cStepStatistics statistics;
+    for (auto&& worker : workers) {
+      worker->AddStatistics(statistics);
+    }
+    const uint64_t elapsed_ms = util::GetTimeMS() - start_ms;
+
+    loadgenerator::cProcessSample server_after;
+    if (server_statistics) {
+      loadgenerator::GetProcessSample(options.server_pid, server_after);
+    }
+
+    PrintStep(clients, statistics, elapsed_ms, server_statistics, loadgenerator::GetCPUPercent(server_before, server_after, elapsed_ms), server_after.rss_bytes);
+
+    if (clients == options.clients) {
+      break;
+    }
+  }
+
+  for (auto&& worker : workers) {
+    worker->Stop();
+  }
+}
+
+void PrintPageLoadHeader(bool server_statistics)
+{
+  std::cout<<std::setw(8)<<"round"<<std::setw(10)<<"displays"<<std::setw(8)<<"failed"<<std::setw(12)<<"requests/s"
+    <<std::setw(18)<<"handshake_p50_ms"<<std::setw(18)<<"handshake_p99_ms"<<std::setw(16)<<"request_p50_ms"<<std::setw(16)<<"request_p99_ms"
+    <<std::setw(13)<<"page_p50_ms"<<std::setw(13)<<"page_p99_ms"<<std::setw(13)<<"page_max_ms";
+  if (server_statistics) {
+    std::cout<<std::setw(12)<<"server_cpu%"<<std::setw(15)<<"server_rss_MB";
+  }
+  std::cout<<std::endl;
+}
+
+// The times from every display in one or more rounds
+class cPageLoadStatistics {
+public:
+  cPageLoadStatistics();
+
+  void Add(const cPageLoadStatistics& rhs);
+
+  size_t displays;
+  size_t failed;
+  uint64_t elapsed_us;
+  std::vector<uint32_t> handshake_us;
+  std::vector<uint32_t> request_us;
+  std::vector<uint32_t> page_us;
+};
+
+cPageLoadStatistics::cPageLoadStatistics() :
+  displays(0),
+  failed(0),
+  elapsed_us(0)
+{
+}
+
+void cPageLoadStatistics::Add(const cPageLoadStatistics& rhs)
+{
+  displays += rhs.displays;
+  failed += rhs.failed;
+  elapsed_us += rhs.elapsed_us;
+  handshake_us.insert(handshake_us.end(), rhs.handshake_us.begin(), rhs.handshake_us.end());
+  request_us.insert(request_us.end(), rhs.request_us.begin(), rhs.request_us.end());
+  page_us.insert(page_us.end(), rhs.page_us.begin(), rhs.page_us.end());
+}
+
+void PrintPageLoadRound(const std::string& round, cPageLoadStatistics& statistics, bool server_statistics, float server_cpu_percent, uint64_t server_rss_bytes)
+{
+  const double seconds = double(std::max<uint64_t>(statistics.elapsed_us, 1)) / 1e6;
+
+  std::cout<<std::fixed<<std::setprecision(2)
+    <<std::setw(8)<<round<<std::setw(10)<<statistics.displays<<std::setw(8)<<statistics.failed
+    <<std::setw(12)<<(double(statistics.request_us.size()) / seconds)
+    <<std::setw(18)<<(GetPercentile(statistics.handshake_us, 0.5f) / 1000.0)
+    <<std::setw(18)<<(GetPercentile(statistics.handshake_us, 0.99f) / 1000.0)
+    <<std::setw(16)<<(GetPercentile(statistics.request_us, 0.5f) / 1000.0)
+    <<std::setw(16)<<(GetPercentile(statistics.request_us, 0.99f) / 1000.0)
+    <<std::setw(13)<<(GetPercentile(statistics.page_us, 0.5f) / 1000.0)
+    <<std::setw(13)<<(GetPercentile(statistics.page_us, 0.99f) / 1000.0)
+    <<std::setw(13)<<(GetPercentile(statistics.page_us, 1.0f) / 1000.0);
+  if (server_statistics) {
+    std::cout<<std::setw(12)<<server_cpu_percent<<std::setw(15)<<(double(server_rss_bytes) / 1e6);
+  }
+  std::cout<<std::endl;
+}
+
+// Every display loads the whole page at the same time, like they all do when they reconnect after the server restarts
+void RunPageLoad(const cOptions& options, gnutlsmm::certificate_credentials* credentials)
+{
+  const bool server_statistics = (options.server_pid != 0);
+  PrintPageLoadHeader(server_statistics);
+
+  cPageLoadStatistics total;
+  loadgenerator::cProcessSample server_start;
+  if (server_statistics) {
+    loadgenerator::GetProcessSample(options.server_pid, server_start);
+  }
+
+  for (size_t round = 0; round < options.rounds; round++) {
+    std::vector<loadgenerator::cPageLoadTimes> times(options.clients);
+    std::vector<uint8_t> results(options.clients, false); // NOTE: Not std::vector<bool>, each thread writes its own element
+
+    loadgenerator::cProcessSample server_before;
+    if (server_statistics) {
+      loadgenerator::GetProcessSample(options.server_pid, server_before);
+    }
+
+    // Start the threads first, then release them all at once
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < options.clients; i++) {
+      threads.emplace_back([&, i]() {
+        while (!go) {
+          std::this_thread::yield();
+        }
+
+        results[i] = loadgenerator::LoadPage(options.host, options.port, credentials, options.connection_per_request, times[i]);
+      });
+    }
+
+    const uint64_t start_us = util::GetMonotonicTimeUS();
+    go = true;
+    for (auto&& thread : threads) {
+      thread.join();
+    }
+
+    cPageLoadStatistics statistics;
+    statistics.elapsed_us = util::GetMonotonicTimeUS() - start_us;
+    statistics.displays = options.clients;
+    for (size_t i = 0; i < options.clients; i++) {
+      statistics.handshake_us.insert(statistics.handshake_us.end(), times[i].handshake_us.begin(), times[i].handshake_us.end());
+      statistics.request_us.insert(statistics.request_us.end(), times[i].request_us.begin(), times[i].request_us.end());
+      if (results[i]) {
+        statistics.page_us.push_back(times[i].page_us);
+      } else {
+        statistics.failed++;
+      }
+    }
+
+    loadgenerator::cProcessSample server_after;
+    if (server_statistics) {
+      loadgenerator::GetProcessSample(options.server_pid, server_after);
+    }
+
+    PrintPageLoadRound(std::to_string(round + 1), statistics, server_statistics, loadgenerator::GetCPUPercent(server_before, server_after, statistics.elapsed_us / 1000), server_after.rss_bytes);
+
+    total.Add(statistics);
+  }
+
+  loadgenerator::cProcessSample server_end;
+  if (server_statistics) {
+    loadgenerator::GetProcessSample(options.server_pid, server_end);
+  }
+
+  PrintPageLoadRound("all", total, server_statistics, loadgenerator::GetCPUPercent(server_start, server_end, total.elapsed_us / 1000), server_end.rss_bytes);
+}
+
+// Each display needs a socket, so allow as many as we can
+void RaiseFileLimit()
+{
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  if ((argc == 2) && ((std::string(argv[1]) == "-h") || (std::string(argv[1]) == "--help"))) {
+    application::PrintUsage();
+    return EXIT_SUCCESS;
+  }
+
+  application::cOptions options;
+  if (!application::ParseArguments(argc, argv, options)) {
+    application::PrintUsage();
+    return EX_USAGE;
+  }
+
+  application::RaiseFileLimit();
+
+  gnutlsmm::helper gnutls_helper;
+
+  // NOTE: We don't verify the server's certificate, we are only here to load it
+  gnutlsmm::certificate_credentials credentials;
+  credentials.init();
+
+  if (options.page_load) {
+    application::RunPageLoad(options, options.tls ? &credentials : nullptr);
+  } else {
+    application::RunWebSocketLoad(options, options.tls ? &credentials : nullptr);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include <cstdlib>
+
+#include <algorithm>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "client_connection.h"
+#include "page_load.h"
+#include "util.h"
+
+namespace {
+
+// Our resources are all under 20 KB, anything bigger than this isn't our server
+const size_t MAX_RESPONSE_BYTES = 1024 * 1024;
+
+// Give up on a response rather than hanging the benchmark
+const time_t RECEIVE_TIMEOUT_SECONDS = 10;
+
+uint32_t GetElapsedUS(uint64_t start_us)
+{
+  return uint32_t(std::min<uint64_t>(util::GetMonotonicTimeUS() - start_us, UINT32_MAX));
+}
+
+bool Connect(loadgenerator::cClientConnection& connection, const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials, loadgenerator::cPageLoadTimes& out_times)
+{
+  const uint64_t start_us = util::GetMonotonicTimeUS();
+  if (!connection.Connect(host, port, credentials, 0)) {
+    return false;
+  }
+
+  out_times.handshake_us.push_back(GetElapsedUS(start_us));
+
+  struct timeval timeout;
+  timeout.tv_sec = RECEIVE_TIMEOUT_SECONDS;
+  timeout.tv_usec = 0;
+  setsockopt(connection.GetSocket(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  return true;
+}
+
+// Reads one whole response, we never pipeline requests so there is nothing after it
+bool ReadResponse(loadgenerator::cClientConnection& connection, uint64_t& out_bytes)
+{
+  std::string response;
+  size_t content_start = std::string::npos;
+  size_t content_length = 0;
+
+  uint8_t buffer[16 * 1024];
+  while ((content_start == std::string::npos) || (response.length() < content_start + content_length)) {
+    if (response.length() > MAX_RESPONSE_BYTES) {
+      return false;
+    }
+
+    const ssize_t result = connection.Receive(buffer, sizeof(buffer));
+    if (result <= 0) {
+      return false;
+    }
+
+    response.append(reinterpret_cast<const char*>(buffer), size_t(result));
+
+    if (content_start == std::string::npos) {
+      const size_t delimiter = response.find("\r\n\r\n");
+      if (delimiter == std::string::npos) {
+        continue;
+      }
+
+      // HTTP/1.1 200 OK
+      if (!response.starts_with("HTTP/1.1 200") && !response.starts_with("HTTP/1.0 200")) {
+        return false;
+      }
+
+      // Content-Length: 2330
+      const std::string headers = response.substr(0, delimiter);
+      const size_t header = headers.find("\r\nContent-Length: ");
+      if (header == std::string::npos) {
+        return false;
+      }
+
+      content_length = std::strtoul(headers.c_str() + header + 18, nullptr, 10);
+      content_start = delimiter + 4;
+    }
+  }
+
+  out_bytes += response.length();
+  return true;
+}
+
+}
+
+namespace loadgenerator {
+
+cPageLoadTimes::cPageLoadTimes() :
+  page_us(0),
+  bytes(0)
+{
+}
+
+bool LoadPage(const util::cIPAddress& host, uint16_t port, gnutlsmm::certificate_credentials* credentials, bool connection_per_request, cPageLoadTimes& out_times)
+{
+  const uint64_t page_start_us = util::GetMonotonicTimeUS();
+
+  const std::string host_header = "Host: " + util::ToString(host) + ":" + std::to_string(port) + "\r\n";
+  const std::string connection_header = connection_per_request ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+
+  cClientConnection connection;
+  if (!connection_per_request && !Connect(connection, host, port, credentials, out_times)) {
+    return false;
+  }
+
+  for (auto&& path : PAGE_RESOURCES) {
+    if (connection_per_request && !Connect(connection, host, port, credentials, out_times)) {
+      return false;
+    }
+
+    const std::string request = "GET " + std::string(path) + " HTTP/1.1\r\n" + host_header + connection_header + "\r\n";
+
+    const uint64_t request_start_us = util::GetMonotonicTimeUS();
+    if (!connection.SendAll(request) || !ReadResponse(connection, out_times.bytes)) {
+      return false;
+    }
+
+    out_times.request_us.push_back(GetElapsedUS(request_start_us));
+  }
+
+  out_times.page_us = GetElapsedUS(page_start_us);
+  return true;
+}
+
+}
@@ -0,0 +1,75 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "process_statistics.h"
+
+namespace loadgenerator {
+
+cProcessSample::cProcessSample() :
+  cpu_time_ms(0),
+  rss_bytes(0)
+{
+}
+
+bool GetProcessSample(int pid, cProcessSample& out_sample)
+{
+  out_sample = cProcessSample();
+
+  const std::string folder = "/proc/" + std::to_string(pid);
+
+  // NOTE: /proc files report a size of 0, so they have to be read a line at a time
+  std::string stat;
+  {
+    std::ifstream f(folder + "/stat");
+    if (!std::getline(f, stat)) {
+      return false;
+    }
+  }
+
+  // The name can contain spaces and brackets, so start after the last bracket, the fields after it start at state (Field 3) and utime and stime are fields 14 and 15
+  const size_t name_end = stat.rfind(')');
+  if (name_end == std::string::npos) {
+    return false;
+  }
+
+  std::istringstream fields(stat.substr(name_end + 1));
+  std::string field;
+  for (size_t i = 0; i < 11; i++) {
+    fields>>field;
+  }
+
+  uint64_t utime_ticks = 0;
+  uint64_t stime_ticks = 0;
+  if (!(fields>>utime_ticks>>stime_ticks)) {
+    return false;
+  }
+
+  const long ticks_per_second = sysconf(_SC_CLK_TCK);
+  out_sample.cpu_time_ms = ((utime_ticks + stime_ticks) * 1000) / uint64_t((ticks_per_second > 0) ? ticks_per_second : 100);
+
+  // VmRSS:     12345 kB
+  std::ifstream f(folder + "/status");
+  std::string line;
+  while (std::getline(f, line)) {
+    if (line.starts_with("VmRSS:")) {
+      out_sample.rss_bytes = std::stoull(line.substr(6)) * 1024;
+      break;
+    }
+  }
+
+  return true;
+}
+
+float GetCPUPercent(const cProcessSample& before, const cProcessSample& after, uint64_t elapsed_ms)
+{
+  if ((elapsed_ms == 0) || (after.cpu_time_ms < before.cpu_time_ms)) {
+    return 0.0f;
+  }
+
+  return 100.0f * float(after.cpu_time_ms - before.cpu_time_ms) / float(elapsed_ms);
+}
+
+}
@@ -14,7 +14,8 @@ function window_onload( /*event*/ )
   showErrorDisconnected();
 
   // Determine the base url (for http:// this is ws:// for https:// this must be wss://)
-  baseUrl = 'ws' + (window.location.protocol === 'https:' ? 's' : '') + '://' + window.location.host + '/ACDisplayServerWebSocket';
+  // We ask for binary car updates, they are smaller and don't need parsing
+  baseUrl = 'ws' + (window.location.protocol === 'https:' ? 's' : '') + '://' + window.location.host + '/ACDisplayServerWebSocket?format=binary';
   websocket_connect();
 }
 
@@ -118,18 +119,401 @@ function gear_index_to_letter(gear)
   return gear - 1;
 }
 
+const SHIFT_LIGHTS_LED_COUNT = 8;
+
+const shiftLightsDimColours = [
+  "#008000",
+  "#008000",
+  "#808000",
+  "#808000",
+  "#800000",
+  "#800000",
+  "#000080",
+  "#000080"
+];
+const shiftLightsBrightColours = [
+  "#00ff00",
+  "#00ff00",
+  "#ffff00",
+  "#ffff00",
+  "#ff0000",
+  "#ff0000",
+  "#0000ff",
+  "#0000ff"
+];
+
+let shiftLightsElements = null;
+let shiftLightsPreviousState = -1;
+
+// Apply the packed shift lights state from the server, bits 0..7 are the LEDs that are lit
+function updateShiftLights(state)
+{
+  if (shiftLightsElements === null) {
+    shiftLightsElements = [];
+    for (let i = 0; i < SHIFT_LIGHTS_LED_COUNT; i++) {
+      shiftLightsElements.push(document.getElementById('digital_led' + i));
+    }
+  }
+
+  const changed = (shiftLightsPreviousState < 0) ? 0xFF : (state ^ shiftLightsPreviousState);
+  if (changed === 0) {
+    return;
+  }
+
+  for (let i = 0; i < SHIFT_LIGHTS_LED_COUNT; i++) {
+    const bit = (1 << i);
+    if ((changed & bit) != 0) {
+      shiftLightsElements[i].style.backgroundColor = ((state & bit) != 0) ? shiftLightsBrightColours[i] : shiftLightsDimColours[i];
+    }
+  }
+
+  shiftLightsPreviousState = state;
+}
+
+const WHEEL_COUNT = 4;
+const WHEEL_SLIP_WHEELSPIN_SHIFT = 4;
+const WHEEL_SLIP_FLASH_PERIOD_MS = 200;
+
+const wheelSlipOffColour = "#bbb";
+const wheelSlipLockupColour = "#ff0000";
+const wheelSlipWheelspinColour = "#ffff00";
+
+let wheelSlipElements = null;
+let wheelSlipPreviousColours = [];
+
+// Apply the packed wheel slip state from the server, bits 0..3 are wheels that are locked up, bits 4..7 are wheels that are spinning
+// Flagged wheels flash so that they catch the driver's eye
+function updateWheelSlip(state)
+{
+  if (wheelSlipElements === null) {
+    wheelSlipElements = [];
+    for (let i = 0; i < WHEEL_COUNT; i++) {
+      wheelSlipElements.push(document.getElementById('digital_wheel' + i));
+      wheelSlipPreviousColours.push("");
+    }
+  }
+
+  const lit = ((Math.floor(Date.now() / (WHEEL_SLIP_FLASH_PERIOD_MS / 2)) % 2) == 0);
+
+  for (let i = 0; i < WHEEL_COUNT; i++) {
+    let colour = wheelSlipOffColour;
+    if (lit) {
+      if ((state & (1 << i)) != 0) {
+        colour = wheelSlipLockupColour;
+      } else if ((state & (1 << (i + WHEEL_SLIP_WHEELSPIN_SHIFT))) != 0) {
+        colour = wheelSlipWheelspinColour;
+      }
+    }
+
+    if (colour !== wheelSlipPreviousColours[i]) {
+      wheelSlipElements[i].style.backgroundColor = colour;
+      wheelSlipPreviousColours[i] = colour;
+    }
+  }
+}
+
+// The track map is sent once as a list of points, then each update only has the car's position bin
+let trackMapBinCount = 0;
+let trackMapPoints = []; // [{ bin, x, y }] in canvas coordinates
+let trackMapPreviousPositionIndex = -1;
+
+function setTrackMap(message)
+{
+  trackMapBinCount = Number(message[1]);
+  trackMapPoints = [];
+  trackMapPreviousPositionIndex = -1;
+
+  let canvas = document.getElementById('track_map_canvas');
+  canvas.width = canvas.clientWidth;
+  canvas.height = Math.round(0.75 * canvas.clientWidth);
+
+  let points = [];
+  let min_x = Infinity;
+  let max_x = -Infinity;
+  let min_z = Infinity;
+  let max_z = -Infinity;
+  for (let i = 2; i < message.length; i++) {
+    const values = message[i].split(',');
+    const point = { bin: Number(values[0]), x: Number(values[1]), z: Number(values[2]) };
+    min_x = Math.min(min_x, point.x);
+    max_x = Math.max(max_x, point.x);
+    min_z = Math.min(min_z, point.z);
+    max_z = Math.max(max_z, point.z);
+    points.push(point);
+  }
+
+  if (points.length < 2) {
+    drawTrackMap(-1);
+    return;
+  }
+
+  // Fit the track inside the canvas keeping the aspect ratio
+  const margin = 10;
+  const scale = Math.min((canvas.width - (2 * margin)) / Math.max(max_x - min_x, 1), (canvas.height - (2 * margin)) / Math.max(max_z - min_z, 1));
+  const offset_x = (canvas.width - (scale * (max_x - min_x))) / 2;
+  const offset_y = (canvas.height - (scale * (max_z - min_z))) / 2;
+  for (const point of points) {
+    trackMapPoints.push({ bin: point.bin, x: offset_x + (scale * (point.x - min_x)), y: offset_y + (scale * (point.z - min_z)) });
+  }
+
+  drawTrackMap(-1);
+}
+
+// Find where the car is by interpolating between the points either side of its position bin
+function getTrackMapCarPosition(position_index)
+{
+  const count = trackMapPoints.length;
+  let next = trackMapPoints.findIndex(point => (point.bin > position_index));
+  if (next < 0) {
+    next = 0;
+  }
+  const previous = (next + count - 1) % count;
+
+  const a = trackMapPoints[previous];
+  const b = trackMapPoints[next];
+  const bins = ((b.bin - a.bin) + trackMapBinCount) % trackMapBinCount;
+  const t = (bins == 0) ? 0 : ((((position_index - a.bin) + trackMapBinCount) % trackMapBinCount) / bins);
+  return { x: a.x + (t * (b.x - a.x)), y: a.y + (t * (b.y - a.y)) };
+}
+
+function drawTrackMap(position_index)
+{
+  let canvas = document.getElementById('track_map_canvas');
+  let ctx = canvas.getContext('2d');
+  ctx.clearRect(0, 0, canvas.width, canvas.height);
+
+  if (trackMapPoints.length < 2) {
+    return;
+  }
+
+  ctx.strokeStyle = "#bbb";
+  ctx.lineWidth = 3;
+  ctx.beginPath();
+  ctx.moveTo(trackMapPoints[0].x, trackMapPoints[0].y);
+  for (const point of trackMapPoints) {
+    ctx.lineTo(point.x, point.y);
+  }
+  ctx.closePath();
+  ctx.stroke();
+
+  if (position_index >= 0) {
+    const car = getTrackMapCarPosition(position_index);
+    ctx.fillStyle = "#ff0000";
+    ctx.beginPath();
+    ctx.arc(car.x, car.y, 6, 0, 2 * Math.PI);
+    ctx.fill();
+  }
+}
+
+function updateTrackMap(position_index)
+{
+  if ((trackMapPoints.length < 2) || (position_index === trackMapPreviousPositionIndex)) {
+    return;
+  }
+
+  drawTrackMap(position_index);
+  trackMapPreviousPositionIndex = position_index;
+}
+
+// The leaderboard rows in order, the server sends the whole table when the order changes and just the changed rows otherwise
+let leaderboardRows = [];
+
+function parseLeaderboardRow(text)
+{
+  const values = text.split(',');
+  return {
+    car_id: values[0],
+    laps: Number(values[1]),
+    last_lap_ms: Number(values[2]),
+    best_lap_ms: Number(values[3]),
+    total_ms: Number(values[4]),
+    driver: values[5],
+    car: values[6]
+  };
+}
+
+function drawLeaderboard()
+{
+  let body = document.getElementById('leaderboard_body');
+  body.replaceChildren();
+
+  const leader = (leaderboardRows.length != 0) ? leaderboardRows[0] : null;
+  for (let i = 0; i < leaderboardRows.length; i++) {
+    const row = leaderboardRows[i];
+
+    let gap = "-";
+    if (i != 0) {
+      const laps_behind = leader.laps - row.laps;
+      gap = (laps_behind > 0) ? `+${laps_behind} L` : "+" + format_time_smallest(row.total_ms - leader.total_ms);
+    }
+
+    const values = [
+      i + 1,
+      row.driver,
+      row.laps,
+      (row.last_lap_ms == 0) ? "-" : format_time_smallest(row.last_lap_ms),
+      (row.best_lap_ms == 0) ? "-" : format_time_smallest(row.best_lap_ms),
+      gap
+    ];
+
+    let tr = document.createElement('tr');
+    for (const value of values) {
+      let td = document.createElement('td');
+      td.innerText = value;
+      tr.appendChild(td);
+    }
+    body.appendChild(tr);
+  }
+}
+
 let rpm_red_line = 5000.0;
 let rpm_maximum = 6000.0;
 let speedometer_red_line_kph = 280.0;
 let speedometer_maximum_kph = 300.0;
 
+// The car_update channels from the server's telemetry_channels message, in the order they are in each car_update, so that we can look the values up by name
+// [{ name, type, scale, units, count }], a channel with a count of more than 1 is an array
+let telemetryChannels = [];
+
+const telemetryBinaryTypes = {
+  u8: { size: 1, get: (view, offset) => view.getUint8(offset) },
+  u16: { size: 2, get: (view, offset) => view.getUint16(offset, true) },
+  u32: { size: 4, get: (view, offset) => view.getUint32(offset, true) },
+  u64: { size: 8, get: (view, offset) => Number(view.getBigUint64(offset, true)) },
+  i8: { size: 1, get: (view, offset) => view.getInt8(offset) },
+  i16: { size: 2, get: (view, offset) => view.getInt16(offset, true) },
+  i32: { size: 4, get: (view, offset) => view.getInt32(offset, true) },
+  f32: { size: 4, get: (view, offset) => view.getFloat32(offset, true) }
+};
+
+// Binary messages start with a type byte
+const BINARY_MESSAGE_CAR_UPDATE = 1;
+const BINARY_MESSAGE_CAR_UPDATE_BATCH = 2;
+
+function setTelemetryChannels(message)
+{
+  telemetryChannels = message.slice(1).map(text => {
+    const values = text.split(',');
+    return { name: values[0], type: values[1], scale: Number(values[2]), units: values[3], count: Number(values[4]) };
+  });
+}
+
+// car_update|value|value|...
+function parseCarUpdateText(message)
+{
+  let values = {};
+  for (let i = 0; i < telemetryChannels.length; i++) {
+    const channel = telemetryChannels[i];
+    if (channel.count == 1) {
+      values[channel.name] = Number(message[1 + i]);
+    } else {
+      // Arrays are one field with the elements separated by commas
+      values[channel.name] = message[1 + i].split(',').map(Number);
+    }
+  }
+  return values;
+}
+
+// The type byte followed by each channel as its binary type, little endian, and multiplied by its scale
+function parseCarUpdateBinary(view)
+{
+  let values = {};
+  let offset = 1;
+  for (const channel of telemetryChannels) {
+    const type = telemetryBinaryTypes[channel.type];
+    if (channel.count == 1) {
+      values[channel.name] = type.get(view, offset) / channel.scale;
+      offset += type.size;
+    } else {
+      let elements = [];
+      for (let i = 0; i < channel.count; i++) {
+        elements.push(type.get(view, offset) / channel.scale);
+        offset += type.size;
+      }
+      values[channel.name] = elements;
+    }
+  }
+  return values;
+}
+
+// Every sample since the last batch, for ?format=batch, returns an array of the same values as parseCarUpdateBinary
+// The type byte, a u16 sample count, the u64 published_time_us of the first sample, a u32 for each sample with the microseconds since then, and then an array for each channel apart from published_time_us
+function parseCarUpdateBatch(view)
+{
+  const count = view.getUint16(1, true);
+  const base_time_us = Number(view.getBigUint64(3, true));
+  let offset = 11;
+
+  let samples = [];
+  for (let i = 0; i < count; i++) {
+    samples.push({ published_time_us: base_time_us + view.getUint32(offset, true) });
+    offset += 4;
+  }
+
+  for (const channel of telemetryChannels) {
+    if (channel.name === 'published_time_us') {
+      continue;
+    }
+
+    const type = telemetryBinaryTypes[channel.type];
+    for (const sample of samples) {
+      if (channel.count == 1) {
+        sample[channel.name] = type.get(view, offset) / channel.scale;
+        offset += type.size;
+      } else {
+        let elements = [];
+        for (let i = 0; i < channel.count; i++) {
+          elements.push(type.get(view, offset) / channel.scale);
+          offset += type.size;
+        }
+        sample[channel.name] = elements;
+      }
+    }
+  }
+  return samples;
+}
+
+function updateCarValues(values)
+{
+  drawGaugesWithValues(values.rpm, values.speed_kmh);
+
+  // The server works out which LEDs are lit, so we just have to apply the bits that changed since the last update
+  updateShiftLights(values.shift_lights);
+
+  updateWheelSlip(values.wheel_slip);
+
+  updateTrackMap(values.track_position_index);
+
+  let digital_lap = document.getElementById('digital_lap');
+  const lap = (values.lap_count == 0) ? "-" : values.lap_count;
+  digital_lap.innerText = `Lap ${lap}`;
+
+  let digital_rpm = document.getElementById('digital_rpm');
+  const iRPM = Math.round(values.rpm);
+  digital_rpm.innerText = `${iRPM} RPM`;
+
+  let digital_gear = document.getElementById('digital_gear');
+  const gear = gear_index_to_letter(values.gear);
+  digital_gear.innerText = `${gear}`;
+
+  let digital_delta = document.getElementById('digital_delta');
+  // TODO: We probably need a timer so that for say 5 seconds after a lap is completed we show the delta for the last lap, then it switches to the delta for the current lap
+  const delta = values.last_lap_ms - values.best_lap_ms;
+  const delta_plus_minus_HH_MM_SS_MS = format_delta_plus_minus_smallest(delta);
+  digital_delta.innerText = `Delta ${delta_plus_minus_HH_MM_SS_MS}`;
+
+  let digital_last_lap = document.getElementById('digital_last_lap');
+  const last_lap_HH_MM_SS_MS = format_time_smallest_HH_MM_SS_MS(values.last_lap_ms);
+  digital_last_lap.innerText = `Last ${last_lap_HH_MM_SS_MS}`;
+}
+
 // This is the event when the socket has received a message.
 // This will parse the message and execute the corresponding command (or add the message).
 function socket_onmessage(event)
 {
   if (typeof(event.data) === 'string') {
     // Text message or command
-    let message = event.data.split('|', 11);
+    let message = event.data.split('|');
     switch (message[0]) {
       case 'car_config': {
         rpm_red_line = message[1];
@@ -140,94 +524,70 @@ function socket_onmessage(event)
 
         break;
       }
+      case 'telemetry_channels': {
+        // telemetry_channels|name,type,scale,units|...
+        setTelemetryChannels(message);
+        break;
+      }
       case 'car_update': {
-        const rpm = message[5];
-        const speed_kph = message[6];
-
-        drawGaugesWithValues(rpm, speed_kph);
-
-        //if (digital) {
-          const dimColours = [
-            "008000",
-            "008000",
-            "808000",
-            "808000",
-            "800000",
-            "800000",
-            "000080",
-            "000080"
-          ];
-          const brightColours = [
-            "00ff00",
-            "00ff00",
-            "ffff00",
-            "ffff00",
-            "ff0000",
-            "ff0000",
-            "0000ff",
-            "0000ff"
-          ];
-          for (let i = 0; i < 8; i++) {
-            let led = document.getElementById('digital_led' + i);
-            let colour = dimColours[i];
-            // TODO: Make the first segment always on, then make the others only turn on for the last half of the RPM range, so essentially the lower limits for the segments might be something like:
-            // 0.0, 4000.0, 4500.0, 5000.0, 5500.0, 6000.0, 6500.0, 7000.0
-            // This would be less distracting and the lights would have a higher resolution for the second half where the shifts actually happen and we want more precision
-            const segmentLowerLimit = rpm_red_line / 8.0;
-            // If the rpm is past our 1/8th of the gauge then "Turn on" the led by switching from the dim colour to the bright colour
-            if (rpm > (segmentLowerLimit * i)) {
-              colour = brightColours[i];
-            }
-            led.setAttribute("style", "background-color: #" + colour);
+        updateCarValues(parseCarUpdateText(message));
+        break;
+      }
+      case 'leaderboard': {
+        // leaderboard|car_id,laps,last_lap_ms,best_lap_ms,total_ms,driver,car|...
+        leaderboardRows = message.slice(1).map(parseLeaderboardRow);
+        drawLeaderboard();
+        break;
+      }
+      case 'leaderboard_rows': {
+        // The same as leaderboard, but only the rows that changed, the order is the same
+        for (const text of message.slice(1)) {
+          const row = parseLeaderboardRow(text);
+          const index = leaderboardRows.findIndex(existing => (existing.car_id === row.car_id));
+          if (index >= 0) {
+            leaderboardRows[index] = row;
           }
-
-          let digital_lap = document.getElementById('digital_lap');
-          const lap = (message[10] == 0) ? "-" : message[10];
-          digital_lap.innerText = `Lap ${lap}`;
-
-          let digital_rpm = document.getElementById('digital_rpm');
-          const iRPM = Math.round(rpm);
-          digital_rpm.innerText = `${iRPM} RPM`;
-
-          let digital_gear = document.getElementById('digital_gear');
-          const gear = gear_index_to_letter(message[1]);
-          digital_gear.innerText = `${gear}`;
-
-          let digital_delta = document.getElementById('digital_delta');
-          // TODO: We probably need a timer so that for say 5 seconds after a lap is completed we show the delta for the last lap, then it switches to the delta for the current lap
-          const best_lap = message[9];
-          const delta = message[8] - best_lap;
-          const delta_plus_minus_HH_MM_SS_MS = format_delta_plus_minus_smallest(delta);
-          digital_delta.innerText = `Delta ${delta_plus_minus_HH_MM_SS_MS}`;
-
-          let digital_last_lap = document.getElementById('digital_last_lap');
-          const last_lap_HH_MM_SS_MS = format_time_smallest_HH_MM_SS_MS(message[8]);
-          digital_last_lap.innerText = `Last ${last_lap_HH_MM_SS_MS}`;
-
-          //let speed_kph = document.getElementById('speed_kph');
-          //speed_kph.setAttribute('value', message[6]);
-
-          //let lap_time_ms = document.getElementById('lap_time_ms');
-          //lap_time_ms.setAttribute('value', message[7]);
-
-          //let best_lap_ms = document.getElementById('best_lap_ms');
-          //best_lap_ms.setAttribute('value', message[9]);
-        //}
-
-          //let accelerator = document.getElementById('accelerator');
-          //accelerator.setAttribute('value', message[2]);
-
-          //let brake = document.getElementById('brake');
-          //brake.setAttribute('value', message[3]);
-
-          //let clutch = document.getElementById('clutch');
-          //clutch.setAttribute('value', message[4]);
+        }
+        drawLeaderboard();
+        break;
+      }
+      case 'track_map': {
+        // track_map|bin_count|bin,x,z|bin,x,z|...
+        setTrackMap(message);
+        break;
+      }
+      case 'sector_times': {
+        // The server sends this when a sector is completed
+        // sector_times|last_completed_sector|last0|last1|last2|best0|best1|best2|theoretical_best
+        const sector_count = 3;
+        let text = "";
+        for (let i = 0; i < sector_count; i++) {
+          const last_ms = Number(message[2 + i]);
+          text += ((i != 0) ? " " : "") + `S${i + 1} ` + ((last_ms == 0) ? "-" : format_time_smallest(last_ms));
+        }
+
+        let digital_sectors = document.getElementById('digital_sectors');
+        digital_sectors.innerText = text;
+
+        const theoretical_best_ms = Number(message[2 + (2 * sector_count)]);
+        let digital_theoretical_best = document.getElementById('digital_theoretical_best');
+        digital_theoretical_best.innerText = "Ideal " + ((theoretical_best_ms == 0) ? "-" : format_time_smallest_HH_MM_SS_MS(theoretical_best_ms));
 
         break;
       }
     }
   } else {
     // We received a binary message
+    const view = new DataView(event.data);
+    if ((view.byteLength != 0) && (view.getUint8(0) === BINARY_MESSAGE_CAR_UPDATE)) {
+      updateCarValues(parseCarUpdateBinary(view));
+    } else if ((view.byteLength != 0) && (view.getUint8(0) === BINARY_MESSAGE_CAR_UPDATE_BATCH)) {
+      // The gauges only need to show the latest sample
+      const samples = parseCarUpdateBatch(view);
+      if (samples.length != 0) {
+        updateCarValues(samples[samples.length - 1]);
+      }
+    }
   }
 }
 
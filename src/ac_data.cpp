@@ -1,23 +1,23 @@
 #include "ac_data.h"
 
-cACData::cACData() :
+cACDataState::cACDataState() :
   config_rpm_red_line(6000.0f),
   config_rpm_maximum(8500.0f),
   config_speedometer_red_line_kph(280.0f),
   config_speedometer_maximum_kph(300.0f),
+  config_automatic(true),
+  config_sequence(0),
+  track_map_sequence(0),
+  leaderboard_sequence(0),
+  telemetry_groups(acdisplay::TELEMETRY_CORE_GROUP)
+{
+}
 
-  gear(1), // Neutral
-  accelerator_0_to_1(0.0f),
-  brake_0_to_1(0.0f),
-  clutch_0_to_1(0.0f),
-  rpm(0.0f),
-  speed_kmh(0.0f),
-  lap_time_ms(0),
-  last_lap_ms(0),
-  best_lap_ms(0),
-  lap_count(0)
+void cACData::CopyFrom(const cACData& rhs, uint32_t telemetry_groups)
 {
+  static_cast<cACDataState&>(*this) = rhs;
+  acdisplay::CopyTelemetryGroups(rhs.telemetry, telemetry_groups, telemetry);
 }
 
-std::mutex mutex_ac_data;
+acdisplay::cInstrumentedMutex mutex_ac_data(acdisplay::metrics.lock_ac_data);
 cACData ac_data;
@@ -1,9 +1,18 @@
+#include <csignal>
+
 #include <fstream>
-#include <iostream>
 #include <string>
 
 #include "ac_display.h"
+#include "car_database.h"
+#include "file_watcher.h"
+#include "flight_recorder.h"
+#include "log.h"
+#include "low_latency.h"
+#include "trace.h"
+#include "tunables.h"
 #include "util.h"
+#include "watchdog.h"
 #include "web_server.h"
 
 // Enable this to turn on a debug mode where we don't read from the AC UDP socket, and instead just cycle the RPM and speed up and down for testing purposes
@@ -17,20 +26,78 @@
 
 namespace acdisplay {
 
-bool RunServer(const application::cSettings& settings)
+namespace {
+
+// The broadcast stage sends at least once per update interval, which is at most 1 second
+const uint64_t WATCHDOG_STALL_THRESHOLD_MS = 3000;
+
+// The HTTPS listener needs to be rebound if any of these change
+bool IsHTTPSListenerChanged(const application::cSettings& a, const application::cSettings& b)
+{
+  return (
+    (util::ToString(a.GetHTTPSHost()) != util::ToString(b.GetHTTPSHost())) ||
+    (a.GetHTTPSPort() != b.GetHTTPSPort()) ||
+    (a.GetHTTPSPrivateKey() != b.GetHTTPSPrivateKey()) ||
+    (a.GetHTTPSPublicCert() != b.GetHTTPSPublicCert())
+  );
+}
+
+bool IsLowLatencyChanged(const application::cLowLatencySettings& a, const application::cLowLatencySettings& b)
+{
+  return (
+    (a.acudp_cpus != b.acudp_cpus) ||
+    (a.websocket_cpus != b.websocket_cpus) ||
+    (a.realtime_priority != b.realtime_priority) ||
+    (a.lock_memory != b.lock_memory) ||
+    (a.prefault_heap_mb != b.prefault_heap_mb) ||
+    (a.busy_poll_us != b.busy_poll_us)
+  );
+}
+
+void ApplyTunables(const application::cSettings& settings)
 {
-  std::cout<<"Running server"<<std::endl;
+  tunables.update_interval_ms.store(settings.GetUpdateIntervalMS(), std::memory_order_relaxed);
+  tunables.batch_interval_ms.store(settings.GetBatchIntervalMS(), std::memory_order_relaxed);
+  util::SetLogLevel(settings.GetLogLevel());
+}
+
+}
+
+bool RunServer(const std::string& settings_file_path, const application::cSettings& settings)
+{
+  LOG_INFO<<"Running server";
+
+  ApplyTunables(settings);
+
+  // Lock memory etc. before we start any threads
+  ApplyLowLatencyProcessSettings(settings.GetLowLatency());
+
+  // Write the recent trace spans to a file when we get SIGUSR2, they are also available at /trace
+  const std::string config_folder = util::GetConfigFolder("ac-display");
+  if (!config_folder.empty()) {
+    util::StartTraceDumpOnSignal(SIGUSR2, config_folder + "/traces", 10000);
+
+    // Write a report if the ingest or broadcast stages stop making progress
+    watchdog.Start(config_folder + "/stalls", WATCHDOG_STALL_THRESHOLD_MS);
+  }
+
+  // Load the car database, this is optional, if a car isn't found we estimate its config from the live data
+  if (!car_database.Start("./car_database.json")) {
+    LOG_ERROR<<"Error watching the car database";
+  }
 
 #ifndef DEBUG_SINE_WAVE
   // Start the ACUDP thread
   if (!StartACUDPThread(settings.GetACUDPHost(), settings.GetACUDPPort())) {
-    std::cerr<<"Error connecting to "<<util::ToString(settings.GetACUDPHost())<<":"<<settings.GetACUDPPort()<<std::endl;
+    LOG_ERROR<<"Error connecting to "<<util::ToString(settings.GetACUDPHost())<<":"<<settings.GetACUDPPort();
     return false;
   }
+
+  ApplyLowLatencySocketSettings();
 #else
   // Start the SineWaveUpdate thread for debugging
   if (!DebugStartSineWaveUpdateThread()) {
-    std::cerr<<"Error creating SineWaveUpdateThread"<<std::endl;
+    LOG_ERROR<<"Error creating SineWaveUpdateThread";
     return false;
   }
 #endif
@@ -38,26 +105,69 @@ bool RunServer(const application::cSettings& settings)
   // Now run the web server
   cWebServerManager web_server_manager;
   if (!web_server_manager.Create(settings.GetHTTPSHost(), settings.GetHTTPSPort(), settings.GetHTTPSPrivateKey(), settings.GetHTTPSPublicCert())) {
-    std::cerr<<"Error creating web server"<<std::endl;
+    LOG_ERROR<<"Error creating web server";
     return false;
   }
 
+  // Watch the settings file and apply any changes while we are running
+  // NOTE: This is only accessed by the file watcher thread
+  application::cSettings current_settings = settings;
+  util::cFileWatcher settings_file_watcher;
+  settings_file_watcher.Start(settings_file_path, [&settings_file_path, &current_settings, &web_server_manager]() {
+    application::cSettings new_settings;
+    if (!new_settings.LoadFromFile(settings_file_path)) {
+      LOG_WARNING<<"Error parsing \""<<settings_file_path<<"\", keeping the current settings";
+      return;
+    }
+
+    LOG_INFO<<"Settings changed, applying";
+    flight_recorder.Record("Settings changed");
+
+    ApplyTunables(new_settings);
+
+    if (IsHTTPSListenerChanged(current_settings, new_settings)) {
+      LOG_INFO<<"HTTPS settings changed, rebinding the web server";
+      flight_recorder.Record("Rebinding the web server");
+      if (!web_server_manager.Rebind(new_settings.GetHTTPSHost(), new_settings.GetHTTPSPort(), new_settings.GetHTTPSPrivateKey(), new_settings.GetHTTPSPublicCert())) {
+        LOG_ERROR<<"Error rebinding the web server";
+        return;
+      }
+    }
+
+    // NOTE: The acudp library blocks reading from its socket with no way to interrupt it, so we can't reconnect without restarting
+    if ((util::ToString(current_settings.GetACUDPHost()) != util::ToString(new_settings.GetACUDPHost())) || (current_settings.GetACUDPPort() != new_settings.GetACUDPPort())) {
+      LOG_INFO<<"ACUDP settings changed, restart ac-display to connect to the new address";
+    }
+
+    if (IsLowLatencyChanged(current_settings.GetLowLatency(), new_settings.GetLowLatency())) {
+      LOG_INFO<<"Low latency settings changed, restart ac-display to apply them";
+    }
+
+    current_settings = new_settings;
+  });
+
   if (settings.GetRunningInContainer()) {
     while (true) {
       util::msleep(500);
     }
   } else {
-    std::cout<<"Press enter to shutdown the server"<<std::endl;
+    LOG_INFO<<"Press enter to shutdown the server";
     (void)getc(stdin);
   }
 
-  std::cout<<"Shutting down server"<<std::endl;
+  settings_file_watcher.Stop();
+
+  LOG_INFO<<"Shutting down server";
   if (!web_server_manager.Destroy()) {
-    std::cerr<<"Error destroying web server"<<std::endl;
+    LOG_ERROR<<"Error destroying web server";
     return false;
   }
 
-  std::cout<<"Server has been shutdown"<<std::endl;
+  car_database.Stop();
+
+  watchdog.Stop();
+
+  LOG_INFO<<"Server has been shutdown";
   return true;
 }
 
@@ -1,5 +1,4 @@
 #include <functional>
-#include <iostream>
 #include <string>
 #include <thread>
 
@@ -7,35 +6,42 @@
 
 #include "ac_data.h"
 #include "acudp_thread.h"
+#include "car_update_processor.h"
+#include "leaderboard.h"
+#include "log.h"
+#include "low_latency.h"
+#include "metrics.h"
+#include "trace.h"
 #include "util.h"
+#include "watchdog.h"
 
 namespace {
 
 void print_handshake_response(const acudp_setup_response& response)
 {
-  std::cout<<"Response:"<<std::endl;
-  std::cout<<"  "<<response.car_name<<std::endl;
-  std::cout<<"  "<<response.driver_name<<std::endl;
-  std::cout<<"  "<<response.identifier<<std::endl;
-  std::cout<<"  "<<response.version<<std::endl;
-  std::cout<<"  "<<response.track_name<<std::endl;
-  std::cout<<"  "<<response.track_config<<std::endl;
+  LOG_INFO<<"Response:";
+  LOG_INFO<<"  "<<response.car_name;
+  LOG_INFO<<"  "<<response.driver_name;
+  LOG_INFO<<"  "<<response.identifier;
+  LOG_INFO<<"  "<<response.version;
+  LOG_INFO<<"  "<<response.track_name;
+  LOG_INFO<<"  "<<response.track_config;
 }
 
 /*void print_car_info(const acudp_car_t& car)
 {
-  std::cout<<"Car info:"<<std::endl;
-  std::cout<<"  identifier: "<<car.identifier<<std::endl;
-  std::cout<<"  size: "<<car.size<<std::endl;
-  std::cout<<"  speed_kmh: "<<car.speed_kmh<<std::endl;
-  std::cout<<"  lap_time: "<<car.lap_time<<std::endl;
-  std::cout<<"  car_position_normalized: "<<car.car_position_normalized<<std::endl;
-  std::cout<<"  lap_count: "<<car.lap_count<<std::endl;
-  std::cout<<"  engine_rpm: "<<car.engine_rpm<<std::endl;
-  std::cout<<"  gear: "<<car.gear<<std::endl;
-  std::cout<<"  gas: "<<car.gas<<std::endl;
-  std::cout<<"  brake: "<<car.brake<<std::endl;
-  std::cout<<"  clutch: "<<car.clutch<<std::endl;
+  LOG_INFO<<"Car info:";
+  LOG_INFO<<"  identifier: "<<car.identifier;
+  LOG_INFO<<"  size: "<<car.size;
+  LOG_INFO<<"  speed_kmh: "<<car.speed_kmh;
+  LOG_INFO<<"  lap_time: "<<car.lap_time;
+  LOG_INFO<<"  car_position_normalized: "<<car.car_position_normalized;
+  LOG_INFO<<"  lap_count: "<<car.lap_count;
+  LOG_INFO<<"  engine_rpm: "<<car.engine_rpm;
+  LOG_INFO<<"  gear: "<<car.gear;
+  LOG_INFO<<"  gas: "<<car.gas;
+  LOG_INFO<<"  brake: "<<car.brake;
+  LOG_INFO<<"  clutch: "<<car.clutch;
 }*/
 
 }
@@ -52,6 +58,7 @@ public:
 
 private:
   acudp::ACUDP acudp;
+  cCarUpdateProcessor processor;
 };
 
 cACUDPThread::cACUDPThread(const util::cIPAddress& ip_address, uint16_t port) :
@@ -62,11 +69,13 @@ cACUDPThread::cACUDPThread(const util::cIPAddress& ip_address, uint16_t port) :
 bool cACUDPThread::HandshakeAndSubscribe()
 {
   // Connect to server and perform handshake
-  std::cout<<"cACUDPThread::HandshakeAndSubscribe Sending handshake"<<std::endl;
+  LOG_INFO<<"cACUDPThread::HandshakeAndSubscribe Sending handshake";
   acudp_setup_response response = acudp.send_handshake();
 
   print_handshake_response(response);
 
+  processor.OnHandshake(response);
+
   // Subscribe to car info events
   acudp.subscribe(acudp::SubscribeMode::update);
 
@@ -75,68 +84,143 @@ bool cACUDPThread::HandshakeAndSubscribe()
 
 void cACUDPThread::MainLoop()
 {
-  std::cout<<"cACUDPThread::MainLoop"<<std::endl;
+  LOG_INFO<<"cACUDPThread::MainLoop";
+
+  util::SetTraceThreadName("acudp_update");
 
   while (true) {
+    // Waiting for a packet isn't a stall, the game may just be paused or closed
+    watchdog.SetWaiting(WATCHDOG_STAGE::INGEST, true);
     auto car = acudp.read_update_event();
+    watchdog.SetWaiting(WATCHDOG_STAGE::INGEST, false);
+
+    // The acudp library receives and decodes the packet in one call and we can't tell how much of that was waiting, so the ingest span starts once the decoded packet is returned
+    TRACE_SCOPE("acudp_ingest");
 
     //print_car_info(car);
 
-    // Update the shared rpm value
-    std::lock_guard<std::mutex> lock(mutex_ac_data);
-    ac_data.gear = car.gear;
-    ac_data.accelerator_0_to_1 = car.gas;
-    ac_data.brake_0_to_1 = car.brake;
-    ac_data.clutch_0_to_1 = car.clutch;
-    ac_data.rpm = car.engine_rpm;
-    ac_data.speed_kmh = car.speed_kmh;
-    ac_data.lap_time_ms = car.lap_time;
-    ac_data.last_lap_ms = car.last_lap;
-    ac_data.best_lap_ms = car.best_lap;
-    ac_data.lap_count = car.lap_count;
+    processor.ProcessUpdate(car, util::GetMonotonicTimeUS());
+  }
+}
+
+
+// Assetto Corsa only sends one kind of event to each subscriber, so the lap events for every car in the session come in on their own connection
+class cACUDPSpotThread {
+public:
+  cACUDPSpotThread(const util::cIPAddress& ip_address, uint16_t port);
+
+  bool HandshakeAndSubscribe();
+
+  void MainLoop();
+
+private:
+  acudp::ACUDP acudp;
+};
+
+cACUDPSpotThread::cACUDPSpotThread(const util::cIPAddress& ip_address, uint16_t port) :
+  acudp(util::ToString(ip_address).c_str(), port)
+{
+}
+
+bool cACUDPSpotThread::HandshakeAndSubscribe()
+{
+  LOG_INFO<<"cACUDPSpotThread::HandshakeAndSubscribe Sending handshake";
+  acudp.send_handshake();
+
+  // Subscribe to lap events
+  acudp.subscribe(acudp::SubscribeMode::spot);
+
+  return true;
+}
+
+void cACUDPSpotThread::MainLoop()
+{
+  LOG_INFO<<"cACUDPSpotThread::MainLoop";
+
+  util::SetTraceThreadName("acudp_spot");
+
+  while (true) {
+    auto lap = acudp.read_spot_event();
+
+    TRACE_SCOPE("acudp_lap_event");
+
+    metrics.acudp_lap_events_received.Increment();
+
+    if ((lap.car_identifier_number < 0) || (lap.lap < 0) || (lap.time_ms < 0)) {
+      continue;
+    }
+
+    // Make sure the names are terminated
+    lap.driver_name[sizeof(lap.driver_name) - 1] = 0;
+    lap.car_name[sizeof(lap.car_name) - 1] = 0;
+
+    uint32_t sequence = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_leaderboard);
+      leaderboard.AddLap(uint32_t(lap.car_identifier_number), uint32_t(lap.lap), lap.driver_name, lap.car_name, uint32_t(lap.time_ms));
+      sequence = leaderboard.sequence;
+    }
+
+    std::lock_guard lock(mutex_ac_data);
+    ac_data.leaderboard_sequence = sequence;
   }
 }
 
+
 // Not the most elegant method, but it works
+template <class T>
 int RunThreadFunction(void* pData)
 {
   if (pData == nullptr) {
     return 1;
   }
 
-  cACUDPThread* pThis = static_cast<cACUDPThread*>(pData);
+  T* pThis = static_cast<T*>(pData);
   if (pThis == nullptr) {
     return 1;
   }
 
-  std::cout<<"RunThreadFunction Calling MainLoop"<<std::endl;
+  ApplyLowLatencyThreadSettings(LOW_LATENCY_THREAD::ACUDP);
+
+  LOG_INFO<<"RunThreadFunction Calling MainLoop";
   pThis->MainLoop();
-  std::cout<<"RunThreadFunction MainLoop returned"<<std::endl;
+  LOG_INFO<<"RunThreadFunction MainLoop returned";
 
   return 0;
 }
 
 bool StartACUDPThread(const util::cIPAddress& ip_address, uint16_t port)
 {
-  std::cout<<"StartACUDPThread Connecting to server "<<util::ToString(ip_address)<<":"<<port<<std::endl;
+  LOG_INFO<<"StartACUDPThread Connecting to server "<<util::ToString(ip_address)<<":"<<port;
 
   // Ok we have successfully connected and subscribed so now we can start the thread to read updates
   cACUDPThread* pACUDPThread = new cACUDPThread(ip_address, port);
   if (pACUDPThread == nullptr) {
-    std::cerr<<"StartACUDPThread Error creating ACUDP thread, returning false"<<std::endl;
+    LOG_ERROR<<"StartACUDPThread Error creating ACUDP thread, returning false";
     return false;
   }
 
   if (!pACUDPThread->HandshakeAndSubscribe()) {
-    std::cerr<<"Error handshaking and subscribing"<<std::endl;
+    LOG_ERROR<<"Error handshaking and subscribing";
     return false;
   }
 
   // Start the thread
   // NOTE: We never release this, it is ugly, but we don't shut down gracefully. We could create a regular object, then give the thread a signal to stop, then have the thread exit gracefully
-  std::thread* pThread = new std::thread(std::bind(&RunThreadFunction, pACUDPThread));
+  std::thread* pThread = new std::thread(std::bind(&RunThreadFunction<cACUDPThread>, pACUDPThread));
   (void)pThread;
 
+  // The leaderboard is nice to have, so if this fails we keep going with just the updates for our car
+  cACUDPSpotThread* pACUDPSpotThread = new cACUDPSpotThread(ip_address, port);
+  if (!pACUDPSpotThread->HandshakeAndSubscribe()) {
+    LOG_ERROR<<"Error handshaking and subscribing to lap events";
+    delete pACUDPSpotThread;
+    return true;
+  }
+
+  std::thread* pSpotThread = new std::thread(std::bind(&RunThreadFunction<cACUDPSpotThread>, pACUDPSpotThread));
+  (void)pSpotThread;
+
   return true;
 }
 
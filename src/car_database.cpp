@@ -0,0 +1,201 @@
+#include <cstring>
+
+
+#include <json-c/json.h>
+
+#include "ac_data.h"
+#include "car_database.h"
+#include "json.h"
+#include "log.h"
+#include "util.h"
+
+namespace {
+
+const size_t MAX_FILE_SIZE_BYTES = 1024 * 1024;
+
+bool JSONParsePositiveNumber(struct json_object* json, const std::string& name, float& out_value)
+{
+  struct json_object* obj = json_object_object_get(json, name.c_str());
+  if (obj == nullptr) {
+    LOG_ERROR<<name<<" not found";
+    return false;
+  }
+
+  enum json_type type = json_object_get_type(obj);
+  if ((type != json_type_int) && (type != json_type_double)) {
+    LOG_ERROR<<name<<" is not a number";
+    return false;
+  }
+
+  const double value = json_object_get_double(obj);
+  if (value <= 0.0) {
+    LOG_ERROR<<name<<" is not valid";
+    return false;
+  }
+
+  out_value = float(value);
+  return true;
+}
+
+}
+
+namespace acdisplay {
+
+cCarConfig::cCarConfig() :
+  rpm_red_line(0.0f),
+  rpm_maximum(0.0f),
+  speedometer_red_line_kph(0.0f),
+  speedometer_maximum_kph(0.0f)
+{
+}
+
+
+bool cCarDatabase::LoadFromFile(const std::string& file_path)
+{
+  cars.clear();
+
+  std::string contents;
+  if (!util::ReadFileIntoString(file_path, MAX_FILE_SIZE_BYTES, contents)) {
+    return false;
+  }
+
+  return LoadFromString(contents);
+}
+
+bool cCarDatabase::LoadFromString(const std::string& contents)
+{
+  cars.clear();
+
+  util::cJSONDocument document(json_tokener_parse(contents.c_str()));
+  if (!document.IsValid()) {
+    LOG_ERROR<<"cCarDatabase::LoadFromString Invalid JSON";
+    return false;
+  }
+
+  struct json_object* cars_obj = json_object_object_get(document.Get(), "cars");
+  if ((cars_obj == nullptr) || (json_object_get_type(cars_obj) != json_type_object)) {
+    LOG_ERROR<<"cCarDatabase::LoadFromString cars object not found";
+    return false;
+  }
+
+  // Parse each car, skip any that are invalid rather than throwing the whole database away
+  json_object_object_foreach(cars_obj, car_key, car_val) {
+    if (json_object_get_type(car_val) != json_type_object) {
+      LOG_ERROR<<"cCarDatabase::LoadFromString "<<car_key<<" is not an object";
+      continue;
+    }
+
+    cCarConfig config;
+    if (
+      !JSONParsePositiveNumber(car_val, "rpm_red_line", config.rpm_red_line) ||
+      !JSONParsePositiveNumber(car_val, "rpm_maximum", config.rpm_maximum) ||
+      !JSONParsePositiveNumber(car_val, "speedometer_red_line_kph", config.speedometer_red_line_kph) ||
+      !JSONParsePositiveNumber(car_val, "speedometer_maximum_kph", config.speedometer_maximum_kph)
+    ) {
+      LOG_WARNING<<"cCarDatabase::LoadFromString Skipping invalid car "<<car_key;
+      continue;
+    }
+
+    cars[car_key] = config;
+  }
+
+  return true;
+}
+
+const cCarConfig* cCarDatabase::Find(const std::string& car_name) const
+{
+  auto iter = cars.find(car_name);
+  return (iter != cars.end()) ? &(iter->second) : nullptr;
+}
+
+
+bool cCarDatabaseManager::Start(const std::string& _file_path)
+{
+  file_path = _file_path;
+
+  Reload();
+
+  // The file is optional, so we keep watching for it even if it doesn't exist yet
+  return file_watcher.Start(file_path, [this]() {
+    LOG_INFO<<"cCarDatabaseManager \""<<file_path<<"\" changed, reloading";
+    Reload();
+    Apply();
+  });
+}
+
+void cCarDatabaseManager::Stop()
+{
+  file_watcher.Stop();
+}
+
+void cCarDatabaseManager::Reload()
+{
+  std::shared_ptr<cCarDatabase> loaded = std::make_shared<cCarDatabase>();
+  if (util::TestFileExists(file_path) && !loaded->LoadFromFile(file_path)) {
+    // Keep using the old database until the file is fixed
+    LOG_ERROR<<"cCarDatabaseManager::Reload Error loading \""<<file_path<<"\"";
+    return;
+  }
+
+  LOG_INFO<<"cCarDatabaseManager::Reload Loaded "<<loaded->GetCount()<<" cars";
+  database.store(loaded);
+}
+
+void cCarDatabaseManager::SetCurrentCar(const std::string& _car_name)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_car_name);
+    car_name = _car_name;
+  }
+
+  Apply();
+}
+
+void cCarDatabaseManager::Apply()
+{
+  std::string current_car_name;
+  {
+    std::lock_guard<std::mutex> lock(mutex_car_name);
+    current_car_name = car_name;
+  }
+
+  if (current_car_name.empty()) {
+    return;
+  }
+
+  const std::shared_ptr<const cCarDatabase> current_database = database.load();
+  const cCarConfig* config = (current_database != nullptr) ? current_database->Find(current_car_name) : nullptr;
+
+  std::lock_guard lock(mutex_ac_data);
+
+  if (config != nullptr) {
+    LOG_INFO<<"cCarDatabaseManager::Apply Using the config for "<<current_car_name;
+    ac_data.config_rpm_red_line = config->rpm_red_line;
+    ac_data.config_rpm_maximum = config->rpm_maximum;
+    ac_data.config_speedometer_red_line_kph = config->speedometer_red_line_kph;
+    ac_data.config_speedometer_maximum_kph = config->speedometer_maximum_kph;
+    ac_data.config_shift_lights.SetDefaultsForRedLine(config->rpm_red_line);
+
+    // The database is more accurate than our estimates
+    ac_data.config_automatic = false;
+  } else {
+    LOG_INFO<<"cCarDatabaseManager::Apply "<<current_car_name<<" not found, estimating the config from the live data";
+
+    // Start from the defaults rather than the previous car's config, the estimates replace them as they come in
+    const cACDataState defaults;
+    ac_data.config_rpm_red_line = defaults.config_rpm_red_line;
+    ac_data.config_rpm_maximum = defaults.config_rpm_maximum;
+    ac_data.config_speedometer_red_line_kph = defaults.config_speedometer_red_line_kph;
+    ac_data.config_speedometer_maximum_kph = defaults.config_speedometer_maximum_kph;
+    ac_data.config_shift_lights = defaults.config_shift_lights;
+    ac_data.config_automatic = true;
+  }
+
+  // Tell the senders to push the new config to the clients
+  ac_data.config_sequence++;
+}
+
+
+cCarDatabaseManager car_database;
+
+}
@@ -0,0 +1,206 @@
+#include <cmath>
+
+#include <algorithm>
+
+#include "ac_data.h"
+#include "car_database.h"
+#include "car_update_processor.h"
+#include "flight_recorder.h"
+#include "log.h"
+#include "metrics.h"
+#include "session_statistics.h"
+#include "telemetry_history.h"
+#include "trace.h"
+#include "util.h"
+#include "watchdog.h"
+
+namespace {
+
+// A gap between packets longer than this is recorded in the flight recorder, Assetto Corsa normally sends an update every frame
+const uint64_t ACUDP_PACKET_GAP_US = 500000;
+
+// Copies a channel from the acudp_car_t member with the same name
+template <typename T, typename U>
+void CopyTelemetryChannel(const U& from, T& to)
+{
+  to = T(from);
+}
+
+template <typename T, typename U, size_t COUNT>
+void CopyTelemetryChannel(const U (&from)[COUNT], std::array<T, COUNT>& to)
+{
+  for (size_t i = 0; i < COUNT; i++) {
+    to[i] = T(from[i]);
+  }
+}
+
+}
+
+namespace acdisplay {
+
+cCarUpdateProcessor::cCarUpdateProcessor() :
+  last_received_time_us(0)
+{
+  gear_shift_lights_valid.fill(false);
+}
+
+void cCarUpdateProcessor::OnHandshake(const acudp_setup_response_t& response)
+{
+  flight_recorder.Record(std::string("ACUDP handshake, car ") + response.car_name + ", track " + response.track_name);
+
+  // The estimates from the previous car don't apply to this one
+  gear_ratio_estimator.Reset();
+  gear_shift_lights_valid.fill(false);
+
+  // Use the config for this car from the car database if there is one
+  car_database.SetCurrentCar(response.car_name);
+
+  // Use the cached track map if we have already driven this track
+  track_map_builder.Reset();
+  track_map_file_path = GetTrackMapFilePath(response.track_name, response.track_config);
+  cTrackMap map;
+  if (!track_map_file_path.empty() && util::TestFileExists(track_map_file_path) && LoadTrackMap(track_map_file_path, map)) {
+    LOG_INFO<<"cCarUpdateProcessor::OnHandshake Loaded track map \""<<track_map_file_path<<"\"";
+    track_map_builder.SetMap(map);
+    PublishTrackMap(map);
+  } else {
+    PublishTrackMap(cTrackMap());
+  }
+}
+
+void cCarUpdateProcessor::ProcessUpdate(const acudp_car_t& car, uint64_t received_time_us)
+{
+  TRACE_SCOPE("acudp_process");
+
+  metrics.acudp_packets_received.Increment();
+
+  if ((last_received_time_us != 0) && ((received_time_us - last_received_time_us) > ACUDP_PACKET_GAP_US)) {
+    flight_recorder.Record("ACUDP packet gap of " + std::to_string((received_time_us - last_received_time_us) / 1000) + " ms");
+  }
+  last_received_time_us = received_time_us;
+
+  const uint64_t now_ms = util::GetTimeMS();
+
+  sector_timing.Update(car.car_position_normalized, car.lap_time, car.last_lap, car.lap_count);
+
+  const uint8_t wheel_slip = wheel_slip_detector.Update(car.speed_ms, car.wheel_angular_speed, car.tyre_radius, car.load);
+
+  if (track_map_builder.Update(car.car_position_normalized, car.car_coordinates[0], car.car_coordinates[2], car.lap_count)) {
+    LOG_INFO<<"cCarUpdateProcessor::ProcessUpdate Built track map with "<<track_map_builder.GetMap().points.size()<<" points";
+    if (!track_map_file_path.empty()) {
+      SaveTrackMapInBackground(track_map_file_path, track_map_builder.GetMap());
+    }
+
+    PublishTrackMap(track_map_builder.GetMap());
+  }
+
+  if (gear_ratio_estimator.Update(car.gear, car.engine_rpm, car.speed_kmh, car.gas, car.brake, car.clutch, car.lap_time, car.last_lap, car.lap_count)) {
+    ApplyGearRatioEstimates();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_session_statistics);
+    session_statistics.Update(car.speed_kmh, car.gear, car.engine_rpm, car.gas, car.brake, car.lap_time, car.last_lap, car.lap_count);
+  }
+
+  // Update the shared rpm value
+  TRACE_SCOPE("acudp_publish");
+  std::lock_guard lock(mutex_ac_data);
+  cTelemetry& telemetry = ac_data.telemetry;
+  telemetry.core.gear = car.gear;
+  telemetry.core.accelerator_0_to_1 = car.gas;
+  telemetry.core.brake_0_to_1 = car.brake;
+  telemetry.core.clutch_0_to_1 = car.clutch;
+  telemetry.core.rpm = car.engine_rpm;
+  telemetry.core.speed_kmh = car.speed_kmh;
+  telemetry.core.lap_time_ms = car.lap_time;
+  telemetry.core.last_lap_ms = car.last_lap;
+  telemetry.core.best_lap_ms = car.best_lap;
+  telemetry.core.lap_count = car.lap_count;
+  const bool use_gear_shift_lights = ac_data.config_automatic && (car.gear >= 0) && (size_t(car.gear) < GEAR_RATIO_ESTIMATOR_GEAR_COUNT) && gear_shift_lights_valid[car.gear];
+  telemetry.core.shift_lights = shift_lights.Update(use_gear_shift_lights ? gear_shift_lights[car.gear] : ac_data.config_shift_lights, car.engine_rpm, now_ms);
+  ac_data.sector_times = sector_timing.GetTimes();
+  telemetry.core.current_sector = ac_data.sector_times.current_sector;
+  telemetry.core.current_sector_ms = ac_data.sector_times.current_sector_ms;
+  telemetry.core.wheel_slip = wheel_slip;
+  telemetry.core.track_position_index = GetTrackMapPositionIndex(car.car_position_normalized);
+
+  // The other groups are only filled in if a client has asked for them
+  const uint32_t telemetry_groups = telemetry_subscriptions.GetGroups();
+  ac_data.telemetry_groups = telemetry_groups;
+#define ACDISPLAY_TELEMETRY_COPY_CHANNEL(GROUP, NAME, TYPE, COUNT, DEFAULT, BINARY_TYPE, SCALE, UNITS) CopyTelemetryChannel(car.NAME, telemetry.GROUP.NAME);
+#define ACDISPLAY_TELEMETRY_COPY_GROUP(GROUP, CLASS, CHANNELS) \
+  if ((telemetry_groups & GetTelemetryGroupMask(TELEMETRY_GROUP::GROUP)) != 0) { \
+    CHANNELS(ACDISPLAY_TELEMETRY_COPY_CHANNEL) \
+  }
+  ACDISPLAY_TELEMETRY_ACUDP_GROUPS(ACDISPLAY_TELEMETRY_COPY_GROUP)
+#undef ACDISPLAY_TELEMETRY_COPY_GROUP
+#undef ACDISPLAY_TELEMETRY_COPY_CHANNEL
+
+  telemetry.core.published_time_us = util::GetMonotonicTimeUS();
+
+  // Keep every sample for the batch clients
+  if (telemetry_history.IsSubscribed()) {
+    telemetry_history.Push(telemetry, telemetry_groups);
+  }
+
+  metrics.samples_published.Increment();
+  metrics.acudp_processing_latency.Observe(telemetry.core.published_time_us - received_time_us);
+
+  watchdog.Progress(WATCHDOG_STAGE::INGEST, telemetry.core.published_time_us / 1000);
+}
+
+void cCarUpdateProcessor::ApplyGearRatioEstimates()
+{
+  // Each gear's shift lights peak at that gear's optimal upshift point
+  float lowest_upshift_rpm = 0.0f;
+  for (uint8_t gear = 0; gear < GEAR_RATIO_ESTIMATOR_GEAR_COUNT; gear++) {
+    const float upshift_rpm = gear_ratio_estimator.GetUpshiftRPM(gear);
+    gear_shift_lights_valid[gear] = (upshift_rpm > 0.0f);
+    if (gear_shift_lights_valid[gear]) {
+      gear_shift_lights[gear].SetDefaultsForRedLine(upshift_rpm);
+
+      if ((lowest_upshift_rpm == 0.0f) || (upshift_rpm < lowest_upshift_rpm)) {
+        lowest_upshift_rpm = upshift_rpm;
+      }
+    }
+  }
+
+  // Round the maximum up to a tidy value for the tachometer
+  const float rpm_step = 500.0f;
+  const float maximum_rpm = rpm_step * std::ceil(gear_ratio_estimator.GetMaximumRPM() / rpm_step);
+
+  std::lock_guard lock(mutex_ac_data);
+  if (!ac_data.config_automatic) {
+    return;
+  }
+
+  // Keep the defaults until we have both, otherwise the default red line could be past the end of an estimated maximum
+  if ((maximum_rpm <= 0.0f) || (lowest_upshift_rpm <= 0.0f)) {
+    return;
+  }
+
+  const float rpm_red_line = std::min(lowest_upshift_rpm, maximum_rpm);
+  if ((maximum_rpm == ac_data.config_rpm_maximum) && (rpm_red_line == ac_data.config_rpm_red_line)) {
+    return;
+  }
+
+  ac_data.config_rpm_maximum = maximum_rpm;
+  ac_data.config_rpm_red_line = rpm_red_line;
+  ac_data.config_sequence++;
+
+  LOG_INFO<<"cCarUpdateProcessor::ApplyGearRatioEstimates red line "<<ac_data.config_rpm_red_line<<", maximum "<<ac_data.config_rpm_maximum;
+}
+
+void cCarUpdateProcessor::PublishTrackMap(const cTrackMap& map)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_track_map);
+    track_map = map;
+  }
+
+  std::lock_guard lock(mutex_ac_data);
+  ac_data.track_map_sequence++;
+}
+
+}
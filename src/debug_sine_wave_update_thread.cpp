@@ -1,11 +1,14 @@
 #include <cmath>
 
 #include <functional>
-#include <iostream>
 #include <thread>
 
 #include "ac_data.h"
 #include "debug_sine_wave_update_thread.h"
+#include "log.h"
+#include "metrics.h"
+#include "shift_lights.h"
+#include "telemetry_history.h"
 #include "util.h"
 
 namespace {
@@ -15,7 +18,7 @@ const float fRPMIdle = 800.0f;
 
 float GetRPMShiftPoint()
 {
-  std::lock_guard<std::mutex> lock(mutex_ac_data);
+  std::lock_guard lock(mutex_ac_data);
   return ac_data.config_rpm_red_line;
 }
 
@@ -26,11 +29,14 @@ namespace acdisplay {
 class cDebugSineWaveUpdateThread {
 public:
   void MainLoop();
+
+private:
+  cShiftLights shift_lights;
 };
 
 void cDebugSineWaveUpdateThread::MainLoop()
 {
-  std::cout<<"cDebugSineWaveUpdateThread::MainLoop"<<std::endl;
+  LOG_INFO<<"cDebugSineWaveUpdateThread::MainLoop";
 
   const float fRPMShiftPoint = GetRPMShiftPoint();
 
@@ -39,23 +45,33 @@ void cDebugSineWaveUpdateThread::MainLoop()
   while (true) {
     // Test with a sin wave
     // This is a bit hacky, basically we just want a sin wave that cycles smoothly between idle RPM to the shift point RPM
-    const uint64_t delta = util::GetTimeMS() - start;
+    const uint64_t now_ms = util::GetTimeMS();
+    const uint64_t delta = now_ms - start;
     const float e = 0.001f * float(delta);
     const float range = (fRPMShiftPoint - fRPMIdle);
     const float g = 0.5f * sinf(e);
     const float h = fRPMIdle + (0.5f * range) + (range * g);
     const int rpm = util::clamp(int(h), int(fRPMIdle), int(fRPMIdle + range));
-    //std::cout<<"delta: "<<delta<<", e: "<<e<<", g: "<<g<<", h: "<<h<<", rpm: "<<rpm<<std::endl;
+    //LOG_INFO<<"delta: "<<delta<<", e: "<<e<<", g: "<<g<<", h: "<<h<<", rpm: "<<rpm;
     const float speed_kph = 150.0f + (100.0f * sinf(0.5f * e));
-    //std::cout<<"rpm: "<<rpm<<", speed: "<<speed_kph<<std::endl;
+    //LOG_INFO<<"rpm: "<<rpm<<", speed: "<<speed_kph;
 
     // Update the shared rpm value
     {
-      std::lock_guard<std::mutex> lock(mutex_ac_data);
-      ac_data.rpm = rpm;
-      ac_data.speed_kmh = speed_kph;
+      std::lock_guard lock(mutex_ac_data);
+      ac_data.telemetry.core.rpm = rpm;
+      ac_data.telemetry.core.speed_kmh = speed_kph;
+      ac_data.telemetry.core.shift_lights = shift_lights.Update(ac_data.config_shift_lights, rpm, now_ms);
+      ac_data.telemetry.core.published_time_us = util::GetMonotonicTimeUS();
+      ac_data.telemetry_groups = TELEMETRY_CORE_GROUP;
+
+      if (telemetry_history.IsSubscribed()) {
+        telemetry_history.Push(ac_data.telemetry, TELEMETRY_CORE_GROUP);
+      }
     }
 
+    metrics.samples_published.Increment();
+
     util::msleep(50);
   }
 }
@@ -72,21 +88,21 @@ int DebugSineWaveUpdateRunThreadFunction(void* pData)
     return 1;
   }
 
-  std::cout<<"DebugSineWaveUpdateRunThreadFunction Calling MainLoop"<<std::endl;
+  LOG_INFO<<"DebugSineWaveUpdateRunThreadFunction Calling MainLoop";
   pThis->MainLoop();
-  std::cout<<"DebugSineWaveUpdateRunThreadFunction MainLoop returned"<<std::endl;
+  LOG_INFO<<"DebugSineWaveUpdateRunThreadFunction MainLoop returned";
 
   return 0;
 }
 
 bool DebugStartSineWaveUpdateThread()
 {
-  std::cout<<"DebugStartSineWaveUpdateThread"<<std::endl;
+  LOG_INFO<<"DebugStartSineWaveUpdateThread";
 
   // Ok we have successfully connected and subscribed so now we can start the thread to read updates
   cDebugSineWaveUpdateThread* pDebugSineWaveUpdateThread = new cDebugSineWaveUpdateThread;
   if (pDebugSineWaveUpdateThread == nullptr) {
-    std::cerr<<"DebugStartSineWaveUpdateThread Error creating DebugSineWaveUpdate thread, returning false"<<std::endl;
+    LOG_ERROR<<"DebugStartSineWaveUpdateThread Error creating DebugSineWaveUpdate thread, returning false";
     return false;
   }
 
@@ -0,0 +1,148 @@
+#include <cerrno>
+#include <cstring>
+
+#include <filesystem>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "file_watcher.h"
+#include "log.h"
+
+namespace {
+
+// Editors often save in a few steps, so wait until the changes have settled before telling anyone
+const int SETTLE_TIME_MS = 100;
+
+}
+
+namespace util {
+
+cFileWatcher::cFileWatcher() :
+  inotify_fd(-1),
+  stop_event_fd(-1)
+{
+}
+
+cFileWatcher::~cFileWatcher()
+{
+  Stop();
+}
+
+bool cFileWatcher::Start(const std::string& file_path, std::function<void()> _on_changed)
+{
+  Stop();
+
+  const std::filesystem::path path(file_path);
+  const std::string folder = path.has_parent_path() ? path.parent_path().string() : std::string(".");
+  file_name = path.filename().string();
+  on_changed = _on_changed;
+
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) {
+    LOG_ERROR<<"cFileWatcher::Start inotify_init1 failed "<<strerror(errno);
+    return false;
+  }
+
+  if (inotify_add_watch(inotify_fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+    LOG_ERROR<<"cFileWatcher::Start Error watching \""<<folder<<"\" "<<strerror(errno);
+    close(inotify_fd);
+    inotify_fd = -1;
+    return false;
+  }
+
+  stop_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (stop_event_fd < 0) {
+    LOG_ERROR<<"cFileWatcher::Start eventfd failed "<<strerror(errno);
+    close(inotify_fd);
+    inotify_fd = -1;
+    return false;
+  }
+
+  thread = std::thread(&cFileWatcher::MainLoop, this);
+
+  return true;
+}
+
+void cFileWatcher::Stop()
+{
+  if (thread.joinable()) {
+    // Wake up the thread and wait for it to finish
+    const uint64_t value = 1;
+    if (write(stop_event_fd, &value, sizeof(value)) != sizeof(value)) {
+      LOG_ERROR<<"cFileWatcher::Stop Error signalling the thread";
+    }
+
+    thread.join();
+  }
+
+  if (stop_event_fd >= 0) {
+    close(stop_event_fd);
+    stop_event_fd = -1;
+  }
+
+  if (inotify_fd >= 0) {
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
+}
+
+void cFileWatcher::MainLoop()
+{
+  bool pending = false;
+
+  while (true) {
+    struct pollfd fds[2];
+    fds[0].fd = inotify_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = stop_event_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    const int result = poll(fds, 2, pending ? SETTLE_TIME_MS : -1);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      LOG_ERROR<<"cFileWatcher::MainLoop poll failed "<<strerror(errno);
+      break;
+    }
+
+    if ((fds[1].revents & POLLIN) != 0) {
+      // We have been asked to stop
+      break;
+    }
+
+    if (result == 0) {
+      // Nothing else has happened for a while so the file is ready
+      pending = false;
+      on_changed();
+      continue;
+    }
+
+    if ((fds[0].revents & POLLIN) != 0) {
+      alignas(struct inotify_event) char buffer[4096];
+      while (true) {
+        const ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+          break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+          const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+          if ((event->len != 0) && (file_name == event->name)) {
+            pending = true;
+          }
+
+          offset += sizeof(struct inotify_event) + event->len;
+        }
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "flight_recorder.h"
+#include "util.h"
+
+namespace acdisplay {
+
+cFlightRecorder::cFlightRecorder() :
+  next(0),
+  count(0)
+{
+}
+
+void cFlightRecorder::Record(std::string_view text)
+{
+  const uint64_t now_ms = util::GetTimeMS();
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  cEvent& event = events[next];
+  event.time_ms = now_ms;
+  event.length = uint8_t(std::min(text.length(), event.text.size()));
+  std::copy_n(text.data(), event.length, event.text.data());
+
+  next = (next + 1) % events.size();
+  count = std::min(count + 1, events.size());
+}
+
+std::vector<std::string> cFlightRecorder::GetEvents() const
+{
+  std::vector<std::string> result;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  result.reserve(count);
+
+  const size_t oldest = (next + events.size() - count) % events.size();
+  for (size_t i = 0; i < count; i++) {
+    const cEvent& event = events[(oldest + i) % events.size()];
+    result.push_back(std::to_string(event.time_ms) + " " + std::string(event.text.data(), event.length));
+  }
+
+  return result;
+}
+
+void cFlightRecorder::Clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  next = 0;
+  count = 0;
+}
+
+cFlightRecorder flight_recorder;
+
+}
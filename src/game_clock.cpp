@@ -0,0 +1,53 @@
+#include "game_clock.h"
+
+namespace acdisplay {
+
+cGameClock::cGameClock()
+{
+  Reset();
+}
+
+void cGameClock::Reset()
+{
+  has_previous = false;
+  previous_lap_time_ms = 0;
+  previous_lap_count = 0;
+
+  time_ms = 0;
+  delta_ms = 0;
+  new_lap = false;
+}
+
+bool cGameClock::Update(uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count)
+{
+  bool restarted = false;
+
+  if (has_previous && ((lap_count < previous_lap_count) || ((lap_count == previous_lap_count) && (lap_time_ms < previous_lap_time_ms)))) {
+    Reset();
+    restarted = true;
+  }
+
+  delta_ms = 0;
+  new_lap = false;
+
+  if (has_previous) {
+    if (lap_count == previous_lap_count) {
+      delta_ms = lap_time_ms - previous_lap_time_ms;
+    } else {
+      // We crossed the line, the last lap time tells us exactly how much of the previous lap was left
+      const uint32_t remaining_ms = (last_lap_ms > previous_lap_time_ms) ? (last_lap_ms - previous_lap_time_ms) : 0;
+      delta_ms = remaining_ms + lap_time_ms;
+      new_lap = true;
+    }
+  }
+
+  time_ms += delta_ms;
+
+  has_previous = true;
+  previous_lap_time_ms = lap_time_ms;
+  previous_lap_count = lap_count;
+
+  return restarted;
+}
+
+}
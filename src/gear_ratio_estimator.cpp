@@ -0,0 +1,301 @@
+#include <cmath>
+
+#include <algorithm>
+
+#include "gear_ratio_estimator.h"
+
+namespace {
+
+// Below this speed the rpm is mostly decided by the clutch and wheelspin rather than the gear ratio
+const float MIN_SPEED_KMH = 20.0f;
+
+// Assetto Corsa reports the clutch as 1 when it is fully engaged
+const float CLUTCH_ENGAGED = 0.99f;
+
+const float FULL_THROTTLE = 0.98f;
+const float BRAKING = 0.05f;
+
+// Ignore the acceleration just after a gear change while the drivetrain settles
+const uint64_t GEAR_SETTLE_TIME_MS = 300;
+
+// The acceleration is measured over at least this long
+const uint64_t ACCELERATION_WINDOW_MS = 100;
+
+const uint64_t RECALCULATE_INTERVAL_MS = 1000;
+
+const uint32_t RATIO_MIN_SAMPLES = 50;
+const double RATIO_MAX_RELATIVE_RESIDUAL = 0.03;
+
+// Once we know the ratio, samples this far off are wheelspin or lockups
+const float RATIO_MAX_SAMPLE_ERROR = 0.1f;
+
+const uint32_t ACCELERATION_MIN_SAMPLES = 3;
+
+// The next gear has to be at least this much better before we say it is time to change up
+const float UPSHIFT_ACCELERATION_MARGIN = 1.01f;
+
+const float UPSHIFT_CHANGED_RPM = 50.0f;
+const float MAXIMUM_CHANGED_RPM = 100.0f;
+
+// Returns false if the rpm is negative, NaN or past the last bucket, converting those to an index would be undefined behaviour
+bool GetRPMBucket(float rpm, size_t& out_bucket)
+{
+  if (!(rpm >= 0.0f) || !(rpm < (float(acdisplay::GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT) * acdisplay::GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH))) {
+    return false;
+  }
+
+  out_bucket = std::min(size_t(rpm / acdisplay::GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH), acdisplay::GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT - 1);
+  return true;
+}
+
+}
+
+namespace acdisplay {
+
+cGearEstimate::cGearEstimate()
+{
+  Clear();
+}
+
+void cGearEstimate::Clear()
+{
+  max_rpm = 0.0f;
+
+  ratio_samples = 0;
+  sum_speed_rpm = 0.0;
+  sum_speed_squared = 0.0;
+  sum_rpm_squared = 0.0;
+  sum_rpm = 0.0;
+
+  acceleration_mean_ms2.fill(0.0f);
+  acceleration_samples.fill(0);
+}
+
+void cGearEstimate::AddRatioSample(float speed_kmh, float rpm)
+{
+  if (IsRatioConverged()) {
+    const float expected_rpm = GetRatio() * speed_kmh;
+    if (std::fabs(rpm - expected_rpm) > (RATIO_MAX_SAMPLE_ERROR * expected_rpm)) {
+      return;
+    }
+  }
+
+  ratio_samples++;
+  sum_speed_rpm += double(speed_kmh) * double(rpm);
+  sum_speed_squared += double(speed_kmh) * double(speed_kmh);
+  sum_rpm_squared += double(rpm) * double(rpm);
+  sum_rpm += double(rpm);
+}
+
+bool cGearEstimate::IsRatioConverged() const
+{
+  if ((ratio_samples < RATIO_MIN_SAMPLES) || (sum_speed_squared <= 0.0)) {
+    return false;
+  }
+
+  // The residual sum of squares for the fit through the origin
+  const double residual = std::max(0.0, sum_rpm_squared - ((sum_speed_rpm * sum_speed_rpm) / sum_speed_squared));
+  const double rms_residual = std::sqrt(residual / double(ratio_samples));
+  const double mean_rpm = sum_rpm / double(ratio_samples);
+  return (rms_residual <= (RATIO_MAX_RELATIVE_RESIDUAL * mean_rpm));
+}
+
+float cGearEstimate::GetRatio() const
+{
+  return (sum_speed_squared > 0.0) ? float(sum_speed_rpm / sum_speed_squared) : 0.0f;
+}
+
+void cGearEstimate::AddAccelerationSample(float rpm, float acceleration_ms2)
+{
+  size_t bucket = 0;
+  if (!GetRPMBucket(rpm, bucket) || !std::isfinite(acceleration_ms2)) {
+    return;
+  }
+
+  acceleration_samples[bucket]++;
+  acceleration_mean_ms2[bucket] += (acceleration_ms2 - acceleration_mean_ms2[bucket]) / float(acceleration_samples[bucket]);
+}
+
+bool cGearEstimate::GetAcceleration(float rpm, float& out_acceleration_ms2) const
+{
+  out_acceleration_ms2 = 0.0f;
+
+  size_t bucket = 0;
+  if (!GetRPMBucket(rpm, bucket) || (acceleration_samples[bucket] < ACCELERATION_MIN_SAMPLES)) {
+    return false;
+  }
+
+  // Interpolate towards the neighbouring bucket if it has enough samples
+  const float centre = (float(bucket) + 0.5f) * GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH;
+  const size_t neighbour = (rpm < centre) ? (bucket - 1) : (bucket + 1);
+  if ((bucket != 0) && (neighbour < GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT) && (acceleration_samples[neighbour] >= ACCELERATION_MIN_SAMPLES)) {
+    const float fraction = std::fabs(rpm - centre) / GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH;
+    out_acceleration_ms2 = acceleration_mean_ms2[bucket] + (fraction * (acceleration_mean_ms2[neighbour] - acceleration_mean_ms2[bucket]));
+  } else {
+    out_acceleration_ms2 = acceleration_mean_ms2[bucket];
+  }
+
+  return true;
+}
+
+
+cGearRatioEstimator::cGearRatioEstimator()
+{
+  Reset();
+}
+
+void cGearRatioEstimator::Reset()
+{
+  clock.Reset();
+
+  for (auto&& gear : gears) {
+    gear.Clear();
+  }
+
+  has_anchor = false;
+  anchor_time_ms = 0;
+  anchor_speed_kmh = 0.0f;
+  anchor_rpm = 0.0f;
+
+  previous_gear = 0;
+  gear_engaged_time_ms = 0;
+
+  last_recalculate_time_ms = 0;
+
+  upshift_rpm.fill(0.0f);
+  max_rpm = 0.0f;
+  reported_max_rpm = 0.0f;
+}
+
+float cGearRatioEstimator::GetRatio(uint8_t gear) const
+{
+  if (gear >= GEAR_RATIO_ESTIMATOR_GEAR_COUNT) {
+    return 0.0f;
+  }
+
+  return gears[gear].IsRatioConverged() ? gears[gear].GetRatio() : 0.0f;
+}
+
+float cGearRatioEstimator::GetUpshiftRPM(uint8_t gear) const
+{
+  return (gear < GEAR_RATIO_ESTIMATOR_GEAR_COUNT) ? upshift_rpm[gear] : 0.0f;
+}
+
+bool cGearRatioEstimator::Update(uint8_t gear, float rpm, float speed_kmh, float accelerator_0_to_1, float brake_0_to_1, float clutch_0_to_1, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count)
+{
+  // NOTE: A restarted session is still the same car, so we keep everything we have learnt
+  clock.Update(lap_time_ms, last_lap_ms, lap_count);
+
+  const uint64_t now_ms = clock.GetTimeMS();
+
+  if (gear != previous_gear) {
+    previous_gear = gear;
+    gear_engaged_time_ms = now_ms;
+    has_anchor = false;
+  }
+
+  const bool forward_gear = (gear >= GEAR_RATIO_ESTIMATOR_FIRST_GEAR) && (gear < GEAR_RATIO_ESTIMATOR_GEAR_COUNT);
+  if (forward_gear && (clutch_0_to_1 >= CLUTCH_ENGAGED) && (speed_kmh >= MIN_SPEED_KMH)) {
+    cGearEstimate& estimate = gears[gear];
+
+    if (rpm > estimate.max_rpm) {
+      estimate.max_rpm = rpm;
+    }
+    if (rpm > max_rpm) {
+      max_rpm = rpm;
+    }
+
+    estimate.AddRatioSample(speed_kmh, rpm);
+
+    const bool full_throttle = (accelerator_0_to_1 >= FULL_THROTTLE) && (brake_0_to_1 < BRAKING) && ((now_ms - gear_engaged_time_ms) >= GEAR_SETTLE_TIME_MS);
+    if (!full_throttle) {
+      has_anchor = false;
+    } else if (!has_anchor) {
+      has_anchor = true;
+      anchor_time_ms = now_ms;
+      anchor_speed_kmh = speed_kmh;
+      anchor_rpm = rpm;
+    } else if ((now_ms - anchor_time_ms) >= ACCELERATION_WINDOW_MS) {
+      const float delta_seconds = float(now_ms - anchor_time_ms) / 1000.0f;
+      const float acceleration_ms2 = ((speed_kmh - anchor_speed_kmh) / 3.6f) / delta_seconds;
+      estimate.AddAccelerationSample(0.5f * (rpm + anchor_rpm), acceleration_ms2);
+
+      anchor_time_ms = now_ms;
+      anchor_speed_kmh = speed_kmh;
+      anchor_rpm = rpm;
+    }
+  } else {
+    has_anchor = false;
+  }
+
+  if ((now_ms - last_recalculate_time_ms) < RECALCULATE_INTERVAL_MS) {
+    return false;
+  }
+
+  last_recalculate_time_ms = now_ms;
+  return Recalculate();
+}
+
+float cGearRatioEstimator::CalculateUpshiftRPM(uint8_t gear) const
+{
+  const cGearEstimate& current = gears[gear];
+  const cGearEstimate& next = gears[gear + 1];
+  if (!current.IsRatioConverged() || !next.IsRatioConverged()) {
+    return 0.0f;
+  }
+
+  const float ratio_change = next.GetRatio() / current.GetRatio();
+  if (ratio_change >= 1.0f) {
+    return 0.0f;
+  }
+
+  // Walk up the rev range in this gear and change up at the first rpm where the next gear would accelerate harder at the same speed
+  bool has_acceleration = false;
+  for (size_t bucket = 0; bucket < GEAR_RATIO_ESTIMATOR_RPM_BUCKET_COUNT; bucket++) {
+    const float bucket_rpm = (float(bucket) + 0.5f) * GEAR_RATIO_ESTIMATOR_RPM_BUCKET_WIDTH;
+    if (bucket_rpm > current.max_rpm) {
+      break;
+    }
+
+    float acceleration_ms2 = 0.0f;
+    if (!current.GetAcceleration(bucket_rpm, acceleration_ms2)) {
+      continue;
+    }
+
+    has_acceleration = true;
+
+    float next_acceleration_ms2 = 0.0f;
+    if (!next.GetAcceleration(bucket_rpm * ratio_change, next_acceleration_ms2)) {
+      continue;
+    }
+
+    if (next_acceleration_ms2 > (acceleration_ms2 * UPSHIFT_ACCELERATION_MARGIN)) {
+      return bucket_rpm;
+    }
+  }
+
+  // The next gear never pulls harder, so hold on to this gear as long as possible
+  return has_acceleration ? current.max_rpm : 0.0f;
+}
+
+bool cGearRatioEstimator::Recalculate()
+{
+  bool changed = false;
+
+  for (uint8_t gear = GEAR_RATIO_ESTIMATOR_FIRST_GEAR; size_t(gear + 1) < GEAR_RATIO_ESTIMATOR_GEAR_COUNT; gear++) {
+    const float rpm = CalculateUpshiftRPM(gear);
+    if (std::fabs(rpm - upshift_rpm[gear]) >= UPSHIFT_CHANGED_RPM) {
+      upshift_rpm[gear] = rpm;
+      changed = true;
+    }
+  }
+
+  if (std::fabs(max_rpm - reported_max_rpm) >= MAXIMUM_CHANGED_RPM) {
+    reported_max_rpm = max_rpm;
+    changed = true;
+  }
+
+  return changed;
+}
+
+}
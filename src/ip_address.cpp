@@ -1,7 +1,7 @@
-#include <iostream>
 #include <sstream>
 
 #include "ip_address.h"
+#include "log.h"
 
 namespace util {
 
@@ -48,13 +48,13 @@ bool ParseAddress(const std::string& text, cIPAddress& out_address)
   s >> a >> dot0 >> b >> dot1 >> c >> dot2 >> d;
 
   if ((a < 0) || (a > 255) || (b < 0) || (b > 255) || (c < 0) || (c > 255) || (d < 0) || (d > 255)) {
-    std::cout<<"Invalid octet"<<std::endl;
+    LOG_INFO<<"Invalid octet";
     return false;
   } else if ((dot0 != '.') || (dot1 != '.') || (dot2 != '.')) {
-    std::cout<<"Invalid dot"<<std::endl;
+    LOG_INFO<<"Invalid dot";
     return false;
   } else if (s.rdbuf()->in_avail() != 0) {
-    std::cout<<"More data in the stringstream"<<std::endl;
+    LOG_INFO<<"More data in the stringstream";
     // There is more after the IP address
     return false;
   }
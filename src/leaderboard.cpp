@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "leaderboard.h"
+
+namespace {
+
+// Returns true if a is ahead of b
+bool IsAhead(const acdisplay::cLeaderboardEntry& a, const acdisplay::cLeaderboardEntry& b)
+{
+  if (a.laps != b.laps) {
+    return (a.laps > b.laps);
+  }
+
+  return (a.total_ms < b.total_ms);
+}
+
+}
+
+namespace acdisplay {
+
+cLeaderboard::cLeaderboard() :
+  sequence(0),
+  order_sequence(0)
+{
+  Clear();
+}
+
+void cLeaderboard::Clear()
+{
+  entries.clear();
+
+  // Keep the sequences going so that senders still notice the change
+  sequence++;
+  order_sequence++;
+}
+
+bool cLeaderboard::AddLap(uint32_t car_identifier, uint32_t lap, const std::string& driver_name, const std::string& car_name, uint32_t lap_time_ms)
+{
+  auto iter = std::find_if(entries.begin(), entries.end(), [car_identifier](const cLeaderboardEntry& entry) { return (entry.car_identifier == car_identifier); });
+
+  if ((iter != entries.end()) && (lap < iter->laps)) {
+    // The lap count went backwards so a new session has started
+    Clear();
+    iter = entries.end();
+  }
+
+  bool order_changed = false;
+
+  if (iter == entries.end()) {
+    cLeaderboardEntry entry;
+    entry.car_identifier = car_identifier;
+    entry.laps = 0;
+    entry.last_lap_ms = 0;
+    entry.best_lap_ms = 0;
+    entry.total_ms = 0;
+    entry.changed_sequence = 0;
+    entries.push_back(entry);
+    iter = entries.end() - 1;
+    order_changed = true;
+  }
+
+  sequence++;
+
+  iter->driver_name = driver_name;
+  iter->car_name = car_name;
+  iter->laps = lap;
+  iter->last_lap_ms = lap_time_ms;
+  if ((lap_time_ms != 0) && ((iter->best_lap_ms == 0) || (lap_time_ms < iter->best_lap_ms))) {
+    iter->best_lap_ms = lap_time_ms;
+  }
+  iter->total_ms += lap_time_ms;
+  iter->changed_sequence = sequence;
+
+  // Completing a lap can only move this car up the order, so move it up until the car in front is still ahead
+  while ((iter != entries.begin()) && IsAhead(*iter, *(iter - 1))) {
+    std::iter_swap(iter, iter - 1);
+    iter--;
+    order_changed = true;
+  }
+
+  if (order_changed) {
+    order_sequence++;
+  }
+
+  return order_changed;
+}
+
+
+std::mutex mutex_leaderboard;
+cLeaderboard leaderboard;
+
+}
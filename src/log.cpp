@@ -0,0 +1,284 @@
+#include <cstdio>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "log.h"
+#include "util.h"
+
+namespace {
+
+std::atomic<util::LOG_LEVEL> runtime_level(util::LOG_LEVEL::LEVEL_INFO);
+
+void WriteMessage(util::LOG_LEVEL level, std::string_view text)
+{
+  // Warnings and errors go to stderr like they did with std::cerr
+  FILE* file = (level >= util::LOG_LEVEL::LEVEL_WARNING) ? stderr : stdout;
+  fwrite(text.data(), 1, text.length(), file);
+  fputc('\n', file);
+}
+
+// Drains the ring buffer on its own thread so that logging never waits for the terminal or a pipe
+class cLogWriter {
+public:
+  cLogWriter();
+  ~cLogWriter();
+
+  void Push(util::LOG_LEVEL level, std::string_view text);
+  void Flush();
+
+private:
+  void MainLoop();
+  bool WriteQueuedMessages();
+
+  util::cLogRingBuffer ring_buffer;
+  std::atomic<uint64_t> pushed;
+  std::atomic<uint64_t> written;
+  std::atomic<uint64_t> dropped;
+  std::atomic<bool> running;
+  std::thread thread;
+};
+
+// Anything logged from other static destructors after the writer has gone is written directly
+std::atomic<bool> log_writer_destroyed(false);
+
+cLogWriter::cLogWriter() :
+  pushed(0),
+  written(0),
+  dropped(0),
+  running(true)
+{
+  thread = std::thread(&cLogWriter::MainLoop, this);
+}
+
+cLogWriter::~cLogWriter()
+{
+  running.store(false);
+  thread.join();
+
+  log_writer_destroyed.store(true);
+}
+
+void cLogWriter::Push(util::LOG_LEVEL level, std::string_view text)
+{
+  if (ring_buffer.TryPush(level, text)) {
+    pushed.fetch_add(1, std::memory_order_release);
+  } else {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void cLogWriter::Flush()
+{
+  const uint64_t target = pushed.load(std::memory_order_acquire);
+  while (written.load(std::memory_order_acquire) < target) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool cLogWriter::WriteQueuedMessages()
+{
+  bool wrote_anything = false;
+
+  util::cLogMessage message;
+  while (ring_buffer.TryPop(message)) {
+    WriteMessage(message.level, std::string_view(message.text.data(), message.length));
+    written.fetch_add(1, std::memory_order_release);
+    wrote_anything = true;
+  }
+
+  const uint64_t dropped_count = dropped.exchange(0, std::memory_order_relaxed);
+  if (dropped_count != 0) {
+    fprintf(stderr, "Log buffer full, dropped %llu messages\n", static_cast<unsigned long long>(dropped_count));
+    wrote_anything = true;
+  }
+
+  if (wrote_anything) {
+    // Flush once per batch rather than once per line
+    fflush(stdout);
+    fflush(stderr);
+  }
+
+  return wrote_anything;
+}
+
+void cLogWriter::MainLoop()
+{
+  while (running.load()) {
+    if (!WriteQueuedMessages()) {
+      // Nothing to do, a short sleep costs the producers nothing, where waking us up on every message would cost them a system call
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+
+  // Write anything that was logged while we were stopping
+  WriteQueuedMessages();
+}
+
+cLogWriter& GetLogWriter()
+{
+  static cLogWriter writer;
+  return writer;
+}
+
+}
+
+namespace util {
+
+bool ParseLogLevel(std::string_view text, LOG_LEVEL& out_level)
+{
+  if (text == "debug") {
+    out_level = LOG_LEVEL::LEVEL_DEBUG;
+  } else if (text == "info") {
+    out_level = LOG_LEVEL::LEVEL_INFO;
+  } else if (text == "warning") {
+    out_level = LOG_LEVEL::LEVEL_WARNING;
+  } else if (text == "error") {
+    out_level = LOG_LEVEL::LEVEL_ERROR;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+void SetLogLevel(LOG_LEVEL level)
+{
+  runtime_level.store(level, std::memory_order_relaxed);
+}
+
+bool IsLogLevelEnabled(LOG_LEVEL level)
+{
+  return (level >= runtime_level.load(std::memory_order_relaxed));
+}
+
+void FlushLog()
+{
+  if (!log_writer_destroyed.load()) {
+    GetLogWriter().Flush();
+  }
+}
+
+
+cLogRingBuffer::cLogRingBuffer() :
+  write_position(0),
+  read_position(0)
+{
+  for (size_t i = 0; i < SIZE; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool cLogRingBuffer::TryPush(LOG_LEVEL level, std::string_view text)
+{
+  // Claim a slot
+  cSlot* slot = nullptr;
+  size_t position = write_position.load(std::memory_order_relaxed);
+  while (true) {
+    slot = &slots[position & (SIZE - 1)];
+    const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const intptr_t difference = intptr_t(sequence) - intptr_t(position);
+    if (difference == 0) {
+      // The slot is free, try to claim it
+      if (write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // The reader hasn't caught up yet, we are full
+      return false;
+    } else {
+      // Another producer claimed this slot, try the next one
+      position = write_position.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->message.level = level;
+  slot->message.length = uint16_t(std::min(text.length(), slot->message.text.size()));
+  std::copy_n(text.data(), slot->message.length, slot->message.text.data());
+
+  // Publish it to the reader
+  slot->sequence.store(position + 1, std::memory_order_release);
+
+  return true;
+}
+
+bool cLogRingBuffer::TryPop(cLogMessage& out_message)
+{
+  cSlot& slot = slots[read_position & (SIZE - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != (read_position + 1)) {
+    // Empty, or the producer is still writing it
+    return false;
+  }
+
+  out_message.level = slot.message.level;
+  out_message.length = slot.message.length;
+  std::copy_n(slot.message.text.data(), slot.message.length, out_message.text.data());
+
+  // Give the slot back to the producers for the next lap
+  slot.sequence.store(read_position + SIZE, std::memory_order_release);
+  read_position++;
+
+  return true;
+}
+
+
+cLogRateLimiter::cLogRateLimiter() :
+  window_start_ms(0),
+  count_in_window(0),
+  suppressed(0)
+{
+}
+
+bool cLogRateLimiter::Allow()
+{
+  return Allow(GetMonotonicTimeUS() / 1000);
+}
+
+bool cLogRateLimiter::Allow(uint64_t now_ms)
+{
+  // Start a new window every second
+  // NOTE: If two threads race here one of them wins and the counts are off by one or two, which is fine for rate limiting
+  uint64_t start_ms = window_start_ms.load(std::memory_order_relaxed);
+  if ((now_ms - start_ms) >= 1000) {
+    if (window_start_ms.compare_exchange_strong(start_ms, now_ms, std::memory_order_relaxed)) {
+      count_in_window.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  if (count_in_window.fetch_add(1, std::memory_order_relaxed) < LOG_RATE_LIMIT_PER_SECOND) {
+    return true;
+  }
+
+  suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+
+cLogLine::cLogLine(LOG_LEVEL _level, uint32_t suppressed) :
+  level(_level),
+  length(0)
+{
+  if (suppressed != 0) {
+    *this<<"("<<suppressed<<" similar messages suppressed) ";
+  }
+}
+
+cLogLine::~cLogLine()
+{
+  if (log_writer_destroyed.load(std::memory_order_relaxed)) {
+    WriteMessage(level, GetText());
+    return;
+  }
+
+  GetLogWriter().Push(level, GetText());
+}
+
+void cLogLine::Append(std::string_view value)
+{
+  const size_t count = std::min(value.length(), text.size() - length);
+  std::copy_n(value.data(), count, text.data() + length);
+  length += count;
+}
+
+}
@@ -0,0 +1,270 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "low_latency.h"
+
+namespace {
+
+// The ACUDP thread only uses a small part of its stack, so we lock that rather than the whole stack
+const size_t ACUDP_THREAD_LOCKED_STACK_BYTES = 256 * 1024;
+
+// Set once at startup before any of the threads that use it are started
+application::cLowLatencySettings low_latency_settings;
+
+const char* GetThreadName(acdisplay::LOW_LATENCY_THREAD thread)
+{
+  return (thread == acdisplay::LOW_LATENCY_THREAD::ACUDP) ? "ACUDP" : "websocket";
+}
+
+std::string ToString(const std::vector<int>& cpus)
+{
+  std::string result;
+  for (auto&& cpu : cpus) {
+    if (!result.empty()) {
+      result += ",";
+    }
+    result += std::to_string(cpu);
+  }
+
+  return result;
+}
+
+}
+
+namespace util {
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus, std::string& out_error)
+{
+  out_error.clear();
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (auto&& cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+
+  const int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (result != 0) {
+    out_error = strerror(result);
+    return false;
+  }
+
+  return true;
+}
+
+bool SetCurrentThreadRealtimePriority(int priority, std::string& out_error)
+{
+  out_error.clear();
+
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+
+  // NOTE: This needs CAP_SYS_NICE or an RLIMIT_RTPRIO limit that allows it
+  const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (result != 0) {
+    out_error = strerror(result);
+    return false;
+  }
+
+  return true;
+}
+
+bool LockMemory(size_t prefault_bytes, std::string& out_error)
+{
+  out_error.clear();
+
+  if (prefault_bytes != 0) {
+    // Serve every thread from the main arena, keep freed memory in the heap instead of giving it back to the system, and serve every allocation from the heap, so the pages we touch here are the ones reused later
+    mallopt(M_ARENA_MAX, 1);
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    char* buffer = static_cast<char*>(malloc(prefault_bytes));
+    if (buffer == nullptr) {
+      out_error = "Error allocating the heap";
+      return false;
+    }
+
+    // Touch each page so that it is faulted in now rather than on the hot path
+    const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    for (size_t i = 0; i < prefault_bytes; i += page_size) {
+      static_cast<volatile char*>(buffer)[i] = 0;
+    }
+
+    free(buffer);
+  }
+
+  // Only lock what we have now, MCL_FUTURE would also lock the whole stack of every websocket thread we start later
+  // NOTE: This needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+  if (mlockall(MCL_CURRENT) != 0) {
+    out_error = strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+bool LockCurrentThreadStack(size_t bytes, std::string& out_error)
+{
+  out_error.clear();
+
+  pthread_attr_t attr;
+  int result = pthread_getattr_np(pthread_self(), &attr);
+  if (result != 0) {
+    out_error = strerror(result);
+    return false;
+  }
+
+  void* stack_address = nullptr;
+  size_t stack_size = 0;
+  result = pthread_attr_getstack(&attr, &stack_address, &stack_size);
+  pthread_attr_destroy(&attr);
+  if (result != 0) {
+    out_error = strerror(result);
+    return false;
+  }
+
+  // The stack grows down, so lock the top of it
+  bytes = std::min(bytes, stack_size);
+  char* stack_top = static_cast<char*>(stack_address) + stack_size;
+  if (mlock(stack_top - bytes, bytes) != 0) {
+    out_error = strerror(errno);
+    return false;
+  }
+
+  return true;
+}
+
+size_t SetBusyPollOnUDPSockets(int microseconds, std::string& out_error)
+{
+  out_error.clear();
+
+  size_t count = 0;
+
+  std::error_code error;
+  for (auto&& entry : std::filesystem::directory_iterator("/proc/self/fd", error)) {
+    const int fd = atoi(entry.path().filename().c_str());
+
+    struct stat s;
+    if ((fstat(fd, &s) != 0) || !S_ISSOCK(s.st_mode)) {
+      continue;
+    }
+
+    int type = 0;
+    int domain = 0;
+    socklen_t length = sizeof(type);
+    if ((getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) != 0) || (type != SOCK_DGRAM)) {
+      continue;
+    }
+
+    length = sizeof(domain);
+    if ((getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &length) != 0) || ((domain != AF_INET) && (domain != AF_INET6))) {
+      continue;
+    }
+
+    // NOTE: Values above net.core.busy_read need CAP_NET_ADMIN
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &microseconds, sizeof(microseconds)) != 0) {
+      out_error = strerror(errno);
+      continue;
+    }
+
+    count++;
+  }
+
+  if (error) {
+    out_error = error.message();
+  }
+
+  return count;
+}
+
+}
+
+namespace acdisplay {
+
+void ApplyLowLatencyProcessSettings(const application::cLowLatencySettings& settings)
+{
+  low_latency_settings = settings;
+
+  if (!settings.IsEnabled()) {
+    return;
+  }
+
+  LOG_INFO<<"Low latency: ACUDP cores ["<<ToString(settings.acudp_cpus)<<"], websocket cores ["<<ToString(settings.websocket_cpus)<<"], real time priority "<<settings.realtime_priority;
+
+  if (settings.lock_memory) {
+    std::string error;
+    if (util::LockMemory(size_t(settings.prefault_heap_mb) * 1024 * 1024, error)) {
+      LOG_INFO<<"Low latency: Memory locked, "<<settings.prefault_heap_mb<<" MB of heap pre-faulted";
+    } else {
+      LOG_WARNING<<"Low latency: Error locking memory "<<error;
+    }
+  }
+}
+
+void ApplyLowLatencyThreadSettings(LOW_LATENCY_THREAD thread)
+{
+  const std::vector<int>& cpus = (thread == LOW_LATENCY_THREAD::ACUDP) ? low_latency_settings.acudp_cpus : low_latency_settings.websocket_cpus;
+  if (!cpus.empty()) {
+    std::string error;
+    if (util::SetCurrentThreadAffinity(cpus, error)) {
+      LOG_INFO<<"Low latency: "<<GetThreadName(thread)<<" thread pinned to cores ["<<ToString(cpus)<<"]";
+    } else {
+      LOG_WARNING<<"Low latency: Error pinning "<<GetThreadName(thread)<<" thread to cores ["<<ToString(cpus)<<"] "<<error;
+    }
+  }
+
+  // Only the ACUDP thread gets real time priority and a locked stack, there is a websocket sender thread per client and a busy client shouldn't be able to starve the rest of the machine
+  if (thread != LOW_LATENCY_THREAD::ACUDP) {
+    return;
+  }
+
+  if (low_latency_settings.lock_memory) {
+    std::string error;
+    if (util::LockCurrentThreadStack(ACUDP_THREAD_LOCKED_STACK_BYTES, error)) {
+      LOG_INFO<<"Low latency: "<<GetThreadName(thread)<<" thread stack locked";
+    } else {
+      LOG_WARNING<<"Low latency: Error locking the "<<GetThreadName(thread)<<" thread stack "<<error;
+    }
+  }
+
+  if (low_latency_settings.realtime_priority != 0) {
+    std::string error;
+    if (util::SetCurrentThreadRealtimePriority(low_latency_settings.realtime_priority, error)) {
+      LOG_INFO<<"Low latency: "<<GetThreadName(thread)<<" thread using SCHED_FIFO priority "<<low_latency_settings.realtime_priority;
+    } else {
+      LOG_WARNING<<"Low latency: Error setting SCHED_FIFO priority for "<<GetThreadName(thread)<<" thread "<<error;
+    }
+  }
+}
+
+void ApplyLowLatencySocketSettings()
+{
+  if (low_latency_settings.busy_poll_us == 0) {
+    return;
+  }
+
+  std::string error;
+  const size_t count = util::SetBusyPollOnUDPSockets(int(low_latency_settings.busy_poll_us), error);
+  if (error.empty()) {
+    LOG_INFO<<"Low latency: SO_BUSY_POLL "<<low_latency_settings.busy_poll_us<<" us set on "<<count<<" UDP sockets";
+  } else {
+    LOG_ERROR<<"Low latency: SO_BUSY_POLL set on "<<count<<" UDP sockets, error "<<error;
+  }
+}
+
+}
@@ -4,6 +4,7 @@
 
 #include "ac_data.h"
 #include "ac_display.h"
+#include "log.h"
 #include "settings.h"
 #include "version.h"
 
@@ -44,7 +45,8 @@ int main(int argc, char* argv[])
 
   // Parse the configuration file
   application::cSettings settings;
-  if (!settings.LoadFromFile("./configuration.json")) {
+  const std::string settings_file_path = "./configuration.json";
+  if (!settings.LoadFromFile(settings_file_path)) {
     std::cerr<<"Error parsing configuration.json"<<std::endl;
     return EXIT_FAILURE;
   }
@@ -53,15 +55,19 @@ int main(int argc, char* argv[])
   {
     // Update the car configuration
     // NOTE: Assetto Corsa doesn't provide any of these values so we have to make them up, I think AC expects you to be on the same machine and look it up in that car's config file?
-    // TODO: It might be nicer to put this in a car config file? Or allow the user to set it on the web page itself?
-    std::lock_guard<std::mutex> lock(mutex_ac_data);
+    // NOTE: These are only the starting values, they are replaced by the car database (See car_database.json.example) when the handshake tells us which car is being driven, or the rpm values are estimated from the live data (See config_automatic)
+    std::lock_guard lock(mutex_ac_data);
     ac_data.config_rpm_red_line = 6000.0f;
     ac_data.config_rpm_maximum = 7500.0f;
     ac_data.config_speedometer_red_line_kph = 250.0f;
     ac_data.config_speedometer_maximum_kph = 300.0f;
+    ac_data.config_shift_lights.SetDefaultsForRedLine(ac_data.config_rpm_red_line);
   }
 
-  const bool result = acdisplay::RunServer(settings);
+  const bool result = acdisplay::RunServer(settings_file_path, settings);
+
+  // Make sure everything that was logged gets written before we exit
+  util::FlushLog();
 
   return (result ? EXIT_SUCCESS : EXIT_FAILURE);
 }
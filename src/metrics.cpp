@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "metrics.h"
+
+namespace {
+
+void AppendHeader(std::string& out, const std::string& name, const std::string& help, const char* type)
+{
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " " + type + "\n";
+}
+
+void AppendCounter(std::string& out, const std::string& name, const std::string& help, const acdisplay::cCounter& counter)
+{
+  AppendHeader(out, name, help, "counter");
+  out += name + " " + std::to_string(counter.Get()) + "\n";
+}
+
+// Prometheus expects seconds, we store microseconds so that the hot path only does integer adds
+std::string MicrosecondsToSeconds(uint64_t duration_us)
+{
+  std::string result = std::to_string(duration_us / 1000000) + ".";
+  const std::string fraction = std::to_string(duration_us % 1000000);
+  result.append(6 - fraction.length(), '0');
+  result += fraction;
+  return result;
+}
+
+}
+
+namespace acdisplay {
+
+cLatencyHistogram::cLatencyHistogram() :
+  sum_us(0),
+  count(0)
+{
+  for (auto&& bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void cLatencyHistogram::Observe(uint64_t duration_us)
+{
+  // Find the first bucket that this fits in, anything longer goes in the last bucket
+  const size_t bucket = std::lower_bound(LATENCY_HISTOGRAM_BUCKETS_US.begin(), LATENCY_HISTOGRAM_BUCKETS_US.end(), duration_us) - LATENCY_HISTOGRAM_BUCKETS_US.begin();
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  sum_us.fetch_add(duration_us, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cLatencyHistogram::ToPrometheus(std::string& out, const std::string& name, const std::string& help) const
+{
+  AppendHeader(out, name, help, "histogram");
+
+  // Prometheus buckets are cumulative
+  // NOTE: The values are read one at a time without a lock so a scrape can be very slightly inconsistent, which Prometheus copes with
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS_US.size(); i++) {
+    cumulative += GetBucketCount(i);
+    out += name + "_bucket{le=\"" + MicrosecondsToSeconds(LATENCY_HISTOGRAM_BUCKETS_US[i]) + "\"} " + std::to_string(cumulative) + "\n";
+  }
+
+  cumulative += GetBucketCount(LATENCY_HISTOGRAM_BUCKETS_US.size());
+  out += name + "_bucket{le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+  out += name + "_sum " + MicrosecondsToSeconds(sum_us.load(std::memory_order_relaxed)) + "\n";
+  out += name + "_count " + std::to_string(cumulative) + "\n";
+}
+
+
+void cLockMetrics::ToPrometheus(std::string& out, const std::string& name) const
+{
+  const std::string prefix = "acdisplay_lock_" + name;
+  AppendCounter(out, prefix + "_acquisitions_total", "Times " + name + " was locked", acquisitions);
+  AppendCounter(out, prefix + "_contended_total", "Times " + name + " was already locked by another thread", contended);
+  wait_time.ToPrometheus(out, prefix + "_wait_seconds", "Time spent waiting for " + name + " when it was contended");
+  hold_time.ToPrometheus(out, prefix + "_hold_seconds", "Time " + name + " was held for");
+}
+
+
+void cMetrics::ToPrometheus(std::string& out) const
+{
+  AppendCounter(out, "acdisplay_acudp_packets_received_total", "Car update packets received from Assetto Corsa", acudp_packets_received);
+  AppendCounter(out, "acdisplay_acudp_lap_events_received_total", "Lap events received from Assetto Corsa", acudp_lap_events_received);
+  AppendCounter(out, "acdisplay_samples_published_total", "Car updates published for the websocket senders", samples_published);
+  acudp_processing_latency.ToPrometheus(out, "acdisplay_acudp_processing_seconds", "Time from receiving a car update to publishing it");
+
+  AppendPrometheusGauge(out, "acdisplay_websocket_clients", "Connected websocket clients", websocket_clients.Get());
+  AppendCounter(out, "acdisplay_websocket_clients_connected_total", "Websocket clients that have connected", websocket_clients_connected);
+  AppendCounter(out, "acdisplay_websocket_evictions_total", "Websocket clients disconnected because of a protocol error", websocket_evictions);
+  AppendCounter(out, "acdisplay_websocket_frames_encoded_total", "Websocket frames encoded", websocket_frames_encoded);
+  AppendCounter(out, "acdisplay_websocket_bytes_sent_total", "Bytes sent to websocket clients", websocket_bytes_sent);
+  AppendCounter(out, "acdisplay_websocket_send_errors_total", "Websocket frames that could not be sent", websocket_send_errors);
+  websocket_send_latency.ToPrometheus(out, "acdisplay_websocket_send_seconds", "Time to encode and send a websocket frame");
+  sample_age_at_send.ToPrometheus(out, "acdisplay_sample_age_at_send_seconds", "Time from publishing a car update to sending it to a client");
+  AppendCounter(out, "acdisplay_batch_samples_sent_total", "Car updates sent to batch clients", batch_samples_sent);
+  AppendCounter(out, "acdisplay_batch_samples_skipped_total", "Car updates that batch clients fell too far behind to be sent", batch_samples_skipped);
+
+  lock_ac_data.ToPrometheus(out, "ac_data");
+  lock_wake_up.ToPrometheus(out, "wake_up");
+  lock_send.ToPrometheus(out, "send");
+  lock_telemetry_history.ToPrometheus(out, "telemetry_history");
+}
+
+void AppendPrometheusGauge(std::string& out, const std::string& name, const std::string& help, int64_t value)
+{
+  AppendHeader(out, name, help, "gauge");
+  out += name + " " + std::to_string(value) + "\n";
+}
+
+cMetrics metrics;
+
+}
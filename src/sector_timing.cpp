@@ -0,0 +1,149 @@
+#include <cmath>
+
+#include "sector_timing.h"
+
+namespace {
+
+// If the car moves further than this between two samples then it has been teleported (Back to the pits, restarted, etc.)
+const float MAX_POSITION_DELTA = 0.1f;
+
+}
+
+namespace acdisplay {
+
+cSectorTimes::cSectorTimes()
+{
+  Clear();
+}
+
+void cSectorTimes::Clear()
+{
+  current_sector = 0;
+  current_sector_ms = 0;
+  last_ms.fill(0);
+  best_ms.fill(0);
+  theoretical_best_lap_ms = 0;
+  last_completed_sector = 0;
+  sequence = 0;
+}
+
+
+cSectorTiming::cSectorTiming()
+{
+  for (size_t i = 0; i < SECTOR_COUNT; i++) {
+    sector_start_positions[i] = float(i) / float(SECTOR_COUNT);
+  }
+
+  Reset();
+}
+
+void cSectorTiming::Reset()
+{
+  clock.Reset();
+  ResetTimes();
+}
+
+void cSectorTiming::ResetTimes()
+{
+  has_previous = false;
+  previous_position = 0.0f;
+  previous_clock_ms = 0.0;
+
+  sector_start_valid = false;
+  sector_start_clock_ms = 0.0;
+
+  // Keep the sequence going so that senders still notice the change
+  const uint32_t sequence = times.sequence;
+  times.Clear();
+  times.sequence = sequence + 1;
+}
+
+bool cSectorTiming::Update(float position_normalized, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count)
+{
+  if (clock.Update(lap_time_ms, last_lap_ms, lap_count)) {
+    // The session was restarted
+    ResetTimes();
+  }
+
+  const double clock_ms = double(clock.GetTimeMS());
+
+  // Unwrap the position so that crossing the line looks like a continuous movement from just under 1 to just over 1
+  float position = position_normalized;
+  if (has_previous && (position < (previous_position - 0.5f))) {
+    position += 1.0f;
+  }
+
+  bool completed = false;
+
+  if (!has_previous) {
+    // Work out which sector we are starting in, but we don't have a valid start time for it
+    times.current_sector = 0;
+    for (size_t i = 0; i < SECTOR_COUNT; i++) {
+      if (position >= sector_start_positions[i]) {
+        times.current_sector = uint8_t(i);
+      }
+    }
+  } else if (std::fabs(position - previous_position) > MAX_POSITION_DELTA) {
+    // The car has been teleported, the current sector time is no longer valid
+    sector_start_valid = false;
+    for (size_t i = 0; i < SECTOR_COUNT; i++) {
+      if (position_normalized >= sector_start_positions[i]) {
+        times.current_sector = uint8_t(i);
+      }
+    }
+  } else if (position > previous_position) {
+    // Check each sector start for this lap and the next one, in order of position
+    for (size_t k = 0; k < (2 * SECTOR_COUNT); k++) {
+      const size_t sector = k % SECTOR_COUNT;
+      const float boundary = sector_start_positions[sector] + float(k / SECTOR_COUNT);
+      if ((boundary <= previous_position) || (boundary > position)) {
+        continue;
+      }
+
+      // Interpolate the exact time that we crossed the boundary
+      const double fraction = double(boundary - previous_position) / double(position - previous_position);
+      const double crossing_clock_ms = previous_clock_ms + (fraction * (clock_ms - previous_clock_ms));
+
+      const size_t completed_sector = (sector + SECTOR_COUNT - 1) % SECTOR_COUNT;
+      if (sector_start_valid && (times.current_sector == completed_sector)) {
+        const uint32_t sector_ms = uint32_t(std::lround(crossing_clock_ms - sector_start_clock_ms));
+        times.last_ms[completed_sector] = sector_ms;
+        if ((times.best_ms[completed_sector] == 0) || (sector_ms < times.best_ms[completed_sector])) {
+          times.best_ms[completed_sector] = sector_ms;
+        }
+
+        times.last_completed_sector = uint8_t(completed_sector);
+        times.sequence++;
+        completed = true;
+      }
+
+      times.current_sector = uint8_t(sector);
+      sector_start_valid = true;
+      sector_start_clock_ms = crossing_clock_ms;
+    }
+  }
+
+  if (completed) {
+    uint32_t total_ms = 0;
+    for (size_t i = 0; i < SECTOR_COUNT; i++) {
+      if (times.best_ms[i] == 0) {
+        total_ms = 0;
+        break;
+      }
+
+      total_ms += times.best_ms[i];
+    }
+
+    times.theoretical_best_lap_ms = total_ms;
+  }
+
+  times.current_sector_ms = sector_start_valid ? uint32_t(std::lround(clock_ms - sector_start_clock_ms)) : 0;
+
+  has_previous = true;
+  previous_position = (position >= 1.0f) ? (position - 1.0f) : position;
+  previous_clock_ms = clock_ms;
+
+  return completed;
+}
+
+}
@@ -0,0 +1,158 @@
+#include <cmath>
+
+#include <algorithm>
+#include <sstream>
+
+#include "session_statistics.h"
+
+namespace {
+
+const float FULL_THROTTLE_THRESHOLD = 0.98f;
+const float BRAKING_THRESHOLD = 0.05f;
+
+template <class T, size_t N>
+void WriteJSONArray(std::ostringstream& o, const std::array<T, N>& values)
+{
+  o<<"[";
+  for (size_t i = 0; i < N; i++) {
+    if (i != 0) {
+      o<<",";
+    }
+    o<<values[i];
+  }
+  o<<"]";
+}
+
+}
+
+namespace acdisplay {
+
+cRunningMoments::cRunningMoments()
+{
+  Clear();
+}
+
+void cRunningMoments::Clear()
+{
+  count = 0;
+  mean = 0.0;
+  m2 = 0.0;
+  minimum = 0.0;
+  maximum = 0.0;
+}
+
+void cRunningMoments::Add(double value)
+{
+  count++;
+
+  const double delta = value - mean;
+  mean += delta / double(count);
+  m2 += delta * (value - mean);
+
+  if ((count == 1) || (value < minimum)) {
+    minimum = value;
+  }
+  if ((count == 1) || (value > maximum)) {
+    maximum = value;
+  }
+}
+
+double cRunningMoments::GetVariance() const
+{
+  // Sample variance, we need at least two values
+  return (count >= 2) ? (m2 / double(count - 1)) : 0.0;
+}
+
+double cRunningMoments::GetStandardDeviation() const
+{
+  return std::sqrt(GetVariance());
+}
+
+
+cSessionStatistics::cSessionStatistics()
+{
+  Clear();
+}
+
+void cSessionStatistics::Clear()
+{
+  max_speed_kmh = 0.0f;
+  total_ms = 0;
+  gear_ms.fill(0);
+  rpm_histogram_ms.fill(0);
+  full_throttle_ms = 0;
+  braking_ms = 0;
+  lap_times_ms.Clear();
+}
+
+void cSessionStatistics::Update(float speed_kmh, uint8_t gear, float rpm, float accelerator_0_to_1, float brake_0_to_1, uint32_t lap_time_ms, uint32_t last_lap_ms, uint32_t lap_count)
+{
+  if (clock.Update(lap_time_ms, last_lap_ms, lap_count)) {
+    // The session was restarted
+    Clear();
+  }
+
+  // Weight each sample by the game time since the previous sample, this way pausing the game doesn't count
+  const uint32_t delta_ms = clock.GetDeltaMS();
+
+  if (clock.IsNewLap() && (last_lap_ms != 0)) {
+    // A lap was completed
+    lap_times_ms.Add(double(last_lap_ms));
+  }
+
+  if (speed_kmh > max_speed_kmh) {
+    max_speed_kmh = speed_kmh;
+  }
+
+  total_ms += delta_ms;
+
+  if (gear < SESSION_STATISTICS_GEAR_COUNT) {
+    gear_ms[gear] += delta_ms;
+  }
+
+  const size_t bucket = (rpm <= 0.0f) ? 0 : std::min<size_t>(size_t(rpm / SESSION_STATISTICS_RPM_BUCKET_WIDTH), SESSION_STATISTICS_RPM_BUCKET_COUNT - 1);
+  rpm_histogram_ms[bucket] += delta_ms;
+
+  if (accelerator_0_to_1 >= FULL_THROTTLE_THRESHOLD) {
+    full_throttle_ms += delta_ms;
+  }
+
+  if (brake_0_to_1 >= BRAKING_THRESHOLD) {
+    braking_ms += delta_ms;
+  }
+}
+
+std::string cSessionStatistics::ToJSON() const
+{
+  const double total = (total_ms != 0) ? double(total_ms) : 1.0;
+
+  std::ostringstream o;
+  o<<"{";
+  o<<"\"max_speed_kmh\":"<<max_speed_kmh<<",";
+  o<<"\"total_ms\":"<<total_ms<<",";
+  o<<"\"gear_ms\":";
+  WriteJSONArray(o, gear_ms);
+  o<<",";
+  o<<"\"rpm_bucket_width\":"<<SESSION_STATISTICS_RPM_BUCKET_WIDTH<<",";
+  o<<"\"rpm_histogram_ms\":";
+  WriteJSONArray(o, rpm_histogram_ms);
+  o<<",";
+  o<<"\"full_throttle_ms\":"<<full_throttle_ms<<",";
+  o<<"\"full_throttle_percentage\":"<<(100.0 * double(full_throttle_ms) / total)<<",";
+  o<<"\"braking_ms\":"<<braking_ms<<",";
+  o<<"\"braking_percentage\":"<<(100.0 * double(braking_ms) / total)<<",";
+  o<<"\"laps\":"<<lap_times_ms.GetCount()<<",";
+  o<<"\"lap_time_mean_ms\":"<<lap_times_ms.GetMean()<<",";
+  o<<"\"lap_time_standard_deviation_ms\":"<<lap_times_ms.GetStandardDeviation()<<",";
+  o<<"\"lap_time_minimum_ms\":"<<lap_times_ms.GetMinimum()<<",";
+  o<<"\"lap_time_maximum_ms\":"<<lap_times_ms.GetMaximum();
+  o<<"}";
+
+  return o.str();
+}
+
+
+std::mutex mutex_session_statistics;
+cSessionStatistics session_statistics;
+
+}
@@ -2,10 +2,10 @@
 #include <cstring>
 
 #include <limits>
-#include <iostream>
 #include <filesystem>
 
 #include <pwd.h>
+#include <sched.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -14,30 +14,43 @@
 #include <json-c/json.h>
 
 #include "json.h"
+#include "log.h"
 #include "settings.h"
+#include "telemetry_history.h"
 #include "util.h"
 
 namespace {
 
+const uint16_t DEFAULT_UPDATE_INTERVAL_MS = 20;
+const uint16_t MIN_UPDATE_INTERVAL_MS = 5;
+const uint16_t MAX_UPDATE_INTERVAL_MS = 1000;
+
+// A batch has every sample since the last one, so the interval only decides how many frames they are spread over
+const uint16_t DEFAULT_BATCH_INTERVAL_MS = 100;
+
+const int MAX_REALTIME_PRIORITY = 99;
+const uint32_t MAX_PREFAULT_HEAP_MB = 1024;
+const uint32_t MAX_BUSY_POLL_US = 1000;
+
 bool JSONParseString(struct json_object* json, const std::string& name, std::string& out_value)
 {
   out_value.clear();
 
   struct json_object* obj = json_object_object_get(json, name.c_str());
   if (obj == nullptr) {
-    std::cerr<<name<<" not found"<<std::endl;
+    LOG_ERROR<<name<<" not found";
     return false;
   }
 
   enum json_type type = json_object_get_type(obj);
   if (type != json_type_string) {
-    std::cerr<<name<<" is not a string"<<std::endl;
+    LOG_ERROR<<name<<" is not a string";
     return false;
   }
 
   const char* value = json_object_get_string(obj);
   if (value == nullptr) {
-    std::cerr<<name<<" is not valid"<<std::endl;
+    LOG_ERROR<<name<<" is not valid";
     return false;
   }
 
@@ -52,13 +65,13 @@ bool JSONParseBool(struct json_object* json, const std::string& name, bool& out_
 
   struct json_object* obj = json_object_object_get(json, name.c_str());
   if (obj == nullptr) {
-    std::cerr<<name<<" not found"<<std::endl;
+    LOG_ERROR<<name<<" not found";
     return false;
   }
 
   enum json_type type = json_object_get_type(obj);
   if (type != json_type_boolean) {
-    std::cerr<<name<<" is not a bool"<<std::endl;
+    LOG_ERROR<<name<<" is not a bool";
     return false;
   }
 
@@ -73,19 +86,19 @@ bool JSONParseUint16(struct json_object* json, const std::string& name, uint16_t
 
   struct json_object* obj = json_object_object_get(json, name.c_str());
   if (obj == nullptr) {
-    std::cerr<<name<<" not found"<<std::endl;
+    LOG_ERROR<<name<<" not found";
     return false;
   }
 
   enum json_type type = json_object_get_type(obj);
   if (type != json_type_int) {
-    std::cerr<<name<<" is not an int"<<std::endl;
+    LOG_ERROR<<name<<" is not an int";
     return false;
   }
 
   const int value = json_object_get_int(obj);
   if ((value <= 0) || (value > USHRT_MAX)) {
-    std::cerr<<name<<" is not valid"<<std::endl;
+    LOG_ERROR<<name<<" is not valid";
     return false;
   }
 
@@ -93,14 +106,144 @@ bool JSONParseUint16(struct json_object* json, const std::string& name, uint16_t
   return true;
 }
 
+bool JSONParseUint32(struct json_object* json, const std::string& name, uint32_t max_value, uint32_t& out_value)
+{
+  out_value = 0;
+
+  struct json_object* obj = json_object_object_get(json, name.c_str());
+  if (obj == nullptr) {
+    LOG_ERROR<<name<<" not found";
+    return false;
+  }
+
+  enum json_type type = json_object_get_type(obj);
+  if (type != json_type_int) {
+    LOG_ERROR<<name<<" is not an int";
+    return false;
+  }
+
+  const int64_t value = json_object_get_int64(obj);
+  if ((value < 0) || (value > int64_t(max_value))) {
+    LOG_ERROR<<name<<" must be between 0 and "<<max_value;
+    return false;
+  }
+
+  out_value = uint32_t(value);
+  return true;
+}
+
+bool JSONParseCPUList(struct json_object* json, const std::string& name, std::vector<int>& out_values)
+{
+  out_values.clear();
+
+  struct json_object* obj = json_object_object_get(json, name.c_str());
+  if (obj == nullptr) {
+    LOG_ERROR<<name<<" not found";
+    return false;
+  }
+
+  if (json_object_get_type(obj) != json_type_array) {
+    LOG_ERROR<<name<<" is not an array";
+    return false;
+  }
+
+  const size_t length = json_object_array_length(obj);
+  for (size_t i = 0; i < length; i++) {
+    struct json_object* item = json_object_array_get_idx(obj, i);
+    if ((item == nullptr) || (json_object_get_type(item) != json_type_int)) {
+      LOG_ERROR<<name<<" must only contain core numbers";
+      return false;
+    }
+
+    const int value = json_object_get_int(item);
+    if ((value < 0) || (value >= CPU_SETSIZE)) {
+      LOG_ERROR<<name<<" contains an invalid core "<<value;
+      return false;
+    }
+
+    out_values.push_back(value);
+  }
+
+  return true;
+}
+
+bool ParseLowLatencySettings(struct json_object* json, application::cLowLatencySettings& out_low_latency)
+{
+  out_low_latency.Clear();
+
+  if (json_object_get_type(json) != json_type_object) {
+    LOG_ERROR<<"low_latency is not an object";
+    return false;
+  }
+
+  // Every field is optional
+  if ((json_object_object_get(json, "acudp_cpus") != nullptr) && !JSONParseCPUList(json, "acudp_cpus", out_low_latency.acudp_cpus)) {
+    return false;
+  }
+
+  if ((json_object_object_get(json, "websocket_cpus") != nullptr) && !JSONParseCPUList(json, "websocket_cpus", out_low_latency.websocket_cpus)) {
+    return false;
+  }
+
+  if (json_object_object_get(json, "realtime_priority") != nullptr) {
+    uint32_t value = 0;
+    if (!JSONParseUint32(json, "realtime_priority", MAX_REALTIME_PRIORITY, value)) {
+      return false;
+    }
+
+    out_low_latency.realtime_priority = int(value);
+  }
+
+  if ((json_object_object_get(json, "lock_memory") != nullptr) && !JSONParseBool(json, "lock_memory", out_low_latency.lock_memory)) {
+    return false;
+  }
+
+  if ((json_object_object_get(json, "prefault_heap_mb") != nullptr) && !JSONParseUint32(json, "prefault_heap_mb", MAX_PREFAULT_HEAP_MB, out_low_latency.prefault_heap_mb)) {
+    return false;
+  }
+
+  if ((json_object_object_get(json, "busy_poll_us") != nullptr) && !JSONParseUint32(json, "busy_poll_us", MAX_BUSY_POLL_US, out_low_latency.busy_poll_us)) {
+    return false;
+  }
+
+  return true;
+}
+
 }
 
 namespace application {
 
+cLowLatencySettings::cLowLatencySettings() :
+  realtime_priority(0),
+  lock_memory(false),
+  prefault_heap_mb(0),
+  busy_poll_us(0)
+{
+}
+
+bool cLowLatencySettings::IsEnabled() const
+{
+  return (!acudp_cpus.empty() || !websocket_cpus.empty() || (realtime_priority != 0) || lock_memory || (busy_poll_us != 0));
+}
+
+void cLowLatencySettings::Clear()
+{
+  acudp_cpus.clear();
+  websocket_cpus.clear();
+  realtime_priority = 0;
+  lock_memory = false;
+  prefault_heap_mb = 0;
+  busy_poll_us = 0;
+}
+
+
 cSettings::cSettings() :
   running_in_container(false),
   acudp_port(0),
-  https_port(0)
+  https_port(0),
+  update_interval_ms(DEFAULT_UPDATE_INTERVAL_MS),
+  batch_interval_ms(DEFAULT_BATCH_INTERVAL_MS),
+  log_level(util::LOG_LEVEL::LEVEL_INFO)
 {
 }
 
@@ -111,13 +254,13 @@ bool cSettings::LoadFromFile(const std::string& sFilePath)
   const size_t nMaxFileSizeBytes = 20 * 1024;
   std::string contents;
   if (!util::ReadFileIntoString(sFilePath, nMaxFileSizeBytes, contents)) {
-    std::cerr<<"File \""<<sFilePath<<"\" not found"<<std::endl;
+    LOG_ERROR<<"File \""<<sFilePath<<"\" not found";
     return false;
   }
 
   util::cJSONDocument document(json_tokener_parse(contents.c_str()));
   if (!document.IsValid()) {
-    std::cerr<<"Invalid JSON config \""<<sFilePath<<"\""<<std::endl;
+    LOG_ERROR<<"Invalid JSON config \""<<sFilePath<<"\"";
     return false;
   }
 
@@ -127,7 +270,7 @@ bool cSettings::LoadFromFile(const std::string& sFilePath)
   json_object_object_foreach(document.Get(), settings_key, settings_val) {
     enum json_type type_settings = json_object_get_type(settings_val);
     if ((type_settings != json_type_object) || (strcmp(settings_key, "settings") != 0)) {
-      std::cerr<<"settings object not found"<<std::endl;
+      LOG_ERROR<<"settings object not found";
       return false;
     }
 
@@ -187,6 +330,46 @@ bool cSettings::LoadFromFile(const std::string& sFilePath)
     if (!JSONParseString(settings_val, "https_public_cert", https_public_cert)) {
       return false;
     }
+
+    // Parse the update interval (Optional)
+    if (json_object_object_get(settings_val, "update_interval_ms") != nullptr) {
+      uint16_t value = 0;
+      if (!JSONParseUint16(settings_val, "update_interval_ms", value) || (value < MIN_UPDATE_INTERVAL_MS) || (value > MAX_UPDATE_INTERVAL_MS)) {
+        LOG_ERROR<<"update_interval_ms must be between "<<MIN_UPDATE_INTERVAL_MS<<" and "<<MAX_UPDATE_INTERVAL_MS;
+        return false;
+      }
+
+      update_interval_ms = value;
+    }
+
+    // Parse the batch interval (Optional)
+    if (json_object_object_get(settings_val, "batch_interval_ms") != nullptr) {
+      uint16_t value = 0;
+      // Longer intervals would need more samples than the history keeps
+      if (!JSONParseUint16(settings_val, "batch_interval_ms", value) || (value < MIN_UPDATE_INTERVAL_MS) || (value > acdisplay::TELEMETRY_HISTORY_MAX_BATCH_INTERVAL_MS)) {
+        LOG_ERROR<<"batch_interval_ms must be between "<<MIN_UPDATE_INTERVAL_MS<<" and "<<acdisplay::TELEMETRY_HISTORY_MAX_BATCH_INTERVAL_MS;
+        return false;
+      }
+
+      batch_interval_ms = value;
+    }
+
+    // Parse the log level (Optional)
+    if (json_object_object_get(settings_val, "log_level") != nullptr) {
+      std::string value;
+      if (!JSONParseString(settings_val, "log_level", value) || !util::ParseLogLevel(value, log_level)) {
+        LOG_ERROR<<"log_level must be one of debug, info, warning, or error";
+        return false;
+      }
+    }
+
+    // Parse the low latency settings (Optional)
+    {
+      struct json_object* low_latency_obj = json_object_object_get(settings_val, "low_latency");
+      if ((low_latency_obj != nullptr) && !ParseLowLatencySettings(low_latency_obj, low_latency)) {
+        return false;
+      }
+    }
   }
 
   return IsValid();
@@ -210,6 +393,10 @@ void cSettings::Clear()
   https_port = 0;
   https_private_key.clear();
   https_public_cert.clear();
+  update_interval_ms = DEFAULT_UPDATE_INTERVAL_MS;
+  batch_interval_ms = DEFAULT_BATCH_INTERVAL_MS;
+  log_level = util::LOG_LEVEL::LEVEL_INFO;
+  low_latency.Clear();
 }
 
 }
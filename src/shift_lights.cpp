@@ -0,0 +1,61 @@
+#include "shift_lights.h"
+
+namespace acdisplay {
+
+cShiftLightsConfig::cShiftLightsConfig() :
+  flash_rpm(6000.0f),
+  flash_period_ms(200)
+{
+  SetDefaultsForRedLine(flash_rpm);
+}
+
+void cShiftLightsConfig::SetDefaultsForRedLine(float rpm_red_line)
+{
+  // The first LED is on as soon as the engine is running
+  led_on_rpm[0] = 1.0f;
+
+  // The remaining LEDs start at half the red line and get closer together as they approach it
+  // For a 6000 rpm red line this gives roughly 3000, 3800, 4470, 5020, 5450, 5760, 5940
+  const size_t remaining = SHIFT_LIGHTS_LED_COUNT - 1;
+  for (size_t i = 1; i < SHIFT_LIGHTS_LED_COUNT; i++) {
+    const float distance_from_top = float(SHIFT_LIGHTS_LED_COUNT - i) / float(remaining);
+    led_on_rpm[i] = rpm_red_line * (1.0f - (0.5f * distance_from_top * distance_from_top));
+  }
+
+  flash_rpm = rpm_red_line;
+}
+
+
+cShiftLights::cShiftLights() :
+  flashing(false),
+  flashing_start_time_ms(0)
+{
+}
+
+uint16_t cShiftLights::Update(const cShiftLightsConfig& config, float rpm, uint64_t time_ms)
+{
+  if (rpm >= config.flash_rpm) {
+    if (!flashing) {
+      // Start on the lit phase so that the driver sees the change straight away
+      flashing = true;
+      flashing_start_time_ms = time_ms;
+    }
+
+    const uint64_t half_period_ms = (config.flash_period_ms >= 2) ? (config.flash_period_ms / 2) : 1;
+    const bool lit = (((time_ms - flashing_start_time_ms) / half_period_ms) % 2) == 0;
+    return lit ? (SHIFT_LIGHTS_LED_MASK | SHIFT_LIGHTS_FLAG_FLASHING | SHIFT_LIGHTS_FLAG_BLINK_PHASE) : SHIFT_LIGHTS_FLAG_FLASHING;
+  }
+
+  flashing = false;
+
+  uint16_t state = 0;
+  for (size_t i = 0; i < SHIFT_LIGHTS_LED_COUNT; i++) {
+    if (rpm >= config.led_on_rpm[i]) {
+      state |= (1 << i);
+    }
+  }
+
+  return state;
+}
+
+}
@@ -0,0 +1,159 @@
+#include <array>
+#include <utility>
+
+#include "telemetry_channels.h"
+
+namespace {
+
+typedef void (*telemetry_text_encoder_t)(const acdisplay::cTelemetry& telemetry, char separator, std::string& out);
+typedef void (*telemetry_binary_encoder_t)(const acdisplay::cTelemetry& telemetry, std::string& out);
+typedef void (*telemetry_batch_binary_encoder_t)(const acdisplay::cTelemetry* samples, size_t count, std::string& out);
+
+template <size_t... GROUPS>
+constexpr std::array<telemetry_text_encoder_t, sizeof...(GROUPS)> MakeTelemetryTextEncoders(std::index_sequence<GROUPS...>)
+{
+  return {{ &acdisplay::AppendTelemetryText<acdisplay::GetTelemetryGroupChannels(GROUPS)>... }};
+}
+
+template <size_t... GROUPS>
+constexpr std::array<telemetry_binary_encoder_t, sizeof...(GROUPS)> MakeTelemetryBinaryEncoders(std::index_sequence<GROUPS...>)
+{
+  return {{ &acdisplay::AppendTelemetryBinary<acdisplay::GetTelemetryGroupChannels(GROUPS)>... }};
+}
+
+template <size_t... GROUPS>
+constexpr std::array<telemetry_batch_binary_encoder_t, sizeof...(GROUPS)> MakeTelemetryBatchBinaryEncoders(std::index_sequence<GROUPS...>)
+{
+  return {{ &acdisplay::AppendTelemetryBatchBinary<acdisplay::GetTelemetryGroupBatchChannels(GROUPS)>... }};
+}
+
+// Indexed by the group mask
+const std::array<telemetry_text_encoder_t, acdisplay::TELEMETRY_GROUP_MASK_ALL + 1> TELEMETRY_TEXT_ENCODERS = MakeTelemetryTextEncoders(std::make_index_sequence<acdisplay::TELEMETRY_GROUP_MASK_ALL + 1>());
+const std::array<telemetry_binary_encoder_t, acdisplay::TELEMETRY_GROUP_MASK_ALL + 1> TELEMETRY_BINARY_ENCODERS = MakeTelemetryBinaryEncoders(std::make_index_sequence<acdisplay::TELEMETRY_GROUP_MASK_ALL + 1>());
+const std::array<telemetry_batch_binary_encoder_t, acdisplay::TELEMETRY_GROUP_MASK_ALL + 1> TELEMETRY_BATCH_BINARY_ENCODERS = MakeTelemetryBatchBinaryEncoders(std::make_index_sequence<acdisplay::TELEMETRY_GROUP_MASK_ALL + 1>());
+
+}
+
+namespace acdisplay {
+
+cTelemetrySubscriptions telemetry_subscriptions;
+
+void AppendTelemetryGroupsText(const cTelemetry& telemetry, uint32_t groups, char separator, std::string& out)
+{
+  TELEMETRY_TEXT_ENCODERS[groups & TELEMETRY_GROUP_MASK_ALL](telemetry, separator, out);
+}
+
+void AppendTelemetryGroupsBinary(const cTelemetry& telemetry, uint32_t groups, std::string& out)
+{
+  TELEMETRY_BINARY_ENCODERS[groups & TELEMETRY_GROUP_MASK_ALL](telemetry, out);
+}
+
+void AppendTelemetryGroupsBatchBinary(const cTelemetry* samples, size_t count, uint32_t groups, std::string& out)
+{
+  TELEMETRY_BATCH_BINARY_ENCODERS[groups & TELEMETRY_GROUP_MASK_ALL](samples, count, out);
+}
+
+uint32_t ParseTelemetryGroups(std::string_view names)
+{
+  uint32_t groups = TELEMETRY_CORE_GROUP;
+
+  while (!names.empty()) {
+    const size_t comma = names.find(',');
+    const std::string_view name = names.substr(0, comma);
+
+    for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+      if (name == TELEMETRY_GROUP_NAMES[i]) {
+        groups |= GetTelemetryGroupMask(TELEMETRY_GROUP(i));
+        break;
+      }
+    }
+
+    if (comma == std::string_view::npos) {
+      break;
+    }
+
+    names.remove_prefix(comma + 1);
+  }
+
+  return groups;
+}
+
+void CopyTelemetryGroups(const cTelemetry& from, uint32_t groups, cTelemetry& to)
+{
+#define ACDISPLAY_TELEMETRY_GROUP_COPY(GROUP, CLASS, CHANNELS) \
+  if ((groups & GetTelemetryGroupMask(TELEMETRY_GROUP::GROUP)) != 0) { \
+    to.GROUP = from.GROUP; \
+  }
+  ACDISPLAY_TELEMETRY_GROUPS(ACDISPLAY_TELEMETRY_GROUP_COPY)
+#undef ACDISPLAY_TELEMETRY_GROUP_COPY
+}
+
+cTelemetrySubscriptions::cTelemetrySubscriptions() :
+  groups(TELEMETRY_CORE_GROUP)
+{
+  counts.fill(0);
+}
+
+void cTelemetrySubscriptions::Subscribe(uint32_t subscribe_groups)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if ((subscribe_groups & GetTelemetryGroupMask(TELEMETRY_GROUP(i))) != 0) {
+      counts[i]++;
+    }
+  }
+
+  UpdateGroups();
+}
+
+void cTelemetrySubscriptions::Unsubscribe(uint32_t unsubscribe_groups)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if (((unsubscribe_groups & GetTelemetryGroupMask(TELEMETRY_GROUP(i))) != 0) && (counts[i] != 0)) {
+      counts[i]--;
+    }
+  }
+
+  UpdateGroups();
+}
+
+void cTelemetrySubscriptions::UpdateGroups()
+{
+  // The core group is always filled in
+  uint32_t subscribed = TELEMETRY_CORE_GROUP;
+  for (size_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if (counts[i] != 0) {
+      subscribed |= GetTelemetryGroupMask(TELEMETRY_GROUP(i));
+    }
+  }
+
+  groups.store(subscribed, std::memory_order_relaxed);
+}
+
+void AppendTelemetryCSVHeader(uint64_t mask, std::string& out)
+{
+  bool first = true;
+  for (size_t i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+    if ((mask & (uint64_t(1) << i)) != 0) {
+      const cTelemetryChannelInfo& info = TELEMETRY_CHANNEL_INFO[i];
+      for (size_t element = 0; element < info.count; element++) {
+        if (!first) {
+          out += ',';
+        }
+        out += info.name;
+        if (info.count != 1) {
+          out += '_';
+          util::AppendNumber(out, element);
+        }
+        first = false;
+      }
+    }
+  }
+
+  out += '\n';
+}
+
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <mutex>
+
+#include "metrics.h"
+#include "telemetry_history.h"
+
+namespace acdisplay {
+
+cTelemetryHistory telemetry_history;
+
+cTelemetryHistory::cTelemetryHistory() :
+  mutex(metrics.lock_telemetry_history),
+  sequence(0),
+  subscribers(0)
+{
+}
+
+void cTelemetryHistory::Subscribe()
+{
+  subscribers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cTelemetryHistory::Unsubscribe()
+{
+  subscribers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void cTelemetryHistory::Push(const cTelemetry& telemetry, uint32_t telemetry_groups)
+{
+  std::lock_guard lock(mutex);
+  CopyTelemetryGroups(telemetry, telemetry_groups, samples[sequence % TELEMETRY_HISTORY_SAMPLES]);
+  sequence++;
+}
+
+uint64_t cTelemetryHistory::GetNextSequence()
+{
+  std::lock_guard lock(mutex);
+  return sequence;
+}
+
+size_t cTelemetryHistory::Read(uint64_t& next_sequence, uint32_t telemetry_groups, std::vector<cTelemetry>& out_samples)
+{
+  std::lock_guard lock(mutex);
+
+  // Skip anything that has already been overwritten
+  const uint64_t oldest = (sequence > TELEMETRY_HISTORY_SAMPLES) ? (sequence - TELEMETRY_HISTORY_SAMPLES) : 0;
+  const uint64_t first = std::max(next_sequence, oldest);
+  const size_t skipped = size_t(first - next_sequence);
+
+  out_samples.resize(size_t(sequence - std::min(first, sequence)));
+  for (size_t i = 0; i < out_samples.size(); i++) {
+    CopyTelemetryGroups(samples[(first + i) % TELEMETRY_HISTORY_SAMPLES], telemetry_groups, out_samples[i]);
+  }
+
+  next_sequence = sequence;
+  return skipped;
+}
+
+}
@@ -0,0 +1,328 @@
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "trace.h"
+#include "util.h"
+
+namespace {
+
+std::atomic<bool> tracing_enabled(true);
+
+class cTraceEvent {
+public:
+  // These are atomics so that a dump can read them while the thread is writing, a torn event is detected and skipped with the write count
+  std::atomic<const char*> name;
+  std::atomic<uint64_t> start_ns;
+  std::atomic<uint64_t> end_ns;
+};
+
+// Written by one thread only, read by GetTraceJSON
+class cTraceThreadBuffer {
+public:
+  cTraceThreadBuffer();
+
+  // NOTE: This is never reset when the buffer is reused, so that a dump that is reading the buffer can still tell which events have been overwritten
+  std::atomic<uint64_t> write_count;
+  std::array<cTraceEvent, util::TRACE_EVENTS_PER_THREAD> events;
+
+  // Protected by mutex_trace_buffers
+  uint64_t first_write_count; // The write count when the current thread started using this buffer, the events before it are from the previous thread
+  pid_t thread_id;
+  std::string thread_name;
+};
+
+cTraceThreadBuffer::cTraceThreadBuffer() :
+  write_count(0),
+  first_write_count(0),
+  thread_id(0)
+{
+}
+
+// NOTE: The lists are deliberately never destroyed, detached threads can still be recording while the process exits
+std::mutex mutex_trace_buffers;
+std::vector<std::shared_ptr<cTraceThreadBuffer>>& trace_buffers = *new std::vector<std::shared_ptr<cTraceThreadBuffer>>;
+std::deque<std::shared_ptr<cTraceThreadBuffer>>& free_trace_buffers = *new std::deque<std::shared_ptr<cTraceThreadBuffer>>; // The buffers of threads that have exited, oldest first
+
+// Gives the buffer back when the thread exits
+class cTraceThreadRegistration {
+public:
+  ~cTraceThreadRegistration();
+
+  std::shared_ptr<cTraceThreadBuffer> buffer;
+};
+
+cTraceThreadRegistration::~cTraceThreadRegistration()
+{
+  if (!buffer) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_trace_buffers);
+
+  free_trace_buffers.push_back(buffer);
+
+  // Free the oldest buffers if we had more threads than usual, a dump that is still reading one keeps it alive until it is finished
+  while ((trace_buffers.size() > util::TRACE_MAX_THREAD_BUFFERS) && !free_trace_buffers.empty()) {
+    std::erase(trace_buffers, free_trace_buffers.front());
+    free_trace_buffers.pop_front();
+  }
+}
+
+thread_local cTraceThreadRegistration trace_thread_registration;
+
+cTraceThreadBuffer& GetThreadBuffer()
+{
+  if (trace_thread_registration.buffer) {
+    return *trace_thread_registration.buffer;
+  }
+
+  const pid_t thread_id = pid_t(syscall(SYS_gettid));
+
+  std::lock_guard<std::mutex> lock(mutex_trace_buffers);
+
+  std::shared_ptr<cTraceThreadBuffer> buffer;
+  if ((trace_buffers.size() >= util::TRACE_MAX_THREAD_BUFFERS) && !free_trace_buffers.empty()) {
+    // Reuse the buffer of the thread that exited the longest time ago
+    buffer = free_trace_buffers.front();
+    free_trace_buffers.pop_front();
+  } else {
+    buffer = std::make_shared<cTraceThreadBuffer>();
+    trace_buffers.push_back(buffer);
+  }
+
+  buffer->first_write_count = buffer->write_count.load(std::memory_order_relaxed);
+  buffer->thread_id = thread_id;
+  buffer->thread_name = "thread " + std::to_string(thread_id);
+
+  trace_thread_registration.buffer = buffer;
+  return *buffer;
+}
+
+// The parts of a buffer that are protected by mutex_trace_buffers, copied so that the events can be formatted without holding the lock
+class cTraceThreadSnapshot {
+public:
+  std::shared_ptr<const cTraceThreadBuffer> buffer;
+  uint64_t first_write_count;
+  uint64_t write_count;
+  pid_t thread_id;
+  std::string thread_name;
+};
+
+// Chrome trace event timestamps are microseconds, we keep the nanoseconds as a fraction
+std::string NanosecondsToMicroseconds(uint64_t ns)
+{
+  const std::string fraction = std::to_string(ns % 1000);
+  return std::to_string(ns / 1000) + "." + std::string(3 - fraction.length(), '0') + fraction;
+}
+
+std::string ToJSONString(const std::string& text)
+{
+  std::string result = "\"";
+  for (auto&& c : text) {
+    if ((c == '"') || (c == '\\')) {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      result += c;
+    }
+  }
+  result += "\"";
+  return result;
+}
+
+
+// The signal handler can only do async signal safe things, so it writes to a pipe and a thread does the rest
+int trace_signal_pipe[2] = { -1, -1 };
+
+void TraceSignalHandler(int)
+{
+  const int saved_errno = errno;
+  const char c = 0;
+  (void)!write(trace_signal_pipe[1], &c, 1);
+  errno = saved_errno;
+}
+
+void TraceDumpThreadFunction(std::string folder, uint64_t duration_ms)
+{
+  util::SetTraceThreadName("trace_dump");
+
+  while (true) {
+    char c = 0;
+    const ssize_t result = read(trace_signal_pipe[0], &c, 1);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      LOG_ERROR<<"TraceDumpThreadFunction Error reading the signal pipe "<<strerror(errno);
+      return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+
+    const std::string file_path = folder + "/trace_" + std::to_string(util::GetTimeMS()) + ".json";
+    std::ofstream o(file_path);
+    o<<util::GetTraceJSON(duration_ms);
+    o.close();
+
+    if (o.fail()) {
+      LOG_ERROR<<"TraceDumpThreadFunction Error writing \""<<file_path<<"\"";
+    } else {
+      LOG_INFO<<"TraceDumpThreadFunction Wrote \""<<file_path<<"\"";
+    }
+  }
+}
+
+}
+
+namespace util {
+
+void SetTracingEnabled(bool enabled)
+{
+  tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsTracingEnabled()
+{
+  return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void SetTraceThreadName(const std::string& name)
+{
+  cTraceThreadBuffer& buffer = GetThreadBuffer();
+
+  std::lock_guard<std::mutex> lock(mutex_trace_buffers);
+  buffer.thread_name = name;
+}
+
+uint64_t GetTraceTimeNS()
+{
+  // NOTE: This is a vDSO call so it doesn't enter the kernel, and unlike reading the TSC directly it doesn't need calibrating or worry about cores being out of sync
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t(now.tv_sec) * 1000000000) + uint64_t(now.tv_nsec);
+}
+
+void RecordTraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+  cTraceThreadBuffer& buffer = GetThreadBuffer();
+
+  const uint64_t index = buffer.write_count.load(std::memory_order_relaxed);
+  cTraceEvent& event = buffer.events[index % TRACE_EVENTS_PER_THREAD];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start_ns.store(start_ns, std::memory_order_relaxed);
+  event.end_ns.store(end_ns, std::memory_order_relaxed);
+
+  // Publish the event
+  buffer.write_count.store(index + 1, std::memory_order_release);
+}
+
+std::string GetTraceJSON(uint64_t duration_ms)
+{
+  const uint64_t now_ns = GetTraceTimeNS();
+  const uint64_t duration_ns = duration_ms * 1000000;
+  const uint64_t cutoff_ns = (now_ns > duration_ns) ? (now_ns - duration_ns) : 0;
+  const std::string pid = std::to_string(getpid());
+
+  std::vector<cTraceThreadSnapshot> snapshots;
+  {
+    std::lock_guard<std::mutex> lock(mutex_trace_buffers);
+
+    snapshots.reserve(trace_buffers.size());
+    for (auto&& buffer : trace_buffers) {
+      // The write count is read under the lock so that every event before it belongs to this thread
+      snapshots.push_back({ buffer, buffer->first_write_count, buffer->write_count.load(std::memory_order_acquire), buffer->thread_id, buffer->thread_name });
+    }
+  }
+
+  std::string json = "{\"traceEvents\":[";
+  bool first = true;
+
+  for (auto&& snapshot : snapshots) {
+    const cTraceThreadBuffer& buffer = *snapshot.buffer;
+    const std::string tid = std::to_string(snapshot.thread_id);
+
+    // Name the thread
+    json += std::string(first ? "" : ",") + "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":" + ToJSONString(snapshot.thread_name) + "}}";
+    first = false;
+
+    // Copy the events out first, the thread may still be writing to the buffer
+    const uint64_t write_count = snapshot.write_count;
+    const uint64_t oldest = std::max((write_count > TRACE_EVENTS_PER_THREAD) ? (write_count - TRACE_EVENTS_PER_THREAD) : 0, snapshot.first_write_count);
+
+    std::vector<uint64_t> indices;
+    std::vector<const char*> names;
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+    for (uint64_t i = oldest; i < write_count; i++) {
+      const cTraceEvent& event = buffer.events[i % TRACE_EVENTS_PER_THREAD];
+      indices.push_back(i);
+      names.push_back(event.name.load(std::memory_order_relaxed));
+      starts.push_back(event.start_ns.load(std::memory_order_relaxed));
+      ends.push_back(event.end_ns.load(std::memory_order_relaxed));
+    }
+
+    // Anything the thread has overwritten while we were copying is discarded, including the slot it may be halfway through writing now
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t write_count_after = buffer.write_count.load(std::memory_order_relaxed);
+    const uint64_t valid_from = (write_count_after >= TRACE_EVENTS_PER_THREAD) ? (write_count_after - TRACE_EVENTS_PER_THREAD + 1) : 0;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+      if ((indices[i] < valid_from) || (starts[i] < cutoff_ns) || (names[i] == nullptr)) {
+        continue;
+      }
+
+      const uint64_t duration = (ends[i] > starts[i]) ? (ends[i] - starts[i]) : 0;
+      json += ",{\"name\":" + ToJSONString(names[i]) + ",\"cat\":\"acdisplay\",\"ph\":\"X\",\"ts\":" + NanosecondsToMicroseconds(starts[i]) + ",\"dur\":" + NanosecondsToMicroseconds(duration) + ",\"pid\":" + pid + ",\"tid\":" + tid + "}";
+    }
+  }
+
+  json += "],\"displayTimeUnit\":\"ms\"}";
+
+  return json;
+}
+
+bool StartTraceDumpOnSignal(int signal_number, const std::string& folder, uint64_t duration_ms)
+{
+  if (pipe2(trace_signal_pipe, O_CLOEXEC) != 0) {
+    LOG_ERROR<<"StartTraceDumpOnSignal pipe2 failed "<<strerror(errno);
+    return false;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = TraceSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(signal_number, &action, nullptr) != 0) {
+    LOG_ERROR<<"StartTraceDumpOnSignal sigaction failed "<<strerror(errno);
+    return false;
+  }
+
+  // NOTE: This thread runs until the process exits
+  std::thread(TraceDumpThreadFunction, folder, duration_ms).detach();
+
+  LOG_INFO<<"StartTraceDumpOnSignal Send signal "<<signal_number<<" to write the last "<<duration_ms<<" ms of trace to \""<<folder<<"\"";
+
+  return true;
+}
+
+}
@@ -0,0 +1,394 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <json-c/json.h>
+
+#include "json.h"
+#include "log.h"
+#include "track_map.h"
+#include "util.h"
+
+namespace {
+
+// If the car moves further than this between two samples then it has been teleported (Back to the pits, restarted, etc.)
+const float MAX_POSITION_DELTA = 0.1f;
+
+// We need at least this fraction of the bins on a lap, otherwise the update rate was too low or something went wrong
+const float MIN_BIN_COVERAGE = 0.5f;
+
+// Assetto Corsa coordinates are in metres, this is well below what can be seen on a small display
+const float SIMPLIFY_TOLERANCE_M = 2.0f;
+
+const size_t MAX_FILE_SIZE_BYTES = 256 * 1024;
+
+// The files that are being saved by SaveTrackMapInBackground, and the newest map waiting to be saved to each one
+std::mutex mutex_track_map_saves;
+std::map<std::string, std::optional<acdisplay::cTrackMap>> track_map_saves;
+
+bool WriteAll(int fd, const std::string& text)
+{
+  size_t written = 0;
+  while (written < text.length()) {
+    const ssize_t result = write(fd, text.data() + written, text.length() - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    written += size_t(result);
+  }
+
+  return true;
+}
+
+float GetDistanceFromSegment(const acdisplay::cTrackMapPoint& point, const acdisplay::cTrackMapPoint& start, const acdisplay::cTrackMapPoint& end)
+{
+  const float dx = end.x - start.x;
+  const float dz = end.z - start.z;
+  const float length_squared = (dx * dx) + (dz * dz);
+  if (length_squared <= 0.0f) {
+    return std::hypot(point.x - start.x, point.z - start.z);
+  }
+
+  const float t = std::clamp((((point.x - start.x) * dx) + ((point.z - start.z) * dz)) / length_squared, 0.0f, 1.0f);
+  return std::hypot(point.x - (start.x + (t * dx)), point.z - (start.z + (t * dz)));
+}
+
+std::string SanitiseFileName(const std::string& name)
+{
+  std::string result = name;
+  for (auto&& c : result) {
+    if (!isalnum(static_cast<unsigned char>(c)) && (c != '-') && (c != '_')) {
+      c = '_';
+    }
+  }
+
+  return result;
+}
+
+}
+
+namespace acdisplay {
+
+uint16_t GetTrackMapPositionIndex(float position_normalized)
+{
+  const float bin = position_normalized * float(TRACK_MAP_BIN_COUNT);
+  return uint16_t(std::clamp(int(bin), 0, int(TRACK_MAP_BIN_COUNT - 1)));
+}
+
+void SimplifyTrackMap(const std::vector<cTrackMapPoint>& points, float tolerance, std::vector<cTrackMapPoint>& out_points)
+{
+  out_points.clear();
+
+  if (points.size() <= 2) {
+    out_points = points;
+    return;
+  }
+
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+
+  // Use our own stack of ranges rather than recursing
+  std::vector<std::pair<size_t, size_t>> ranges;
+  ranges.push_back(std::make_pair(0, points.size() - 1));
+
+  while (!ranges.empty()) {
+    const auto [start, end] = ranges.back();
+    ranges.pop_back();
+
+    float furthest_distance = 0.0f;
+    size_t furthest = start;
+    for (size_t i = start + 1; i < end; i++) {
+      const float distance = GetDistanceFromSegment(points[i], points[start], points[end]);
+      if (distance > furthest_distance) {
+        furthest_distance = distance;
+        furthest = i;
+      }
+    }
+
+    if (furthest_distance > tolerance) {
+      keep[furthest] = true;
+      ranges.push_back(std::make_pair(start, furthest));
+      ranges.push_back(std::make_pair(furthest, end));
+    }
+  }
+
+  for (size_t i = 0; i < points.size(); i++) {
+    if (keep[i]) {
+      out_points.push_back(points[i]);
+    }
+  }
+}
+
+std::string GetTrackMapFilePath(const std::string& track_name, const std::string& track_config)
+{
+  const std::string folder = util::GetConfigFolder("ac-display");
+  if (folder.empty()) {
+    return "";
+  }
+
+  return folder + "/track_maps/" + SanitiseFileName(track_name) + "_" + SanitiseFileName(track_config) + ".json";
+}
+
+bool LoadTrackMap(const std::string& file_path, cTrackMap& out_map)
+{
+  out_map.Clear();
+
+  std::string contents;
+  if (!util::ReadFileIntoString(file_path, MAX_FILE_SIZE_BYTES, contents)) {
+    return false;
+  }
+
+  util::cJSONDocument document(json_tokener_parse(contents.c_str()));
+  if (!document.IsValid()) {
+    LOG_ERROR<<"LoadTrackMap Invalid JSON \""<<file_path<<"\"";
+    return false;
+  }
+
+  struct json_object* points = json_object_object_get(document.Get(), "points");
+  if ((points == nullptr) || (json_object_get_type(points) != json_type_array)) {
+    LOG_ERROR<<"LoadTrackMap points array not found";
+    return false;
+  }
+
+  // Each point is an array of [bin, x, z]
+  const size_t count = json_object_array_length(points);
+  for (size_t i = 0; i < count; i++) {
+    struct json_object* point = json_object_array_get_idx(points, i);
+    if ((point == nullptr) || (json_object_get_type(point) != json_type_array) || (json_object_array_length(point) != 3)) {
+      LOG_ERROR<<"LoadTrackMap Invalid point "<<i;
+      out_map.Clear();
+      return false;
+    }
+
+    const int bin = json_object_get_int(json_object_array_get_idx(point, 0));
+    if ((bin < 0) || (bin >= int(TRACK_MAP_BIN_COUNT))) {
+      LOG_ERROR<<"LoadTrackMap Invalid bin "<<bin;
+      out_map.Clear();
+      return false;
+    }
+
+    cTrackMapPoint p;
+    p.bin = uint16_t(bin);
+    p.x = float(json_object_get_double(json_object_array_get_idx(point, 1)));
+    p.z = float(json_object_get_double(json_object_array_get_idx(point, 2)));
+    out_map.points.push_back(p);
+  }
+
+  return out_map.IsValid();
+}
+
+bool SaveTrackMap(const std::string& file_path, const cTrackMap& map)
+{
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(file_path).parent_path(), error);
+  if (error) {
+    LOG_ERROR<<"SaveTrackMap Error creating folder for \""<<file_path<<"\" "<<error.message();
+    return false;
+  }
+
+  std::ostringstream o;
+  o<<"{\"points\":[";
+  for (size_t i = 0; i < map.points.size(); i++) {
+    const cTrackMapPoint& point = map.points[i];
+    o<<((i != 0) ? "," : "")<<"["<<point.bin<<","<<point.x<<","<<point.z<<"]";
+  }
+  o<<"]}"<<std::endl;
+
+  // Write to a temporary file first so that a crash can't leave a half written map behind, the name is unique so that two saves of the same map can't write to the same temporary file
+  std::string temporary_file_path = file_path + ".XXXXXX";
+  const int fd = mkstemp(temporary_file_path.data());
+  if (fd < 0) {
+    LOG_ERROR<<"SaveTrackMap Error creating a temporary file for \""<<file_path<<"\" "<<strerror(errno);
+    return false;
+  }
+
+  // mkstemp only gives the owner access
+  fchmod(fd, 0644);
+
+  const std::string text = o.str();
+  const bool written = WriteAll(fd, text);
+  if ((close(fd) != 0) || !written) {
+    LOG_ERROR<<"SaveTrackMap Error writing \""<<temporary_file_path<<"\"";
+    unlink(temporary_file_path.c_str());
+    return false;
+  }
+
+  std::filesystem::rename(temporary_file_path, file_path, error);
+  if (error) {
+    LOG_ERROR<<"SaveTrackMap Error renaming \""<<temporary_file_path<<"\" "<<error.message();
+    unlink(temporary_file_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void SaveTrackMapInBackground(const std::string& file_path, const cTrackMap& map)
+{
+  std::lock_guard<std::mutex> lock(mutex_track_map_saves);
+
+  // If this file is already being saved then the thread saving it picks up this map when it has finished, only the newest map is kept
+  auto [iter, inserted] = track_map_saves.try_emplace(file_path);
+  iter->second = map;
+  if (!inserted) {
+    return;
+  }
+
+  // NOTE: The thread is detached, SaveTrackMap writes to a temporary file first so exiting part way through a save is ok
+  std::thread([file_path]() {
+    std::unique_lock<std::mutex> lock(mutex_track_map_saves);
+    while (true) {
+      auto iter = track_map_saves.find(file_path);
+      if (!iter->second.has_value()) {
+        track_map_saves.erase(iter);
+        break;
+      }
+
+      const cTrackMap map = std::move(*iter->second);
+      iter->second.reset();
+
+      lock.unlock();
+      SaveTrackMap(file_path, map);
+      lock.lock();
+    }
+  }).detach();
+}
+
+
+cTrackMapBuilder::cTrackMapBuilder()
+{
+  Reset();
+}
+
+void cTrackMapBuilder::Reset()
+{
+  has_previous = false;
+  previous_position = 0.0f;
+  previous_lap_count = 0;
+
+  recording = false;
+  recording_lap_count = 0;
+
+  has_map = false;
+  map.Clear();
+}
+
+void cTrackMapBuilder::SetMap(const cTrackMap& new_map)
+{
+  Reset();
+
+  has_map = true;
+  map = new_map;
+}
+
+void cTrackMapBuilder::StartLap(uint32_t lap_count)
+{
+  recording = true;
+  recording_lap_count = lap_count;
+
+  bins.fill(cBin{ 0.0, 0.0, 0 });
+}
+
+bool cTrackMapBuilder::FinishLap()
+{
+  recording = false;
+
+  std::vector<cTrackMapPoint> points;
+  points.reserve(TRACK_MAP_BIN_COUNT);
+
+  for (size_t i = 0; i < TRACK_MAP_BIN_COUNT; i++) {
+    const cBin& bin = bins[i];
+    if (bin.samples != 0) {
+      cTrackMapPoint point;
+      point.bin = uint16_t(i);
+      point.x = float(bin.sum_x / double(bin.samples));
+      point.z = float(bin.sum_z / double(bin.samples));
+      points.push_back(point);
+    }
+  }
+
+  if (float(points.size()) < (MIN_BIN_COVERAGE * float(TRACK_MAP_BIN_COUNT))) {
+    LOG_WARNING<<"cTrackMapBuilder::FinishLap Not enough samples for a track map "<<points.size();
+    return false;
+  }
+
+  SimplifyTrackMap(points, SIMPLIFY_TOLERANCE_M, map.points);
+
+  has_map = true;
+  return true;
+}
+
+bool cTrackMapBuilder::Update(float position_normalized, float x, float z, uint32_t lap_count)
+{
+  if (has_map) {
+    return false;
+  }
+
+  bool completed = false;
+
+  if (has_previous) {
+    bool teleported = false;
+
+    float delta = position_normalized - previous_position;
+    if (delta < -0.5f) {
+      // Crossed the line
+      delta += 1.0f;
+    }
+
+    if (std::fabs(delta) > MAX_POSITION_DELTA) {
+      // The car has been teleported, this lap is no good
+      teleported = true;
+      recording = false;
+    }
+
+    // The lap count changes when we cross the line, or when the session is restarted which we have already caught as a teleport
+    if ((lap_count != previous_lap_count) && !teleported) {
+      if (recording && (lap_count == (recording_lap_count + 1))) {
+        completed = FinishLap();
+      }
+
+      if (!completed) {
+        StartLap(lap_count);
+      }
+    }
+  }
+
+  if (recording) {
+    cBin& bin = bins[GetTrackMapPositionIndex(position_normalized)];
+    bin.sum_x += x;
+    bin.sum_z += z;
+    bin.samples++;
+  }
+
+  has_previous = true;
+  previous_position = position_normalized;
+  previous_lap_count = lap_count;
+
+  return completed;
+}
+
+
+std::mutex mutex_track_map;
+cTrackMap track_map;
+
+}
@@ -0,0 +1,13 @@
+#include "tunables.h"
+
+namespace acdisplay {
+
+cTunables::cTunables() :
+  update_interval_ms(20),
+  batch_interval_ms(100)
+{
+}
+
+cTunables tunables;
+
+}
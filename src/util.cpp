@@ -3,7 +3,6 @@
 
 #include <chrono>
 #include <iomanip>
-#include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -12,6 +11,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "log.h"
+
 namespace util {
 
 // From: https://stackoverflow.com/a/1157217/1074390
@@ -42,6 +43,12 @@ uint64_t GetTimeMS()
   return ms;
 }
 
+uint64_t GetMonotonicTimeUS()
+{
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+}
+
 std::string GetHomeFolder()
 {
   const char* szHomeFolder = getenv("HOME");
@@ -83,16 +90,16 @@ size_t GetFileSizeBytes(const std::string& sFilePath)
 bool ReadFileIntoString(const std::string& sFilePath, size_t nMaxFileSizeBytes, std::string& contents)
 {
   if (!TestFileExists(sFilePath)) {
-    std::cerr<<"File \""<<sFilePath<<"\" not found"<<std::endl;
+    LOG_ERROR<<"File \""<<sFilePath<<"\" not found";
     return false;
   }
 
   const size_t nFileSizeBytes = GetFileSizeBytes(sFilePath);
   if (nFileSizeBytes == 0) {
-    std::cerr<<"Empty file \""<<sFilePath<<"\""<<std::endl;
+    LOG_ERROR<<"Empty file \""<<sFilePath<<"\"";
     return false;
   } else if (nFileSizeBytes > nMaxFileSizeBytes) {
-    std::cerr<<"File \""<<sFilePath<<"\" is too large"<<std::endl;
+    LOG_ERROR<<"File \""<<sFilePath<<"\" is too large";
     return false;
   }
 
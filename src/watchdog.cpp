@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "flight_recorder.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "util.h"
+#include "watchdog.h"
+
+namespace {
+
+const uint64_t WATCHDOG_CHECK_INTERVAL_MS = 250;
+
+// How much of the trace to write with each stall report
+const uint64_t STALL_REPORT_TRACE_DURATION_MS = 10000;
+
+// NOTE: We can't use util::ReadFileIntoString because proc files report a size of 0
+std::string ReadProcFileFirstLine(const std::string& file_path)
+{
+  std::ifstream f(file_path);
+  std::string line;
+  std::getline(f, line);
+  return line;
+}
+
+}
+
+namespace acdisplay {
+
+const char* GetWatchdogStageName(WATCHDOG_STAGE stage)
+{
+  switch (stage) {
+    case WATCHDOG_STAGE::INGEST: return "ingest";
+    case WATCHDOG_STAGE::BROADCAST: return "broadcast";
+  }
+
+  return "unknown";
+}
+
+cWatchdog::cWatchdog() :
+  stall_threshold_ms(0),
+  stop(false)
+{
+  for (auto& value : last_progress_ms) {
+    value.store(0, std::memory_order_relaxed);
+  }
+  for (auto& value : waiting) {
+    value.store(false, std::memory_order_relaxed);
+  }
+  expected_since_ms.fill(0);
+  stalled.fill(false);
+}
+
+cWatchdog::~cWatchdog()
+{
+  Stop();
+}
+
+bool cWatchdog::Start(const std::string& _folder, uint64_t _stall_threshold_ms)
+{
+  Stop();
+
+  folder = _folder;
+  SetStallThresholdMS(_stall_threshold_ms);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_stop);
+    stop = false;
+  }
+
+  thread = std::thread(&cWatchdog::MainLoop, this);
+
+  LOG_INFO<<"cWatchdog::Start Writing a report to \""<<folder<<"\" if a stage stalls for "<<_stall_threshold_ms<<" ms";
+
+  return true;
+}
+
+void cWatchdog::Stop()
+{
+  if (thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_stop);
+      stop = true;
+    }
+    cv_stop.notify_one();
+
+    thread.join();
+  }
+}
+
+void cWatchdog::Progress(WATCHDOG_STAGE stage, uint64_t now_ms)
+{
+  last_progress_ms[size_t(stage)].store(now_ms, std::memory_order_relaxed);
+}
+
+void cWatchdog::SetWaiting(WATCHDOG_STAGE stage, bool _waiting)
+{
+  waiting[size_t(stage)].store(_waiting, std::memory_order_relaxed);
+}
+
+std::vector<WATCHDOG_STAGE> cWatchdog::Check(uint64_t now_ms, const std::array<bool, WATCHDOG_STAGE_COUNT>& expected)
+{
+  std::vector<WATCHDOG_STAGE> newly_stalled;
+
+  for (size_t i = 0; i < WATCHDOG_STAGE_COUNT; i++) {
+    const WATCHDOG_STAGE stage = WATCHDOG_STAGE(i);
+
+    if (!expected[i]) {
+      // Start timing again from when this stage is next expected to make progress
+      expected_since_ms[i] = 0;
+      stalled[i] = false;
+      continue;
+    }
+
+    if (expected_since_ms[i] == 0) {
+      expected_since_ms[i] = now_ms;
+    }
+
+    const uint64_t last_ms = std::max(last_progress_ms[i].load(std::memory_order_relaxed), expected_since_ms[i]);
+    const uint64_t stalled_ms = (now_ms > last_ms) ? (now_ms - last_ms) : 0;
+
+    if (stalled_ms > stall_threshold_ms.load(std::memory_order_relaxed)) {
+      if (!stalled[i]) {
+        stalled[i] = true;
+        flight_recorder.Record(std::string("Watchdog ") + GetWatchdogStageName(stage) + " stalled, no progress for " + std::to_string(stalled_ms) + " ms");
+        newly_stalled.push_back(stage);
+      }
+    } else if (stalled[i]) {
+      stalled[i] = false;
+      flight_recorder.Record(std::string("Watchdog ") + GetWatchdogStageName(stage) + " resumed");
+    }
+  }
+
+  return newly_stalled;
+}
+
+void cWatchdog::MainLoop()
+{
+  util::SetTraceThreadName("watchdog");
+
+  std::unique_lock<std::mutex> lock(mutex_stop);
+
+  while (!cv_stop.wait_for(lock, std::chrono::milliseconds(WATCHDOG_CHECK_INTERVAL_MS), [this]{ return stop; })) {
+    // Ingest is expected to make progress once the first packet has arrived and while it isn't waiting for the next one, broadcast whenever a client is connected
+    const std::array<bool, WATCHDOG_STAGE_COUNT> expected = {
+      (last_progress_ms[size_t(WATCHDOG_STAGE::INGEST)].load(std::memory_order_relaxed) != 0) && !waiting[size_t(WATCHDOG_STAGE::INGEST)].load(std::memory_order_relaxed),
+      (metrics.websocket_clients.Get() > 0),
+    };
+
+    const std::vector<WATCHDOG_STAGE> newly_stalled = Check(util::GetMonotonicTimeUS() / 1000, expected);
+    for (WATCHDOG_STAGE stage : newly_stalled) {
+      LOG_WARNING<<"cWatchdog::MainLoop The "<<GetWatchdogStageName(stage)<<" stage has stalled";
+
+      const std::string file_path = WriteStallReport(folder, std::string(GetWatchdogStageName(stage)) + " stage made no progress for over " + std::to_string(stall_threshold_ms.load(std::memory_order_relaxed)) + " ms");
+      if (!file_path.empty()) {
+        LOG_WARNING<<"cWatchdog::MainLoop Wrote \""<<file_path<<"\"";
+      }
+
+      RemoveOldStallReports(folder, WATCHDOG_MAX_STALL_REPORTS);
+    }
+  }
+}
+
+
+std::string GetThreadStates()
+{
+  std::string result;
+
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator("/proc/self/task", error)) {
+    const std::string task_folder = entry.path().string();
+
+    // The state is the first field after the name, which is in brackets and may contain spaces
+    const std::string stat = ReadProcFileFirstLine(task_folder + "/stat");
+    const size_t name_end = stat.rfind(')');
+    const char state = ((name_end != std::string::npos) && (name_end + 2 < stat.length())) ? stat[name_end + 2] : '?';
+
+    const std::string wchan = ReadProcFileFirstLine(task_folder + "/wchan");
+
+    result += entry.path().filename().string() + " " + ReadProcFileFirstLine(task_folder + "/comm") + " " + state + " " + (wchan.empty() ? "-" : wchan) + "\n";
+  }
+
+  return result;
+}
+
+std::string WriteStallReport(const std::string& folder, const std::string& reason)
+{
+  std::error_code error;
+  std::filesystem::create_directories(folder, error);
+
+  const std::string file_path_prefix = folder + "/stall_" + std::to_string(util::GetTimeMS());
+
+  {
+    std::ofstream o(file_path_prefix + "_trace.json");
+    o<<util::GetTraceJSON(STALL_REPORT_TRACE_DURATION_MS);
+  }
+
+  std::string metrics_text;
+  metrics.ToPrometheus(metrics_text);
+
+  const std::string file_path = file_path_prefix + ".txt";
+  std::ofstream o(file_path);
+  o<<"Stall: "<<reason<<"\n";
+  o<<"Trace: "<<file_path_prefix<<"_trace.json\n";
+  o<<"\n";
+  o<<"Threads (tid name state wait_channel):\n";
+  o<<GetThreadStates();
+  o<<"\n";
+  o<<"Flight recorder (time_ms event):\n";
+  for (const std::string& event : flight_recorder.GetEvents()) {
+    o<<event<<"\n";
+  }
+  o<<"\n";
+  o<<"Metrics:\n";
+  o<<metrics_text;
+  o.close();
+
+  if (o.fail()) {
+    LOG_ERROR<<"WriteStallReport Error writing \""<<file_path<<"\"";
+    return "";
+  }
+
+  return file_path;
+}
+
+void RemoveOldStallReports(const std::string& folder, size_t max_reports)
+{
+  // The reports are named by the time they were written, so sorting the names puts them in order
+  std::vector<std::string> reports;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(folder, error)) {
+    const std::string file_name = entry.path().filename().string();
+    if (file_name.starts_with("stall_") && file_name.ends_with(".txt")) {
+      reports.push_back(file_name.substr(0, file_name.length() - 4));
+    }
+  }
+
+  if (reports.size() <= max_reports) {
+    return;
+  }
+
+  std::sort(reports.begin(), reports.end());
+
+  for (size_t i = 0; i < (reports.size() - max_reports); i++) {
+    std::filesystem::remove(folder + "/" + reports[i] + ".txt", error);
+    std::filesystem::remove(folder + "/" + reports[i] + "_trace.json", error);
+  }
+}
+
+
+cWatchdog watchdog;
+
+}
@@ -1,6 +1,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
@@ -8,16 +9,20 @@
 #include <chrono>
 #include <condition_variable>
 #include <fstream>
-#include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include <microhttpd.h>
 #include <microhttpd_ws.h>
@@ -25,8 +30,24 @@
 #include <security_headers.h>
 
 #include "ac_data.h"
+#include "copy_on_write_vector.h"
+#include "flight_recorder.h"
+#include "instrumented_mutex.h"
+#include "leaderboard.h"
+#include "log.h"
+#include "low_latency.h"
+#include "metrics.h"
+#include "session_statistics.h"
+#include "telemetry_channels.h"
+#include "trace.h"
+#include "track_map.h"
+#include "tunables.h"
 #include "util.h"
+#include "watchdog.h"
 #include "web_server.h"
+#include "websocket_allocator.h"
+#include "websocket_frame.h"
+#include "websocket_sender.h"
 
 // For "ms" literal suffix
 using namespace std::chrono_literals;
@@ -40,6 +61,20 @@ const std::string HTML_MIMETYPE = "text/html";
 const std::string CSS_MIMETYPE = "text/css";
 const std::string JAVASCRIPT_MIMETYPE = "text/javascript";
 const std::string SVG_XML_MIMETYPE = "image/svg+xml";
+const std::string JSON_MIMETYPE = "application/json";
+const std::string PROMETHEUS_MIMETYPE = "text/plain; version=0.0.4";
+const std::string CSV_MIMETYPE = "text/csv";
+
+const uint64_t RETIRED_WEBSERVER_CHECK_INTERVAL_MS = 1000;
+
+// After a rebind the old server keeps serving its clients for this long, then it asks them to disconnect so that they reconnect to the new server
+const uint64_t RETIRED_WEBSERVER_GRACE_PERIOD_MS = 60000;
+
+// How long the clients get to disconnect before we close their sockets ourselves
+const uint64_t RETIRED_WEBSERVER_CLOSE_TIMEOUT_MS = 5000;
+
+const uint64_t DEFAULT_TRACE_SECONDS = 10;
+const uint64_t MAX_TRACE_SECONDS = 60;
 
 }
 
@@ -88,76 +123,125 @@ enum MHD_Result Server404NotFoundResponse(struct MHD_Connection* connection)
  * This struct is used to keep the data of a connected user.
  * It is passed to the socket-receive thread (cWebSocketRequestHandler::ClientReceiveThreadFunction) as well as to
  * the socket-send thread (cWebSocketRequestHandler::ClientSendThreadFunction).
- * It can also be accessed via the global array users (mutex protected).
+ * It can also be accessed via a snapshot of the global list of users, which keeps it alive until the snapshot is released.
  */
 struct ConnectedUser
 {
   ConnectedUser() :
     fd(-1),
+    daemon(nullptr),
     urh(nullptr),
     ws(nullptr),
     extra_in(nullptr),
     extra_in_size(0),
+    update_format(acdisplay::WEBSOCKET_UPDATE_FORMAT::TEXT),
+    telemetry_groups(acdisplay::TELEMETRY_CORE_GROUP),
+    wake_up_mutex(acdisplay::metrics.lock_wake_up),
     disconnect(false),
-    wake_up_notify(false)
+    close_connection(false),
+    wake_up_notify(false),
+    send_mutex(acdisplay::metrics.lock_send)
   {
   }
 
   /* the TCP/IP socket for reading/writing */
   MHD_socket fd;
+  // The server that this connection came from, so that a retired server can close its own connections
+  const struct MHD_Daemon* daemon;
   /* the UpgradeResponseHandle of libmicrohttpd (needed for closing the socket) */
   struct MHD_UpgradeResponseHandle* urh;
+  // Held while closing the socket, and by anything other than this connection's own threads that uses fd, so that it can't be closed and reused in the middle (This guards urh)
+  std::mutex close_mutex;
   /* the websocket encode/decode stream */
   struct MHD_WebSocketStream* ws;
   /* the possibly read data at the start (only used once) */
   char* extra_in;
   size_t extra_in_size;
-  /* specifies whether the websocket shall be closed (true)) or not (false) */
+  /* whether the client asked for binary car updates with ?format=binary, or batches of them with ?format=batch */
+  acdisplay::WEBSOCKET_UPDATE_FORMAT update_format;
+  /* the channel groups that the client asked for with ?groups=wheels,dynamics */
+  uint32_t telemetry_groups;
+
+  // Each connection has its own mutex for waking up its sender, so senders never wait for each other or for users connecting and disconnecting
+  acdisplay::cInstrumentedMutex wake_up_mutex;
+  /* specifies whether the websocket shall be closed (true)) or not (false) (This can only be modified when locked by the wake_up_mutex) */
   bool disconnect;
+  bool close_connection; // The sender should send a close frame and stop, the receive thread cleans up when the client closes the connection (This can only be modified when locked by the wake_up_mutex)
   /* condition variable to wake up the sender of this connection */
-  std::condition_variable wake_up_sender;
-  bool wake_up_notify; // Flag to tell the cWebSocketRequestHandler::ClientSendThreadFunction thread that it should wake up (This can only be modified when locked by the users_mutex)
+  std::condition_variable_any wake_up_sender;
+  bool wake_up_notify; // Flag to tell the cWebSocketRequestHandler::ClientSendThreadFunction thread that it should wake up (This can only be modified when locked by the wake_up_mutex)
 
   /* mutex to ensure that no send actions are mixed
      (sending can be done by send and recv thread;
-      may not be simultaneously locked with users_mutex by the same thread) */
-  std::mutex send_mutex;
+      may not be simultaneously locked with wake_up_mutex by the same thread) */
+  acdisplay::cInstrumentedMutex send_mutex;
 };
 
 
-/* the connected users data (May be accessed by all threads, but is protected by mutex) */
-std::mutex users_mutex;
-std::vector<ConnectedUser*> users;
+/* the connected users, the senders never use this, it is only iterated when shutting down and when the metrics are requested */
+util::cCopyOnWriteVector<std::shared_ptr<ConnectedUser>> users;
 
-/* specifies whether all websockets must close (1) or not (0) */
-volatile int disconnect_all = 0;
+/* specifies whether all websockets must close (true) or not (false) */
+std::atomic<bool> disconnect_all(false);
 
 
 namespace connected_users {
 
-static void AddUser(struct ConnectedUser* cu)
+static void AddUser(const std::shared_ptr<ConnectedUser>& cu)
 {
-  std::cout<<"AddUser"<<std::endl;
+  LOG_DEBUG<<"AddUser";
+
+  const size_t count = users.Add(cu);
 
-  // Lock the users mutex and add the user to the list
-  std::lock_guard<std::mutex> lock(users_mutex);
+  acdisplay::metrics.websocket_clients.Add(1);
+  acdisplay::metrics.websocket_clients_connected.Increment();
 
-  users.push_back(cu);
+  acdisplay::flight_recorder.Record("Websocket client " + std::to_string(cu->fd) + " connected, " + std::to_string(count) + " clients");
 }
 
-void RemoveUser(struct ConnectedUser* cu)
+void RemoveUser(const std::shared_ptr<ConnectedUser>& cu)
 {
-  std::cout<<"RemoveUser"<<std::endl;
+  LOG_DEBUG<<"RemoveUser";
 
-  // Lock the users mutex and remove the user from the list
-  std::lock_guard<std::mutex> lock(users_mutex);
+  size_t count = 0;
+  if (users.Remove(cu, count)) {
+    acdisplay::metrics.websocket_clients.Add(-1);
+    acdisplay::flight_recorder.Record("Websocket client " + std::to_string(cu->fd) + " disconnected, " + std::to_string(count) + " clients");
+  }
+}
 
-  for (size_t i = 0; i < users.size(); i++) {
-    if (users[i] == cu) {
-      users.erase(users.begin() + i);
-      break;
-    }
+// Wakes up the sender thread of this user, optionally telling it to disconnect
+void WakeUpSender(ConnectedUser& cu, bool disconnect)
+{
+  std::lock_guard lock(cu.wake_up_mutex);
+
+  if (disconnect) {
+    cu.disconnect = true;
   }
+  cu.wake_up_notify = true;
+  cu.wake_up_sender.notify_one();
+}
+
+// Closes the socket if it is still open, this also wakes up the receive thread if it is waiting
+void CloseSocket(ConnectedUser& cu)
+{
+  std::lock_guard<std::mutex> lock(cu.close_mutex);
+
+  if (cu.urh != nullptr) {
+    struct MHD_UpgradeResponseHandle* urh = cu.urh;
+    cu.urh = nullptr;
+    MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
+  }
+}
+
+// Tells the sender thread of this user to ask the client to close the connection
+void CloseConnection(ConnectedUser& cu)
+{
+  std::lock_guard lock(cu.wake_up_mutex);
+
+  cu.close_connection = true;
+  cu.wake_up_notify = true;
+  cu.wake_up_sender.notify_one();
 }
 
 }
@@ -191,10 +275,13 @@ static void SocketMakeBlocking(MHD_socket fd)
  * Sends all data of the given buffer via the TCP/IP socket
  *
  * @param fd  The TCP/IP socket which is used for sending
+ * @return    True if all of the data was sent
  */
-static void SocketSendAll(struct ConnectedUser& cu, std::string_view buffer)
+static bool SocketSendAll(struct ConnectedUser& cu, std::string_view buffer)
 {
-  std::lock_guard<std::mutex> lock(cu.send_mutex);
+  TRACE_SCOPE("socket_write");
+
+  std::lock_guard lock(cu.send_mutex);
 
   while (!buffer.empty()) {
     const ssize_t result = send(cu.fd, buffer.data(), int(buffer.length()), 0);
@@ -212,12 +299,27 @@ static void SocketSendAll(struct ConnectedUser& cu, std::string_view buffer)
 
     // Else there was a normal read, subtract what we read from the buffer
     buffer.remove_prefix(std::min<size_t>(buffer.length(), result));
+    acdisplay::metrics.websocket_bytes_sent.Increment(result);
   }
+
+  return buffer.empty();
 }
 
 }
 
 
+// Sends the frames for a websocket client to its socket
+class cConnectedUserFrameSink : public acdisplay::cWebSocketFrameSink {
+public:
+  explicit cConnectedUserFrameSink(struct ConnectedUser& _cu) : cu(_cu) {}
+
+  bool SendFrame(std::string_view frame) override { return network::SocketSendAll(cu, frame); }
+
+private:
+  struct ConnectedUser& cu;
+};
+
+
 namespace acdisplay {
 
 class cStaticResourcesRequestHandler {
@@ -239,7 +341,7 @@ bool cStaticResourcesRequestHandler::LoadStaticResource(const std::string& reque
 
   const size_t nMaxFileSizeBytes = 20 * 1024;
   if (!util::ReadFileIntoString(file_path, nMaxFileSizeBytes, resource.response_text)) {
-    std::cerr<<"File \""<<file_path<<"\" not found"<<std::endl;
+    LOG_ERROR<<"File \""<<file_path<<"\" not found";
     return false;
   }
 
@@ -272,7 +374,7 @@ bool cStaticResourcesRequestHandler::LoadStaticResources()
 
 bool cStaticResourcesRequestHandler::HandleRequest(struct MHD_Connection* connection, std::string_view url)
 {
-  std::cout<<"cStaticResourcesRequestHandler::HandleRequest "<<url<<std::endl;
+  LOG_DEBUG<<"cStaticResourcesRequestHandler::HandleRequest "<<url;
 
   // Handle static resources
   if (!url.empty() && (url[0] == '/')) {
@@ -294,6 +396,88 @@ bool cStaticResourcesRequestHandler::HandleRequest(struct MHD_Connection* connec
 
 
 
+namespace {
+
+// We don't queue messages ourselves, each sender thread blocks until its frame is written, so the send queue is the data sitting in each client's socket that hasn't been sent yet
+// NOTE: This is only calculated when the metrics are requested so it costs nothing on the hot path
+void AppendSendQueueMetrics(std::string& out)
+{
+  int64_t total_bytes = 0;
+  int64_t max_bytes = 0;
+
+  const auto snapshot = users.GetSnapshot();
+  for (auto&& user : *snapshot) {
+    // A user in the snapshot may have just disconnected, so hold its close mutex to make sure that the fd is still its socket and not one that has reused the number
+    std::lock_guard<std::mutex> lock(user->close_mutex);
+    if (user->urh == nullptr) {
+      continue;
+    }
+
+    int pending_bytes = 0;
+    if (ioctl(user->fd, SIOCOUTQ, &pending_bytes) == 0) {
+      total_bytes += pending_bytes;
+      max_bytes = std::max<int64_t>(max_bytes, pending_bytes);
+    }
+  }
+
+  AppendPrometheusGauge(out, "acdisplay_websocket_send_queue_bytes", "Bytes waiting to be sent to all websocket clients", total_bytes);
+  AppendPrometheusGauge(out, "acdisplay_websocket_send_queue_max_bytes", "Bytes waiting to be sent to the slowest websocket client", max_bytes);
+}
+
+}
+
+// Resources that are generated on each request, such as the session statistics
+class cDynamicResourcesRequestHandler {
+public:
+  bool HandleRequest(struct MHD_Connection* connection, std::string_view url);
+};
+
+bool cDynamicResourcesRequestHandler::HandleRequest(struct MHD_Connection* connection, std::string_view url)
+{
+  std::string response_text;
+  const std::string* response_mime_type = nullptr;
+
+  if (url == "/session_statistics") {
+    std::lock_guard<std::mutex> lock(mutex_session_statistics);
+    response_text = session_statistics.ToJSON();
+    response_mime_type = &JSON_MIMETYPE;
+  } else if (url == "/trace") {
+    // The last few seconds of spans from every thread, ?seconds=N
+    uint64_t seconds = DEFAULT_TRACE_SECONDS;
+    const char* seconds_value = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "seconds");
+    if (seconds_value != nullptr) {
+      seconds = util::clamp<uint64_t>(strtoull(seconds_value, nullptr, 10), 1, MAX_TRACE_SECONDS);
+    }
+
+    response_text = util::GetTraceJSON(seconds * 1000);
+    response_mime_type = &JSON_MIMETYPE;
+  } else if (url == "/telemetry.csv") {
+    // The latest value of every telemetry channel that is being filled in, the groups that no client is subscribed to would be stale
+    mutex_ac_data.lock();
+    const cTelemetry telemetry = ac_data.telemetry;
+    const uint32_t telemetry_groups = ac_data.telemetry_groups;
+    mutex_ac_data.unlock();
+
+    AppendTelemetryCSVHeader(GetTelemetryGroupChannels(telemetry_groups), response_text);
+    AppendTelemetryGroupsText(telemetry, telemetry_groups, ',', response_text);
+    response_text += '\n';
+    response_mime_type = &CSV_MIMETYPE;
+  } else if (url == "/metrics") {
+    metrics.ToPrometheus(response_text);
+    AppendSendQueueMetrics(response_text);
+    response_mime_type = &PROMETHEUS_MIMETYPE;
+  } else {
+    return false;
+  }
+
+  struct MHD_Response* response = MHD_create_response_from_buffer_copy(response_text.length(), response_text.c_str());
+  MHD_add_response_header(response, "Content-Type", response_mime_type->c_str());
+  ServerAddSecurityHeaders(response);
+  const int result = MHD_queue_response(connection, MHD_HTTP_OK, response);
+  MHD_destroy_response(response);
+  return (result == MHD_YES);
+}
+
 
 class cWebSocketRequestHandler {
 public:
@@ -313,9 +497,6 @@ private:
   static void* ClientReceiveThreadFunction(void* cls);
   static void* ClientSendThreadFunction(void* cls);
 
-  static void SendWebSocketMessage(struct ConnectedUser& user, std::string_view message);
-  static void SendWebSocketCarConfig(struct ConnectedUser& user);
-  static void SendWebSocketUpdate(struct ConnectedUser& user);
   static bool ReceiveWebSocket(struct ConnectedUser& cu, char* buf, size_t buf_len);
 };
 
@@ -375,10 +556,9 @@ void cWebSocketRequestHandler::UpgradeHandler(void* cls,
                  MHD_socket fd,
                  struct MHD_UpgradeResponseHandle* urh)
 {
-  std::cout<<"cWebSocketRequestHandler::UpgradeHandler"<<std::endl;
+  LOG_DEBUG<<"cWebSocketRequestHandler::UpgradeHandler";
 
   (void) cls;         /* Unused. Silent compiler warning. */
-  (void) connection;  /* Unused. Silent compiler warning. */
   (void) req_cls;     /* Unused. Silent compiler warning. */
 
   /* This callback must return as soon as possible. */
@@ -386,7 +566,7 @@ void cWebSocketRequestHandler::UpgradeHandler(void* cls,
   /* allocate new connected user */
   struct ConnectedUser* cu = new ConnectedUser;
   if (nullptr == cu) {
-    std::cerr<<"cWebSocketRequestHandler::UpgradeHandler Error allocating memory"<<std::endl;
+    LOG_ERROR<<"cWebSocketRequestHandler::UpgradeHandler Error allocating memory";
     return;
   }
 
@@ -397,9 +577,29 @@ void cWebSocketRequestHandler::UpgradeHandler(void* cls,
     memcpy(cu->extra_in, extra_in, extra_in_size);
   }
   cu->extra_in_size = extra_in_size;
+
+  // The client can ask for binary car updates, see resources/receive.js
+  const char* format = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "format");
+  if ((format != nullptr) && (strcmp(format, "binary") == 0)) {
+    cu->update_format = acdisplay::WEBSOCKET_UPDATE_FORMAT::BINARY;
+  } else if ((format != nullptr) && (strcmp(format, "batch") == 0)) {
+    cu->update_format = acdisplay::WEBSOCKET_UPDATE_FORMAT::BATCH;
+  }
+
+  // And more channels than the core ones, see ACDISPLAY_TELEMETRY_GROUPS
+  const char* groups = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "groups");
+  if (groups != nullptr) {
+    cu->telemetry_groups = acdisplay::ParseTelemetryGroups(groups);
+  }
+
   cu->fd = fd;
   cu->urh = urh;
 
+  const union MHD_ConnectionInfo* info = MHD_get_connection_info(connection, MHD_CONNECTION_INFO_DAEMON);
+  if (info != nullptr) {
+    cu->daemon = info->daemon;
+  }
+
   /* create thread for the new connected user */
   pthread_t pt;
   if (0 != pthread_create(&pt, nullptr, &ClientReceiveThreadFunction, cu))
@@ -407,68 +607,6 @@ void cWebSocketRequestHandler::UpgradeHandler(void* cls,
   pthread_detach(pt);
 }
 
-void cWebSocketRequestHandler::SendWebSocketMessage(struct ConnectedUser& user, std::string_view message)
-{
-  char* frame_data = nullptr;
-  size_t frame_len = 0;
-
-  const int status = MHD_websocket_encode_text(
-    user.ws,
-    message.data(), message.size(),
-    MHD_WEBSOCKET_FRAGMENTATION_NONE,
-    &frame_data, &frame_len,
-    nullptr
-  );
-  if (MHD_WEBSOCKET_STATUS_OK == status) {
-    network::SocketSendAll(user, std::string_view(frame_data, frame_len));
-
-    // Free the frame data
-    MHD_websocket_free(user.ws, frame_data);
-  }
-}
-
-void cWebSocketRequestHandler::SendWebSocketCarConfig(struct ConnectedUser& user)
-{
-  // Get a copy of the AC data
-  mutex_ac_data.lock();
-  const cACData copy = ac_data;
-  mutex_ac_data.unlock();
-
-  // Create our car config
-  const std::string message = "car_config|" +
-    std::to_string(copy.config_rpm_red_line) + "|" +
-    std::to_string(copy.config_rpm_maximum) + "|" +
-    std::to_string(copy.config_speedometer_red_line_kph) + "|" +
-    std::to_string(copy.config_speedometer_maximum_kph)
-  ;
-
-  SendWebSocketMessage(user, message);
-}
-
-void cWebSocketRequestHandler::SendWebSocketUpdate(struct ConnectedUser& user)
-{
-  // Get a copy of the AC data
-  mutex_ac_data.lock();
-  const cACData copy = ac_data;
-  mutex_ac_data.unlock();
-
-  // Create our car update
-  const std::string message = "car_update|" +
-    std::to_string(copy.gear) + "|" +
-    std::to_string(copy.accelerator_0_to_1) + "|" +
-    std::to_string(copy.brake_0_to_1) + "|" +
-    std::to_string(copy.clutch_0_to_1) + "|" +
-    std::to_string(copy.rpm) + "|" +
-    std::to_string(copy.speed_kmh) + "|" +
-    std::to_string(copy.lap_time_ms) + "|" +
-    std::to_string(copy.last_lap_ms) + "|" +
-    std::to_string(copy.best_lap_ms) + "|" +
-    std::to_string(copy.lap_count)
-  ;
-
-  SendWebSocketMessage(user, message);
-}
-
 /**
  * Sends messages from the message list over the TCP/IP socket
  * after encoding it with the websocket stream.
@@ -482,33 +620,42 @@ void cWebSocketRequestHandler::SendWebSocketUpdate(struct ConnectedUser& user)
  */
 void* cWebSocketRequestHandler::ClientSendThreadFunction(void* cls)
 {
-  std::cout<<"cWebSocketRequestHandler::ClientSendThreadFunction"<<std::endl;
+  LOG_DEBUG<<"cWebSocketRequestHandler::ClientSendThreadFunction";
+
+  ApplyLowLatencyThreadSettings(LOW_LATENCY_THREAD::WEBSOCKET);
+  util::SetTraceThreadName("websocket_sender");
 
   struct ConnectedUser& cu = *((ConnectedUser*)cls);
 
-  // Send the config once at the start
-  SendWebSocketCarConfig(cu);
+  cConnectedUserFrameSink sink(cu);
+  cWebSocketSender sender(sink, cu.fd, cu.update_format, cu.telemetry_groups);
+
+  // Send the channels and the config once at the start
+  sender.SendInitialMessages();
 
   std::chrono::high_resolution_clock::time_point last = std::chrono::high_resolution_clock::now();
 
   bool running = true;
 
-  // Lock the users mutex
-  std::unique_lock lock(users_mutex);
+  // Lock our wake up mutex, this is only shared with whoever wakes us up
+  std::unique_lock lock(cu.wake_up_mutex);
 
   while (running) {
     /* loop while not all messages processed */
     bool all_messages_read = false;
     while (running && !all_messages_read) {
-      if (1 == disconnect_all) {
+      if (disconnect_all.load()) {
         // The application is closing so we need to disconnect all users
-        if (cu.urh != nullptr) {
-          /* Close the TCP/IP socket. */
-          /* This will also wake-up the waiting receive-thread for this connected user. */
-          struct MHD_UpgradeResponseHandle* urh = cu.urh;
-          cu.urh = nullptr;
-          MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
-        }
+        /* Close the TCP/IP socket. */
+        /* This will also wake-up the waiting receive-thread for this connected user. */
+        connected_users::CloseSocket(cu);
+
+        running = false;
+      } else if (cu.close_connection) {
+        // Our server has been retired, tell the client that we are going away so that it closes the connection and can reconnect to the new server
+        std::string frame;
+        EncodeWebSocketCloseFrame(MHD_WEBSOCKET_CLOSEREASON_GOING_AWAY, frame);
+        network::SocketSendAll(cu, frame);
 
         running = false;
       } else if (cu.disconnect) {
@@ -530,21 +677,24 @@ void* cWebSocketRequestHandler::ClientSendThreadFunction(void* cls)
     /* Wait for wake up. */
     /* This will automatically unlock the mutex while waiting and */
     /* lock the mutex after waiting */
-    cu.wake_up_sender.wait_until(lock, std::chrono::system_clock::now() + 20ms, [&cu]{ return cu.wake_up_notify; });
+    // NOTE: The interval can be changed while we are running
+    // Batch clients get every sample anyway, so they can have fewer, bigger updates
+    const uint32_t update_interval_ms = ((cu.update_format == acdisplay::WEBSOCKET_UPDATE_FORMAT::BATCH) ? tunables.batch_interval_ms : tunables.update_interval_ms).load(std::memory_order_relaxed);
+    cu.wake_up_sender.wait_until(lock, std::chrono::system_clock::now() + std::chrono::milliseconds(update_interval_ms), [&cu]{ return cu.wake_up_notify; });
 
     const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
 
-    // Send an update every 20 milliseconds (Roughly)
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count() > 20) {
+    // Send an update every update interval (Roughly)
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count() > update_interval_ms) {
       lock.unlock();
-      SendWebSocketUpdate(cu);
+      sender.SendUpdate();
       lock.lock();
 
       last = now;
     }
   }
 
-  std::cout<<"cWebSocketRequestHandler::ClientSendThreadFunction returning"<<std::endl;
+  LOG_DEBUG<<"cWebSocketRequestHandler::ClientSendThreadFunction returning";
   return nullptr;
 }
 
@@ -558,7 +708,7 @@ void* cWebSocketRequestHandler::ClientSendThreadFunction(void* cls)
 */
 bool cWebSocketRequestHandler::ReceiveWebSocket(struct ConnectedUser& cu, char *buf, size_t buf_len)
 {
-  std::cout<<"cWebSocketRequestHandler::ReceiveWebSocket"<<std::endl;
+  LOG_DEBUG<<"cWebSocketRequestHandler::ReceiveWebSocket";
 
   size_t buf_offset = 0;
   while (buf_offset < buf_len) {
@@ -589,17 +739,9 @@ bool cWebSocketRequestHandler::ReceiveWebSocket(struct ConnectedUser& cu, char *
           /* if we receive a close frame, we will respond with one */
           MHD_websocket_free(cu.ws, frame_data);
           {
-            char *result = nullptr;
-            size_t result_len = 0;
-            int er = MHD_websocket_encode_close(cu.ws,
-                                                 MHD_WEBSOCKET_CLOSEREASON_REGULAR,
-                                                 nullptr,
-                                                 0,
-                                                 &result, &result_len);
-            if (MHD_WEBSOCKET_STATUS_OK == er) {
-              network::SocketSendAll(cu, std::string_view(result, result_len));
-              MHD_websocket_free(cu.ws, result);
-            }
+            std::string frame;
+            EncodeWebSocketCloseFrame(MHD_WEBSOCKET_CLOSEREASON_REGULAR, frame);
+            network::SocketSendAll(cu, frame);
           }
           return false;
 
@@ -627,22 +769,24 @@ bool cWebSocketRequestHandler::ReceiveWebSocket(struct ConnectedUser& cu, char *
  */
 void* cWebSocketRequestHandler::ClientReceiveThreadFunction(void* cls)
 {
-  std::cout<<"cWebSocketRequestHandler::ClientReceiveThreadFunction"<<std::endl;
-  struct ConnectedUser* cu = (ConnectedUser*)cls;
+  LOG_DEBUG<<"cWebSocketRequestHandler::ClientReceiveThreadFunction";
+  util::SetTraceThreadName("websocket_receiver");
+  // This thread owns the user, snapshots of the users list can keep it alive a little longer after we return
+  const std::shared_ptr<ConnectedUser> owner((ConnectedUser*)cls);
+  struct ConnectedUser* cu = owner.get();
 
   /* make the socket blocking */
   network::SocketMakeBlocking(cu->fd);
 
   /* add the user to the user list */
-  connected_users::AddUser(cu);
+  connected_users::AddUser(owner);
 
   /* initialize the web socket stream for encoding/decoding */
-  int result = MHD_websocket_stream_init(&cu->ws, MHD_WEBSOCKET_FLAG_SERVER | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0);
+  int result = acdisplay::CreateServerWebSocketStream(&cu->ws);
   if (MHD_WEBSOCKET_STATUS_OK != result) {
-    connected_users::RemoveUser(cu);
-    MHD_upgrade_action(cu->urh, MHD_UPGRADE_ACTION_CLOSE);
+    connected_users::CloseSocket(*cu);
     delete[] cu->extra_in;
-    delete cu;
+    connected_users::RemoveUser(owner);
     return nullptr;
   }
 
@@ -655,26 +799,17 @@ void* cWebSocketRequestHandler::ClientReceiveThreadFunction(void* cls)
   /* start by parsing extra data MHD may have already read, if any */
   if (0 != cu->extra_in_size) {
     if (!ReceiveWebSocket(*cu, cu->extra_in, cu->extra_in_size)) {
-      connected_users::RemoveUser(cu);
+      metrics.websocket_evictions.Increment();
+      flight_recorder.Record("Websocket client " + std::to_string(cu->fd) + " evicted after a protocol error");
 
-      {
-        std::lock_guard<std::mutex> lock(users_mutex);
-
-        cu->disconnect = true;
-        cu->wake_up_notify = true;
-        cu->wake_up_sender.notify_one();
-      }
+      connected_users::WakeUpSender(*cu, true);
 
       pthread_join(pt, nullptr);
 
-      if (cu->urh != nullptr) {
-        struct MHD_UpgradeResponseHandle* urh = cu->urh;
-        cu->urh = nullptr;
-        MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
-      }
+      connected_users::CloseSocket(*cu);
       MHD_websocket_stream_free(cu->ws);
       delete[] cu->extra_in;
-      delete cu;
+      connected_users::RemoveUser(owner);
       return nullptr;
     }
     delete[] cu->extra_in;
@@ -694,56 +829,36 @@ void* cWebSocketRequestHandler::ClientReceiveThreadFunction(void* cls)
     if (0 < got) {
       if (!ReceiveWebSocket(*cu, buf, size_t(got))) {
         /* A websocket protocol error occurred */
-        connected_users::RemoveUser(cu);
+        metrics.websocket_evictions.Increment();
+        flight_recorder.Record("Websocket client " + std::to_string(cu->fd) + " evicted after a protocol error");
 
-        {
-          std::lock_guard<std::mutex> lock(users_mutex);
-
-          cu->disconnect = true;
-          cu->wake_up_notify = true;
-          cu->wake_up_sender.notify_one();
-        }
+        connected_users::WakeUpSender(*cu, true);
 
         pthread_join(pt, nullptr);
-        if (cu->urh != nullptr) {
-          struct MHD_UpgradeResponseHandle* urh = cu->urh;
-          cu->urh = nullptr;
-          MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
-        }
+        connected_users::CloseSocket(*cu);
         MHD_websocket_stream_free(cu->ws);
-        delete cu;
+        connected_users::RemoveUser(owner);
         return nullptr;
       }
     }
   }
 
   /* cleanup */
-  connected_users::RemoveUser(cu);
-
-  {
-    std::lock_guard<std::mutex> lock(users_mutex);
-
-    cu->disconnect = true;
-    cu->wake_up_notify = true;
-    cu->wake_up_sender.notify_one();
-  }
+  connected_users::WakeUpSender(*cu, true);
 
   pthread_join(pt, nullptr);
 
-  if (cu->urh != nullptr) {
-    struct MHD_UpgradeResponseHandle* urh = cu->urh;  
-    cu->urh = nullptr;
-    MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
-  }
+  connected_users::CloseSocket(*cu);
   MHD_websocket_stream_free(cu->ws);
-  delete cu;
 
+  // Removed last, so a user is in the list until both of its threads are finished with the socket, see cWebServerManager::ReapRetiredWebServers
+  connected_users::RemoveUser(owner);
   return nullptr;
 }
 
 bool cWebSocketRequestHandler::HandleRequest(struct MHD_Connection* connection, std::string_view url, std::string_view version)
 {
-  std::cout<<"cWebSocketRequestHandler::HandleRequest "<<url<<std::endl;
+  LOG_DEBUG<<"cWebSocketRequestHandler::HandleRequest "<<url;
 
   struct MHD_Response *response = nullptr;
   int result = MHD_YES;
@@ -829,13 +944,25 @@ namespace acdisplay {
 
 class cWebServer {
 public:
-  cWebServer(cStaticResourcesRequestHandler& static_resources_request_handler, cWebSocketRequestHandler& web_socket_request_handler);
+  cWebServer(cStaticResourcesRequestHandler& static_resources_request_handler, cDynamicResourcesRequestHandler& dynamic_resources_request_handler, cWebSocketRequestHandler& web_socket_request_handler);
   ~cWebServer();
 
   bool Open(const util::cIPAddress& host, uint16_t port, const std::string& private_key, const std::string& public_cert);
   void NoMoreConnections();
   bool Close();
 
+  // The number of connections to this server, including websocket connections
+  size_t GetConnectionCount() const;
+
+  // Asks the websocket clients of this server to disconnect
+  void AskWebSocketClientsToDisconnect();
+
+  // Closes the sockets of the websocket clients of this server that are still connected
+  void CloseWebSocketSockets();
+
+  // Whether any websocket clients of this server still have threads using their sockets
+  bool HasWebSocketUsers() const;
+
 private:
   static enum MHD_Result _OnRequest(
     void* cls,
@@ -851,12 +978,14 @@ private:
   struct MHD_Daemon* daemon;
 
   cStaticResourcesRequestHandler& static_resources_request_handler;
+  cDynamicResourcesRequestHandler& dynamic_resources_request_handler;
   cWebSocketRequestHandler& web_socket_request_handler;
 };
 
-cWebServer::cWebServer(cStaticResourcesRequestHandler& _static_resources_request_handler, cWebSocketRequestHandler& _web_socket_request_handler) :
+cWebServer::cWebServer(cStaticResourcesRequestHandler& _static_resources_request_handler, cDynamicResourcesRequestHandler& _dynamic_resources_request_handler, cWebSocketRequestHandler& _web_socket_request_handler) :
   daemon(nullptr),
   static_resources_request_handler(_static_resources_request_handler),
+  dynamic_resources_request_handler(_dynamic_resources_request_handler),
   web_socket_request_handler(_web_socket_request_handler)
 {
 }
@@ -874,7 +1003,7 @@ bool cWebServer::Open(const util::cIPAddress& host, uint16_t port, const std::st
   struct sockaddr_in sad;
   memset(&sad, 0, sizeof(sad));
   if (inet_pton(AF_INET, address.c_str(), &(sad.sin_addr.s_addr)) != 1) {
-    std::cerr<<"V4 inet_pton fail for "<<address<<std::endl;
+    LOG_ERROR<<"V4 inet_pton fail for "<<address;
     return false;
   }
 
@@ -882,14 +1011,14 @@ bool cWebServer::Open(const util::cIPAddress& host, uint16_t port, const std::st
   sad.sin_port   = htons(port);
 
   if (!private_key.empty() && !public_cert.empty()) {
-    std::cout<<"cWebServer::Run Starting server at https://"<<address<<":"<<port<<"/"<<std::endl;
+    LOG_INFO<<"cWebServer::Run Starting server at https://"<<address<<":"<<port<<"/";
     std::string server_key;
     util::ReadFileIntoString(private_key, 10 * 1024, server_key);
     std::string server_cert;
     util::ReadFileIntoString(public_cert, 10 * 1024, server_cert);
 
     daemon = MHD_start_daemon(MHD_ALLOW_UPGRADE | MHD_USE_AUTO
-                          | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG
+                          | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ITC | MHD_USE_ERROR_LOG
                           | MHD_USE_TLS,
                           port,
                           nullptr, nullptr,
@@ -901,9 +1030,9 @@ bool cWebServer::Open(const util::cIPAddress& host, uint16_t port, const std::st
                           MHD_OPTION_LISTENING_ADDRESS_REUSE, 1, // Mainly for fuzz testing so that we can bind the port repeatedly in quick succession
                           MHD_OPTION_END);
   } else {
-    std::cout<<"cWebServer::Run Starting server at http://"<<address<<":"<<port<<"/"<<std::endl;
+    LOG_INFO<<"cWebServer::Run Starting server at http://"<<address<<":"<<port<<"/";
     daemon = MHD_start_daemon(MHD_ALLOW_UPGRADE | MHD_USE_AUTO
-                          | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+                          | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ITC | MHD_USE_ERROR_LOG,
                           port,
                           nullptr, nullptr,
                           &_OnRequest, this,
@@ -918,11 +1047,58 @@ bool cWebServer::Open(const util::cIPAddress& host, uint16_t port, const std::st
 
 void cWebServer::NoMoreConnections()
 {
+  // Stop accepting new connections, but keep serving the connections that we already have
   if (daemon != nullptr) {
-    MHD_quiesce_daemon(daemon);
+    const MHD_socket listen_fd = MHD_quiesce_daemon(daemon);
+    if (listen_fd != MHD_INVALID_SOCKET) {
+      close(listen_fd);
+    }
   }
 }
 
+size_t cWebServer::GetConnectionCount() const
+{
+  if (daemon == nullptr) {
+    return 0;
+  }
+
+  const union MHD_DaemonInfo* info = MHD_get_daemon_info(daemon, MHD_DAEMON_INFO_CURRENT_CONNECTIONS);
+  return (info != nullptr) ? size_t(info->num_connections) : 0;
+}
+
+void cWebServer::AskWebSocketClientsToDisconnect()
+{
+  const auto snapshot = users.GetSnapshot();
+  for (auto&& cu : *snapshot) {
+    if (cu->daemon == daemon) {
+      connected_users::CloseConnection(*cu);
+    }
+  }
+}
+
+void cWebServer::CloseWebSocketSockets()
+{
+  const auto snapshot = users.GetSnapshot();
+  for (auto&& cu : *snapshot) {
+    if (cu->daemon == daemon) {
+      connected_users::CloseSocket(*cu);
+    }
+  }
+}
+
+bool cWebServer::HasWebSocketUsers() const
+{
+  // Users are only removed once both of their threads are finished with the socket
+  const auto snapshot = users.GetSnapshot();
+  for (auto&& cu : *snapshot) {
+    if (cu->daemon == daemon) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool cWebServer::Close()
 {
   // Stop the server
@@ -965,7 +1141,9 @@ enum MHD_Result cWebServer::_OnRequest(
   void** req_cls
 )
 {
-  //std::cout<<"cWebServer::_OnRequest "<<url<<std::endl;
+  //LOG_DEBUG<<"cWebServer::_OnRequest "<<url;
+  TRACE_SCOPE("http_request");
+
   (void)upload_data;
   (void)upload_data_size;
 
@@ -986,7 +1164,7 @@ enum MHD_Result cWebServer::_OnRequest(
 
   cWebServer* pThis = static_cast<cWebServer*>(cls);
   if (pThis == nullptr) {
-    std::cerr<<"Error pThis is NULL"<<std::endl;
+    LOG_ERROR<<"Error pThis is NULL";
     return MHD_NO;
   }
 
@@ -995,6 +1173,11 @@ enum MHD_Result cWebServer::_OnRequest(
     return MHD_YES;
   }
 
+  // Handle dynamic resources
+  if (pThis->dynamic_resources_request_handler.HandleRequest(connection, url)) {
+    return MHD_YES;
+  }
+
   // Handle web socket requests
   if (pThis->web_socket_request_handler.HandleRequest(connection, url, version)) {
     return MHD_YES;
@@ -1009,13 +1192,107 @@ enum MHD_Result cWebServer::_OnRequest(
 
 cWebServerManager::cWebServerManager() :
   static_resources_request_handler(nullptr),
+  dynamic_resources_request_handler(nullptr),
   web_socket_request_handler(nullptr),
-  webserver(nullptr)
+  webserver(nullptr),
+  stop(false)
+{
+}
+
+bool cWebServerManager::Rebind(const util::cIPAddress& host, uint16_t port, const std::string& private_key, const std::string& public_cert)
 {
+  if (webserver == nullptr) {
+    LOG_ERROR<<"cWebServerManager::Rebind Error not created";
+    return false;
+  }
+
+  // Open the new listener first, if that fails we just keep the old one running
+  // NOTE: The listening socket uses address reuse, so the new one can bind the same port while the old one is still open
+  cWebServer* new_webserver = new cWebServer(*static_resources_request_handler, *dynamic_resources_request_handler, *web_socket_request_handler);
+  if (!new_webserver->Open(host, port, private_key, public_cert)) {
+    LOG_WARNING<<"cWebServerManager::Rebind Error opening web server, keeping the old one";
+    delete new_webserver;
+    return false;
+  }
+
+  // The old server stops accepting connections, but the clients that are connected to it keep going until they disconnect, or the grace period is over
+  webserver->NoMoreConnections();
+  {
+    std::lock_guard<std::mutex> lock(mutex_retired_webservers);
+    retired_webservers.push_back(cRetiredWebServer{ webserver, util::GetTimeMS(), 0 });
+  }
+  webserver = new_webserver;
+
+  LOG_INFO<<"cWebServerManager::Rebind Server is running";
+
+  return true;
+}
+
+void cWebServerManager::ReapRetiredWebServers(uint64_t now_ms)
+{
+  std::lock_guard<std::mutex> lock(mutex_retired_webservers);
+
+  for (auto iter = retired_webservers.begin(); iter != retired_webservers.end();) {
+    cRetiredWebServer& retired = *iter;
+
+    // Stopping the daemon frees its upgraded connections, so it is only stopped once every websocket user has closed its socket and its threads have finished
+    const bool has_websocket_users = retired.webserver->HasWebSocketUsers();
+    const bool drained = (retired.webserver->GetConnectionCount() == 0);
+    const bool timed_out = (retired.closing_clients_time_ms != 0) && ((now_ms - retired.closing_clients_time_ms) >= RETIRED_WEBSERVER_CLOSE_TIMEOUT_MS);
+    if (!has_websocket_users && (drained || timed_out)) {
+      LOG_INFO<<"cWebServerManager::ReapRetiredWebServers Stopping a retired server";
+      flight_recorder.Record("Stopped a retired web server");
+      delete retired.webserver;
+      iter = retired_webservers.erase(iter);
+      continue;
+    }
+
+    if (timed_out) {
+      // The clients that ignored the close frame, closing the socket wakes up the receive thread which then cleans up
+      retired.webserver->CloseWebSocketSockets();
+    } else if ((retired.closing_clients_time_ms == 0) && ((now_ms - retired.retired_time_ms) >= RETIRED_WEBSERVER_GRACE_PERIOD_MS)) {
+      LOG_INFO<<"cWebServerManager::ReapRetiredWebServers Asking the clients of a retired server to disconnect";
+      retired.webserver->AskWebSocketClientsToDisconnect();
+      retired.closing_clients_time_ms = now_ms;
+    }
+
+    iter++;
+  }
+}
+
+void cWebServerManager::ReaperMainLoop()
+{
+  util::SetTraceThreadName("webserver_reaper");
+
+  std::unique_lock<std::mutex> lock(mutex_stop);
+
+  while (!cv_stop.wait_for(lock, std::chrono::milliseconds(RETIRED_WEBSERVER_CHECK_INTERVAL_MS), [this]{ return stop; })) {
+    ReapRetiredWebServers(util::GetTimeMS());
+  }
+}
+
+void cWebServerManager::StopReaperThread()
+{
+  if (reaper_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_stop);
+      stop = true;
+    }
+    cv_stop.notify_one();
+
+    reaper_thread.join();
+  }
 }
 
 cWebServerManager::~cWebServerManager()
 {
+  StopReaperThread();
+
+  for (auto&& retired : retired_webservers) {
+    delete retired.webserver;
+  }
+  retired_webservers.clear();
+
   if (webserver != nullptr) {
     delete webserver;
     webserver = nullptr;
@@ -1026,6 +1303,11 @@ cWebServerManager::~cWebServerManager()
     web_socket_request_handler = nullptr;
   }
 
+  if (dynamic_resources_request_handler != nullptr) {
+    delete dynamic_resources_request_handler;
+    dynamic_resources_request_handler = nullptr;
+  }
+
   if (static_resources_request_handler != nullptr) {
     delete static_resources_request_handler;
     static_resources_request_handler = nullptr;
@@ -1036,14 +1318,16 @@ bool cWebServerManager::Create(const util::cIPAddress& host, uint16_t port, cons
 {
   if (
     (static_resources_request_handler != nullptr) ||
+    (dynamic_resources_request_handler != nullptr) ||
     (web_socket_request_handler != nullptr) ||
     (webserver != nullptr)
   ) {
-    std::cerr<<"Error already created"<<std::endl;
+    LOG_ERROR<<"Error already created";
     return false;
   }
 
   static_resources_request_handler = new cStaticResourcesRequestHandler;
+  dynamic_resources_request_handler = new cDynamicResourcesRequestHandler;
   web_socket_request_handler = new cWebSocketRequestHandler;
 
   // Load the static resources
@@ -1051,46 +1335,45 @@ bool cWebServerManager::Create(const util::cIPAddress& host, uint16_t port, cons
     return false;
   }
 
-  webserver = new cWebServer(*static_resources_request_handler, *web_socket_request_handler);
+  webserver = new cWebServer(*static_resources_request_handler, *dynamic_resources_request_handler, *web_socket_request_handler);
   if (!webserver->Open(host, port, private_key, public_cert)) {
-    std::cerr<<"Error opening web server"<<std::endl;
+    LOG_ERROR<<"Error opening web server";
     return false;
   }
 
-  std::cout<<"Server is running"<<std::endl;
+  reaper_thread = std::thread(&cWebServerManager::ReaperMainLoop, this);
+
+  LOG_INFO<<"Server is running";
 
   return true;
 };
 
 bool cWebServerManager::Destroy()
 {
-  std::cout<<"Shutting down the server"<<std::endl;
+  LOG_INFO<<"Shutting down the server";
+
+  StopReaperThread();
 
   webserver->NoMoreConnections();
 
   // Tell each connection to wake up and disconnect
+  disconnect_all = true;
   {
-    std::lock_guard<std::mutex> lock(users_mutex);
-
-    disconnect_all = 1;
-    for (auto&& cu : users) {
-      std::cout<<"Notifying a user connection"<<std::endl;
-      cu->wake_up_notify = true;
-      cu->wake_up_sender.notify_one();
+    const auto snapshot = users.GetSnapshot();
+    for (auto&& cu : *snapshot) {
+      LOG_DEBUG<<"Notifying a user connection";
+      connected_users::WakeUpSender(*cu, false);
     }
   }
 
   // Wait for the connection threads to respond
-  std::cout<<"Waiting for the connection threads to respond"<<std::endl;
+  LOG_INFO<<"Waiting for the connection threads to respond";
   sleep(2);
 
   // Tell each connection to close
-  std::cout<<"Closing connections"<<std::endl;
-  {
-    std::lock_guard<std::mutex> lock(users_mutex);
-    if (!users.empty()) {
-      std::cerr<<"Error there are still active connections"<<std::endl;
-    }
+  LOG_INFO<<"Closing connections";
+  if (!users.GetSnapshot()->empty()) {
+    LOG_ERROR<<"Error there are still active connections";
   }
 
   // Wait for the connection threads to close
@@ -1100,6 +1383,9 @@ bool cWebServerManager::Destroy()
   /* but we skip this in the example */
 
   webserver->Close();
+  for (auto&& retired : retired_webservers) {
+    retired.webserver->Close();
+  }
 
   return true;
 }
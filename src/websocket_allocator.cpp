@@ -0,0 +1,149 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <array>
+
+#include <microhttpd.h>
+#include <microhttpd_ws.h>
+
+#include "websocket_allocator.h"
+
+namespace {
+
+// Each block starts with its capacity, padded so that the memory we hand out is as aligned as malloc's
+struct alignas(std::max_align_t) cBlockHeader {
+  size_t capacity;
+};
+
+// Blocks are rounded up to a power of two so that slightly different sizes still reuse the same block
+const size_t MINIMUM_BLOCK_CAPACITY = 256;
+
+// The decoder only has a couple of frames in flight at a time
+const size_t CACHED_BLOCKS_PER_THREAD = 4;
+
+size_t GetBlockCapacity(size_t size)
+{
+  size_t capacity = MINIMUM_BLOCK_CAPACITY;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+
+  return capacity;
+}
+
+cBlockHeader* GetHeader(void* p)
+{
+  return static_cast<cBlockHeader*>(p) - 1;
+}
+
+class cBlockCache {
+public:
+  cBlockCache();
+  ~cBlockCache();
+
+  cBlockHeader* Take(size_t size);
+  bool Give(cBlockHeader* header);
+
+private:
+  std::array<cBlockHeader*, CACHED_BLOCKS_PER_THREAD> blocks;
+};
+
+cBlockCache::cBlockCache()
+{
+  blocks.fill(nullptr);
+}
+
+cBlockCache::~cBlockCache()
+{
+  for (auto&& block : blocks) {
+    free(block);
+  }
+}
+
+cBlockHeader* cBlockCache::Take(size_t size)
+{
+  for (auto&& block : blocks) {
+    if ((block != nullptr) && (block->capacity >= size)) {
+      cBlockHeader* header = block;
+      block = nullptr;
+      return header;
+    }
+  }
+
+  return nullptr;
+}
+
+bool cBlockCache::Give(cBlockHeader* header)
+{
+  for (auto&& block : blocks) {
+    if (block == nullptr) {
+      block = header;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Blocks can be freed on a different thread than they were allocated on, they just join that thread's cache
+thread_local cBlockCache block_cache;
+
+}
+
+namespace acdisplay {
+
+void* WebSocketMalloc(size_t size)
+{
+  cBlockHeader* header = block_cache.Take(size);
+  if (header == nullptr) {
+    const size_t capacity = GetBlockCapacity(size);
+    header = static_cast<cBlockHeader*>(malloc(sizeof(cBlockHeader) + capacity));
+    if (header == nullptr) {
+      return nullptr;
+    }
+
+    header->capacity = capacity;
+  }
+
+  return header + 1;
+}
+
+void* WebSocketRealloc(void* p, size_t size)
+{
+  if (p == nullptr) {
+    return WebSocketMalloc(size);
+  }
+
+  cBlockHeader* header = GetHeader(p);
+  if (header->capacity >= size) {
+    return p;
+  }
+
+  void* resized = WebSocketMalloc(size);
+  if (resized == nullptr) {
+    return nullptr;
+  }
+
+  memcpy(resized, p, header->capacity);
+  WebSocketFree(p);
+  return resized;
+}
+
+void WebSocketFree(void* p)
+{
+  if (p == nullptr) {
+    return;
+  }
+
+  cBlockHeader* header = GetHeader(p);
+  if (!block_cache.Give(header)) {
+    free(header);
+  }
+}
+
+int CreateServerWebSocketStream(struct MHD_WebSocketStream** out_ws)
+{
+  return MHD_websocket_stream_init2(out_ws, MHD_WEBSOCKET_FLAG_SERVER | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0, WebSocketMalloc, WebSocketRealloc, WebSocketFree, nullptr, nullptr);
+}
+
+}
@@ -0,0 +1,55 @@
+#include "websocket_frame.h"
+
+namespace {
+
+// The final fragment bit, we always send whole messages
+const uint8_t FIN = 0x80;
+
+// Payload lengths up to 125 fit in the second byte, the next two values mean a 16 or 64 bit length follows
+const size_t MAX_SHORT_PAYLOAD_LENGTH = 125;
+const uint8_t PAYLOAD_LENGTH_16 = 126;
+const uint8_t PAYLOAD_LENGTH_64 = 127;
+
+}
+
+namespace acdisplay {
+
+size_t WriteWebSocketFrameHeader(WEBSOCKET_OPCODE opcode, size_t payload_length, uint8_t (&out_header)[WEBSOCKET_MAX_FRAME_HEADER_BYTES])
+{
+  out_header[0] = FIN | uint8_t(opcode);
+
+  // The length is in network byte order
+  if (payload_length <= MAX_SHORT_PAYLOAD_LENGTH) {
+    out_header[1] = uint8_t(payload_length);
+    return 2;
+  } else if (payload_length <= UINT16_MAX) {
+    out_header[1] = PAYLOAD_LENGTH_16;
+    out_header[2] = uint8_t(payload_length >> 8);
+    out_header[3] = uint8_t(payload_length);
+    return 4;
+  }
+
+  out_header[1] = PAYLOAD_LENGTH_64;
+  const uint64_t length = payload_length;
+  for (size_t i = 0; i < 8; i++) {
+    out_header[2 + i] = uint8_t(length >> (56 - (8 * i)));
+  }
+  return 10;
+}
+
+void EncodeWebSocketFrame(WEBSOCKET_OPCODE opcode, std::string_view payload, std::string& out_frame)
+{
+  uint8_t header[WEBSOCKET_MAX_FRAME_HEADER_BYTES];
+  const size_t header_length = WriteWebSocketFrameHeader(opcode, payload.size(), header);
+
+  out_frame.assign(reinterpret_cast<const char*>(header), header_length);
+  out_frame.append(payload);
+}
+
+void EncodeWebSocketCloseFrame(uint16_t status_code, std::string& out_frame)
+{
+  const char payload[2] = { char(status_code >> 8), char(status_code & 0xFF) };
+  EncodeWebSocketFrame(WEBSOCKET_OPCODE::CLOSE, std::string_view(payload, sizeof(payload)), out_frame);
+}
+
+}
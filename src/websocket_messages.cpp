@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <string_view>
+
+#include "telemetry_channels.h"
+#include "util.h"
+#include "websocket_messages.h"
+
+namespace {
+
+template <typename T>
+void AppendField(std::string& out, T value)
+{
+  out += '|';
+  util::AppendNumber(out, value);
+}
+
+// Returns the length of the UTF-8 sequence at the start of text, or 0 if it isn't valid (Overlong, a surrogate, past U+10FFFF, or cut short)
+size_t GetUTF8SequenceLength(std::string_view text)
+{
+  const uint8_t first = uint8_t(text[0]);
+  if (first < 0x80) {
+    return 1;
+  }
+
+  size_t length = 0;
+  uint8_t second_minimum = 0x80;
+  uint8_t second_maximum = 0xBF;
+  if ((first >= 0xC2) && (first <= 0xDF)) {
+    length = 2;
+  } else if ((first >= 0xE0) && (first <= 0xEF)) {
+    length = 3;
+    if (first == 0xE0) {
+      second_minimum = 0xA0;
+    } else if (first == 0xED) {
+      second_maximum = 0x9F;
+    }
+  } else if ((first >= 0xF0) && (first <= 0xF4)) {
+    length = 4;
+    if (first == 0xF0) {
+      second_minimum = 0x90;
+    } else if (first == 0xF4) {
+      second_maximum = 0x8F;
+    }
+  } else {
+    return 0;
+  }
+
+  if (text.size() < length) {
+    return 0;
+  }
+
+  const uint8_t second = uint8_t(text[1]);
+  if ((second < second_minimum) || (second > second_maximum)) {
+    return 0;
+  }
+
+  for (size_t i = 2; i < length; i++) {
+    if ((uint8_t(text[i]) & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+
+  return length;
+}
+
+// Driver and car names come from the game, so make sure they can't break our message format
+// They also have to be valid UTF-8 because they are sent in text frames, anything that isn't is replaced with a '?'
+void AppendLeaderboardName(std::string& out, const std::string& name)
+{
+  std::string_view remaining(name);
+  while (!remaining.empty()) {
+    const size_t length = GetUTF8SequenceLength(remaining);
+    if (length == 0) {
+      out += '?';
+      remaining.remove_prefix(1);
+    } else if (length == 1) {
+      const char c = remaining[0];
+      out += ((c == '|') || (c == ',')) ? ' ' : c;
+      remaining.remove_prefix(1);
+    } else {
+      out.append(remaining.substr(0, length));
+      remaining.remove_prefix(length);
+    }
+  }
+}
+
+}
+
+namespace acdisplay {
+
+void FormatCarConfigMessage(const cACData& data, std::string& out)
+{
+  out = "car_config";
+  AppendField(out, data.config_rpm_red_line);
+  AppendField(out, data.config_rpm_maximum);
+  AppendField(out, data.config_speedometer_red_line_kph);
+  AppendField(out, data.config_speedometer_maximum_kph);
+}
+
+void FormatCarUpdateMessage(const cACData& data, std::string& out)
+{
+  out = "car_update|";
+  AppendTelemetryText<TELEMETRY_CAR_UPDATE_CHANNELS>(data.telemetry, '|', out);
+}
+
+void FormatCarUpdateMessage(const cACData& data, uint32_t telemetry_groups, std::string& out)
+{
+  out = "car_update|";
+  AppendTelemetryGroupsText(data.telemetry, telemetry_groups, '|', out);
+}
+
+void FormatCarUpdateBinaryMessage(const cACData& data, std::string& out)
+{
+  out.assign(1, char(BINARY_MESSAGE_TYPE::CAR_UPDATE));
+  AppendTelemetryBinary<TELEMETRY_CAR_UPDATE_CHANNELS>(data.telemetry, out);
+}
+
+void FormatCarUpdateBinaryMessage(const cACData& data, uint32_t telemetry_groups, std::string& out)
+{
+  out.assign(1, char(BINARY_MESSAGE_TYPE::CAR_UPDATE));
+  AppendTelemetryGroupsBinary(data.telemetry, telemetry_groups, out);
+}
+
+void FormatCarUpdateBatchBinaryMessage(const std::vector<cTelemetry>& samples, uint32_t telemetry_groups, std::string& out)
+{
+  const uint64_t base_time_us = samples.empty() ? 0 : samples.front().core.published_time_us;
+
+  out.assign(1, char(BINARY_MESSAGE_TYPE::CAR_UPDATE_BATCH));
+  out.resize(1 + sizeof(uint16_t) + sizeof(uint64_t) + (samples.size() * sizeof(uint32_t)));
+  char* position = out.data() + 1;
+  WriteTelemetryBinaryValue<uint16_t>(position, uint16_t(samples.size()), 1);
+  WriteTelemetryBinaryValue<uint64_t>(position, base_time_us, 1);
+  for (auto&& sample : samples) {
+    const uint64_t time_us = std::max(sample.core.published_time_us, base_time_us);
+    WriteTelemetryBinaryValue<uint32_t>(position, uint32_t(std::min<uint64_t>(time_us - base_time_us, UINT32_MAX)), 1);
+  }
+
+  AppendTelemetryGroupsBatchBinary(samples.data(), samples.size(), telemetry_groups, out);
+}
+
+void FormatTelemetryChannelsMessage(uint64_t mask, std::string& out)
+{
+  out = "telemetry_channels";
+  for (size_t i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+    if ((mask & (uint64_t(1) << i)) != 0) {
+      const cTelemetryChannelInfo& info = TELEMETRY_CHANNEL_INFO[i];
+      out += '|';
+      out += info.name;
+      out += ',';
+      out += info.binary_type;
+      out += ',';
+      util::AppendNumber(out, info.scale);
+      out += ',';
+      out += info.units;
+      out += ',';
+      util::AppendNumber(out, info.count);
+    }
+  }
+}
+
+void FormatSectorTimesMessage(const cSectorTimes& sector_times, std::string& out)
+{
+  out = "sector_times";
+  AppendField(out, sector_times.last_completed_sector);
+
+  for (auto&& sector_ms : sector_times.last_ms) {
+    AppendField(out, sector_ms);
+  }
+
+  for (auto&& sector_ms : sector_times.best_ms) {
+    AppendField(out, sector_ms);
+  }
+
+  AppendField(out, sector_times.theoretical_best_lap_ms);
+}
+
+void FormatTrackMapMessage(const cTrackMap& map, std::string& out)
+{
+  out = "track_map";
+  AppendField(out, TRACK_MAP_BIN_COUNT);
+
+  for (auto&& point : map.points) {
+    AppendField(out, point.bin);
+    out += ',';
+    util::AppendNumber(out, point.x);
+    out += ',';
+    util::AppendNumber(out, point.z);
+  }
+}
+
+void AppendLeaderboardRow(const cLeaderboardEntry& entry, std::string& out)
+{
+  util::AppendNumber(out, entry.car_identifier);
+  out += ',';
+  util::AppendNumber(out, entry.laps);
+  out += ',';
+  util::AppendNumber(out, entry.last_lap_ms);
+  out += ',';
+  util::AppendNumber(out, entry.best_lap_ms);
+  out += ',';
+  util::AppendNumber(out, entry.total_ms);
+  out += ',';
+  AppendLeaderboardName(out, entry.driver_name);
+  out += ',';
+  AppendLeaderboardName(out, entry.car_name);
+}
+
+std::string GetCarConfigMessage(const cACData& data)
+{
+  std::string message;
+  FormatCarConfigMessage(data, message);
+  return message;
+}
+
+std::string GetCarUpdateMessage(const cACData& data)
+{
+  std::string message;
+  FormatCarUpdateMessage(data, message);
+  return message;
+}
+
+std::string GetSectorTimesMessage(const cSectorTimes& sector_times)
+{
+  std::string message;
+  FormatSectorTimesMessage(sector_times, message);
+  return message;
+}
+
+std::string GetTrackMapMessage(const cTrackMap& map)
+{
+  std::string message;
+  FormatTrackMapMessage(map, message);
+  return message;
+}
+
+std::string GetLeaderboardRow(const cLeaderboardEntry& entry)
+{
+  std::string row;
+  AppendLeaderboardRow(entry, row);
+  return row;
+}
+
+}
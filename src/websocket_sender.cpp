@@ -0,0 +1,210 @@
+#include <string>
+
+#include "flight_recorder.h"
+#include "leaderboard.h"
+#include "metrics.h"
+#include "telemetry_history.h"
+#include "trace.h"
+#include "track_map.h"
+#include "util.h"
+#include "watchdog.h"
+#include "websocket_frame.h"
+#include "websocket_messages.h"
+#include "websocket_sender.h"
+
+namespace {
+
+// A send that takes longer than this is recorded in the flight recorder
+const uint64_t SLOW_WEBSOCKET_SEND_US = 50000;
+
+}
+
+namespace acdisplay {
+
+cWebSocketSender::cWebSocketSender(cWebSocketFrameSink& _sink, int _client_id, WEBSOCKET_UPDATE_FORMAT _update_format, uint32_t _telemetry_groups) :
+  sink(_sink),
+  client_id(_client_id),
+  update_format(_update_format),
+  telemetry_groups(_telemetry_groups | TELEMETRY_CORE_GROUP),
+  history_sequence(0),
+  car_config_sequence(0),
+  sector_times_sequence(0),
+  track_map_sequence(0),
+  leaderboard_sequence(0),
+  leaderboard_order_sequence(0)
+{
+  telemetry_subscriptions.Subscribe(telemetry_groups);
+
+  if (update_format == WEBSOCKET_UPDATE_FORMAT::BATCH) {
+    // Start from the next sample, and make room for as many samples as there can be so that we never allocate
+    telemetry_history.Subscribe();
+    history_sequence = telemetry_history.GetNextSequence();
+    batch_samples.reserve(TELEMETRY_HISTORY_SAMPLES);
+  }
+}
+
+cWebSocketSender::~cWebSocketSender()
+{
+  if (update_format == WEBSOCKET_UPDATE_FORMAT::BATCH) {
+    telemetry_history.Unsubscribe();
+  }
+
+  telemetry_subscriptions.Unsubscribe(telemetry_groups);
+}
+
+void cWebSocketSender::SendInitialMessages()
+{
+  FormatTelemetryChannelsMessage(GetTelemetryGroupChannels(telemetry_groups), message);
+  SendMessage(WEBSOCKET_OPCODE::TEXT);
+
+  mutex_ac_data.lock();
+  snapshot.CopyFrom(ac_data, telemetry_groups);
+  mutex_ac_data.unlock();
+
+  SendCarConfig(snapshot);
+}
+
+void cWebSocketSender::SendMessage(WEBSOCKET_OPCODE opcode)
+{
+  const uint64_t start_time_us = util::GetMonotonicTimeUS();
+
+  {
+    TRACE_SCOPE("websocket_encode");
+    EncodeWebSocketFrame(opcode, message, frame);
+  }
+
+  metrics.websocket_frames_encoded.Increment();
+
+  if (!sink.SendFrame(frame)) {
+    metrics.websocket_send_errors.Increment();
+  }
+
+  const uint64_t duration_us = util::GetMonotonicTimeUS() - start_time_us;
+  metrics.websocket_send_latency.Observe(duration_us);
+
+  if (duration_us > SLOW_WEBSOCKET_SEND_US) {
+    flight_recorder.Record("Slow websocket send to client " + std::to_string(client_id) + ", " + std::to_string(frame.size()) + " bytes took " + std::to_string(duration_us / 1000) + " ms");
+  }
+}
+
+void cWebSocketSender::SendCarConfig(const cACData& copy)
+{
+  FormatCarConfigMessage(copy, message);
+  SendMessage(WEBSOCKET_OPCODE::TEXT);
+  car_config_sequence = copy.config_sequence;
+}
+
+void cWebSocketSender::SendUpdate()
+{
+  TRACE_SCOPE("websocket_update");
+
+  // Get a copy of the AC data
+  mutex_ac_data.lock();
+  snapshot.CopyFrom(ac_data, telemetry_groups);
+  mutex_ac_data.unlock();
+
+  const cACData& copy = snapshot;
+
+  if (update_format == WEBSOCKET_UPDATE_FORMAT::BATCH) {
+    metrics.batch_samples_skipped.Increment(telemetry_history.Read(history_sequence, telemetry_groups, batch_samples));
+
+    // Nothing has been published since the last batch
+    if (!batch_samples.empty()) {
+      {
+        TRACE_SCOPE("websocket_format");
+        FormatCarUpdateBatchBinaryMessage(batch_samples, telemetry_groups, message);
+      }
+      SendMessage(WEBSOCKET_OPCODE::BINARY);
+      metrics.batch_samples_sent.Increment(batch_samples.size());
+    }
+  } else if (update_format == WEBSOCKET_UPDATE_FORMAT::BINARY) {
+    {
+      TRACE_SCOPE("websocket_format");
+      FormatCarUpdateBinaryMessage(copy, telemetry_groups, message);
+    }
+    SendMessage(WEBSOCKET_OPCODE::BINARY);
+  } else {
+    {
+      TRACE_SCOPE("websocket_format");
+      FormatCarUpdateMessage(copy, telemetry_groups, message);
+    }
+    SendMessage(WEBSOCKET_OPCODE::TEXT);
+  }
+
+  watchdog.Progress(WATCHDOG_STAGE::BROADCAST, util::GetMonotonicTimeUS() / 1000);
+
+  if (copy.telemetry.core.published_time_us != 0) {
+    metrics.sample_age_at_send.Observe(util::GetMonotonicTimeUS() - copy.telemetry.core.published_time_us);
+  }
+
+  // Send the config again if it has changed, for example when the shift points have been estimated
+  if (copy.config_sequence != car_config_sequence) {
+    SendCarConfig(copy);
+  }
+
+  // Send the sector times when a sector has been completed
+  if (copy.sector_times.sequence != sector_times_sequence) {
+    SendSectorTimes(copy.sector_times);
+    sector_times_sequence = copy.sector_times.sequence;
+  }
+
+  // Send the track map when we first connect and whenever it changes, after that the car position is just a bin index in each update
+  if (copy.track_map_sequence != track_map_sequence) {
+    SendTrackMap();
+    track_map_sequence = copy.track_map_sequence;
+  }
+
+  // Send the leaderboard when a lap event has changed it
+  if (copy.leaderboard_sequence != leaderboard_sequence) {
+    SendLeaderboard();
+  }
+}
+
+void cWebSocketSender::SendSectorTimes(const cSectorTimes& sector_times)
+{
+  FormatSectorTimesMessage(sector_times, message);
+  SendMessage(WEBSOCKET_OPCODE::TEXT);
+}
+
+void cWebSocketSender::SendTrackMap()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_track_map);
+    FormatTrackMapMessage(track_map, message);
+  }
+
+  SendMessage(WEBSOCKET_OPCODE::TEXT);
+}
+
+void cWebSocketSender::SendLeaderboard()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_leaderboard);
+
+    if (leaderboard.order_sequence != leaderboard_order_sequence) {
+      // The order changed so send the whole table in the new order
+      // leaderboard|car_id,laps,last_lap_ms,best_lap_ms,total_ms,driver,car|...
+      message = "leaderboard";
+      for (auto&& entry : leaderboard.GetEntries()) {
+        message += '|';
+        AppendLeaderboardRow(entry, message);
+      }
+    } else {
+      // Only send the rows that changed since we last sent anything to this client
+      message = "leaderboard_rows";
+      for (auto&& entry : leaderboard.GetEntries()) {
+        if (int32_t(entry.changed_sequence - leaderboard_sequence) > 0) {
+          message += '|';
+          AppendLeaderboardRow(entry, message);
+        }
+      }
+    }
+
+    leaderboard_sequence = leaderboard.sequence;
+    leaderboard_order_sequence = leaderboard.order_sequence;
+  }
+
+  SendMessage(WEBSOCKET_OPCODE::TEXT);
+}
+
+}
@@ -0,0 +1,128 @@
+#include <cmath>
+
+#if defined(__SSE2__) && !defined(ACDISPLAY_WHEEL_SLIP_SCALAR)
+#include <emmintrin.h>
+#endif
+
+#include "wheel_slip.h"
+
+namespace {
+
+// Below this speed the slip ratio is mostly noise, and it is infinite when stopped
+const float MIN_SPEED_MS = 3.0f;
+
+// A wheel with less load than this is in the air, so it is free to spin or stop
+const float MIN_LOAD_N = 50.0f;
+
+const float LOCKUP_ON_SLIP = -0.2f;
+const float LOCKUP_OFF_SLIP = -0.1f;
+const float WHEELSPIN_ON_SLIP = 0.2f;
+const float WHEELSPIN_OFF_SLIP = 0.1f;
+
+}
+
+namespace acdisplay {
+
+cWheelSlipDetector::cWheelSlipDetector()
+{
+  Reset();
+}
+
+void cWheelSlipDetector::Reset()
+{
+  state = 0;
+}
+
+#if defined(__SSE2__) && !defined(ACDISPLAY_WHEEL_SLIP_SCALAR)
+
+namespace {
+
+// Expand the low 4 bits of flags into a lane mask, all ones where the bit is set
+inline __m128 FlagsToMask(uint8_t flags)
+{
+  const __m128i bits = _mm_and_si128(_mm_set1_epi32(flags), _mm_setr_epi32(1, 2, 4, 8));
+  return _mm_castsi128_ps(_mm_cmpgt_epi32(bits, _mm_setzero_si128()));
+}
+
+}
+
+uint8_t cWheelSlipDetector::Update(float speed_ms, const float wheel_angular_speed[WHEEL_COUNT], const float tyre_radius[WHEEL_COUNT], const float load[WHEEL_COUNT])
+{
+  if (speed_ms < MIN_SPEED_MS) {
+    state = 0;
+    return state;
+  }
+
+  // The sign of the angular speed depends on the direction of travel, we only care about how fast the surface is moving
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  const __m128 angular_speed = _mm_and_ps(_mm_loadu_ps(wheel_angular_speed), abs_mask);
+  const __m128 surface_speed = _mm_mul_ps(angular_speed, _mm_loadu_ps(tyre_radius));
+
+  const __m128 speed = _mm_set1_ps(speed_ms);
+  const __m128 slip = _mm_mul_ps(_mm_sub_ps(surface_speed, speed), _mm_set1_ps(1.0f / speed_ms));
+
+  const __m128 on_ground = _mm_cmpge_ps(_mm_loadu_ps(load), _mm_set1_ps(MIN_LOAD_N));
+
+  // Start when we pass the on threshold, or carry on if we were already flagged and haven't come back past the off threshold
+  const __m128 was_locked = FlagsToMask(state & WHEEL_SLIP_LOCKUP_MASK);
+  const __m128 locked = _mm_and_ps(on_ground, _mm_or_ps(
+    _mm_cmplt_ps(slip, _mm_set1_ps(LOCKUP_ON_SLIP)),
+    _mm_and_ps(was_locked, _mm_cmplt_ps(slip, _mm_set1_ps(LOCKUP_OFF_SLIP)))
+  ));
+
+  const __m128 was_spinning = FlagsToMask(state >> WHEEL_SLIP_WHEELSPIN_SHIFT);
+  const __m128 spinning = _mm_and_ps(on_ground, _mm_or_ps(
+    _mm_cmpgt_ps(slip, _mm_set1_ps(WHEELSPIN_ON_SLIP)),
+    _mm_and_ps(was_spinning, _mm_cmpgt_ps(slip, _mm_set1_ps(WHEELSPIN_OFF_SLIP)))
+  ));
+
+  state = uint8_t(_mm_movemask_ps(locked) | (_mm_movemask_ps(spinning) << WHEEL_SLIP_WHEELSPIN_SHIFT));
+  return state;
+}
+
+#else
+
+uint8_t cWheelSlipDetector::Update(float speed_ms, const float wheel_angular_speed[WHEEL_COUNT], const float tyre_radius[WHEEL_COUNT], const float load[WHEEL_COUNT])
+{
+  return UpdateScalar(speed_ms, wheel_angular_speed, tyre_radius, load);
+}
+
+#endif
+
+uint8_t cWheelSlipDetector::UpdateScalar(float speed_ms, const float wheel_angular_speed[WHEEL_COUNT], const float tyre_radius[WHEEL_COUNT], const float load[WHEEL_COUNT])
+{
+  if (speed_ms < MIN_SPEED_MS) {
+    state = 0;
+    return state;
+  }
+
+  uint8_t new_state = 0;
+
+  for (size_t i = 0; i < WHEEL_COUNT; i++) {
+    if (load[i] < MIN_LOAD_N) {
+      continue;
+    }
+
+    // The sign of the angular speed depends on the direction of travel, we only care about how fast the surface is moving
+    const float surface_speed = std::fabs(wheel_angular_speed[i]) * tyre_radius[i];
+    // Multiply by the reciprocal like the SSE2 version does, so that both round the same way at the thresholds
+    const float slip = (surface_speed - speed_ms) * (1.0f / speed_ms);
+
+    const uint8_t lockup_bit = uint8_t(1 << i);
+    const bool was_locked = ((state & lockup_bit) != 0);
+    if ((slip < LOCKUP_ON_SLIP) || (was_locked && (slip < LOCKUP_OFF_SLIP))) {
+      new_state |= lockup_bit;
+    }
+
+    const uint8_t wheelspin_bit = uint8_t(1 << (i + WHEEL_SLIP_WHEELSPIN_SHIFT));
+    const bool was_spinning = ((state & wheelspin_bit) != 0);
+    if ((slip > WHEELSPIN_ON_SLIP) || (was_spinning && (slip > WHEELSPIN_OFF_SLIP))) {
+      new_state |= wheelspin_bit;
+    }
+  }
+
+  state = new_state;
+  return state;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+namespace util {
+
+// Every allocation is counted while allocation_counter.cpp is linked in, it interposes malloc, so this covers operator new as well as C libraries such as libmicrohttpd
+uint64_t GetAllocationCount();
+uint64_t GetAllocatedBytes();
+
+// Only the allocations made by the calling thread, this isn't disturbed by other threads such as the log writer
+uint64_t GetThreadAllocationCount();
+
+// The allocations made in one pipeline stage, the stage is the innermost TRACE_SCOPE when the allocation was made, see util::trace_scope_name
+class cAllocationStageCount {
+public:
+  cAllocationStageCount();
+
+  const char* stage; // nullptr for allocations outside of any TRACE_SCOPE
+  uint64_t count;
+  uint64_t bytes;
+};
+
+// The stages that have allocated anything since they were last reset
+std::vector<cAllocationStageCount> GetAllocationsByStage();
+void ResetAllocationsByStage();
+
+// For example "websocket_encode: 4 allocations, 512 bytes"
+std::string ToString(const std::vector<cAllocationStageCount>& stages);
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <acudp.hpp>
+
+#include "websocket_sender.h"
+
+// Assetto Corsa sends an update every physics frame, so this is a lap of about 100 seconds at 60 Hz
+const size_t SYNTHETIC_LAP_SAMPLES = 6000;
+
+// Made up laps, the car drives around a circle accelerating and braking through the gears
+std::vector<acudp_car_t> GetSyntheticLaps(size_t laps);
+
+// Counts the frames instead of writing them to a socket
+class cMemoryFrameSink : public acdisplay::cWebSocketFrameSink {
+public:
+  cMemoryFrameSink();
+
+  bool SendFrame(std::string_view frame) override;
+
+  uint64_t frames;
+  uint64_t bytes;
+};
+
+// A websocket client without a socket, its sender encodes the frames exactly like the web server does
+class cMemoryClient {
+public:
+  explicit cMemoryClient(int client_id, acdisplay::WEBSOCKET_UPDATE_FORMAT update_format = acdisplay::WEBSOCKET_UPDATE_FORMAT::TEXT, uint32_t telemetry_groups = acdisplay::TELEMETRY_CORE_GROUP);
+
+  cMemoryFrameSink sink;
+  std::unique_ptr<acdisplay::cWebSocketSender> sender;
+};
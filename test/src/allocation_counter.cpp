@@ -0,0 +1,202 @@
+#include <cerrno>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#include "allocation_counter.h"
+#include "trace.h"
+
+// We count allocations by interposing the C allocation functions and forwarding them to glibc's own allocator, so the heap is unchanged
+// This catches operator new, which calls malloc, as well as the C libraries that we use such as libmicrohttpd and json-c
+// NOTE: free doesn't need replacing because the memory still comes from the glibc heap
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+std::atomic<uint64_t> allocation_count(0);
+std::atomic<uint64_t> allocated_bytes(0);
+
+thread_local uint64_t thread_allocation_count = 0;
+
+// We can't allocate while counting an allocation, so the stages live in a fixed size table
+// Stage names are string literals, so we compare the pointers, a stage that doesn't fit in the table is counted as no stage
+const size_t MAX_STAGES = 64;
+
+class cStageSlot {
+public:
+  std::atomic<const char*> stage;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> bytes;
+};
+
+// Slot 0 is for allocations outside of any stage
+std::array<cStageSlot, MAX_STAGES> stages;
+std::atomic<size_t> stage_count(1);
+
+cStageSlot& GetStageSlot(const char* stage)
+{
+  if (stage == nullptr) {
+    return stages[0];
+  }
+
+  const size_t count = stage_count.load(std::memory_order_acquire);
+  for (size_t i = 1; i < count; i++) {
+    if (stages[i].stage.load(std::memory_order_relaxed) == stage) {
+      return stages[i];
+    }
+  }
+
+  // Claim a new slot, if two threads add the same stage at once it just ends up with two slots that are added together when reported
+  const size_t index = stage_count.fetch_add(1, std::memory_order_acq_rel);
+  if (index >= MAX_STAGES) {
+    stage_count.store(MAX_STAGES, std::memory_order_relaxed);
+    return stages[0];
+  }
+
+  stages[index].stage.store(stage, std::memory_order_release);
+  return stages[index];
+}
+
+void CountAllocation(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  thread_allocation_count++;
+
+  cStageSlot& slot = GetStageSlot(util::trace_scope_name);
+  slot.count.fetch_add(1, std::memory_order_relaxed);
+  slot.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept
+{
+  CountAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+  CountAllocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) noexcept
+{
+  CountAllocation(size);
+  return __libc_realloc(p, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+  CountAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out_p, size_t alignment, size_t size) noexcept
+{
+  // The alignment must be a power of two multiple of sizeof(void*)
+  if (((alignment % sizeof(void*)) != 0) || ((alignment & (alignment - 1)) != 0) || (alignment == 0)) {
+    return EINVAL;
+  }
+
+  CountAllocation(size);
+  void* p = __libc_memalign(alignment, size);
+  if (p == nullptr) {
+    return ENOMEM;
+  }
+
+  *out_p = p;
+  return 0;
+}
+
+}
+
+namespace util {
+
+uint64_t GetAllocationCount()
+{
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+uint64_t GetAllocatedBytes()
+{
+  return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t GetThreadAllocationCount()
+{
+  return thread_allocation_count;
+}
+
+cAllocationStageCount::cAllocationStageCount() :
+  stage(nullptr),
+  count(0),
+  bytes(0)
+{
+}
+
+std::vector<cAllocationStageCount> GetAllocationsByStage()
+{
+  // Read the table before creating the result, because creating the result allocates
+  std::array<cAllocationStageCount, MAX_STAGES> snapshot;
+  const size_t count = std::min(stage_count.load(std::memory_order_acquire), MAX_STAGES);
+  for (size_t i = 0; i < count; i++) {
+    snapshot[i].stage = stages[i].stage.load(std::memory_order_acquire);
+    snapshot[i].count = stages[i].count.load(std::memory_order_relaxed);
+    snapshot[i].bytes = stages[i].bytes.load(std::memory_order_relaxed);
+  }
+
+  std::vector<cAllocationStageCount> result;
+  for (size_t i = 0; i < count; i++) {
+    if (snapshot[i].count == 0) {
+      continue;
+    }
+
+    auto iter = std::find_if(result.begin(), result.end(), [&](const cAllocationStageCount& stage) { return (stage.stage == snapshot[i].stage); });
+    if (iter != result.end()) {
+      iter->count += snapshot[i].count;
+      iter->bytes += snapshot[i].bytes;
+    } else {
+      result.push_back(snapshot[i]);
+    }
+  }
+
+  return result;
+}
+
+void ResetAllocationsByStage()
+{
+  // The stages stay in the table, only their counts are reset
+  for (auto&& slot : stages) {
+    slot.count.store(0, std::memory_order_relaxed);
+    slot.bytes.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::string ToString(const std::vector<cAllocationStageCount>& stages)
+{
+  std::string result;
+  for (auto&& stage : stages) {
+    if (!result.empty()) {
+      result += ", ";
+    }
+
+    result += std::string((stage.stage != nullptr) ? stage.stage : "no stage") + ": " + std::to_string(stage.count) + " allocations, " + std::to_string(stage.bytes) + " bytes";
+  }
+
+  return result;
+}
+
+}
@@ -0,0 +1,94 @@
+// Standard headers
+#include <memory>
+#include <string>
+#include <vector>
+
+// gtest headers
+#include <gtest/gtest.h>
+
+// Application headers
+#include "allocation_counter.h"
+#include "car_update_processor.h"
+#include "synthetic_pipeline.h"
+#include "trace.h"
+
+namespace {
+
+const size_t CLIENTS = 4;
+
+void ProcessAndSend(acdisplay::cCarUpdateProcessor& processor, std::vector<std::unique_ptr<cMemoryClient>>& clients, const acudp_car_t& car)
+{
+  processor.ProcessUpdate(car, util::GetMonotonicTimeUS());
+
+  for (auto&& client : clients) {
+    client->sender->SendUpdate();
+  }
+}
+
+}
+
+TEST(Allocation, TestCountsByStage)
+{
+  // The first span on a thread allocates the thread's trace buffer
+  {
+    TRACE_SCOPE("allocation_test_warm_up");
+  }
+
+  util::ResetAllocationsByStage();
+
+  const uint64_t thread_allocations = util::GetThreadAllocationCount();
+  {
+    TRACE_SCOPE("allocation_test_stage");
+    std::unique_ptr<int> p = std::make_unique<int>(5);
+    EXPECT_EQ(5, *p);
+  }
+  EXPECT_EQ(thread_allocations + 1, util::GetThreadAllocationCount());
+
+  bool found = false;
+  for (auto&& stage : util::GetAllocationsByStage()) {
+    if ((stage.stage != nullptr) && (std::string(stage.stage) == "allocation_test_stage")) {
+      EXPECT_EQ(1, stage.count);
+      EXPECT_EQ(sizeof(int), stage.bytes);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+// Once everything has warmed up, receiving a sample and sending it to every client must not touch the heap
+TEST(Allocation, TestSteadyStateIsAllocationFree)
+{
+  acdisplay::cCarUpdateProcessor processor;
+
+  std::vector<std::unique_ptr<cMemoryClient>> clients;
+  for (size_t i = 0; i < CLIENTS; i++) {
+    clients.push_back(std::make_unique<cMemoryClient>(int(i)));
+  }
+
+  // And one of each of the other formats, with every channel
+  clients.push_back(std::make_unique<cMemoryClient>(int(CLIENTS), acdisplay::WEBSOCKET_UPDATE_FORMAT::BINARY, acdisplay::TELEMETRY_GROUP_MASK_ALL));
+  clients.push_back(std::make_unique<cMemoryClient>(int(CLIENTS + 1), acdisplay::WEBSOCKET_UPDATE_FORMAT::BATCH, acdisplay::TELEMETRY_GROUP_MASK_ALL));
+
+  // Warm up so that the gear ratios are estimated, every buffer has grown to its steady size, and the track map has been built and sent
+  // NOTE: The track map builder starts recording on the first lap change, so the map is only finished at the start of the third lap
+  const std::vector<acudp_car_t> samples = GetSyntheticLaps(5);
+  const size_t warm_up_samples = 3 * SYNTHETIC_LAP_SAMPLES;
+  for (size_t i = 0; i < warm_up_samples; i++) {
+    ProcessAndSend(processor, clients, samples[i]);
+  }
+
+  // Then measure a whole lap, including the sector and lap events
+  util::ResetAllocationsByStage();
+  const uint64_t allocations_at_start = util::GetThreadAllocationCount();
+
+  for (size_t i = warm_up_samples; i < warm_up_samples + SYNTHETIC_LAP_SAMPLES; i++) {
+    ProcessAndSend(processor, clients, samples[i]);
+  }
+
+  const uint64_t allocations = util::GetThreadAllocationCount() - allocations_at_start;
+  EXPECT_EQ(0, allocations)<<util::ToString(util::GetAllocationsByStage());
+
+  for (auto&& client : clients) {
+    EXPECT_LE(SYNTHETIC_LAP_SAMPLES, client->sink.frames);
+  }
+}
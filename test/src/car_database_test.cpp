@@ -0,0 +1,122 @@
+// Standard headers
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+// Application headers
+#include "ac_data.h"
+#include "car_database.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+void WriteFile(const std::string& file_path, const std::string& contents)
+{
+  // Write and rename like an editor would
+  const std::string temporary_file_path = file_path + ".tmp";
+  {
+    std::ofstream f(temporary_file_path);
+    f<<contents;
+  }
+  std::filesystem::rename(temporary_file_path, file_path);
+}
+
+std::string GetCarDatabaseJSON(int rpm_red_line)
+{
+  return "{ \"cars\": { \"ks_mazda_mx5_cup\": { \"rpm_red_line\": " + std::to_string(rpm_red_line) + ", \"rpm_maximum\": 7500, \"speedometer_red_line_kph\": 200.5, \"speedometer_maximum_kph\": 220 } } }";
+}
+
+// Wait for the file watcher to notice the change and apply it
+bool WaitForRedLine(float rpm_red_line)
+{
+  for (size_t i = 0; i < 100; i++) {
+    {
+      std::lock_guard lock(mutex_ac_data);
+      if (ac_data.config_rpm_red_line == rpm_red_line) {
+        return true;
+      }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  return false;
+}
+
+}
+
+TEST(CarDatabase, TestLoad)
+{
+  acdisplay::cCarDatabase database;
+  ASSERT_TRUE(database.LoadFromString(
+    "{ \"cars\": {"
+    "  \"ks_mazda_mx5_cup\": { \"rpm_red_line\": 7000, \"rpm_maximum\": 7500, \"speedometer_red_line_kph\": 200.5, \"speedometer_maximum_kph\": 220 },"
+    "  \"missing_fields\": { \"rpm_red_line\": 7000 },"
+    "  \"negative\": { \"rpm_red_line\": -1, \"rpm_maximum\": 7500, \"speedometer_red_line_kph\": 200, \"speedometer_maximum_kph\": 220 }"
+    "} }"
+  ));
+
+  EXPECT_EQ(1, database.GetCount());
+  EXPECT_EQ(nullptr, database.Find("missing_fields"));
+  EXPECT_EQ(nullptr, database.Find("negative"));
+  EXPECT_EQ(nullptr, database.Find("ks_ferrari_f2004"));
+
+  const acdisplay::cCarConfig* config = database.Find("ks_mazda_mx5_cup");
+  ASSERT_NE(nullptr, config);
+  EXPECT_FLOAT_EQ(7000.0f, config->rpm_red_line);
+  EXPECT_FLOAT_EQ(7500.0f, config->rpm_maximum);
+  EXPECT_FLOAT_EQ(200.5f, config->speedometer_red_line_kph);
+  EXPECT_FLOAT_EQ(220.0f, config->speedometer_maximum_kph);
+
+  EXPECT_FALSE(database.LoadFromString("{ \"not_cars\": {} }"));
+  EXPECT_FALSE(database.LoadFromString("not json"));
+}
+
+TEST(CarDatabase, TestApplyAndReload)
+{
+  const std::filesystem::path folder = std::filesystem::temp_directory_path() / "ac_display_car_database_test";
+  std::filesystem::create_directories(folder);
+  const std::string file_path = (folder / "car_database.json").string();
+  WriteFile(file_path, GetCarDatabaseJSON(6800));
+
+  uint32_t config_sequence = 0;
+  {
+    std::lock_guard lock(mutex_ac_data);
+    config_sequence = ac_data.config_sequence;
+  }
+
+  acdisplay::cCarDatabaseManager manager;
+  ASSERT_TRUE(manager.Start(file_path));
+  manager.SetCurrentCar("ks_mazda_mx5_cup");
+
+  {
+    std::lock_guard lock(mutex_ac_data);
+    EXPECT_FLOAT_EQ(6800.0f, ac_data.config_rpm_red_line);
+    EXPECT_FLOAT_EQ(7500.0f, ac_data.config_rpm_maximum);
+    EXPECT_FALSE(ac_data.config_automatic);
+    EXPECT_NE(config_sequence, ac_data.config_sequence);
+  }
+
+  // Changing the file is applied straight away
+  WriteFile(file_path, GetCarDatabaseJSON(6900));
+  EXPECT_TRUE(WaitForRedLine(6900.0f));
+
+  // Cars that aren't in the database go back to being estimated, starting from the defaults rather than the previous car's config
+  manager.SetCurrentCar("ks_ferrari_f2004");
+  {
+    const cACDataState defaults;
+    std::lock_guard lock(mutex_ac_data);
+    EXPECT_TRUE(ac_data.config_automatic);
+    EXPECT_FLOAT_EQ(defaults.config_rpm_red_line, ac_data.config_rpm_red_line);
+    EXPECT_FLOAT_EQ(defaults.config_rpm_maximum, ac_data.config_rpm_maximum);
+    EXPECT_FLOAT_EQ(defaults.config_speedometer_red_line_kph, ac_data.config_speedometer_red_line_kph);
+    EXPECT_FLOAT_EQ(defaults.config_speedometer_maximum_kph, ac_data.config_speedometer_maximum_kph);
+    EXPECT_FLOAT_EQ(defaults.config_shift_lights.flash_rpm, ac_data.config_shift_lights.flash_rpm);
+  }
+
+  manager.Stop();
+  std::filesystem::remove_all(folder);
+}
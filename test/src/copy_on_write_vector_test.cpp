@@ -0,0 +1,94 @@
+// Standard headers
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Application headers
+#include "copy_on_write_vector.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(CopyOnWriteVector, TestAddRemove)
+{
+  util::cCopyOnWriteVector<int> vector;
+  EXPECT_TRUE(vector.GetSnapshot()->empty());
+
+  EXPECT_EQ(1, vector.Add(1));
+  EXPECT_EQ(2, vector.Add(2));
+  EXPECT_EQ(3, vector.Add(3));
+
+  // A snapshot doesn't change when the vector does
+  const auto snapshot = vector.GetSnapshot();
+
+  size_t size = 0;
+  EXPECT_TRUE(vector.Remove(2, size));
+  EXPECT_EQ(2, size);
+  EXPECT_FALSE(vector.Remove(2, size));
+  EXPECT_EQ(2, size);
+
+  EXPECT_EQ(std::vector<int>({ 1, 2, 3 }), *snapshot);
+  EXPECT_EQ(std::vector<int>({ 1, 3 }), *vector.GetSnapshot());
+}
+
+TEST(CopyOnWriteVector, TestSnapshotKeepsItemsAlive)
+{
+  util::cCopyOnWriteVector<std::shared_ptr<int>> vector;
+
+  std::shared_ptr<int> item = std::make_shared<int>(5);
+  std::weak_ptr<int> weak_item = item;
+  vector.Add(item);
+
+  auto snapshot = vector.GetSnapshot();
+
+  size_t size = 0;
+  EXPECT_TRUE(vector.Remove(item, size));
+  item.reset();
+
+  // The snapshot is the only owner now
+  ASSERT_FALSE(weak_item.expired());
+  EXPECT_EQ(5, *snapshot->front());
+
+  snapshot.reset();
+  EXPECT_TRUE(weak_item.expired());
+}
+
+TEST(CopyOnWriteVector, TestConcurrentReaders)
+{
+  util::cCopyOnWriteVector<std::shared_ptr<int>> vector;
+
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> snapshots(0);
+
+  // Readers iterate without locking while the writer adds and removes items
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; i++) {
+    readers.emplace_back([&vector, &stop, &snapshots]() {
+      while (!stop) {
+        const auto snapshot = vector.GetSnapshot();
+        for (auto&& item : *snapshot) {
+          EXPECT_EQ(7, *item);
+        }
+        snapshots++;
+      }
+    });
+  }
+
+  for (size_t i = 0; i < 1000; i++) {
+    std::shared_ptr<int> item = std::make_shared<int>(7);
+    vector.Add(item);
+    size_t size = 0;
+    if ((i % 2) == 0) {
+      EXPECT_TRUE(vector.Remove(item, size));
+    }
+  }
+
+  stop = true;
+  for (auto&& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(500, vector.GetSnapshot()->size());
+  EXPECT_LT(0, snapshots.load());
+}
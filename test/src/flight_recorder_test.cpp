@@ -0,0 +1,54 @@
+// Standard headers
+#include <string>
+#include <vector>
+
+// Application headers
+#include "flight_recorder.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+bool EndsWith(const std::string& text, const std::string& suffix)
+{
+  return (text.length() >= suffix.length()) && (text.compare(text.length() - suffix.length(), suffix.length(), suffix) == 0);
+}
+
+}
+
+TEST(FlightRecorder, TestRecord)
+{
+  acdisplay::cFlightRecorder recorder;
+  EXPECT_TRUE(recorder.GetEvents().empty());
+
+  recorder.Record("Websocket client 5 connected, 1 clients");
+  recorder.Record("ACUDP packet gap of 750 ms");
+
+  const std::vector<std::string> events = recorder.GetEvents();
+  ASSERT_EQ(2, events.size());
+  EXPECT_TRUE(EndsWith(events[0], " Websocket client 5 connected, 1 clients"));
+  EXPECT_TRUE(EndsWith(events[1], " ACUDP packet gap of 750 ms"));
+
+  // Long events are truncated
+  recorder.Clear();
+  recorder.Record(std::string(1000, 'a'));
+  ASSERT_EQ(1, recorder.GetEvents().size());
+  EXPECT_TRUE(EndsWith(recorder.GetEvents()[0], " " + std::string(acdisplay::FLIGHT_RECORDER_EVENT_MAX_LENGTH, 'a')));
+}
+
+TEST(FlightRecorder, TestWrap)
+{
+  acdisplay::cFlightRecorder recorder;
+
+  const size_t count = acdisplay::FLIGHT_RECORDER_EVENT_COUNT + 10;
+  for (size_t i = 0; i < count; i++) {
+    recorder.Record("Event " + std::to_string(i));
+  }
+
+  // The oldest events are overwritten
+  const std::vector<std::string> events = recorder.GetEvents();
+  ASSERT_EQ(acdisplay::FLIGHT_RECORDER_EVENT_COUNT, events.size());
+  EXPECT_TRUE(EndsWith(events.front(), " Event 10"));
+  EXPECT_TRUE(EndsWith(events.back(), " Event " + std::to_string(count - 1)));
+}
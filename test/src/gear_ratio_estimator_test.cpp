@@ -0,0 +1,150 @@
+// Standard headers
+#include <cmath>
+
+#include <array>
+#include <limits>
+
+// Application headers
+#include "gear_ratio_estimator.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+// A simple car with a torque curve that peaks at 5000 rpm and a rev limiter at 7500 rpm
+const std::array<float, 7> ratios = { 0.0f, 0.0f, 80.0f, 55.0f, 42.0f, 34.0f, 28.0f };
+const uint8_t top_gear = 6;
+const float limiter_rpm = 7500.0f;
+
+float GetTorque(float rpm)
+{
+  const float x = (rpm - 5000.0f) / 4000.0f;
+  return 1.0f - (x * x);
+}
+
+float GetAcceleration(uint8_t gear, float speed_kmh)
+{
+  const float rpm = ratios[gear] * speed_kmh;
+  const float drive = (rpm < limiter_rpm) ? (0.1f * GetTorque(rpm) * ratios[gear]) : 0.0f;
+  return drive - (0.00005f * speed_kmh * speed_kmh);
+}
+
+// The rpm where the next gear accelerates harder at the same speed, worked out from the model
+float GetExpectedUpshiftRPM(uint8_t gear)
+{
+  for (float rpm = 3000.0f; rpm < limiter_rpm; rpm += 10.0f) {
+    const float speed_kmh = rpm / ratios[gear];
+    if (GetAcceleration(gear + 1, speed_kmh) > GetAcceleration(gear, speed_kmh)) {
+      return rpm;
+    }
+  }
+
+  return limiter_rpm;
+}
+
+}
+
+TEST(GearRatioEstimator, TestGearEstimateRatio)
+{
+  acdisplay::cGearEstimate estimate;
+  EXPECT_FALSE(estimate.IsRatioConverged());
+
+  for (size_t i = 0; i < 100; i++) {
+    const float speed_kmh = 30.0f + float(i);
+    const float noise = ((i % 2) == 0) ? 20.0f : -20.0f;
+    estimate.AddRatioSample(speed_kmh, (50.0f * speed_kmh) + noise);
+  }
+
+  EXPECT_TRUE(estimate.IsRatioConverged());
+  EXPECT_NEAR(50.0f, estimate.GetRatio(), 0.1f);
+
+  // Wheelspin is ignored once the ratio is known
+  for (size_t i = 0; i < 100; i++) {
+    estimate.AddRatioSample(60.0f, 6000.0f);
+  }
+
+  EXPECT_NEAR(50.0f, estimate.GetRatio(), 0.1f);
+}
+
+TEST(GearRatioEstimator, TestGearEstimateAcceleration)
+{
+  acdisplay::cGearEstimate estimate;
+
+  float acceleration_ms2 = 0.0f;
+  EXPECT_FALSE(estimate.GetAcceleration(4100.0f, acceleration_ms2));
+
+  for (size_t i = 0; i < 3; i++) {
+    estimate.AddAccelerationSample(4100.0f, 5.0f);
+    estimate.AddAccelerationSample(4400.0f, 6.0f);
+  }
+
+  // Bucket centres are at 4125 and 4375, in between we interpolate
+  EXPECT_TRUE(estimate.GetAcceleration(4125.0f, acceleration_ms2));
+  EXPECT_FLOAT_EQ(5.0f, acceleration_ms2);
+  EXPECT_TRUE(estimate.GetAcceleration(4250.0f, acceleration_ms2));
+  EXPECT_FLOAT_EQ(5.5f, acceleration_ms2);
+  EXPECT_FALSE(estimate.GetAcceleration(5000.0f, acceleration_ms2));
+
+  // Garbage rpm values are ignored rather than indexing out of range
+  const float nan = std::nanf("");
+  const float infinity = std::numeric_limits<float>::infinity();
+  for (float rpm : { -100.0f, nan, infinity, 1.0e30f }) {
+    estimate.AddAccelerationSample(rpm, 100.0f);
+    EXPECT_FALSE(estimate.GetAcceleration(rpm, acceleration_ms2));
+  }
+  EXPECT_TRUE(estimate.GetAcceleration(4125.0f, acceleration_ms2));
+  EXPECT_FLOAT_EQ(5.0f, acceleration_ms2);
+}
+
+TEST(GearRatioEstimator, TestEstimateUpshiftPoints)
+{
+  acdisplay::cGearRatioEstimator estimator;
+
+  const uint32_t step_ms = 20;
+  uint32_t lap_time_ms = 0;
+  bool changed = false;
+
+  // Accelerate through the gears a few times, changing up at different rpms like a driver would
+  for (float shift_rpm : { 6000.0f, 6500.0f, 7000.0f, 7450.0f, 6000.0f, 6500.0f, 7000.0f, 7450.0f }) {
+    uint8_t gear = 2;
+    float speed_kmh = 25.0f;
+
+    for (uint32_t run_ms = 0; run_ms < 30000; run_ms += step_ms) {
+      float rpm = ratios[gear] * speed_kmh;
+      if ((gear < top_gear) && (rpm >= shift_rpm)) {
+        // Clutch in for a moment to change gear
+        changed |= estimator.Update(gear, rpm, speed_kmh, 0.0f, 0.0f, 0.0f, lap_time_ms, 0, 0);
+        lap_time_ms += step_ms;
+        gear++;
+        rpm = ratios[gear] * speed_kmh;
+      }
+
+      changed |= estimator.Update(gear, rpm, speed_kmh, 1.0f, 0.0f, 1.0f, lap_time_ms, 0, 0);
+
+      speed_kmh += 3.6f * GetAcceleration(gear, speed_kmh) * (float(step_ms) / 1000.0f);
+      lap_time_ms += step_ms;
+    }
+
+    // Back to neutral before the next run
+    changed |= estimator.Update(1, 1000.0f, 0.0f, 0.0f, 0.0f, 1.0f, lap_time_ms, 0, 0);
+    lap_time_ms += step_ms;
+  }
+
+  EXPECT_TRUE(changed);
+
+  for (uint8_t gear = 2; gear <= top_gear; gear++) {
+    EXPECT_NEAR(ratios[gear], estimator.GetRatio(gear), 0.01f * ratios[gear]);
+  }
+
+  EXPECT_FLOAT_EQ(0.0f, estimator.GetRatio(7));
+  EXPECT_GT(estimator.GetMaximumRPM(), 7400.0f);
+  EXPECT_LE(estimator.GetMaximumRPM(), limiter_rpm);
+
+  for (uint8_t gear = 2; gear < 5; gear++) {
+    EXPECT_NEAR(GetExpectedUpshiftRPM(gear), estimator.GetUpshiftRPM(gear), 300.0f) << "gear " << int(gear);
+  }
+
+  // There is nothing to change up to from the top gear
+  EXPECT_FLOAT_EQ(0.0f, estimator.GetUpshiftRPM(top_gear));
+}
@@ -0,0 +1,101 @@
+// Standard headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Application headers
+#include "instrumented_mutex.h"
+#include "metrics.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(InstrumentedMutex, TestUncontended)
+{
+  acdisplay::cLockMetrics lock_metrics;
+  acdisplay::cInstrumentedMutex mutex(lock_metrics);
+
+  {
+    std::lock_guard lock(mutex);
+  }
+  {
+    std::unique_lock lock(mutex);
+  }
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+
+  EXPECT_EQ(3, lock_metrics.acquisitions.Get());
+  EXPECT_EQ(0, lock_metrics.contended.Get());
+  EXPECT_EQ(0, lock_metrics.wait_time.GetCount());
+  EXPECT_EQ(3, lock_metrics.hold_time.GetCount());
+}
+
+TEST(InstrumentedMutex, TestContended)
+{
+  acdisplay::cLockMetrics lock_metrics;
+  acdisplay::cInstrumentedMutex mutex(lock_metrics);
+
+  std::atomic<bool> waiting(false);
+
+  mutex.lock();
+
+  std::thread thread([&mutex, &waiting]() {
+    waiting = true;
+    std::lock_guard lock(mutex);
+  });
+
+  // Hold the lock for long enough that the other thread has to wait
+  while (!waiting) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(mutex.try_lock());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  mutex.unlock();
+
+  thread.join();
+
+  EXPECT_EQ(2, lock_metrics.acquisitions.Get());
+  EXPECT_EQ(1, lock_metrics.contended.Get());
+  EXPECT_EQ(1, lock_metrics.wait_time.GetCount());
+  EXPECT_EQ(2, lock_metrics.hold_time.GetCount());
+
+  // The hold of at least 20 ms was recorded in the 25 ms bucket or above
+  uint64_t long_holds = 0;
+  for (size_t i = 10; i <= acdisplay::LATENCY_HISTOGRAM_BUCKETS_US.size(); i++) {
+    long_holds += lock_metrics.hold_time.GetBucketCount(i);
+  }
+  EXPECT_EQ(1, long_holds);
+
+  std::string out;
+  lock_metrics.ToPrometheus(out, "test");
+  EXPECT_NE(std::string::npos, out.find("acdisplay_lock_test_acquisitions_total 2\n"));
+  EXPECT_NE(std::string::npos, out.find("acdisplay_lock_test_contended_total 1\n"));
+  EXPECT_NE(std::string::npos, out.find("acdisplay_lock_test_wait_seconds_count 1\n"));
+}
+
+TEST(InstrumentedMutex, TestConditionVariable)
+{
+  acdisplay::cLockMetrics lock_metrics;
+  acdisplay::cInstrumentedMutex mutex(lock_metrics);
+  std::condition_variable_any cv;
+  bool notified = false;
+
+  std::thread thread([&]() {
+    std::lock_guard lock(mutex);
+    notified = true;
+    cv.notify_one();
+  });
+
+  {
+    std::unique_lock lock(mutex);
+    EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&notified]{ return notified; }));
+  }
+
+  thread.join();
+
+  // Waiting unlocks and relocks the mutex
+  EXPECT_GE(lock_metrics.acquisitions.Get(), 2);
+  EXPECT_EQ(lock_metrics.acquisitions.Get(), lock_metrics.hold_time.GetCount());
+}
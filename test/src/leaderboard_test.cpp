@@ -0,0 +1,58 @@
+// Application headers
+#include "leaderboard.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(Leaderboard, TestOrder)
+{
+  acdisplay::cLeaderboard leaderboard;
+  EXPECT_TRUE(leaderboard.GetEntries().empty());
+
+  // New cars are added at the end
+  EXPECT_TRUE(leaderboard.AddLap(5, 1, "Alice", "ks_mazda_mx5_cup", 90000));
+  EXPECT_TRUE(leaderboard.AddLap(7, 1, "Bob", "ks_mazda_mx5_cup", 91000));
+  ASSERT_EQ(2, leaderboard.GetEntries().size());
+  EXPECT_EQ(5, leaderboard.GetEntries()[0].car_identifier);
+  EXPECT_EQ(7, leaderboard.GetEntries()[1].car_identifier);
+
+  // Alice stays ahead, only the sequence changes
+  const uint32_t order_sequence = leaderboard.order_sequence;
+  const uint32_t sequence = leaderboard.sequence;
+  EXPECT_FALSE(leaderboard.AddLap(5, 2, "Alice", "ks_mazda_mx5_cup", 89000));
+  EXPECT_EQ(order_sequence, leaderboard.order_sequence);
+  EXPECT_EQ(sequence + 1, leaderboard.sequence);
+  EXPECT_EQ(leaderboard.sequence, leaderboard.GetEntries()[0].changed_sequence);
+  EXPECT_EQ(2, leaderboard.GetEntries()[0].laps);
+  EXPECT_EQ(89000, leaderboard.GetEntries()[0].best_lap_ms);
+  EXPECT_EQ(179000, leaderboard.GetEntries()[0].total_ms);
+
+  // Bob is still a lap behind
+  EXPECT_FALSE(leaderboard.AddLap(7, 2, "Bob", "ks_mazda_mx5_cup", 95000));
+
+  // Alice has a slow lap and Bob gets past on the same lap count
+  EXPECT_FALSE(leaderboard.AddLap(5, 3, "Alice", "ks_mazda_mx5_cup", 120000));
+  EXPECT_TRUE(leaderboard.AddLap(7, 3, "Bob", "ks_mazda_mx5_cup", 85000));
+  EXPECT_EQ(order_sequence + 1, leaderboard.order_sequence);
+  EXPECT_EQ(7, leaderboard.GetEntries()[0].car_identifier);
+  EXPECT_EQ(85000, leaderboard.GetEntries()[0].best_lap_ms);
+  EXPECT_EQ(85000, leaderboard.GetEntries()[0].last_lap_ms);
+  EXPECT_EQ(271000, leaderboard.GetEntries()[0].total_ms);
+  EXPECT_EQ(5, leaderboard.GetEntries()[1].car_identifier);
+}
+
+TEST(Leaderboard, TestNewSession)
+{
+  acdisplay::cLeaderboard leaderboard;
+
+  leaderboard.AddLap(1, 5, "Alice", "car", 90000);
+  leaderboard.AddLap(2, 5, "Bob", "car", 91000);
+  ASSERT_EQ(2, leaderboard.GetEntries().size());
+
+  // The lap count going backwards means a new session
+  EXPECT_TRUE(leaderboard.AddLap(2, 1, "Bob", "car", 92000));
+  ASSERT_EQ(1, leaderboard.GetEntries().size());
+  EXPECT_EQ(2, leaderboard.GetEntries()[0].car_identifier);
+  EXPECT_EQ(1, leaderboard.GetEntries()[0].laps);
+  EXPECT_EQ(92000, leaderboard.GetEntries()[0].total_ms);
+}
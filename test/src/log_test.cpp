@@ -0,0 +1,147 @@
+// Standard headers
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Application headers
+#include "log.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(Log, TestParseLogLevel)
+{
+  util::LOG_LEVEL level = util::LOG_LEVEL::LEVEL_INFO;
+  EXPECT_TRUE(util::ParseLogLevel("debug", level));
+  EXPECT_EQ(util::LOG_LEVEL::LEVEL_DEBUG, level);
+  EXPECT_TRUE(util::ParseLogLevel("error", level));
+  EXPECT_EQ(util::LOG_LEVEL::LEVEL_ERROR, level);
+  EXPECT_FALSE(util::ParseLogLevel("verbose", level));
+}
+
+TEST(Log, TestLogLine)
+{
+  util::SetLogLevel(util::LOG_LEVEL::LEVEL_ERROR);
+
+  {
+    util::cLogLine line(util::LOG_LEVEL::LEVEL_DEBUG, 0);
+    line<<"gear "<<uint8_t(3)<<", rpm "<<6500.5f<<", "<<std::string("name")<<' '<<true;
+    EXPECT_EQ("gear 3, rpm 6500.5, name 1", line.GetText());
+  }
+
+  {
+    util::cLogLine line(util::LOG_LEVEL::LEVEL_DEBUG, 2);
+    line<<"message";
+    EXPECT_EQ("(2 similar messages suppressed) message", line.GetText());
+  }
+
+  // Long lines are truncated
+  {
+    util::cLogLine line(util::LOG_LEVEL::LEVEL_DEBUG, 0);
+    line<<std::string(2 * util::LOG_LINE_MAX_LENGTH, 'a');
+    EXPECT_EQ(util::LOG_LINE_MAX_LENGTH, line.GetText().length());
+  }
+
+  util::FlushLog();
+
+  util::SetLogLevel(util::LOG_LEVEL::LEVEL_INFO);
+}
+
+TEST(Log, TestRingBuffer)
+{
+  std::unique_ptr<util::cLogRingBuffer> ring_buffer = std::make_unique<util::cLogRingBuffer>();
+  util::cLogMessage message;
+  EXPECT_FALSE(ring_buffer->TryPop(message));
+
+  // Fill it up, the next push is dropped rather than blocking
+  for (size_t i = 0; i < util::cLogRingBuffer::SIZE; i++) {
+    EXPECT_TRUE(ring_buffer->TryPush(util::LOG_LEVEL::LEVEL_INFO, std::to_string(i)));
+  }
+  EXPECT_FALSE(ring_buffer->TryPush(util::LOG_LEVEL::LEVEL_INFO, "full"));
+
+  // Messages come out in order
+  ASSERT_TRUE(ring_buffer->TryPop(message));
+  EXPECT_EQ("0", std::string_view(message.text.data(), message.length));
+  EXPECT_TRUE(ring_buffer->TryPush(util::LOG_LEVEL::LEVEL_ERROR, "wrapped"));
+
+  for (size_t i = 1; i < util::cLogRingBuffer::SIZE; i++) {
+    ASSERT_TRUE(ring_buffer->TryPop(message));
+    EXPECT_EQ(std::to_string(i), std::string_view(message.text.data(), message.length));
+  }
+
+  ASSERT_TRUE(ring_buffer->TryPop(message));
+  EXPECT_EQ(util::LOG_LEVEL::LEVEL_ERROR, message.level);
+  EXPECT_EQ("wrapped", std::string_view(message.text.data(), message.length));
+  EXPECT_FALSE(ring_buffer->TryPop(message));
+}
+
+TEST(Log, TestRingBufferMultipleProducers)
+{
+  std::unique_ptr<util::cLogRingBuffer> ring_buffer = std::make_unique<util::cLogRingBuffer>();
+
+  const size_t producer_count = 4;
+  const size_t messages_per_producer = 10000;
+
+  std::atomic<size_t> pushed(0);
+  std::atomic<size_t> finished(0);
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < producer_count; p++) {
+    producers.emplace_back([&ring_buffer, &pushed, &finished]() {
+      for (size_t i = 0; i < messages_per_producer; i++) {
+        if (ring_buffer->TryPush(util::LOG_LEVEL::LEVEL_INFO, "message")) {
+          pushed++;
+        }
+      }
+
+      finished++;
+    });
+  }
+
+  // Read while the producers are running, every message we read must be complete
+  size_t popped = 0;
+  size_t incomplete = 0;
+  util::cLogMessage message;
+  while (true) {
+    if (ring_buffer->TryPop(message)) {
+      if (std::string_view(message.text.data(), message.length) != "message") {
+        incomplete++;
+      }
+      popped++;
+    } else if (finished.load() == producer_count) {
+      // The producers have finished, so if it is still empty we have everything
+      if (!ring_buffer->TryPop(message)) {
+        break;
+      }
+      popped++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  for (auto&& producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_EQ(0, incomplete);
+  EXPECT_EQ(pushed.load(), popped);
+}
+
+TEST(Log, TestRateLimiter)
+{
+  util::cLogRateLimiter rate_limiter;
+
+  uint64_t now_ms = 100000;
+  for (size_t i = 0; i < util::LOG_RATE_LIMIT_PER_SECOND; i++) {
+    EXPECT_TRUE(rate_limiter.Allow(now_ms));
+  }
+
+  EXPECT_FALSE(rate_limiter.Allow(now_ms + 10));
+  EXPECT_FALSE(rate_limiter.Allow(now_ms + 20));
+
+  // A second later we can log again, and we find out how many were dropped
+  now_ms += 1000;
+  EXPECT_TRUE(rate_limiter.Allow(now_ms));
+  EXPECT_EQ(2, rate_limiter.TakeSuppressed());
+  EXPECT_EQ(0, rate_limiter.TakeSuppressed());
+}
@@ -0,0 +1,70 @@
+// Standard headers
+#include <thread>
+
+// POSIX headers
+#include <netinet/in.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Application headers
+#include "low_latency.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(LowLatency, TestSetCurrentThreadAffinity)
+{
+  // Run on another thread so that we don't change the affinity of the other tests
+  std::thread thread([]() {
+    const int cpu = sched_getcpu();
+    ASSERT_GE(cpu, 0);
+
+    std::string error;
+    EXPECT_TRUE(util::SetCurrentThreadAffinity({ cpu }, error)) << error;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(cpu_set), &cpu_set));
+    EXPECT_EQ(1, CPU_COUNT(&cpu_set));
+    EXPECT_TRUE(CPU_ISSET(cpu, &cpu_set));
+
+    // A core that doesn't exist
+    EXPECT_FALSE(util::SetCurrentThreadAffinity({ CPU_SETSIZE - 1 }, error));
+    EXPECT_FALSE(error.empty());
+  });
+
+  thread.join();
+}
+
+TEST(LowLatency, TestSetBusyPollOnUDPSockets)
+{
+  const int udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(udp_socket, 0);
+
+  // Busy polling may need CAP_NET_ADMIN, so we only check that our socket is found, it either worked or gave us a reason
+  std::string error;
+  const size_t count = util::SetBusyPollOnUDPSockets(0, error);
+  EXPECT_TRUE((count >= 1) || !error.empty());
+
+  close(udp_socket);
+}
+
+TEST(LowLatency, TestLockCurrentThreadStack)
+{
+  std::thread thread([]() {
+    // Locking may need CAP_IPC_LOCK or a larger RLIMIT_MEMLOCK, so it either worked or gave us a reason
+    std::string error;
+    const bool result = util::LockCurrentThreadStack(64 * 1024, error);
+    EXPECT_TRUE(result || !error.empty());
+
+    // Asking for more than the whole stack only locks the stack
+    const bool result_large = util::LockCurrentThreadStack(size_t(1) << 40, error);
+    EXPECT_TRUE(result_large || !error.empty());
+
+    munlockall();
+  });
+
+  thread.join();
+}
@@ -0,0 +1,47 @@
+// Application headers
+#include "metrics.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(Metrics, TestLatencyHistogram)
+{
+  acdisplay::cLatencyHistogram histogram;
+  histogram.Observe(5); // 10 us bucket
+  histogram.Observe(10); // 10 us bucket, the bounds are inclusive
+  histogram.Observe(11); // 25 us bucket
+  histogram.Observe(1000000); // +Inf bucket
+
+  EXPECT_EQ(4, histogram.GetCount());
+  EXPECT_EQ(2, histogram.GetBucketCount(0));
+  EXPECT_EQ(1, histogram.GetBucketCount(1));
+  EXPECT_EQ(0, histogram.GetBucketCount(2));
+  EXPECT_EQ(1, histogram.GetBucketCount(acdisplay::LATENCY_HISTOGRAM_BUCKETS_US.size()));
+
+  std::string text;
+  histogram.ToPrometheus(text, "test_seconds", "Test histogram");
+  EXPECT_NE(std::string::npos, text.find("# TYPE test_seconds histogram\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_bucket{le=\"0.000010\"} 2\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_bucket{le=\"0.000025\"} 3\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_bucket{le=\"0.050000\"} 3\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_bucket{le=\"+Inf\"} 4\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_sum 1.000026\n"));
+  EXPECT_NE(std::string::npos, text.find("test_seconds_count 4\n"));
+}
+
+TEST(Metrics, TestPrometheusFormat)
+{
+  acdisplay::cMetrics metrics;
+  metrics.acudp_packets_received.Increment();
+  metrics.acudp_packets_received.Increment();
+  metrics.websocket_bytes_sent.Increment(1234);
+  metrics.websocket_clients.Add(3);
+  metrics.websocket_clients.Add(-1);
+
+  std::string text;
+  metrics.ToPrometheus(text);
+  EXPECT_NE(std::string::npos, text.find("# TYPE acdisplay_acudp_packets_received_total counter\nacdisplay_acudp_packets_received_total 2\n"));
+  EXPECT_NE(std::string::npos, text.find("\nacdisplay_websocket_bytes_sent_total 1234\n"));
+  EXPECT_NE(std::string::npos, text.find("# TYPE acdisplay_websocket_clients gauge\nacdisplay_websocket_clients 2\n"));
+  EXPECT_EQ('\n', text.back());
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+
+// Application headers
+#include "sector_timing.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+// Drive laps at a constant speed, returns the number of sectors that were completed
+size_t DriveLaps(acdisplay::cSectorTiming& sector_timing, uint32_t lap_ms, uint32_t sample_ms, uint32_t laps)
+{
+  size_t completed = 0;
+
+  uint32_t last_lap_ms = 0;
+  for (uint32_t lap = 0; lap < laps; lap++) {
+    for (uint32_t lap_time_ms = 0; lap_time_ms < lap_ms; lap_time_ms += sample_ms) {
+      const float position = float(lap_time_ms) / float(lap_ms);
+      if (sector_timing.Update(position, lap_time_ms, last_lap_ms, lap)) {
+        completed++;
+      }
+    }
+
+    last_lap_ms = lap_ms;
+  }
+
+  return completed;
+}
+
+}
+
+TEST(SectorTiming, TestConstantSpeed)
+{
+  acdisplay::cSectorTiming sector_timing;
+
+  // Start with a position that lines up with a sample and then use a sample rate that doesn't divide the sectors evenly so that we have to interpolate
+  const size_t completed = DriveLaps(sector_timing, 90000, 37, 3);
+
+  // We join exactly on the start line so the first sector isn't timed, and the last sector of the last lap isn't finished
+  EXPECT_EQ(7, completed);
+
+  const acdisplay::cSectorTimes& times = sector_timing.GetTimes();
+  EXPECT_EQ(1, times.last_completed_sector);
+  EXPECT_EQ(2, times.current_sector);
+
+  for (size_t i = 0; i < acdisplay::SECTOR_COUNT; i++) {
+    EXPECT_NEAR(30000, times.last_ms[i], 1);
+    EXPECT_NEAR(30000, times.best_ms[i], 1);
+  }
+
+  EXPECT_NEAR(90000, times.theoretical_best_lap_ms, 2);
+}
+
+TEST(SectorTiming, TestBestAndTheoreticalBest)
+{
+  acdisplay::cSectorTiming sector_timing;
+
+  // A lap where the first sector is quick and the rest are slow
+  uint32_t lap_count = 0;
+  uint32_t lap_time_ms = 0;
+  float position = -0.001f;
+  auto drive = [&](float to_position, uint32_t duration_ms) {
+    const float from_position = position;
+    const uint32_t from_lap_time_ms = lap_time_ms;
+    for (uint32_t t = 10; t <= duration_ms; t += 10) {
+      position = from_position + ((to_position - from_position) * (float(t) / float(duration_ms)));
+      lap_time_ms = from_lap_time_ms + t;
+      sector_timing.Update(std::fmod(position + 1.0f, 1.0f), lap_time_ms, 0, lap_count);
+    }
+  };
+
+  // Join just before the line so that the first sector is timed
+  sector_timing.Update(0.999f, 0, 0, 0);
+  drive(1.0f / 3.0f, 20000);
+  drive(2.0f / 3.0f, 40000);
+
+  const acdisplay::cSectorTimes& times = sector_timing.GetTimes();
+  const float first_sector_ms = 20000.0f * (1.0f / 3.0f) / ((1.0f / 3.0f) + 0.001f);
+  EXPECT_NEAR(first_sector_ms, times.best_ms[0], 1);
+  EXPECT_NEAR(40000, times.best_ms[1], 1);
+  EXPECT_EQ(0, times.best_ms[2]);
+
+  // No theoretical best until every sector has a time
+  EXPECT_EQ(0, times.theoretical_best_lap_ms);
+
+  // Finish the lap
+  drive(0.99f, 29700);
+  const uint32_t lap_ms = lap_time_ms + 300;
+  lap_count++;
+  lap_time_ms = 0;
+  position = 0.0f;
+  sector_timing.Update(0.005f, 150, lap_ms, lap_count);
+  EXPECT_NEAR(30000, times.best_ms[2], 2);
+  EXPECT_NEAR(first_sector_ms + 40000 + 30000, times.theoretical_best_lap_ms, 3);
+}
+
+TEST(SectorTiming, TestTeleportAndRestart)
+{
+  acdisplay::cSectorTiming sector_timing;
+
+  sector_timing.Update(0.0f, 0, 0, 0);
+  sector_timing.Update(0.05f, 1000, 0, 0);
+
+  // Teleported back to the pits, the sector can't be timed
+  sector_timing.Update(0.9f, 1100, 0, 0);
+  EXPECT_EQ(2, sector_timing.GetTimes().current_sector);
+  EXPECT_EQ(0, sector_timing.GetTimes().current_sector_ms);
+
+  // The lap time going backwards means the session was restarted
+  const uint32_t sequence = sector_timing.GetTimes().sequence;
+  sector_timing.Update(0.0f, 0, 0, 0);
+  EXPECT_NE(sequence, sector_timing.GetTimes().sequence);
+  EXPECT_EQ(0, sector_timing.GetTimes().theoretical_best_lap_ms);
+}
@@ -0,0 +1,60 @@
+// Application headers
+#include "session_statistics.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(SessionStatistics, TestRunningMoments)
+{
+  acdisplay::cRunningMoments moments;
+  EXPECT_EQ(0, moments.GetCount());
+  EXPECT_DOUBLE_EQ(0.0, moments.GetStandardDeviation());
+
+  for (double value : { 2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0 }) {
+    moments.Add(value);
+  }
+
+  EXPECT_EQ(8, moments.GetCount());
+  EXPECT_DOUBLE_EQ(5.0, moments.GetMean());
+  EXPECT_DOUBLE_EQ(32.0 / 7.0, moments.GetVariance());
+  EXPECT_DOUBLE_EQ(2.0, moments.GetMinimum());
+  EXPECT_DOUBLE_EQ(9.0, moments.GetMaximum());
+}
+
+TEST(SessionStatistics, TestUpdate)
+{
+  acdisplay::cSessionStatistics statistics;
+
+  // 10 seconds in first gear at 3200 rpm on full throttle, then 10 seconds in second gear at 13000 rpm braking
+  uint32_t lap_time_ms = 0;
+  for (; lap_time_ms <= 10000; lap_time_ms += 20) {
+    statistics.Update(100.0f, 2, 3200.0f, 1.0f, 0.0f, lap_time_ms, 0, 0);
+  }
+  for (; lap_time_ms <= 20000; lap_time_ms += 20) {
+    statistics.Update(150.0f, 3, 13000.0f, 0.0f, 0.5f, lap_time_ms, 0, 0);
+  }
+
+  EXPECT_FLOAT_EQ(150.0f, statistics.max_speed_kmh);
+  EXPECT_EQ(20000, statistics.total_ms);
+  EXPECT_EQ(10000, statistics.gear_ms[2]);
+  EXPECT_EQ(10000, statistics.gear_ms[3]);
+  EXPECT_EQ(10000, statistics.rpm_histogram_ms[6]);
+  EXPECT_EQ(10000, statistics.rpm_histogram_ms[acdisplay::SESSION_STATISTICS_RPM_BUCKET_COUNT - 1]);
+  EXPECT_EQ(10000, statistics.full_throttle_ms);
+  EXPECT_EQ(10000, statistics.braking_ms);
+
+  // Complete some laps, the time across the line comes from the last lap time
+  statistics.Update(150.0f, 3, 5000.0f, 0.0f, 0.0f, 10, 20010, 1);
+  EXPECT_EQ(20020, statistics.total_ms);
+  statistics.Update(150.0f, 3, 5000.0f, 0.0f, 0.0f, 10, 22000, 2);
+  statistics.Update(150.0f, 3, 5000.0f, 0.0f, 0.0f, 10, 21000, 3);
+  EXPECT_EQ(3, statistics.lap_times_ms.GetCount());
+  EXPECT_DOUBLE_EQ(21003.333333333332, statistics.lap_times_ms.GetMean());
+  EXPECT_NEAR(995.0, statistics.lap_times_ms.GetStandardDeviation(), 1.0);
+
+  // Restarting the session clears everything
+  statistics.Update(0.0f, 1, 800.0f, 0.0f, 0.0f, 0, 0, 0);
+  EXPECT_FLOAT_EQ(0.0f, statistics.max_speed_kmh);
+  EXPECT_EQ(0, statistics.total_ms);
+  EXPECT_EQ(0, statistics.lap_times_ms.GetCount());
+}
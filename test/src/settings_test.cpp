@@ -30,4 +30,17 @@ TEST(Application, TestSettings)
 
   const std::string https_public_cert = settings.GetHTTPSPublicCert();
   EXPECT_STREQ("./server.crt", https_public_cert.c_str());
+
+  EXPECT_EQ(25, settings.GetUpdateIntervalMS());
+  EXPECT_EQ(50, settings.GetBatchIntervalMS());
+  EXPECT_EQ(util::LOG_LEVEL::LEVEL_WARNING, settings.GetLogLevel());
+
+  const application::cLowLatencySettings& low_latency = settings.GetLowLatency();
+  EXPECT_TRUE(low_latency.IsEnabled());
+  EXPECT_EQ(std::vector<int>({ 2 }), low_latency.acudp_cpus);
+  EXPECT_EQ(std::vector<int>({ 3, 4 }), low_latency.websocket_cpus);
+  EXPECT_EQ(50, low_latency.realtime_priority);
+  EXPECT_TRUE(low_latency.lock_memory);
+  EXPECT_EQ(64, low_latency.prefault_heap_mb);
+  EXPECT_EQ(50, low_latency.busy_poll_us);
 }
@@ -0,0 +1,57 @@
+// Application headers
+#include "shift_lights.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(ShiftLights, TestDefaultLayout)
+{
+  acdisplay::cShiftLightsConfig config;
+  config.SetDefaultsForRedLine(6000.0f);
+
+  // The first LED is always on, the rest start at half the red line and get closer together towards the top
+  EXPECT_FLOAT_EQ(1.0f, config.led_on_rpm[0]);
+  EXPECT_FLOAT_EQ(3000.0f, config.led_on_rpm[1]);
+  for (size_t i = 2; i < acdisplay::SHIFT_LIGHTS_LED_COUNT; i++) {
+    EXPECT_LT(config.led_on_rpm[i - 1], config.led_on_rpm[i]);
+    EXPECT_LT(config.led_on_rpm[i], 6000.0f);
+  }
+
+  const float first_gap = config.led_on_rpm[2] - config.led_on_rpm[1];
+  const float last_gap = config.led_on_rpm[7] - config.led_on_rpm[6];
+  EXPECT_GT(first_gap, 3.0f * last_gap);
+
+  EXPECT_FLOAT_EQ(6000.0f, config.flash_rpm);
+}
+
+TEST(ShiftLights, TestUpdate)
+{
+  acdisplay::cShiftLightsConfig config;
+  config.SetDefaultsForRedLine(6000.0f);
+  config.flash_period_ms = 200;
+
+  acdisplay::cShiftLights shift_lights;
+
+  // Engine off
+  EXPECT_EQ(0x00, shift_lights.Update(config, 0.0f, 0));
+
+  // Idle only lights the first LED
+  EXPECT_EQ(0x01, shift_lights.Update(config, 800.0f, 0));
+
+  // Exactly on a threshold turns that LED on
+  EXPECT_EQ(0x03, shift_lights.Update(config, 3000.0f, 0));
+
+  // Just under the red line has every LED lit but is not flashing
+  EXPECT_EQ(0xFF, shift_lights.Update(config, 5999.0f, 0));
+
+  // At the red line we flash, starting with the lit phase
+  EXPECT_EQ(0xFF | acdisplay::SHIFT_LIGHTS_FLAG_FLASHING | acdisplay::SHIFT_LIGHTS_FLAG_BLINK_PHASE, shift_lights.Update(config, 6000.0f, 1000));
+  EXPECT_EQ(0xFF | acdisplay::SHIFT_LIGHTS_FLAG_FLASHING | acdisplay::SHIFT_LIGHTS_FLAG_BLINK_PHASE, shift_lights.Update(config, 6100.0f, 1099));
+  EXPECT_EQ(acdisplay::SHIFT_LIGHTS_FLAG_FLASHING, shift_lights.Update(config, 6100.0f, 1100));
+  EXPECT_EQ(acdisplay::SHIFT_LIGHTS_FLAG_FLASHING, shift_lights.Update(config, 6100.0f, 1199));
+  EXPECT_EQ(0xFF | acdisplay::SHIFT_LIGHTS_FLAG_FLASHING | acdisplay::SHIFT_LIGHTS_FLAG_BLINK_PHASE, shift_lights.Update(config, 6100.0f, 1200));
+
+  // Dropping below the red line stops the flashing and the next time we hit it we start on the lit phase again
+  EXPECT_EQ(0xFF, shift_lights.Update(config, 5999.0f, 1300));
+  EXPECT_EQ(0xFF | acdisplay::SHIFT_LIGHTS_FLAG_FLASHING | acdisplay::SHIFT_LIGHTS_FLAG_BLINK_PHASE, shift_lights.Update(config, 6000.0f, 1350));
+}
@@ -0,0 +1,66 @@
+#include <cmath>
+#include <cstring>
+
+#include "synthetic_pipeline.h"
+
+std::vector<acudp_car_t> GetSyntheticLaps(size_t laps)
+{
+  const int lap_time_ms = int(SYNTHETIC_LAP_SAMPLES * 1000 / 60);
+
+  std::vector<acudp_car_t> samples(laps * SYNTHETIC_LAP_SAMPLES);
+
+  for (size_t sample = 0; sample < samples.size(); sample++) {
+    const size_t lap = sample / SYNTHETIC_LAP_SAMPLES;
+    const size_t i = sample % SYNTHETIC_LAP_SAMPLES;
+    const float position = float(i) / float(SYNTHETIC_LAP_SAMPLES);
+    const float phase = std::fmod(position * 8.0f, 1.0f);
+    const int gear = 2 + int(phase * 5.0f);
+
+    acudp_car_t& car = samples[sample];
+    memset(&car, 0, sizeof(car));
+    car.identifier = 'a';
+    car.size = sizeof(car);
+    car.speed_kmh = 60.0f + 150.0f * phase;
+    car.speed_ms = car.speed_kmh / 3.6f;
+    car.gas = (phase < 0.8f) ? 1.0f : 0.0f;
+    car.brake = (phase < 0.8f) ? 0.0f : 0.7f;
+    car.clutch = 1.0f;
+    car.gear = gear;
+    car.engine_rpm = 4000.0f + 3000.0f * std::fmod(phase * 5.0f, 1.0f);
+    car.lap_time = int(i * 1000 / 60);
+    car.last_lap = (lap == 0) ? 0 : lap_time_ms;
+    car.best_lap = car.last_lap;
+    car.lap_count = int(lap);
+    car.car_position_normalized = position;
+    car.car_coordinates[0] = 500.0f * std::cos(position * 6.2831853f);
+    car.car_coordinates[2] = 500.0f * std::sin(position * 6.2831853f);
+    for (size_t wheel = 0; wheel < 4; wheel++) {
+      car.tyre_radius[wheel] = 0.3f;
+      car.wheel_angular_speed[wheel] = car.speed_ms / car.tyre_radius[wheel];
+      car.load[wheel] = 3000.0f;
+    }
+  }
+
+  return samples;
+}
+
+
+cMemoryFrameSink::cMemoryFrameSink() :
+  frames(0),
+  bytes(0)
+{
+}
+
+bool cMemoryFrameSink::SendFrame(std::string_view frame)
+{
+  frames++;
+  bytes += frame.size();
+  return true;
+}
+
+
+cMemoryClient::cMemoryClient(int client_id, acdisplay::WEBSOCKET_UPDATE_FORMAT update_format, uint32_t telemetry_groups)
+{
+  sender = std::make_unique<acdisplay::cWebSocketSender>(sink, client_id, update_format, telemetry_groups);
+  sender->SendInitialMessages();
+}
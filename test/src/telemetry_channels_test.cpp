@@ -0,0 +1,144 @@
+// Standard headers
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Application headers
+#include "telemetry_channels.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+const uint64_t RPM_AND_SPEED = acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::rpm) | acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::speed_kmh);
+
+template <typename T>
+T ReadBinary(const std::string& binary, size_t offset)
+{
+  T value = 0;
+  std::memcpy(&value, binary.data() + offset, sizeof(value));
+  return value;
+}
+
+}
+
+TEST(TelemetryChannels, TestTable)
+{
+  EXPECT_STREQ("gear", acdisplay::TELEMETRY_CHANNEL_INFO[size_t(acdisplay::TELEMETRY_CHANNEL::gear)].name);
+  EXPECT_STREQ("u16", acdisplay::TELEMETRY_CHANNEL_INFO[size_t(acdisplay::TELEMETRY_CHANNEL::rpm)].binary_type);
+  EXPECT_EQ(10, acdisplay::TELEMETRY_CHANNEL_INFO[size_t(acdisplay::TELEMETRY_CHANNEL::speed_kmh)].scale);
+  EXPECT_STREQ("km/h", acdisplay::TELEMETRY_CHANNEL_INFO[size_t(acdisplay::TELEMETRY_CHANNEL::speed_kmh)].units);
+
+  // Neutral
+  acdisplay::cTelemetry telemetry;
+  EXPECT_EQ(1, telemetry.core.gear);
+
+  EXPECT_EQ(4, acdisplay::GetTelemetryBinarySize(RPM_AND_SPEED));
+
+  // Arrays
+  EXPECT_EQ(4, acdisplay::TELEMETRY_CHANNEL_INFO[size_t(acdisplay::TELEMETRY_CHANNEL::load)].count);
+  EXPECT_EQ(4 * sizeof(float), acdisplay::GetTelemetryBinarySize(acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::load)));
+
+  // Each group is on its own cache lines
+  EXPECT_EQ(0, alignof(acdisplay::cTelemetryWheels) % 64);
+  EXPECT_EQ(0, offsetof(acdisplay::cTelemetry, wheels) % 64);
+}
+
+TEST(TelemetryChannels, TestGroups)
+{
+  EXPECT_EQ(acdisplay::TELEMETRY_CORE_GROUP, acdisplay::ParseTelemetryGroups(""));
+  EXPECT_EQ(acdisplay::TELEMETRY_CORE_GROUP, acdisplay::ParseTelemetryGroups("nonsense"));
+  EXPECT_EQ(acdisplay::TELEMETRY_CORE_GROUP | acdisplay::GetTelemetryGroupMask(acdisplay::TELEMETRY_GROUP::wheels) | acdisplay::GetTelemetryGroupMask(acdisplay::TELEMETRY_GROUP::assists), acdisplay::ParseTelemetryGroups("wheels,nonsense,assists,"));
+  EXPECT_EQ(acdisplay::TELEMETRY_GROUP_MASK_ALL, acdisplay::ParseTelemetryGroups("core,assists,dynamics,wheels,position"));
+
+  EXPECT_EQ(acdisplay::TELEMETRY_CHANNEL_MASK_ALL, acdisplay::GetTelemetryGroupChannels(acdisplay::TELEMETRY_GROUP_MASK_ALL));
+  const uint64_t position = acdisplay::GetTelemetryGroupChannels(acdisplay::GetTelemetryGroupMask(acdisplay::TELEMETRY_GROUP::position));
+  EXPECT_EQ(acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::car_position_normalized) | acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::car_coordinates), position);
+
+  // Only the groups that are asked for are copied
+  acdisplay::cTelemetry from;
+  from.core.rpm = 5000.0f;
+  from.wheels.load[0] = 1000.0f;
+  from.position.car_position_normalized = 0.5f;
+
+  acdisplay::cTelemetry to;
+  acdisplay::CopyTelemetryGroups(from, acdisplay::ParseTelemetryGroups("wheels"), to);
+  EXPECT_EQ(5000.0f, to.core.rpm);
+  EXPECT_EQ(1000.0f, to.wheels.load[0]);
+  EXPECT_EQ(0.0f, to.position.car_position_normalized);
+}
+
+TEST(TelemetryChannels, TestSubscriptions)
+{
+  acdisplay::cTelemetrySubscriptions subscriptions;
+  EXPECT_EQ(acdisplay::TELEMETRY_CORE_GROUP, subscriptions.GetGroups());
+
+  const uint32_t wheels = acdisplay::ParseTelemetryGroups("wheels");
+  const uint32_t wheels_and_position = acdisplay::ParseTelemetryGroups("wheels,position");
+  subscriptions.Subscribe(wheels);
+  subscriptions.Subscribe(wheels_and_position);
+  EXPECT_EQ(wheels_and_position, subscriptions.GetGroups());
+
+  subscriptions.Unsubscribe(wheels_and_position);
+  EXPECT_EQ(wheels, subscriptions.GetGroups());
+
+  // The core group is always wanted
+  subscriptions.Unsubscribe(wheels);
+  EXPECT_EQ(acdisplay::TELEMETRY_CORE_GROUP, subscriptions.GetGroups());
+}
+
+TEST(TelemetryChannels, TestTextAndCSV)
+{
+  acdisplay::cTelemetry telemetry;
+  telemetry.core.rpm = 6543.25f;
+  telemetry.core.speed_kmh = 163.5f;
+
+  std::string text;
+  acdisplay::AppendTelemetryText<RPM_AND_SPEED>(telemetry, '|', text);
+  EXPECT_EQ("6543.250000|163.500000", text);
+
+  std::string csv;
+  acdisplay::AppendTelemetryCSVHeader(RPM_AND_SPEED, csv);
+  acdisplay::AppendTelemetryCSVRow<RPM_AND_SPEED>(telemetry, csv);
+  EXPECT_EQ("rpm,speed_kmh\n6543.250000,163.500000\n", csv);
+
+  // Arrays are one field in the text encoding and a column for each element in the CSV
+  const uint64_t COORDINATES = acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::car_coordinates);
+  telemetry.position.car_coordinates = { 1.0f, 2.5f, -3.0f };
+  text.clear();
+  acdisplay::AppendTelemetryText<RPM_AND_SPEED | COORDINATES>(telemetry, '|', text);
+  EXPECT_EQ("6543.250000|163.500000|1.000000,2.500000,-3.000000", text);
+
+  csv.clear();
+  acdisplay::AppendTelemetryCSVHeader(COORDINATES, csv);
+  acdisplay::AppendTelemetryCSVRow<COORDINATES>(telemetry, csv);
+  EXPECT_EQ("car_coordinates_0,car_coordinates_1,car_coordinates_2\n1.000000,2.500000,-3.000000\n", csv);
+}
+
+TEST(TelemetryChannels, TestBinary)
+{
+  acdisplay::cTelemetry telemetry;
+  telemetry.core.rpm = 6543.6f;
+  telemetry.core.speed_kmh = 163.46f;
+
+  std::string binary;
+  acdisplay::AppendTelemetryBinary<RPM_AND_SPEED>(telemetry, binary);
+  ASSERT_EQ(4, binary.size());
+  EXPECT_EQ(6544, ReadBinary<uint16_t>(binary, 0));
+  EXPECT_EQ(1635, ReadBinary<uint16_t>(binary, 2));
+
+  // Values that don't fit are clamped, and NaN is sent as 0
+  telemetry.core.rpm = 100000.0f;
+  telemetry.core.speed_kmh = NAN;
+  binary.clear();
+  acdisplay::AppendTelemetryBinary<RPM_AND_SPEED>(telemetry, binary);
+  EXPECT_EQ(65535, ReadBinary<uint16_t>(binary, 0));
+  EXPECT_EQ(0, ReadBinary<uint16_t>(binary, 2));
+
+  // Every channel
+  binary.clear();
+  acdisplay::AppendTelemetryBinary<acdisplay::TELEMETRY_CHANNEL_MASK_ALL>(telemetry, binary);
+  EXPECT_EQ(acdisplay::GetTelemetryBinarySize(acdisplay::TELEMETRY_CHANNEL_MASK_ALL), binary.size());
+}
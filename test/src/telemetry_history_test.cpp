@@ -0,0 +1,80 @@
+// Standard headers
+#include <memory>
+#include <vector>
+
+// Application headers
+#include "telemetry_history.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+acdisplay::cTelemetry GetSample(uint64_t published_time_us)
+{
+  acdisplay::cTelemetry telemetry;
+  telemetry.core.published_time_us = published_time_us;
+  telemetry.core.rpm = float(published_time_us);
+  telemetry.wheels.load[0] = float(published_time_us);
+  return telemetry;
+}
+
+}
+
+TEST(TelemetryHistory, TestRead)
+{
+  std::unique_ptr<acdisplay::cTelemetryHistory> history = std::make_unique<acdisplay::cTelemetryHistory>();
+  std::vector<acdisplay::cTelemetry> samples;
+
+  history->Subscribe();
+  EXPECT_TRUE(history->IsSubscribed());
+
+  uint64_t next_sequence = history->GetNextSequence();
+  EXPECT_EQ(0, history->Read(next_sequence, acdisplay::TELEMETRY_CORE_GROUP, samples));
+  EXPECT_TRUE(samples.empty());
+
+  for (uint64_t i = 1; i <= 3; i++) {
+    history->Push(GetSample(i), acdisplay::TELEMETRY_GROUP_MASK_ALL);
+  }
+
+  // Every sample since the last read, in order
+  EXPECT_EQ(0, history->Read(next_sequence, acdisplay::TELEMETRY_CORE_GROUP, samples));
+  ASSERT_EQ(3, samples.size());
+  EXPECT_EQ(1, samples[0].core.published_time_us);
+  EXPECT_EQ(3.0f, samples[2].core.rpm);
+
+  // Only the groups we asked for are copied
+  EXPECT_EQ(0.0f, samples[2].wheels.load[0]);
+
+  // Nothing new
+  EXPECT_EQ(0, history->Read(next_sequence, acdisplay::TELEMETRY_CORE_GROUP, samples));
+  EXPECT_TRUE(samples.empty());
+
+  history->Push(GetSample(4), acdisplay::TELEMETRY_GROUP_MASK_ALL);
+  EXPECT_EQ(0, history->Read(next_sequence, acdisplay::TELEMETRY_GROUP_MASK_ALL, samples));
+  ASSERT_EQ(1, samples.size());
+  EXPECT_EQ(4.0f, samples[0].wheels.load[0]);
+
+  history->Unsubscribe();
+  EXPECT_FALSE(history->IsSubscribed());
+}
+
+TEST(TelemetryHistory, TestFallingBehind)
+{
+  std::unique_ptr<acdisplay::cTelemetryHistory> history = std::make_unique<acdisplay::cTelemetryHistory>();
+  std::vector<acdisplay::cTelemetry> samples;
+
+  uint64_t next_sequence = history->GetNextSequence();
+
+  // The oldest samples have been overwritten by the time we read
+  const size_t pushed = acdisplay::TELEMETRY_HISTORY_SAMPLES + 10;
+  for (uint64_t i = 0; i < pushed; i++) {
+    history->Push(GetSample(i), acdisplay::TELEMETRY_CORE_GROUP);
+  }
+
+  EXPECT_EQ(10, history->Read(next_sequence, acdisplay::TELEMETRY_CORE_GROUP, samples));
+  ASSERT_EQ(acdisplay::TELEMETRY_HISTORY_SAMPLES, samples.size());
+  EXPECT_EQ(10, samples.front().core.published_time_us);
+  EXPECT_EQ(pushed - 1, samples.back().core.published_time_us);
+  EXPECT_EQ(pushed, next_sequence);
+}
@@ -0,0 +1,103 @@
+// Standard headers
+#include <string>
+#include <thread>
+
+// Application headers
+#include "trace.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+size_t CountOccurrences(const std::string& text, const std::string& needle)
+{
+  size_t count = 0;
+  for (size_t position = text.find(needle); position != std::string::npos; position = text.find(needle, position + 1)) {
+    count++;
+  }
+  return count;
+}
+
+}
+
+TEST(Trace, TestScopes)
+{
+  std::thread thread([]() {
+    util::SetTraceThreadName("trace_test_thread");
+
+    {
+      TRACE_SCOPE("trace_test_outer");
+      TRACE_SCOPE("trace_test_inner");
+    }
+
+    // Something that happened long ago is outside the window
+    util::RecordTraceSpan("trace_test_old", 1000, 2000);
+  });
+  thread.join();
+
+  const std::string json = util::GetTraceJSON(60000);
+  EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"name\":\"trace_test_thread\"}"));
+  EXPECT_EQ(1, CountOccurrences(json, "\"name\":\"trace_test_outer\",\"cat\":\"acdisplay\",\"ph\":\"X\""));
+  EXPECT_EQ(1, CountOccurrences(json, "\"name\":\"trace_test_inner\""));
+  EXPECT_EQ(0, CountOccurrences(json, "trace_test_old"));
+}
+
+TEST(Trace, TestRingBufferWraps)
+{
+  std::thread thread([]() {
+    util::SetTraceThreadName("trace_test_wrap");
+
+    const uint64_t now_ns = util::GetTraceTimeNS();
+    for (size_t i = 0; i < util::TRACE_EVENTS_PER_THREAD; i++) {
+      util::RecordTraceSpan("trace_test_first_lap", now_ns, now_ns + 1000);
+    }
+
+    // Overwrite the oldest 10
+    for (size_t i = 0; i < 10; i++) {
+      util::RecordTraceSpan("trace_test_second_lap", now_ns, now_ns + 1500);
+    }
+  });
+  thread.join();
+
+  const std::string json = util::GetTraceJSON(60000);
+  // NOTE: The oldest remaining span is skipped too because it is the next one to be overwritten, so it could be half written while we read it
+  EXPECT_EQ(util::TRACE_EVENTS_PER_THREAD - 11, CountOccurrences(json, "\"name\":\"trace_test_first_lap\""));
+  EXPECT_EQ(10, CountOccurrences(json, "\"name\":\"trace_test_second_lap\""));
+  EXPECT_NE(std::string::npos, json.find("\"dur\":1.500,"));
+}
+
+TEST(Trace, TestBuffersAreReused)
+{
+  // Many more threads than there are buffers, one after another
+  for (size_t i = 0; i < 2 * util::TRACE_MAX_THREAD_BUFFERS; i++) {
+    std::thread thread([i]() {
+      const bool last = (i + 1 == 2 * util::TRACE_MAX_THREAD_BUFFERS);
+      util::SetTraceThreadName(last ? "trace_test_reused_last" : "trace_test_reused");
+      TRACE_SCOPE("trace_test_reused");
+    });
+    thread.join();
+  }
+
+  const std::string json = util::GetTraceJSON(60000);
+  EXPECT_GE(util::TRACE_MAX_THREAD_BUFFERS, CountOccurrences(json, "\"name\":\"thread_name\""));
+  EXPECT_EQ(1, CountOccurrences(json, "\"args\":{\"name\":\"trace_test_reused_last\"}"));
+
+  // A reused buffer only shows the spans of the thread that is using it now
+  EXPECT_GE(util::TRACE_MAX_THREAD_BUFFERS, CountOccurrences(json, "\"name\":\"trace_test_reused\",\"cat\""));
+}
+
+TEST(Trace, TestDisabled)
+{
+  util::SetTracingEnabled(false);
+
+  std::thread thread([]() {
+    TRACE_SCOPE("trace_test_disabled");
+  });
+  thread.join();
+
+  util::SetTracingEnabled(true);
+
+  EXPECT_EQ(std::string::npos, util::GetTraceJSON(60000).find("trace_test_disabled"));
+}
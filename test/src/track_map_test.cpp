@@ -0,0 +1,199 @@
+// Standard headers
+#include <cmath>
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+// Application headers
+#include "track_map.h"
+#include "util.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+// A circular track
+const float radius_m = 500.0f;
+
+void GetCoordinates(float position_normalized, float& out_x, float& out_z)
+{
+  const float angle = 2.0f * float(M_PI) * position_normalized;
+  out_x = radius_m * std::cos(angle);
+  out_z = radius_m * std::sin(angle);
+}
+
+// Drive around the track from start to end (Which can be more than 1 lap), returns true if the map was completed
+bool Drive(acdisplay::cTrackMapBuilder& builder, float start, float end, uint32_t& lap_count)
+{
+  bool completed = false;
+  float previous = std::fmod(start, 1.0f);
+  for (float position = start; position < end; position += 0.0002f) {
+    const float position_normalized = std::fmod(position, 1.0f);
+    if (position_normalized < previous) {
+      lap_count++;
+    }
+    previous = position_normalized;
+
+    float x = 0.0f;
+    float z = 0.0f;
+    GetCoordinates(position_normalized, x, z);
+    completed |= builder.Update(position_normalized, x, z, lap_count);
+  }
+
+  return completed;
+}
+
+}
+
+TEST(TrackMap, TestPositionIndex)
+{
+  EXPECT_EQ(0, acdisplay::GetTrackMapPositionIndex(0.0f));
+  EXPECT_EQ(512, acdisplay::GetTrackMapPositionIndex(0.5f));
+  EXPECT_EQ(acdisplay::TRACK_MAP_BIN_COUNT - 1, acdisplay::GetTrackMapPositionIndex(0.99999f));
+  EXPECT_EQ(acdisplay::TRACK_MAP_BIN_COUNT - 1, acdisplay::GetTrackMapPositionIndex(1.0f));
+}
+
+TEST(TrackMap, TestSimplify)
+{
+  // A straight line with a corner in the middle
+  std::vector<acdisplay::cTrackMapPoint> points;
+  for (uint16_t i = 0; i <= 100; i++) {
+    points.push_back({ i, float(i), 0.0f });
+  }
+  for (uint16_t i = 1; i <= 100; i++) {
+    points.push_back({ uint16_t(100 + i), 100.0f, float(i) + ((i % 2) ? 0.5f : -0.5f) });
+  }
+
+  std::vector<acdisplay::cTrackMapPoint> simplified;
+  acdisplay::SimplifyTrackMap(points, 1.0f, simplified);
+  ASSERT_EQ(3, simplified.size());
+  EXPECT_EQ(0, simplified[0].bin);
+  EXPECT_EQ(100, simplified[1].bin);
+  EXPECT_EQ(200, simplified[2].bin);
+}
+
+TEST(TrackMap, TestBuildFromFirstCleanLap)
+{
+  acdisplay::cTrackMapBuilder builder;
+  uint32_t lap_count = 0;
+
+  // Join part way through a lap, then drive a full lap
+  EXPECT_FALSE(Drive(builder, 0.5f, 1.9f, lap_count));
+  EXPECT_FALSE(builder.HasMap());
+  EXPECT_TRUE(Drive(builder, 1.9f, 2.1f, lap_count));
+  ASSERT_TRUE(builder.HasMap());
+
+  const acdisplay::cTrackMap& map = builder.GetMap();
+  EXPECT_TRUE(map.IsValid());
+
+  // The map is much smaller than the number of bins, but the points are still on the track
+  EXPECT_LT(map.points.size(), acdisplay::TRACK_MAP_BIN_COUNT / 4);
+  EXPECT_GT(map.points.size(), 10);
+  for (auto&& point : map.points) {
+    float x = 0.0f;
+    float z = 0.0f;
+    GetCoordinates((float(point.bin) + 0.5f) / float(acdisplay::TRACK_MAP_BIN_COUNT), x, z);
+    EXPECT_NEAR(x, point.x, 2.0f);
+    EXPECT_NEAR(z, point.z, 2.0f);
+  }
+}
+
+TEST(TrackMap, TestTeleportInvalidatesLap)
+{
+  acdisplay::cTrackMapBuilder builder;
+  uint32_t lap_count = 0;
+
+  // Start a lap, then get sent back to the pits half way around
+  EXPECT_FALSE(Drive(builder, 0.9f, 1.5f, lap_count));
+  EXPECT_FALSE(Drive(builder, 0.95f, 1.1f, lap_count));
+  EXPECT_FALSE(builder.HasMap());
+
+  // The next full lap is used
+  EXPECT_TRUE(Drive(builder, 1.1f, 2.1f, lap_count));
+  EXPECT_TRUE(builder.HasMap());
+}
+
+TEST(TrackMap, TestSetMapSkipsBuilding)
+{
+  acdisplay::cTrackMap cached;
+  cached.points.push_back({ 0, 1.0f, 2.0f });
+  cached.points.push_back({ 512, 3.0f, 4.0f });
+
+  acdisplay::cTrackMapBuilder builder;
+  builder.SetMap(cached);
+  ASSERT_TRUE(builder.HasMap());
+
+  // Driving a clean lap doesn't replace the cached map
+  uint32_t lap_count = 0;
+  EXPECT_FALSE(Drive(builder, 0.5f, 2.1f, lap_count));
+  ASSERT_EQ(2, builder.GetMap().points.size());
+  EXPECT_EQ(512, builder.GetMap().points[1].bin);
+
+  // A new session starts building again
+  builder.Reset();
+  EXPECT_FALSE(builder.HasMap());
+}
+
+TEST(TrackMap, TestSaveAndLoad)
+{
+  acdisplay::cTrackMap map;
+  map.points.push_back({ 0, 1.5f, -2.25f });
+  map.points.push_back({ 100, 200.0f, 300.5f });
+  map.points.push_back({ 1023, -10.0f, 0.0f });
+
+  const std::string file_path = (std::filesystem::temp_directory_path() / "ac_display_track_map_test" / "track.json").string();
+  ASSERT_TRUE(acdisplay::SaveTrackMap(file_path, map));
+
+  acdisplay::cTrackMap loaded;
+  ASSERT_TRUE(acdisplay::LoadTrackMap(file_path, loaded));
+  ASSERT_EQ(3, loaded.points.size());
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(map.points[i].bin, loaded.points[i].bin);
+    EXPECT_FLOAT_EQ(map.points[i].x, loaded.points[i].x);
+    EXPECT_FLOAT_EQ(map.points[i].z, loaded.points[i].z);
+  }
+
+  std::filesystem::remove_all(std::filesystem::path(file_path).parent_path());
+
+  EXPECT_EQ("/track_maps/ks_nordschleife_endurance_.json", acdisplay::GetTrackMapFilePath("ks_nordschleife", "endurance ").substr(util::GetConfigFolder("ac-display").length()));
+}
+
+TEST(TrackMap, TestSaveInBackground)
+{
+  const std::filesystem::path folder = std::filesystem::temp_directory_path() / "ac_display_track_map_background_test";
+  std::filesystem::remove_all(folder);
+  const std::string file_path = (folder / "track.json").string();
+
+  // Save the same file many times in a row, only the newest map should end up on disk
+  for (size_t i = 0; i < 50; i++) {
+    acdisplay::cTrackMap map;
+    map.points.push_back({ uint16_t(i), float(i), 0.0f });
+    acdisplay::SaveTrackMapInBackground(file_path, map);
+  }
+
+  // Wait for the saves to finish, the last one is always written
+  acdisplay::cTrackMap loaded;
+  for (size_t i = 0; i < 100; i++) {
+    if (acdisplay::LoadTrackMap(file_path, loaded) && (loaded.points.size() == 1) && (loaded.points[0].bin == 49)) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  ASSERT_EQ(1, loaded.points.size());
+  EXPECT_EQ(49, loaded.points[0].bin);
+  EXPECT_FLOAT_EQ(49.0f, loaded.points[0].x);
+
+  // No temporary files are left behind
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  size_t file_count = 0;
+  for (auto&& entry : std::filesystem::directory_iterator(folder)) {
+    (void)entry;
+    file_count++;
+  }
+  EXPECT_EQ(1, file_count);
+
+  std::filesystem::remove_all(folder);
+}
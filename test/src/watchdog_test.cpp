@@ -0,0 +1,102 @@
+// Standard headers
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Application headers
+#include "flight_recorder.h"
+#include "util.h"
+#include "watchdog.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(Watchdog, TestCheck)
+{
+  acdisplay::cWatchdog watchdog;
+  watchdog.SetStallThresholdMS(1000);
+
+  const std::array<bool, acdisplay::WATCHDOG_STAGE_COUNT> ingest_only = { true, false };
+  const std::array<bool, acdisplay::WATCHDOG_STAGE_COUNT> both = { true, true };
+
+  // Making progress
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::INGEST, 10000);
+  EXPECT_TRUE(watchdog.Check(10500, ingest_only).empty());
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::INGEST, 10900);
+  EXPECT_TRUE(watchdog.Check(11800, ingest_only).empty());
+
+  // Stalled, this is only reported once
+  std::vector<acdisplay::WATCHDOG_STAGE> stalled = watchdog.Check(12000, ingest_only);
+  ASSERT_EQ(1, stalled.size());
+  EXPECT_EQ(acdisplay::WATCHDOG_STAGE::INGEST, stalled[0]);
+  EXPECT_TRUE(watchdog.Check(12500, ingest_only).empty());
+
+  // Recovered and stalled again
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::INGEST, 13000);
+  EXPECT_TRUE(watchdog.Check(13000, ingest_only).empty());
+  EXPECT_EQ(1, watchdog.Check(14500, ingest_only).size());
+
+  // Broadcast is timed from when it is first expected to make progress, not from when it last made progress
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::INGEST, 20000);
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::BROADCAST, 1000);
+  EXPECT_TRUE(watchdog.Check(20000, both).empty());
+  watchdog.Progress(acdisplay::WATCHDOG_STAGE::INGEST, 20800);
+  stalled = watchdog.Check(21500, both);
+  ASSERT_EQ(1, stalled.size());
+  EXPECT_EQ(acdisplay::WATCHDOG_STAGE::BROADCAST, stalled[0]);
+
+  // Stages that aren't expected to make progress never stall
+  EXPECT_TRUE(watchdog.Check(21800, { false, false }).empty());
+  EXPECT_TRUE(watchdog.Check(30000, { false, false }).empty());
+}
+
+TEST(Watchdog, TestWriteStallReport)
+{
+  const std::filesystem::path folder = std::filesystem::temp_directory_path() / "ac_display_watchdog_test";
+  std::filesystem::remove_all(folder);
+
+  acdisplay::flight_recorder.Record("Websocket client 7 connected, 1 clients");
+
+  const std::string file_path = acdisplay::WriteStallReport(folder.string(), "broadcast stage made no progress");
+  ASSERT_FALSE(file_path.empty());
+
+  std::string contents;
+  ASSERT_TRUE(util::ReadFileIntoString(file_path, 1024 * 1024, contents));
+  EXPECT_NE(std::string::npos, contents.find("Stall: broadcast stage made no progress"));
+  EXPECT_NE(std::string::npos, contents.find("Websocket client 7 connected, 1 clients"));
+  EXPECT_NE(std::string::npos, contents.find("unit_tests"));
+  EXPECT_NE(std::string::npos, contents.find("acdisplay_acudp_packets_received"));
+
+  std::filesystem::remove_all(folder);
+}
+
+TEST(Watchdog, TestRemoveOldStallReports)
+{
+  const std::filesystem::path folder = std::filesystem::temp_directory_path() / "ac_display_watchdog_remove_test";
+  std::filesystem::remove_all(folder);
+  std::filesystem::create_directories(folder);
+
+  for (size_t i = 0; i < 5; i++) {
+    const std::string file_path_prefix = (folder / ("stall_100000000000" + std::to_string(i))).string();
+    std::ofstream(file_path_prefix + ".txt")<<"Stall";
+    std::ofstream(file_path_prefix + "_trace.json")<<"{}";
+  }
+  std::ofstream((folder / "other.txt").string())<<"Not a report";
+
+  // Only the newest reports and their traces are kept, anything else in the folder is left alone
+  acdisplay::RemoveOldStallReports(folder.string(), 2);
+  EXPECT_FALSE(std::filesystem::exists(folder / "stall_1000000000002.txt"));
+  EXPECT_FALSE(std::filesystem::exists(folder / "stall_1000000000002_trace.json"));
+  EXPECT_TRUE(std::filesystem::exists(folder / "stall_1000000000003.txt"));
+  EXPECT_TRUE(std::filesystem::exists(folder / "stall_1000000000004_trace.json"));
+  EXPECT_TRUE(std::filesystem::exists(folder / "other.txt"));
+
+  size_t count = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(folder)) {
+    (void)entry;
+    count++;
+  }
+  EXPECT_EQ(5, count);
+
+  std::filesystem::remove_all(folder);
+}
@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 // Application headers
+#include "ac_data.h"
 #include "gnutlsmm.h"
 #include "poll_helper.h"
 #include "tcp_connection.h"
@@ -472,6 +473,49 @@ TEST_F(WebServerTest, TestResources)
   EXPECT_STREQ("image/svg+xml", response.headers.content_type.c_str());
   EXPECT_TRUE(response.content == expected_content_favicon_svg);
 
+  // Dynamic resources
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/session_statistics", response));
+  EXPECT_EQ(200, response.headers.response_code);
+  EXPECT_STREQ("application/json", response.headers.content_type.c_str());
+  EXPECT_FALSE(response.content.empty());
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/trace", response));
+  EXPECT_EQ(200, response.headers.response_code);
+  EXPECT_STREQ("application/json", response.headers.content_type.c_str());
+  EXPECT_NE(std::string::npos, std::string(response.content.data(), response.content.size()).find("\"name\":\"http_request\""));
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/metrics", response));
+  EXPECT_EQ(200, response.headers.response_code);
+  EXPECT_STREQ("text/plain; version=0.0.4", response.headers.content_type.c_str());
+  EXPECT_NE(std::string::npos, std::string(response.content.data(), response.content.size()).find("\nacdisplay_websocket_clients 0\n"));
+
+  // The telemetry groups that no client is subscribed to are stale, so they are left out
+  {
+    std::lock_guard lock(mutex_ac_data);
+    ac_data.telemetry.core.rpm = 4321.0f;
+    ac_data.telemetry.wheels.load[0] = 1234.0f;
+    ac_data.telemetry_groups = acdisplay::TELEMETRY_CORE_GROUP;
+  }
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/telemetry.csv", response));
+  EXPECT_EQ(200, response.headers.response_code);
+  EXPECT_STREQ("text/csv", response.headers.content_type.c_str());
+  std::string telemetry_csv(response.content.data(), response.content.size());
+  EXPECT_NE(std::string::npos, telemetry_csv.find(",rpm,"));
+  EXPECT_NE(std::string::npos, telemetry_csv.find("4321"));
+  EXPECT_EQ(std::string::npos, telemetry_csv.find("load_0"));
+  EXPECT_EQ(std::string::npos, telemetry_csv.find("1234"));
+  {
+    std::lock_guard lock(mutex_ac_data);
+    ac_data.telemetry_groups = acdisplay::TELEMETRY_CORE_GROUP | acdisplay::GetTelemetryGroupMask(acdisplay::TELEMETRY_GROUP::wheels);
+  }
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/telemetry.csv", response));
+  EXPECT_EQ(200, response.headers.response_code);
+  telemetry_csv.assign(response.content.data(), response.content.size());
+  EXPECT_NE(std::string::npos, telemetry_csv.find("load_0"));
+  EXPECT_NE(std::string::npos, telemetry_csv.find("1234"));
+  {
+    std::lock_guard lock(mutex_ac_data);
+    ac_data = cACData();
+  }
+
   // Resources that have extra data on the end which will be trimmed and match the real file
   EXPECT_TRUE(PerformHTTPSGetRequestString("/style.css?something_else", response));
   EXPECT_EQ(200, response.headers.response_code);
@@ -526,3 +570,24 @@ TEST_F(WebServerTest, TestResources)
   EXPECT_STREQ(response.headers.raw_headers["Cross-Origin-Resource-Policy"].c_str(), "same-origin");
   EXPECT_STREQ(response.headers.raw_headers["Cache-Control"].c_str(), "must-revalidate, max-age=600");
 }
+
+TEST_F(WebServerTest, TestRebind)
+{
+  cHTTPResponse response;
+
+  // Move to a new port
+  const uint16_t new_port = port + 1;
+  ASSERT_TRUE(web_server_manager.Rebind(host, new_port, "./server.key", "./server.crt"));
+  EXPECT_TRUE(PerformHTTPSGetRequest(std::string("/"), new_port, "./server.crt", response));
+  EXPECT_EQ(200, response.headers.response_code);
+
+  // Move back to the original port
+  ASSERT_TRUE(web_server_manager.Rebind(host, port, "./server.key", "./server.crt"));
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/", response));
+  EXPECT_EQ(200, response.headers.response_code);
+
+  // If the new settings are bad we keep the current server
+  EXPECT_FALSE(web_server_manager.Rebind(host, new_port, "./missing.key", "./missing.crt"));
+  EXPECT_TRUE(PerformHTTPSGetRequestString("/", response));
+  EXPECT_EQ(200, response.headers.response_code);
+}
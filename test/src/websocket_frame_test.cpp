@@ -0,0 +1,113 @@
+// Standard headers
+#include <cstdlib>
+#include <string>
+
+// microhttpd headers
+#include <microhttpd.h>
+#include <microhttpd_ws.h>
+
+// Application headers
+#include "websocket_frame.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+// Our frames must be byte for byte what libmicrohttpd_ws would have sent
+std::string EncodeWithMHD(const std::string& payload)
+{
+  struct MHD_WebSocketStream* ws = nullptr;
+  EXPECT_EQ(MHD_WEBSOCKET_STATUS_OK, MHD_websocket_stream_init(&ws, MHD_WEBSOCKET_FLAG_SERVER | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0));
+
+  char* frame_data = nullptr;
+  size_t frame_len = 0;
+  EXPECT_EQ(MHD_WEBSOCKET_STATUS_OK, MHD_websocket_encode_text(ws, payload.data(), payload.size(), MHD_WEBSOCKET_FRAGMENTATION_NONE, &frame_data, &frame_len, nullptr));
+
+  const std::string frame(frame_data, frame_len);
+  MHD_websocket_free(ws, frame_data);
+  MHD_websocket_stream_free(ws);
+  return frame;
+}
+
+// Client mode needs random numbers to mask the frames it sends, we only decode
+size_t RandomNumberGenerator(void* cls, void* buf, size_t buf_len)
+{
+  (void)cls;
+  (void)buf;
+  return buf_len;
+}
+
+}
+
+TEST(WebSocketFrame, TestHeader)
+{
+  uint8_t header[acdisplay::WEBSOCKET_MAX_FRAME_HEADER_BYTES];
+
+  EXPECT_EQ(2, acdisplay::WriteWebSocketFrameHeader(acdisplay::WEBSOCKET_OPCODE::TEXT, 0, header));
+  EXPECT_EQ(0x81, header[0]);
+  EXPECT_EQ(0, header[1]);
+
+  EXPECT_EQ(2, acdisplay::WriteWebSocketFrameHeader(acdisplay::WEBSOCKET_OPCODE::BINARY, 125, header));
+  EXPECT_EQ(0x82, header[0]);
+  EXPECT_EQ(125, header[1]);
+
+  EXPECT_EQ(4, acdisplay::WriteWebSocketFrameHeader(acdisplay::WEBSOCKET_OPCODE::TEXT, 126, header));
+  EXPECT_EQ(126, header[1]);
+  EXPECT_EQ(0, header[2]);
+  EXPECT_EQ(126, header[3]);
+
+  EXPECT_EQ(4, acdisplay::WriteWebSocketFrameHeader(acdisplay::WEBSOCKET_OPCODE::TEXT, 65535, header));
+  EXPECT_EQ(0xFF, header[2]);
+  EXPECT_EQ(0xFF, header[3]);
+
+  EXPECT_EQ(10, acdisplay::WriteWebSocketFrameHeader(acdisplay::WEBSOCKET_OPCODE::TEXT, 65536, header));
+  EXPECT_EQ(127, header[1]);
+  for (size_t i = 2; i < 7; i++) {
+    EXPECT_EQ(0, header[i]);
+  }
+  EXPECT_EQ(1, header[7]);
+  EXPECT_EQ(0, header[8]);
+  EXPECT_EQ(0, header[9]);
+}
+
+TEST(WebSocketFrame, TestTextFrameMatchesMHD)
+{
+  std::string frame;
+  for (size_t length : { 0, 1, 125, 126, 127, 200, 65535, 65536, 100000 }) {
+    const std::string payload(length, 'a' + char(length % 26));
+    acdisplay::EncodeWebSocketFrame(acdisplay::WEBSOCKET_OPCODE::TEXT, payload, frame);
+    EXPECT_EQ(EncodeWithMHD(payload), frame)<<"Payload length "<<length;
+  }
+}
+
+TEST(WebSocketFrame, TestClientCanDecode)
+{
+  struct MHD_WebSocketStream* ws = nullptr;
+  ASSERT_EQ(MHD_WEBSOCKET_STATUS_OK, MHD_websocket_stream_init2(&ws, MHD_WEBSOCKET_FLAG_CLIENT | MHD_WEBSOCKET_FLAG_NO_FRAGMENTS, 0, malloc, realloc, free, nullptr, RandomNumberGenerator));
+
+  std::string frame;
+  acdisplay::EncodeWebSocketFrame(acdisplay::WEBSOCKET_OPCODE::TEXT, "car_update|4|0.5", frame);
+
+  size_t offset = 0;
+  char* payload = nullptr;
+  size_t payload_length = 0;
+  EXPECT_EQ(MHD_WEBSOCKET_STATUS_TEXT_FRAME, MHD_websocket_decode(ws, frame.data(), frame.size(), &offset, &payload, &payload_length));
+  EXPECT_EQ(frame.size(), offset);
+  EXPECT_EQ("car_update|4|0.5", std::string(payload, payload_length));
+  MHD_websocket_free(ws, payload);
+
+  acdisplay::EncodeWebSocketCloseFrame(MHD_WEBSOCKET_CLOSEREASON_REGULAR, frame);
+  EXPECT_EQ(std::string("\x88\x02\x03\xE8", 4), frame);
+
+  offset = 0;
+  payload = nullptr;
+  payload_length = 0;
+  EXPECT_EQ(MHD_WEBSOCKET_STATUS_CLOSE_FRAME, MHD_websocket_decode(ws, frame.data(), frame.size(), &offset, &payload, &payload_length));
+  EXPECT_EQ(frame.size(), offset);
+  if (payload != nullptr) {
+    MHD_websocket_free(ws, payload);
+  }
+
+  MHD_websocket_stream_free(ws);
+}
@@ -0,0 +1,188 @@
+// Standard headers
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Application headers
+#include "ac_data.h"
+#include "websocket_messages.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+TEST(WebSocketMessages, TestCarConfig)
+{
+  cACData data;
+  data.config_rpm_red_line = 7200.0f;
+  data.config_rpm_maximum = 7500.0f;
+  data.config_speedometer_red_line_kph = 200.5f;
+  data.config_speedometer_maximum_kph = 220.0f;
+
+  EXPECT_EQ("car_config|7200.000000|7500.000000|200.500000|220.000000", acdisplay::GetCarConfigMessage(data));
+}
+
+TEST(WebSocketMessages, TestCarUpdate)
+{
+  cACData data;
+  data.telemetry.core.gear = 4;
+  data.telemetry.core.accelerator_0_to_1 = 0.5f;
+  data.telemetry.core.brake_0_to_1 = 0.0f;
+  data.telemetry.core.clutch_0_to_1 = 1.0f;
+  data.telemetry.core.rpm = 6543.25f;
+  data.telemetry.core.speed_kmh = 163.5f;
+  data.telemetry.core.lap_time_ms = 54321;
+  data.telemetry.core.last_lap_ms = 104567;
+  data.telemetry.core.best_lap_ms = 103987;
+  data.telemetry.core.lap_count = 7;
+  data.telemetry.core.shift_lights = 31;
+  data.telemetry.core.current_sector = 1;
+  data.telemetry.core.current_sector_ms = 21034;
+  data.telemetry.core.wheel_slip = 2;
+  data.telemetry.core.track_position_index = 312;
+  data.telemetry.core.published_time_us = 987654321;
+
+  EXPECT_EQ("car_update|4|0.500000|0.000000|1.000000|6543.250000|163.500000|54321|104567|103987|7|31|1|21034|2|312|987654321", acdisplay::GetCarUpdateMessage(data));
+}
+
+TEST(WebSocketMessages, TestTelemetryChannels)
+{
+  std::string message;
+  acdisplay::FormatTelemetryChannelsMessage(acdisplay::TELEMETRY_CAR_UPDATE_CHANNELS, message);
+  EXPECT_TRUE(message.starts_with("telemetry_channels|gear,u8,1,,1|accelerator_0_to_1,u8,255,,1|"));
+  EXPECT_TRUE(message.ends_with("|published_time_us,u64,1,us,1"));
+
+  // One field for each value in car_update
+  const std::string car_update = acdisplay::GetCarUpdateMessage(cACData());
+  EXPECT_EQ(std::count(message.begin(), message.end(), '|'), std::count(car_update.begin(), car_update.end(), '|'));
+
+  // And with the other groups
+  const uint32_t groups = acdisplay::ParseTelemetryGroups("wheels,position");
+  acdisplay::FormatTelemetryChannelsMessage(acdisplay::GetTelemetryGroupChannels(groups), message);
+  EXPECT_TRUE(message.ends_with("|car_position_normalized,f32,1,,1|car_coordinates,f32,1,m,3"));
+
+  std::string car_update_groups;
+  acdisplay::FormatCarUpdateMessage(cACData(), groups, car_update_groups);
+  EXPECT_TRUE(car_update_groups.starts_with(car_update + "|"));
+  EXPECT_EQ(std::count(message.begin(), message.end(), '|'), std::count(car_update_groups.begin(), car_update_groups.end(), '|'));
+}
+
+TEST(WebSocketMessages, TestCarUpdateBinary)
+{
+  cACData data;
+  data.telemetry.core.gear = 4;
+  data.telemetry.core.accelerator_0_to_1 = 1.0f;
+  data.telemetry.core.published_time_us = 987654321;
+
+  std::string message;
+  acdisplay::FormatCarUpdateBinaryMessage(data, message);
+  ASSERT_EQ(1 + acdisplay::GetTelemetryBinarySize(acdisplay::TELEMETRY_CAR_UPDATE_CHANNELS), message.size());
+  EXPECT_EQ(uint8_t(acdisplay::BINARY_MESSAGE_TYPE::CAR_UPDATE), uint8_t(message[0]));
+  EXPECT_EQ(4, uint8_t(message[1]));
+  EXPECT_EQ(255, uint8_t(message[2]));
+
+  uint64_t published_time_us = 0;
+  std::memcpy(&published_time_us, message.data() + message.size() - sizeof(published_time_us), sizeof(published_time_us));
+  EXPECT_EQ(987654321, published_time_us);
+
+  // The wheels come after the core channels
+  data.telemetry.wheels.load = { 1000.0f, 2000.0f, 3000.0f, 4000.0f };
+  acdisplay::FormatCarUpdateBinaryMessage(data, acdisplay::ParseTelemetryGroups("wheels"), message);
+  ASSERT_EQ(1 + acdisplay::GetTelemetryBinarySize(acdisplay::TELEMETRY_CAR_UPDATE_CHANNELS) + (13 * 4 * sizeof(float)), message.size());
+
+  // Skip the channels before load
+  const uint64_t wheels = acdisplay::GetTelemetryGroupChannels(acdisplay::ParseTelemetryGroups("wheels"));
+  const size_t offset = 1 + acdisplay::GetTelemetryBinarySize(wheels & (acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::load) - 1));
+  float load = 0.0f;
+  std::memcpy(&load, message.data() + offset + (3 * sizeof(load)), sizeof(load));
+  EXPECT_EQ(4000.0f, load);
+}
+
+TEST(WebSocketMessages, TestCarUpdateBatch)
+{
+  std::vector<acdisplay::cTelemetry> samples(3);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i].core.gear = uint8_t(2 + i);
+    samples[i].core.rpm = 5000.0f + (1000.0f * i);
+    samples[i].core.published_time_us = 1000000 + (3000 * i);
+  }
+
+  std::string message;
+  acdisplay::FormatCarUpdateBatchBinaryMessage(samples, acdisplay::TELEMETRY_CORE_GROUP, message);
+
+  // The header, the sample times, and then each channel apart from published_time_us
+  const size_t header_size = 1 + sizeof(uint16_t) + sizeof(uint64_t);
+  const size_t times_size = 3 * sizeof(uint32_t);
+  ASSERT_EQ(header_size + times_size + (3 * acdisplay::GetTelemetryBinarySize(acdisplay::GetTelemetryGroupBatchChannels(acdisplay::TELEMETRY_CORE_GROUP))), message.size());
+  EXPECT_EQ(uint8_t(acdisplay::BINARY_MESSAGE_TYPE::CAR_UPDATE_BATCH), uint8_t(message[0]));
+
+  uint16_t count = 0;
+  std::memcpy(&count, message.data() + 1, sizeof(count));
+  EXPECT_EQ(3, count);
+
+  uint64_t base_time_us = 0;
+  std::memcpy(&base_time_us, message.data() + 1 + sizeof(uint16_t), sizeof(base_time_us));
+  EXPECT_EQ(1000000, base_time_us);
+
+  uint32_t time_offset_us = 0;
+  std::memcpy(&time_offset_us, message.data() + header_size + (2 * sizeof(uint32_t)), sizeof(time_offset_us));
+  EXPECT_EQ(6000, time_offset_us);
+
+  // gear is first, one byte for each sample
+  const size_t gear_offset = header_size + times_size;
+  EXPECT_EQ(2, uint8_t(message[gear_offset]));
+  EXPECT_EQ(3, uint8_t(message[gear_offset + 1]));
+  EXPECT_EQ(4, uint8_t(message[gear_offset + 2]));
+
+  // Then rpm after the pedals
+  const size_t rpm_offset = gear_offset + (3 * acdisplay::GetTelemetryBinarySize(acdisplay::GetTelemetryChannelMask(acdisplay::TELEMETRY_CHANNEL::rpm) - 1));
+  uint16_t rpm = 0;
+  std::memcpy(&rpm, message.data() + rpm_offset + sizeof(rpm), sizeof(rpm));
+  EXPECT_EQ(6000, rpm);
+
+  // An empty batch is just the header
+  samples.clear();
+  acdisplay::FormatCarUpdateBatchBinaryMessage(samples, acdisplay::TELEMETRY_CORE_GROUP, message);
+  EXPECT_EQ(header_size, message.size());
+}
+
+TEST(WebSocketMessages, TestSectorTimes)
+{
+  acdisplay::cSectorTimes sector_times;
+  sector_times.last_completed_sector = 2;
+  sector_times.last_ms = { 33210, 35871, 35486 };
+  sector_times.best_ms = { 33002, 35710, 35275 };
+  sector_times.theoretical_best_lap_ms = 103987;
+
+  EXPECT_EQ("sector_times|2|33210|35871|35486|33002|35710|35275|103987", acdisplay::GetSectorTimesMessage(sector_times));
+}
+
+TEST(WebSocketMessages, TestTrackMap)
+{
+  acdisplay::cTrackMap map;
+  map.points.push_back({ 0, 1.5f, -2.0f });
+  map.points.push_back({ 10, 3.0f, 4.25f });
+
+  EXPECT_EQ("track_map|" + std::to_string(acdisplay::TRACK_MAP_BIN_COUNT) + "|0,1.500000,-2.000000|10,3.000000,4.250000", acdisplay::GetTrackMapMessage(map));
+}
+
+TEST(WebSocketMessages, TestLeaderboardRow)
+{
+  acdisplay::cLeaderboardEntry entry;
+  entry.car_identifier = 3;
+  entry.driver_name = "Driver|One";
+  entry.car_name = "ks,mazda";
+  entry.laps = 5;
+  entry.last_lap_ms = 104567;
+  entry.best_lap_ms = 103987;
+  entry.total_ms = 523456;
+  entry.changed_sequence = 0;
+
+  // Names can't break the message format
+  EXPECT_EQ("3,5,104567,103987,523456,Driver One,ks mazda", acdisplay::GetLeaderboardRow(entry));
+
+  // Names are sent in text frames so they must be valid UTF-8, anything else is replaced
+  entry.driver_name = "J\xC3\xBCrgen";
+  entry.car_name = "bad\xFF\xC3\xE2\x82 name\xED\xA0\x80";
+  EXPECT_EQ("3,5,104567,103987,523456,J\xC3\xBCrgen,bad???? name???", acdisplay::GetLeaderboardRow(entry));
+}
@@ -0,0 +1,121 @@
+// Application headers
+#include "wheel_slip.h"
+
+// gtest headers
+#include <gtest/gtest.h>
+
+namespace {
+
+const float tyre_radius[acdisplay::WHEEL_COUNT] = { 0.3f, 0.3f, 0.33f, 0.33f };
+const float load[acdisplay::WHEEL_COUNT] = { 3000.0f, 3000.0f, 3500.0f, 3500.0f };
+
+// Set the wheel angular speeds so that each wheel has the requested slip at this speed
+void SetSlip(float speed_ms, const float slip[acdisplay::WHEEL_COUNT], float out_wheel_angular_speed[acdisplay::WHEEL_COUNT])
+{
+  for (size_t i = 0; i < acdisplay::WHEEL_COUNT; i++) {
+    out_wheel_angular_speed[i] = (speed_ms * (1.0f + slip[i])) / tyre_radius[i];
+  }
+}
+
+}
+
+TEST(WheelSlip, TestNoSlip)
+{
+  acdisplay::cWheelSlipDetector detector;
+
+  const float speed_ms = 30.0f;
+  const float slip[acdisplay::WHEEL_COUNT] = { 0.0f, 0.05f, -0.05f, 0.08f };
+  float wheel_angular_speed[acdisplay::WHEEL_COUNT];
+  SetSlip(speed_ms, slip, wheel_angular_speed);
+
+  EXPECT_EQ(0, detector.Update(speed_ms, wheel_angular_speed, tyre_radius, load));
+}
+
+TEST(WheelSlip, TestLockupAndWheelspinWithHysteresis)
+{
+  acdisplay::cWheelSlipDetector detector;
+
+  const float speed_ms = 30.0f;
+  float wheel_angular_speed[acdisplay::WHEEL_COUNT];
+
+  // Front left locks up, rear right spins
+  {
+    const float slip[acdisplay::WHEEL_COUNT] = { -0.5f, 0.0f, 0.0f, 0.5f };
+    SetSlip(speed_ms, slip, wheel_angular_speed);
+    EXPECT_EQ(0x01 | 0x80, detector.Update(speed_ms, wheel_angular_speed, tyre_radius, load));
+  }
+
+  // Between the on and off thresholds the flags stay on, but new wheels are not flagged
+  {
+    const float slip[acdisplay::WHEEL_COUNT] = { -0.15f, -0.15f, 0.15f, 0.15f };
+    SetSlip(speed_ms, slip, wheel_angular_speed);
+    EXPECT_EQ(0x01 | 0x80, detector.Update(speed_ms, wheel_angular_speed, tyre_radius, load));
+  }
+
+  // Back past the off thresholds
+  {
+    const float slip[acdisplay::WHEEL_COUNT] = { -0.05f, -0.15f, 0.15f, 0.05f };
+    SetSlip(speed_ms, slip, wheel_angular_speed);
+    EXPECT_EQ(0, detector.Update(speed_ms, wheel_angular_speed, tyre_radius, load));
+  }
+
+  // Wheels spinning backwards are the same as forwards
+  {
+    const float slip[acdisplay::WHEEL_COUNT] = { 0.0f, 0.5f, 0.0f, 0.0f };
+    SetSlip(speed_ms, slip, wheel_angular_speed);
+    wheel_angular_speed[1] = -wheel_angular_speed[1];
+    EXPECT_EQ(0x20, detector.Update(speed_ms, wheel_angular_speed, tyre_radius, load));
+  }
+}
+
+TEST(WheelSlip, TestIgnored)
+{
+  acdisplay::cWheelSlipDetector detector;
+
+  const float slip[acdisplay::WHEEL_COUNT] = { -1.0f, -1.0f, 0.5f, 0.5f };
+  float wheel_angular_speed[acdisplay::WHEEL_COUNT];
+
+  // Too slow for the slip to mean anything
+  SetSlip(1.0f, slip, wheel_angular_speed);
+  EXPECT_EQ(0, detector.Update(1.0f, wheel_angular_speed, tyre_radius, load));
+
+  // Wheels in the air are not flagged
+  const float airborne_load[acdisplay::WHEEL_COUNT] = { 0.0f, 3000.0f, 0.0f, 3500.0f };
+  SetSlip(30.0f, slip, wheel_angular_speed);
+  EXPECT_EQ(0x02 | 0x80, detector.Update(30.0f, wheel_angular_speed, tyre_radius, airborne_load));
+}
+
+TEST(WheelSlip, TestScalarMatchesUpdate)
+{
+  // Update uses SSE2 on x86, so the plain loop wouldn't be tested here otherwise
+  acdisplay::cWheelSlipDetector detector;
+  acdisplay::cWheelSlipDetector detector_scalar;
+
+  const float speeds_ms[] = { 1.0f, 3.0f, 30.0f, 80.0f };
+  const float airborne_load[acdisplay::WHEEL_COUNT] = { 0.0f, 3000.0f, 49.0f, 3500.0f };
+
+  size_t flagged_count = 0;
+  for (auto&& speed_ms : speeds_ms) {
+    // Sweep each wheel up past the wheelspin thresholds and back down past the lockup thresholds, at different offsets so the wheels are in different states
+    for (int step = -60; step <= 180; step++) {
+      const int phase = (step <= 60) ? step : (120 - step);
+      float slip[acdisplay::WHEEL_COUNT];
+      for (size_t i = 0; i < acdisplay::WHEEL_COUNT; i++) {
+        slip[i] = 0.01f * float(phase - (10 * int(i)));
+      }
+
+      float wheel_angular_speed[acdisplay::WHEEL_COUNT];
+      SetSlip(speed_ms, slip, wheel_angular_speed);
+      const float* wheel_load = ((step % 7) == 0) ? airborne_load : load;
+
+      const uint8_t state = detector.Update(speed_ms, wheel_angular_speed, tyre_radius, wheel_load);
+      ASSERT_EQ(state, detector_scalar.UpdateScalar(speed_ms, wheel_angular_speed, tyre_radius, wheel_load)) << "speed " << speed_ms << ", step " << step;
+      if (state != 0) {
+        flagged_count++;
+      }
+    }
+  }
+
+  // Make sure the sweep actually flagged something
+  EXPECT_NE(0, flagged_count);
+}